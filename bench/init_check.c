@@ -0,0 +1,103 @@
+/*
+ * Benchmark of the "is logger initialized" check done on every log call.
+ * Compares shared atomic_flag test-and-set (used before) with per-thread enter/leave
+ * and read only instance pointer load, for 1 to N threads.
+ *
+ * Usage: ./bench_init_check.out [max_threads] [iterations_per_thread]
+ * Output: CSV - check,threads,ns_per_call,calls_per_sec
+ * */
+#include <../src/mylogger.c>    // Including .c gives access to static functions.
+
+#define BENCH_DEFAULT_ITERATIONS 10000000UL
+
+typedef enum bench_check_t
+{
+    BENCH_CHECK_TEST_AND_SET,
+    BENCH_CHECK_ENTER_LEAVE
+} bench_check_t;
+
+typedef struct bench_args_t
+{
+    bench_check_t check;
+    size_t iterations;
+    pthread_barrier_t* barrier;
+    size_t initialized;
+} bench_args_t;
+
+static atomic_flag g_bench_flag = ATOMIC_FLAG_INIT;
+
+static void* bench_worker(void* arg)
+{
+    bench_args_t* args = arg;
+    size_t initialized = 0;
+
+    pthread_barrier_wait(args->barrier);
+    if(args->check == BENCH_CHECK_TEST_AND_SET)
+    {
+        for(size_t i = 0; i < args->iterations; i++)
+            initialized += atomic_flag_test_and_set(&g_bench_flag) ? 1 : 0;
+    }
+    else
+    {
+        for(size_t i = 0; i < args->iterations; i++)
+        {
+            initialized += __mylogger_enter() != NULL ? 1 : 0;
+            __mylogger_leave();
+        }
+    }
+    args->initialized = initialized;
+    return NULL;
+}
+
+static double bench_run(bench_check_t check, size_t threads, size_t iterations)
+{
+    pthread_t tids[threads];
+    bench_args_t args[threads];
+    pthread_barrier_t barrier;
+    pthread_barrier_init(&barrier, NULL, (unsigned)threads + 1);
+
+    for(size_t i = 0; i < threads; i++)
+    {
+        args[i] = (bench_args_t){.check = check, .iterations = iterations, .barrier = &barrier};
+        pthread_create(&tids[i], NULL, bench_worker, &args[i]);
+    }
+
+    struct timespec start, end;
+    pthread_barrier_wait(&barrier);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for(size_t i = 0; i < threads; i++)
+        pthread_join(tids[i], NULL);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    pthread_barrier_destroy(&barrier);
+    return (double)(end.tv_sec - start.tv_sec) * 1e9 + (double)(end.tv_nsec - start.tv_nsec);
+}
+
+int main(int argc, char** argv)
+{
+    const long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    const size_t max_threads = argc > 1 ? strtoul(argv[1], NULL, 10) : (size_t)(cpus > 0 ? cpus : 1);
+    const size_t iterations = argc > 2 ? strtoul(argv[2], NULL, 10) : BENCH_DEFAULT_ITERATIONS;
+
+    atomic_flag_test_and_set(&g_bench_flag);
+    if(mylogger_init(NULL, MYLOGGER_FEATURE_NO_FILE | MYLOGGER_FEATURE_STDOUT) != MYLOGGER_INIT_SUCCESS)
+        return 1;
+
+    static const char* names[] = {"test_and_set", "enter_leave"};
+    printf("check,threads,ns_per_call,calls_per_sec\n");
+    for(size_t threads = 1; threads <= max_threads; threads = threads < max_threads && threads * 2 > max_threads ? max_threads : threads * 2)
+    {
+        for(bench_check_t check = BENCH_CHECK_TEST_AND_SET; check <= BENCH_CHECK_ENTER_LEAVE; check++)
+        {
+            const double elapsed_ns = bench_run(check, threads, iterations);
+            printf("%s,%zu,%.2f,%.0f\n",
+                   names[check],
+                   threads,
+                   elapsed_ns / (double)iterations,
+                   (double)(threads * iterations) / elapsed_ns * 1e9);
+        }
+    }
+
+    mylogger_destroy();
+    return 0;
+}
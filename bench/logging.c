@@ -0,0 +1,381 @@
+/*
+ * Benchmark of log calls: per-call latency percentiles and throughput for 1 to N threads
+ * across outputs, features, mode (sync, sync with batches of BENCH_BATCH_MESSAGES, async, async with
+ * io_uring log file) and message sizes.
+ *
+ * Outputs:
+ * - devnull    - log file /dev/null
+ * - tmpfs      - log file in /dev/shm (skipped when it does not exist)
+ * - file       - log file in the current directory
+ * - stdout     - MYLOGGER_FEATURE_STDOUT | NO_FILE, stdout is redirected to /dev/null during the run
+ * - sink       - MYLOGGER_FEATURE_NO_FILE with a custom sink that drops everything (formatting and locking only)
+ *
+ * Latency is measured around every call with rdtsc on x86 (calibrated against CLOCK_MONOTONIC) and
+ * clock_gettime(CLOCK_MONOTONIC) elsewhere. calls_per_sec counts log calls only, end_to_end_per_sec
+ * includes mylogger_destroy(), which writes out everything buffered by ASYNC mode.
+ *
+ * Usage: ./bench_logging.out [-t max_threads] [-n messages_per_thread] [-f csv|json]
+ * Output: CSV - output,features,mode,threads,msg_size,messages,p50_ns,p99_ns,p999_ns,max_ns,calls_per_sec,end_to_end_per_sec
+ *         JSON - array of objects with the same keys
+ * */
+#include <mylogger/mylogger.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+#define BENCH_DEFAULT_MESSAGES  10000UL
+#define BENCH_MAX_MSG_SIZE      1024
+#define BENCH_BATCH_MESSAGES    1000
+#define BENCH_FILE_NAME         "bench_logging_tmp.txt"
+#define BENCH_TMPFS_FILE_NAME   "/dev/shm/" BENCH_FILE_NAME
+
+typedef enum bench_output_t
+{
+    BENCH_OUTPUT_DEVNULL,
+    BENCH_OUTPUT_TMPFS,
+    BENCH_OUTPUT_FILE,
+    BENCH_OUTPUT_STDOUT,
+    BENCH_OUTPUT_SINK,
+    BENCH_OUTPUTS_COUNT
+} bench_output_t;
+
+typedef struct bench_case_t
+{
+    bench_output_t output;
+    size_t features;            // index to g_bench_features
+    size_t mode;                // index to g_bench_modes
+    size_t threads;
+    size_t msg_size;
+    size_t messages;            // per thread
+} bench_case_t;
+
+typedef struct bench_result_t
+{
+    double p50_ns;
+    double p99_ns;
+    double p999_ns;
+    double max_ns;
+    double calls_per_sec;
+    double end_to_end_per_sec;
+} bench_result_t;
+
+typedef struct bench_args_t
+{
+    const bench_case_t* bench;
+    const char* payload;
+    pthread_barrier_t* barrier;
+    uint64_t* samples;          // bench->messages latencies in timer ticks
+    uint64_t start_ns;
+    uint64_t end_ns;
+} bench_args_t;
+
+static const char* g_bench_output_names[BENCH_OUTPUTS_COUNT] = {"devnull", "tmpfs", "file", "stdout", "sink"};
+static const struct
+{
+    const char* name;
+    mylogger_feature_t features;
+} g_bench_features[] = {
+    {"none", 0},
+    {"timestamps", MYLOGGER_FEATURE_TIMESTAMPS},
+    {"thread_id", MYLOGGER_FEATURE_THREAD_ID},
+    {"timestamps+thread_id", MYLOGGER_FEATURE_TIMESTAMPS | MYLOGGER_FEATURE_THREAD_ID}
+};
+static const struct
+{
+    const char* name;
+    mylogger_feature_t features;
+    bool batch;                 // every BENCH_BATCH_MESSAGES calls are committed at once
+} g_bench_modes[] = {
+    {"sync", 0, false},
+    {"sync_batch", 0, true},
+    {"async", MYLOGGER_FEATURE_ASYNC, false},
+    {"async_uring", MYLOGGER_FEATURE_ASYNC | MYLOGGER_FEATURE_IO_URING, false}  // log file outputs only, others as async
+};
+static const size_t g_bench_msg_sizes[] = {16, 128, BENCH_MAX_MSG_SIZE};
+static double g_bench_ns_per_tick = 1.0;
+
+static uint64_t bench_monotonic_ns(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+}
+
+static inline uint64_t bench_ticks(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __builtin_ia32_rdtsc();
+#else
+    return bench_monotonic_ns();
+#endif
+}
+
+static void bench_timer_calibrate(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    const uint64_t start_ns = bench_monotonic_ns();
+    const uint64_t start_ticks = bench_ticks();
+    nanosleep(&(struct timespec){.tv_sec = 0, .tv_nsec = 50000000L}, NULL);
+    const uint64_t ticks = bench_ticks() - start_ticks;
+    const uint64_t elapsed_ns = bench_monotonic_ns() - start_ns;
+    if(ticks > 0)
+        g_bench_ns_per_tick = (double)elapsed_ns / (double)ticks;
+#endif
+}
+
+static void bench_sink_write(void* user_data, const char* data, size_t len)
+{
+    (void)user_data;
+    (void)data;
+    (void)len;
+}
+
+static int bench_compare(const void* a, const void* b)
+{
+    const uint64_t x = *(const uint64_t*)a;
+    const uint64_t y = *(const uint64_t*)b;
+    return (x > y) - (x < y);
+}
+
+static void* bench_worker(void* arg)
+{
+    bench_args_t* args = arg;
+    const size_t messages = args->bench->messages;
+    const bool batch = g_bench_modes[args->bench->mode].batch;
+
+    pthread_barrier_wait(args->barrier);
+    args->start_ns = bench_monotonic_ns();
+    for(size_t i = 0; i < messages; i++)
+    {
+        // begin and commit are part of the first and the last call of the batch
+        const uint64_t start = bench_ticks();
+        if(batch && i % BENCH_BATCH_MESSAGES == 0)
+            mylogger_batch_begin();
+        MYLOGGER_INFO("%s %zu\n", args->payload, i);
+        if(batch && (i % BENCH_BATCH_MESSAGES == BENCH_BATCH_MESSAGES - 1 || i == messages - 1))
+            mylogger_batch_commit();
+        args->samples[i] = bench_ticks() - start;
+    }
+    args->end_ns = bench_monotonic_ns();
+    return NULL;
+}
+
+/**
+ * Initializes logger for the case. Returns false when the output is not available.
+ * */
+static bool bench_logger_init(const bench_case_t* bench)
+{
+    static const mylogger_sink_t sink = {.write = bench_sink_write};
+    mylogger_config_t config = {
+        .features = g_bench_features[bench->features].features | g_bench_modes[bench->mode].features
+    };
+
+    switch(bench->output)
+    {
+        case BENCH_OUTPUT_DEVNULL:
+            config.log_file = fopen("/dev/null", "w");
+            break;
+        case BENCH_OUTPUT_TMPFS:
+            config.log_file = fopen(BENCH_TMPFS_FILE_NAME, "w");
+            break;
+        case BENCH_OUTPUT_FILE:
+            config.log_file = fopen(BENCH_FILE_NAME, "w");
+            break;
+        case BENCH_OUTPUT_STDOUT:
+            config.features |= MYLOGGER_FEATURE_NO_FILE | MYLOGGER_FEATURE_STDOUT;
+            break;
+        case BENCH_OUTPUT_SINK:
+        case BENCH_OUTPUTS_COUNT:
+        default:
+            config.features |= MYLOGGER_FEATURE_NO_FILE;
+            config.sinks = &sink;
+            config.sinks_count = 1;
+            break;
+    }
+    if(config.log_file == NULL && !(config.features & MYLOGGER_FEATURE_NO_FILE))
+        return false;
+
+    if(mylogger_init_config(&config) != MYLOGGER_INIT_SUCCESS)
+    {
+        if(config.log_file != NULL)
+            fclose(config.log_file);
+        return false;
+    }
+    return true;
+}
+
+static bool bench_run(const bench_case_t* bench, bench_result_t* result)
+{
+    const size_t threads = bench->threads;
+    const size_t total = threads * bench->messages;
+    pthread_t* tids = malloc(threads * sizeof(pthread_t));
+    bench_args_t* args = malloc(threads * sizeof(bench_args_t));
+    uint64_t* samples = malloc(total * sizeof(uint64_t));
+    char payload[BENCH_MAX_MSG_SIZE + 1];
+    memset(payload, 'x', bench->msg_size);
+    payload[bench->msg_size] = '\0';
+
+    // terminal would be the bottleneck, stdout goes to /dev/null and results are printed after the run
+    int saved_stdout = -1;
+    if(bench->output == BENCH_OUTPUT_STDOUT)
+    {
+        fflush(stdout);
+        const int devnull = open("/dev/null", O_WRONLY);
+        saved_stdout = dup(STDOUT_FILENO);
+        dup2(devnull, STDOUT_FILENO);
+        close(devnull);
+    }
+
+    bool ok = tids != NULL && args != NULL && samples != NULL && bench_logger_init(bench);
+    if(ok)
+    {
+        pthread_barrier_t barrier;
+        pthread_barrier_init(&barrier, NULL, (unsigned)threads + 1);
+        for(size_t i = 0; i < threads; i++)
+        {
+            args[i] = (bench_args_t){.bench = bench, .payload = payload, .barrier = &barrier, .samples = &samples[i * bench->messages]};
+            pthread_create(&tids[i], NULL, bench_worker, &args[i]);
+        }
+
+        // main thread can be scheduled out after the barrier, workers take the time themselves
+        pthread_barrier_wait(&barrier);
+        uint64_t start_ns = UINT64_MAX;
+        uint64_t end_ns = 0;
+        for(size_t i = 0; i < threads; i++)
+        {
+            pthread_join(tids[i], NULL);
+            start_ns = args[i].start_ns < start_ns ? args[i].start_ns : start_ns;
+            end_ns = args[i].end_ns > end_ns ? args[i].end_ns : end_ns;
+        }
+        mylogger_destroy();
+        const uint64_t calls_ns = end_ns - start_ns;
+        const uint64_t end_to_end_ns = bench_monotonic_ns() - start_ns;
+        pthread_barrier_destroy(&barrier);
+
+        qsort(samples, total, sizeof(samples[0]), bench_compare);
+        *result = (bench_result_t) {
+            .p50_ns = (double)samples[total / 2] * g_bench_ns_per_tick,
+            .p99_ns = (double)samples[total * 99 / 100] * g_bench_ns_per_tick,
+            .p999_ns = (double)samples[total * 999 / 1000] * g_bench_ns_per_tick,
+            .max_ns = (double)samples[total - 1] * g_bench_ns_per_tick,
+            .calls_per_sec = (double)total / ((double)calls_ns / 1e9),
+            .end_to_end_per_sec = (double)total / ((double)end_to_end_ns / 1e9)
+        };
+    }
+
+    if(saved_stdout >= 0)
+    {
+        fflush(stdout);
+        dup2(saved_stdout, STDOUT_FILENO);
+        close(saved_stdout);
+    }
+    if(bench->output == BENCH_OUTPUT_TMPFS)
+        remove(BENCH_TMPFS_FILE_NAME);
+    else if(bench->output == BENCH_OUTPUT_FILE)
+        remove(BENCH_FILE_NAME);
+    free(samples);
+    free(args);
+    free(tids);
+    return ok;
+}
+
+static void bench_print(const bench_case_t* bench, const bench_result_t* result, bool json, bool first)
+{
+    const char* format = json ?
+        "%s{\"output\":\"%s\",\"features\":\"%s\",\"mode\":\"%s\",\"threads\":%zu,\"msg_size\":%zu,\"messages\":%zu,"
+        "\"p50_ns\":%.1f,\"p99_ns\":%.1f,\"p999_ns\":%.1f,\"max_ns\":%.1f,\"calls_per_sec\":%.0f,\"end_to_end_per_sec\":%.0f}" :
+        "%s%s,%s,%s,%zu,%zu,%zu,%.1f,%.1f,%.1f,%.1f,%.0f,%.0f\n";
+    printf(format,
+           json ? (first ? "[\n  " : ",\n  ") : "",
+           g_bench_output_names[bench->output],
+           g_bench_features[bench->features].name,
+           g_bench_modes[bench->mode].name,
+           bench->threads,
+           bench->msg_size,
+           bench->threads * bench->messages,
+           result->p50_ns,
+           result->p99_ns,
+           result->p999_ns,
+           result->max_ns,
+           result->calls_per_sec,
+           result->end_to_end_per_sec);
+    fflush(stdout);
+}
+
+int main(int argc, char** argv)
+{
+    const long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    size_t max_threads = (size_t)(cpus > 0 ? cpus : 1);
+    size_t messages = BENCH_DEFAULT_MESSAGES;
+    bool json = false;
+
+    int opt;
+    while((opt = getopt(argc, argv, "t:n:f:")) != -1)
+    {
+        switch(opt)
+        {
+            case 't':
+                max_threads = strtoul(optarg, NULL, 10);
+                break;
+            case 'n':
+                messages = strtoul(optarg, NULL, 10);
+                break;
+            case 'f':
+                json = strcmp(optarg, "json") == 0;
+                break;
+            default:
+                fprintf(stderr, "Usage: %s [-t max_threads] [-n messages_per_thread] [-f csv|json]\n", argv[0]);
+                return 1;
+        }
+    }
+    if(max_threads == 0 || messages == 0)
+        return 1;
+
+    bench_timer_calibrate();
+    if(!json)
+        printf("output,features,mode,threads,msg_size,messages,p50_ns,p99_ns,p999_ns,max_ns,calls_per_sec,end_to_end_per_sec\n");
+
+    bool first = true;
+    for(bench_output_t output = BENCH_OUTPUT_DEVNULL; output < BENCH_OUTPUTS_COUNT; output++)
+    {
+        if(output == BENCH_OUTPUT_TMPFS && access("/dev/shm", W_OK) != 0)
+        {
+            fprintf(stderr, "Skipping tmpfs output, /dev/shm is not writable\n");
+            continue;
+        }
+        for(size_t features = 0; features < sizeof(g_bench_features) / sizeof(g_bench_features[0]); features++)
+        {
+            for(size_t mode = 0; mode < sizeof(g_bench_modes) / sizeof(g_bench_modes[0]); mode++)
+            {
+                for(size_t size = 0; size < sizeof(g_bench_msg_sizes) / sizeof(g_bench_msg_sizes[0]); size++)
+                {
+                    for(size_t threads = 1; threads <= max_threads; threads = threads < max_threads && threads * 2 > max_threads ? max_threads : threads * 2)
+                    {
+                        const bench_case_t bench = {
+                            .output = output,
+                            .features = features,
+                            .mode = mode,
+                            .threads = threads,
+                            .msg_size = g_bench_msg_sizes[size],
+                            .messages = messages
+                        };
+                        bench_result_t result;
+                        if(!bench_run(&bench, &result))
+                        {
+                            fprintf(stderr, "Cannot run %s output\n", g_bench_output_names[output]);
+                            return 1;
+                        }
+                        bench_print(&bench, &result, json, first);
+                        first = false;
+                    }
+                }
+            }
+        }
+    }
+    if(json)
+        printf(first ? "[]\n" : "\n]\n");
+    return 0;
+}
@@ -20,6 +20,8 @@
 
 #include <stdint.h>
 #include <stddef.h>
+#include <stdatomic.h>
+#include <stdbool.h>
 
 typedef enum mylogger_level_t
 {
@@ -32,22 +34,136 @@ typedef enum mylogger_level_t
 } mylogger_level_t;
 
 
-typedef uint8_t mylogger_feature_t;
+typedef uint32_t mylogger_feature_t;
 #define MYLOGGER_FEATURE_STDOUT_WRAP        (1 << 0)
 #define MYLOGGER_FEATURE_STDERR_WRAP        (1 << 1)
 #define MYLOGGER_FEATURE_TIMESTAMPS_WRAP    (1 << 2)
 #define MYLOGGER_FEATURE_THREAD_ID_WRAP     (1 << 3)
 #define MYLOGGER_FEATURE_NO_FILE_WRAP       (1 << 4)
+#define MYLOGGER_FEATURE_ASYNC_WRAP         (1 << 5)
+#define MYLOGGER_FEATURE_DEFERRED_WRAP      (1 << 6)
+#define MYLOGGER_FEATURE_MMAP_WRAP          (1 << 7)
+#define MYLOGGER_FEATURE_BINARY_WRAP        (1 << 8)
+#define MYLOGGER_FEATURE_COLLAPSE_WRAP      (1 << 9)
+#define MYLOGGER_FEATURE_CRASH_HANDLER_WRAP (1 << 10)
+#define MYLOGGER_FEATURE_STATS_WRAP         (1 << 11)
+#define MYLOGGER_FEATURE_IO_URING_WRAP      (1 << 12)
+#define MYLOGGER_FEATURE_SHARED_WRAP        (1 << 13)
 
 
+#ifndef MYLOGGER_MIN_LEVEL
+#define MYLOGGER_MIN_LEVEL MYLOGGER_LEVEL_DEBUG_WRAP
+#endif
+
+extern atomic_int __mylogger_level_threshold;
+
+struct MyLogger_instance;
+// Leading part of every logger instance, read by the *_TO macros without a function call.
+typedef struct mylogger_head_t
+{
+    atomic_int level;
+} mylogger_head_t;
+
+#define MYLOGGER_SITE_UNREGISTERED_WRAP     0
+#define MYLOGGER_SITE_ENABLED_WRAP          1
+#define MYLOGGER_SITE_DISABLED_WRAP         2
+
+// Static descriptor of one log call, registered on first use.
+typedef struct mylogger_site_t
+{
+    atomic_int state;                   // MYLOGGER_SITE_*_WRAP
+    mylogger_level_t level;
+    uint32_t line;
+    const char* file;
+    const char* func;
+    atomic_uint_fast64_t hits;          // approximate when threads use the site concurrently
+    atomic_uint_fast64_t suppressed;    // rate limited or collapsed calls
+    atomic_uint_fast64_t calls;         // *_EVERY_N counter
+    atomic_uint_fast64_t limit;         // *_RATELIMIT theoretical arrival time of the next message in ns
+    atomic_uint_fast64_t last_hash;     // MYLOGGER_FEATURE_COLLAPSE hash of the last message, 0 when none
+    atomic_uint_fast64_t repeats;       // MYLOGGER_FEATURE_COLLAPSE skipped repetitions of the last message
+    _Atomic(const void*) repeats_logger;    // MYLOGGER_FEATURE_COLLAPSE instance that got the last message
+    const char* prefix;                 // "file:line func: " rendered while some instance exists
+    size_t prefix_len;
+    _Atomic(const void*) parsed;        // format string parsed at the first call, freed with the last instance
+    struct mylogger_site_t* next;       // list of registered sites
+} mylogger_site_t;
+
 void __attribute__(( format(printf, 5, 6) )) __mylogger_print(const char* file,
                       const char* func,
                       size_t line,
                       mylogger_level_t level,
                       const char* format,
                       ...);
+void __attribute__(( format(printf, 2, 3) )) __mylogger_print_site(mylogger_site_t* site, const char* format, ...);
+void __attribute__(( format(printf, 3, 4) )) __mylogger_print_site_to(struct MyLogger_instance* logger,
+                                                                      mylogger_site_t* site,
+                                                                      const char* format,
+                                                                      ...);
+struct mylogger_field_t;
+void __attribute__(( format(printf, 4, 5) )) __mylogger_print_site_kv(mylogger_site_t* site,
+                                                                      const struct mylogger_field_t* fields,
+                                                                      size_t fields_count,
+                                                                      const char* format,
+                                                                      ...);
+bool __mylogger_site_register(mylogger_site_t* site);
+bool __mylogger_site_ratelimit(mylogger_site_t* site, uint32_t rate);
+
+static inline bool __mylogger_site_every_n(mylogger_site_t* site, uint64_t n)
+{
+    if(atomic_fetch_add_explicit(&site->calls, 1, memory_order_relaxed) % (n > 0 ? n : 1) == 0)
+        return true;
+    atomic_fetch_add_explicit(&site->suppressed, 1, memory_order_relaxed);
+    return false;
+}
 
-#define MYLOGGER_GENERAL_WRAPPER(LVL, ...) __mylogger_print(__FILE__, __func__, __LINE__, LVL, __VA_ARGS__)
+// First condition is constant and removes the call at compile time. Arguments are evaluated only when level is enabled.
+#define MYLOGGER_LEVEL_ENABLED_WRAPPER(LVL) \
+    ((LVL) >= (MYLOGGER_MIN_LEVEL) && \
+     (int)(LVL) >= atomic_load_explicit(&__mylogger_level_threshold, memory_order_relaxed))
+// Acquire makes prefix rendered by the registering thread visible.
+#define MYLOGGER_SITE_ENABLED_WRAPPER(SITE) \
+    (atomic_load_explicit(&(SITE)->state, memory_order_acquire) == MYLOGGER_SITE_ENABLED_WRAP || \
+     (atomic_load_explicit(&(SITE)->state, memory_order_relaxed) == MYLOGGER_SITE_UNREGISTERED_WRAP && \
+      __mylogger_site_register(SITE)))
+// LIMIT is evaluated after site checks and can use __mylogger_site
+#define MYLOGGER_LIMITED_WRAPPER(LVL, LIMIT, ...) \
+    (MYLOGGER_LEVEL_ENABLED_WRAPPER(LVL) ? __extension__ ({ \
+        static mylogger_site_t __mylogger_site = {.level = (LVL), .line = __LINE__, .file = __FILE__, .func = __func__}; \
+        if(MYLOGGER_SITE_ENABLED_WRAPPER(&__mylogger_site) && (LIMIT)) \
+            __mylogger_print_site(&__mylogger_site, __VA_ARGS__); \
+    }) : (void)0)
+#define MYLOGGER_GENERAL_WRAPPER(LVL, ...) \
+    MYLOGGER_LIMITED_WRAPPER(LVL, true, __VA_ARGS__)
+#define MYLOGGER_EVERY_N_WRAPPER(LVL, N, ...) \
+    MYLOGGER_LIMITED_WRAPPER(LVL, __mylogger_site_every_n(&__mylogger_site, (N)), __VA_ARGS__)
+#define MYLOGGER_RATELIMIT_WRAPPER(LVL, RATE, ...) \
+    MYLOGGER_LIMITED_WRAPPER(LVL, __mylogger_site_ratelimit(&__mylogger_site, (RATE)), __VA_ARGS__)
+// LOGGER is evaluated once, NULL logger logs nothing
+#define MYLOGGER_LOGGER_WRAPPER(LOGGER, LVL, ...) \
+    __extension__ ({ \
+        struct MyLogger_instance* const __mylogger_logger = (LOGGER); \
+        if((LVL) >= (MYLOGGER_MIN_LEVEL) && __mylogger_logger != NULL && \
+           (int)(LVL) >= atomic_load_explicit(&((mylogger_head_t*)(void*)__mylogger_logger)->level, memory_order_relaxed)) \
+        { \
+            static mylogger_site_t __mylogger_site = {.level = (LVL), .line = __LINE__, .file = __FILE__, .func = __func__}; \
+            if(MYLOGGER_SITE_ENABLED_WRAPPER(&__mylogger_site)) \
+                __mylogger_print_site_to(__mylogger_logger, &__mylogger_site, __VA_ARGS__); \
+        } \
+        (void)0; \
+    })
+// FIELDS is a parenthesized list, MYLOGGER_FIELDS_UNWRAP FIELDS removes the parentheses
+#define MYLOGGER_FIELDS_UNWRAP(...) __VA_ARGS__
+#define MYLOGGER_KV_WRAPPER(LVL, FIELDS, ...) \
+    (MYLOGGER_LEVEL_ENABLED_WRAPPER(LVL) ? __extension__ ({ \
+        static mylogger_site_t __mylogger_site = {.level = (LVL), .line = __LINE__, .file = __FILE__, .func = __func__}; \
+        if(MYLOGGER_SITE_ENABLED_WRAPPER(&__mylogger_site)) \
+        { \
+            const struct mylogger_field_t __mylogger_fields[] = {MYLOGGER_FIELDS_UNWRAP FIELDS}; \
+            __mylogger_print_site_kv(&__mylogger_site, __mylogger_fields, \
+                                     sizeof(__mylogger_fields) / sizeof(__mylogger_fields[0]), __VA_ARGS__); \
+        } \
+    }) : (void)0)
 #define MYLOGGER_DEBUG_WRAPPER(...)         MYLOGGER_GENERAL_WRAPPER(MYLOGGER_LEVEL_DEBUG_WRAP, __VA_ARGS__)
 #define MYLOGGER_INFO_WRAPPER(...)          MYLOGGER_GENERAL_WRAPPER(MYLOGGER_LEVEL_INFO_WRAP, __VA_ARGS__)
 #define MYLOGGER_WARNING_WRAPPER(...)       MYLOGGER_GENERAL_WRAPPER(MYLOGGER_LEVEL_WARNING_WRAP, __VA_ARGS__)
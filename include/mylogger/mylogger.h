@@ -27,13 +27,55 @@ typedef enum mylogger_init_error_code_t
  * - TIMESTAMPS - add timestamps to your log messages
  * - THREAD_ID  - add thread id to your log messages
  * - NO_FILE    - no logging file will be created
- * - ALL        - use all the features except NO_FILE
+ * - ASYNC      - messages are formatted on the calling thread into a per-thread ring buffer
+ *                and written by a background thread. mylogger_destroy() drains all buffers.
+ * - DEFERRED   - ASYNC, but calling thread only copies arguments (strings are copied) and message is
+ *                formatted by the background thread. Format string must be a string literal.
+ *                Messages with %n, %m, %ls or positional arguments are formatted immediately.
+ * - MMAP       - log file is memory mapped and threads copy messages straight into the mapping
+ *                without system calls or locks. File grows in preallocated regions and is truncated
+ *                to the real length by mylogger_destroy(). When the file cannot grow, following messages
+ *                are dropped and the file ends before the first of them. Given log file has to be opened
+ *                for reading and writing (e.g. "w+" or "a+"). Ignored with NO_FILE.
+ * - BINARY     - log file contains compact binary records instead of text: call sites (file, function,
+ *                format) are written once and messages carry only timestamp, TID and raw arguments.
+ *                Log file has to be the only output and it cannot be rotated. Convert it back to text
+ *                with mylogger_decode() or the mylogger-decode tool on a machine with the same ABI.
+ * - COLLAPSE   - identical consecutive messages of one call site (same format and arguments) are written
+ *                once, followed by "last message repeated N times" when the site logs something else,
+ *                once per flush interval (1 s by default) or when the logger is destroyed. Messages with
+ *                %n, %m, %ls or long strings are never collapsed.
+ * - CRASH_HANDLER - SIGSEGV, SIGBUS, SIGILL, SIGFPE and SIGABRT handlers write out buffered messages
+ *                and a stack trace of raw addresses (see MYLOGGER_TRACE_ADDRESSES) to the log file, stdout
+ *                and stderr, then the signal kills the process. Custom sinks are skipped, they are not
+ *                async-signal-safe. Previous handlers are restored by mylogger_destroy(). Handlers run on
+ *                an alternate stack, so stack overflow is reported too, in the creating thread and in threads
+ *                that log for the first time afterwards.
+ * - STATS      - every thread counts its messages, bytes, truncations, lock waits and output write times
+ *                in its own memory, see mylogger_get_stats(). Totals can be logged periodically (config.stats_interval_ms).
+ * - IO_URING   - ASYNC writer thread writes the log file through io_uring with several batches in flight
+ *                and submits fdatasync (config.sync_interval_ms) without waiting for the disk. Ignored without
+ *                ASYNC, with MMAP and with rotation. Plain writev is used when io_uring is not available.
+ * - SHARED     - several processes append to one log file: the log file descriptor gets O_APPEND and every
+ *                write carries whole messages, so lines of different processes are never torn. Cannot be
+ *                combined with MMAP, BINARY and rotation, IO_URING is ignored.
+ * - ALL        - use all the features except NO_FILE, ASYNC, DEFERRED, MMAP, BINARY, COLLAPSE, CRASH_HANDLER,
+ *                STATS, IO_URING and SHARED
  * */
 #define MYLOGGER_FEATURE_STDOUT         MYLOGGER_FEATURE_STDOUT_WRAP
 #define MYLOGGER_FEATURE_STDERR         MYLOGGER_FEATURE_STDERR_WRAP
 #define MYLOGGER_FEATURE_TIMESTAMPS     MYLOGGER_FEATURE_TIMESTAMPS_WRAP
 #define MYLOGGER_FEATURE_THREAD_ID      MYLOGGER_FEATURE_THREAD_ID_WRAP
 #define MYLOGGER_FEATURE_NO_FILE        MYLOGGER_FEATURE_NO_FILE_WRAP
+#define MYLOGGER_FEATURE_ASYNC          MYLOGGER_FEATURE_ASYNC_WRAP
+#define MYLOGGER_FEATURE_DEFERRED       MYLOGGER_FEATURE_DEFERRED_WRAP
+#define MYLOGGER_FEATURE_MMAP           MYLOGGER_FEATURE_MMAP_WRAP
+#define MYLOGGER_FEATURE_BINARY         MYLOGGER_FEATURE_BINARY_WRAP
+#define MYLOGGER_FEATURE_COLLAPSE       MYLOGGER_FEATURE_COLLAPSE_WRAP
+#define MYLOGGER_FEATURE_CRASH_HANDLER  MYLOGGER_FEATURE_CRASH_HANDLER_WRAP
+#define MYLOGGER_FEATURE_STATS          MYLOGGER_FEATURE_STATS_WRAP
+#define MYLOGGER_FEATURE_IO_URING       MYLOGGER_FEATURE_IO_URING_WRAP
+#define MYLOGGER_FEATURE_SHARED         MYLOGGER_FEATURE_SHARED_WRAP
 
 #define MYLOGGER_FEATURE_ALL            (MYLOGGER_FEATURE_STDOUT | MYLOGGER_FEATURE_STDERR | \
                                         MYLOGGER_FEATURE_TIMESTAMPS | MYLOGGER_FEATURE_THREAD_ID)
@@ -71,6 +113,234 @@ typedef enum mylogger_init_error_code_t
 #define MYLOGGER_LEVEL_CRITICAL     MYLOGGER_LEVEL_CRITICAL_WRAP
 #define MYLOGGER_LEVEL_FATAL        MYLOGGER_LEVEL_FATAL_WRAP
 
+/**
+ * Clock used for timestamps (MYLOGGER_FEATURE_TIMESTAMPS):
+ * REALTIME         -   clock_gettime(CLOCK_REALTIME). Default.
+ * REALTIME_COARSE  -   clock_gettime(CLOCK_REALTIME_COARSE). Cheapest, resolution of a few milliseconds.
+ * TSC              -   CPU time stamp counter calibrated against CLOCK_REALTIME during initialization
+ *                      (takes ~10ms). Requires invariant TSC and may drift from the wall clock over time.
+ *                      REALTIME is used on platforms other than x86.
+ * */
+typedef enum mylogger_clock_t
+{
+    MYLOGGER_CLOCK_REALTIME         = 0,
+    MYLOGGER_CLOCK_REALTIME_COARSE  = 1,
+    MYLOGGER_CLOCK_TSC              = 2
+} mylogger_clock_t;
+
+/**
+ * Timestamp layout:
+ * TIME     -   [HH:MM:SS.uuuuuu] Default.
+ * ISO8601  -   [YYYY-MM-DDTHH:MM:SS.uuuuuu+hh:mm] Full date and UTC offset.
+ * */
+typedef enum mylogger_timestamp_format_t
+{
+    MYLOGGER_TIMESTAMP_TIME     = 0,
+    MYLOGGER_TIMESTAMP_ISO8601  = 1
+} mylogger_timestamp_format_t;
+
+/**
+ * Fraction of second in timestamp:
+ * USEC     -   microseconds, 6 digits. Default.
+ * NSEC     -   nanoseconds, 9 digits.
+ * */
+typedef enum mylogger_timestamp_precision_t
+{
+    MYLOGGER_TIMESTAMP_USEC     = 0,
+    MYLOGGER_TIMESTAMP_NSEC     = 1
+} mylogger_timestamp_precision_t;
+
+/**
+ * Stack trace of FATAL messages:
+ * SYMBOLS      -   function names from backtrace_symbols(), allocates memory and takes milliseconds. Default.
+ * ADDRESSES    -   "module(+0xoffset) [0xaddress]" lines written without allocation in microseconds.
+ *                  Symbolize offline, e.g. addr2line -f -e module 0xoffset.
+ * */
+typedef enum mylogger_trace_mode_t
+{
+    MYLOGGER_TRACE_SYMBOLS      = 0,
+    MYLOGGER_TRACE_ADDRESSES    = 1
+} mylogger_trace_mode_t;
+
+/**
+ * Layout of text messages:
+ * TEXT     -   [LEVEL] [time][TID: n]file:line func: message key=value... Default.
+ * JSON     -   one JSON object per line: {"level":"INFO","time":"...","thread":"n","file":"...","line":n,
+ *              "func":"...","msg":"...","key":value...}. Stack trace of FATAL message is in "trace".
+ * LOGFMT   -   level=INFO time=... thread=n file=... line=n func=... msg="..." key=value...
+ * Trailing newline of the message is not part of "msg". Message that does not fit ends "msg" with
+ * "... [TRUNCATED]" and drops the fields, so the line stays valid. Invalid UTF-8 bytes are written as \u00XX.
+ * Time and thread are present with MYLOGGER_FEATURE_TIMESTAMPS and MYLOGGER_FEATURE_THREAD_ID.
+ * MYLOGGER_FEATURE_BINARY files always decode to TEXT.
+ * */
+typedef enum mylogger_encoder_t
+{
+    MYLOGGER_ENCODER_TEXT       = 0,
+    MYLOGGER_ENCODER_JSON       = 1,
+    MYLOGGER_ENCODER_LOGFMT     = 2
+} mylogger_encoder_t;
+
+/**
+ * Custom output. MyLogger calls write with one or more complete messages, never concurrently.
+ * - write      - writes data somewhere
+ * - close      - optional, called by mylogger_destroy after last write
+ * - user_data  - passed to both callbacks
+ * */
+typedef struct mylogger_sink_t
+{
+    void (*write)(void* user_data, const char* data, size_t len);
+    void (*close)(void* user_data);
+    void* user_data;
+} mylogger_sink_t;
+
+#define MYLOGGER_CUSTOM_SINKS_MAX 8
+
+/**
+ * Flush policy of log file and custom sinks. Messages are collected in a batch that is written when:
+ * - size        - next message does not fit in the batch of this size (64 KiB by default, 1 writes every message)
+ * - interval_ms - oldest message in the batch is older than interval (disabled by default). Without
+ *                 MYLOGGER_FEATURE_ASYNC a background thread checks the batches every half interval
+ * - level       - message of this level or higher is logged (MYLOGGER_LEVEL_ERROR by default, when 0 and
+ *                 level_set is false)
+ * - level_set   - level is used even when it is MYLOGGER_LEVEL_DEBUG (every message is written)
+ * stdout and stderr are never batched. Everything is written by mylogger_destroy.
+ * */
+typedef struct mylogger_flush_policy_t
+{
+    size_t size;
+    uint32_t interval_ms;
+    mylogger_level_t level;
+    bool level_set;
+} mylogger_flush_policy_t;
+
+/**
+ * Compression of rotated log files. Available when MyLogger is built with zlib (ZLIB=1)
+ * or zstd (ZSTD=1).
+ * */
+typedef enum mylogger_compression_t
+{
+    MYLOGGER_COMPRESSION_NONE = 0,
+    MYLOGGER_COMPRESSION_GZIP,      // file.txt.gz
+    MYLOGGER_COMPRESSION_ZSTD       // file.txt.zst
+} mylogger_compression_t;
+
+/**
+ * Rotation of the log file created by MyLogger (no log file given, no NO_FILE and no MMAP).
+ * First file is log_<date>_<time>.txt, next ones are log_<date>_<time>_<N>.txt.
+ * Next file is opened ahead of time and compression runs on a low priority background thread.
+ * - max_size       - start new file before it would grow above max_size bytes (0 disabled)
+ * - interval_s     - start new file every interval_s seconds (0 disabled)
+ * - keep           - number of rotated files to keep, older are deleted (0 keeps everything)
+ * - compression    - compression of rotated files
+ * */
+typedef struct mylogger_rotation_t
+{
+    size_t max_size;
+    uint32_t interval_s;
+    uint32_t keep;
+    mylogger_compression_t compression;
+} mylogger_rotation_t;
+
+/**
+ * What MYLOGGER_FEATURE_ASYNC does when the ring of a logging thread fills up because outputs are slow:
+ * BLOCK            -   wait for the writer thread. Default.
+ * DROP_NEWEST      -   drop the message that does not fit.
+ * DROP_LOW_LEVELS  -   drop lower levels first, DEBUG when the ring is 1/4 full, INFO at 2/4 and WARNING at 3/4
+ *                      (with default keep_level), then drop the message that does not fit.
+ * SAMPLE           -   when the ring is half full keep randomly 1 of sample_rate messages, drop the message
+ *                      that does not fit.
+ * */
+typedef enum mylogger_overload_mode_t
+{
+    MYLOGGER_OVERLOAD_BLOCK = 0,
+    MYLOGGER_OVERLOAD_DROP_NEWEST,
+    MYLOGGER_OVERLOAD_DROP_LOW_LEVELS,
+    MYLOGGER_OVERLOAD_SAMPLE
+} mylogger_overload_mode_t;
+
+/**
+ * Overload policy of MYLOGGER_FEATURE_ASYNC. Synchronous logging always waits for the outputs.
+ * - mode               - what happens to messages when the writer thread falls behind
+ * - keep_level         - messages of this level or higher are never dropped, they wait for space
+ *                        (MYLOGGER_LEVEL_ERROR by default, when 0 and keep_level_set is false)
+ * - keep_level_set     - keep_level is used even when it is MYLOGGER_LEVEL_DEBUG (nothing is dropped)
+ * - sample_rate        - SAMPLE keeps 1 of sample_rate messages (8 by default)
+ * - report_interval_ms - "N messages dropped" WARNING is logged at most once per interval (1000 by default)
+ * Dropped messages are counted per level, see mylogger_get_dropped().
+ * */
+typedef struct mylogger_overload_policy_t
+{
+    mylogger_overload_mode_t mode;
+    mylogger_level_t keep_level;
+    uint32_t sample_rate;
+    uint32_t report_interval_ms;
+    bool keep_level_set;
+} mylogger_overload_policy_t;
+
+/**
+ * Flight recorder. Messages below the level threshold are not written out but kept in memory of the logging
+ * thread, with arguments copied as by MYLOGGER_FEATURE_DEFERRED. A message of dump_level or higher writes out
+ * the recorded messages of its thread first, so outputs get verbose context of the failure only.
+ * - size       - bytes of the circular buffer of each thread, oldest messages are overwritten. Rounded up to
+ *                a power of 2, at least 4 KiB (0 disabled)
+ * - level      - lowest recorded level (MYLOGGER_LEVEL_DEBUG by default)
+ * - dump_level - messages of this level or higher dump the recorder of their thread (MYLOGGER_LEVEL_ERROR by default, when 0
+ *                and dump_level_set is false)
+ * - dump_level_set - dump_level is used even when it is MYLOGGER_LEVEL_DEBUG
+ * Format strings of recorded messages have to be string literals. With ASYNC and CRASH_HANDLER the writer thread
+ * dumps recorders of every thread before the crash report. Ignored with MYLOGGER_FEATURE_BINARY.
+ * */
+typedef struct mylogger_recorder_t
+{
+    size_t size;
+    mylogger_level_t level;
+    mylogger_level_t dump_level;
+    bool dump_level_set;
+} mylogger_recorder_t;
+
+/**
+ * Logger configuration. Zero initialized fields mean default values.
+ * - log_file               - file to which the logs are to be written. Can be NULL if stdout or stderr logging feature added.
+ * - features               - chosen logger features. Can be combined with bitwise OR operator
+ * - level                  - messages below this level are not logged (MYLOGGER_LEVEL_DEBUG by default)
+ * - clock                  - clock used for timestamps
+ * - timestamp_format       - timestamp layout
+ * - timestamp_precision    - fraction of second in timestamp
+ * - trace                  - stack trace of FATAL messages
+ * - encoder                - layout of messages
+ * - flush                  - when batched messages are written
+ * - rotation               - rotation of the created log file
+ * - overload               - MYLOGGER_FEATURE_ASYNC behavior when outputs are too slow
+ * - sync_interval_ms       - MYLOGGER_FEATURE_ASYNC writer thread syncs log file data (fdatasync) at most once per
+ *                            interval (0 disabled)
+ * - mmap_region_size       - MYLOGGER_FEATURE_MMAP file growth step, rounded up to page size (16 MiB by default)
+ * - stats_interval_ms      - MYLOGGER_FEATURE_STATS totals are logged as INFO "logger stats" message with fields
+ *                            at most once per interval (0 disabled)
+ * - recorder               - flight recorder of messages below the level threshold (disabled by default)
+ * - sinks                  - custom outputs (up to MYLOGGER_CUSTOM_SINKS_MAX), array is copied
+ * - sinks_count            - number of custom outputs
+ * */
+typedef struct mylogger_config_t
+{
+    FILE* log_file;
+    mylogger_feature_t features;
+    mylogger_level_t level;
+    mylogger_clock_t clock;
+    mylogger_timestamp_format_t timestamp_format;
+    mylogger_timestamp_precision_t timestamp_precision;
+    mylogger_trace_mode_t trace;
+    mylogger_encoder_t encoder;
+    mylogger_flush_policy_t flush;
+    mylogger_rotation_t rotation;
+    mylogger_overload_policy_t overload;
+    uint32_t sync_interval_ms;
+    size_t mmap_region_size;
+    uint32_t stats_interval_ms;
+    mylogger_recorder_t recorder;
+    const mylogger_sink_t* sinks;
+    size_t sinks_count;
+} mylogger_config_t;
+
 /**
  * Initializes the logger instance with the given features.
  * @param[in] log_file - file to which the logs are to be written. Can be NULL if stdout or stderr logging feature added.
@@ -81,6 +351,156 @@ typedef enum mylogger_init_error_code_t
  * */
 mylogger_init_error_code_t mylogger_init(FILE* log_file, mylogger_feature_t features);
 
+/**
+ * Initializes the logger instance with the given configuration.
+ * Logger can work without file, stdout and stderr when custom sinks are given.
+ * @param[in] config - logger configuration
+ *
+ * @return  MYLOGGER_INIT_SUCCESS = 0 on success \n
+ *          else any other error code >0
+ * */
+mylogger_init_error_code_t mylogger_init_config(const mylogger_config_t* config);
+
+/**
+ * Logger instance created with mylogger_create(). Every instance has its own outputs, level, lock and
+ * writer thread. MYLOGGER_* macros log to the default instance of mylogger_init(), MYLOGGER_*_TO macros
+ * to the given instance.
+ *
+ * Instances survive fork(): batched messages are written out before the fork, so the child never repeats
+ * them, and the child gets unlocked instances without messages, counters and recorded history of the parent.
+ * ASYNC instances are synchronous in the child, writer and rotation threads stay in the parent and the child
+ * keeps appending to the current log file. IO_URING and MMAP log files are shared: the child writes into space
+ * reserved from the same offset as the parent, without a ring of its own. The parent truncates a MMAP file when
+ * it closes the instance, children should close theirs before.
+ * */
+typedef struct MyLogger_instance mylogger_t;
+
+/**
+ * Creates logger instance independent of the default one and of each other.
+ * @param[in] config - logger configuration, as for mylogger_init_config()
+ * @param[out] error - reason of the failure, can be NULL
+ *
+ * @return logger instance or NULL on failure.
+ * */
+mylogger_t* mylogger_create(const mylogger_config_t* config, mylogger_init_error_code_t* error);
+
+/**
+ * Writes out every buffered message and frees the instance. Log calls that are already running are waited for,
+ * new ones must not start.
+ * @param[in] logger - instance from mylogger_create(), NULL is ignored
+ * */
+void mylogger_close(mylogger_t* logger);
+
+/**
+ * Runtime level threshold of the instance (config.level at creation).
+ * NULL logger is ignored by every mylogger_logger_* function, getters return 0 or false for it.
+ * */
+void mylogger_logger_set_level(mylogger_t* logger, mylogger_level_t level);
+mylogger_level_t mylogger_logger_get_level(mylogger_t* logger);
+
+/**
+ * Returns number of messages of the level dropped by the overload policy of the instance.
+ * */
+uint64_t mylogger_logger_get_dropped(mylogger_t* logger, mylogger_level_t level);
+
+#define MYLOGGER_STATS_BUCKETS 32
+/**
+ * Latency histogram of MYLOGGER_FEATURE_STATS. Bucket 0 counts durations below 2 ns, bucket i counts
+ * durations from 2^i to 2^(i+1) - 1 ns, last bucket counts everything longer.
+ * */
+typedef struct mylogger_histogram_t
+{
+    uint64_t count;
+    uint64_t sum_ns;
+    uint64_t max_ns;
+    uint64_t buckets[MYLOGGER_STATS_BUCKETS];
+} mylogger_histogram_t;
+
+/**
+ * Logger metrics collected with MYLOGGER_FEATURE_STATS since the instance was created.
+ * - messages   - log calls that passed the level filter, including dropped ones
+ * - dropped    - messages dropped by the overload policy
+ * - bytes      - bytes of formatted messages passed to the outputs
+ * - truncated  - messages that did not fit in the message buffer
+ * - lock_wait  - time log calls waited for the instance mutex, uncontended lock counts as 0 ns
+ * - sink_write - time of single writes to the log file, stdout, stderr and custom sinks
+ * Counters of running threads are read without stopping them, totals may lag behind by a few messages.
+ * */
+typedef struct mylogger_stats_t
+{
+    uint64_t messages[MYLOGGER_LEVEL_FATAL + 1];
+    uint64_t dropped[MYLOGGER_LEVEL_FATAL + 1];
+    uint64_t bytes;
+    uint64_t truncated;
+    mylogger_histogram_t lock_wait;
+    mylogger_histogram_t sink_write;
+} mylogger_stats_t;
+
+/**
+ * Adds up counters of every thread that used the default instance.
+ * @param[out] stats - metrics
+ * @return false when logger is not initialized or MYLOGGER_FEATURE_STATS is not enabled.
+ * */
+bool mylogger_get_stats(mylogger_stats_t* stats);
+bool mylogger_logger_get_stats(mylogger_t* logger, mylogger_stats_t* stats);
+
+/**
+ * Writes out messages kept by the flight recorder (config.recorder) of every thread, oldest first,
+ * and empties the recorders.
+ * @return false when logger is not initialized or flight recorder is disabled.
+ * */
+bool mylogger_dump_recorder(void);
+bool mylogger_logger_dump_recorder(mylogger_t* logger);
+
+/**
+ * Batch of the calling thread. Between begin and commit every message the thread logs to the instance
+ * (MYLOGGER_* macros for the default instance, MYLOGGER_*_TO for the given one) is formatted with its own
+ * level, timestamp and TID into one thread-local buffer. Commit writes the buffer to every output under one
+ * lock acquisition, as one write where the sink batch allows it. Messages of other threads are not delayed.
+ * Batch is written early when it grows over 1 MiB or FATAL message is added, rotation does not split it.
+ * mylogger_close and mylogger_destroy write the open batch of the calling thread, batches of other threads have
+ * to be committed before. Uncommitted batch of an exiting thread is written when its instance is still open.
+ * @return begin - false when logger is not initialized, the thread already has an open batch or the instance
+ *                 is ASYNC (the writer thread batches messages already), messages are then written as usual.
+ *         commit - number of messages written since begin, 0 when no batch is open.
+ * */
+bool mylogger_batch_begin(void);
+bool mylogger_logger_batch_begin(mylogger_t* logger);
+size_t mylogger_batch_commit(void);
+
+/**
+ * Returns approximate percentile of the histogram: upper bound of the bucket, at most max_ns.
+ * @param[in] histogram - histogram from mylogger_stats_t
+ * @param[in] percentile - 0 to 100, e.g. 99.9
+ * @return duration in ns, 0 for empty histogram.
+ * */
+uint64_t mylogger_histogram_percentile(const mylogger_histogram_t* histogram, double percentile);
+
+/**
+ * Log level filtering:
+ * - compile time - define MYLOGGER_MIN_LEVEL (e.g. -DMYLOGGER_MIN_LEVEL=MYLOGGER_LEVEL_INFO) before including
+ *                  this header. Calls below that level are removed by the compiler.
+ * - runtime      - messages below the threshold are skipped without evaluating their arguments.
+ *                  Threshold is set at initialization (config.level) and can be changed at any time.
+ *                  With flight recorder (config.recorder) recorded levels are evaluated and kept in memory.
+ * */
+void mylogger_set_level(mylogger_level_t level);
+mylogger_level_t mylogger_get_level(void);
+
+/**
+ * Returns number of messages of the level dropped by the overload policy since initialization.
+ * @param[in] level - message level
+ * @return dropped messages, 0 when logger is not initialized.
+ * */
+uint64_t mylogger_get_dropped(mylogger_level_t level);
+
+/**
+ * Sets name of the calling thread shown next to its TID (MYLOGGER_FEATURE_THREAD_ID), e.g. [TID: 1234 worker].
+ * Name is rendered once and reused for every message. Longer names are truncated to 31 characters.
+ * @param[in] name - thread name, NULL removes the name
+ * */
+void mylogger_set_thread_name(const char* name);
+
 #define MYLOGGER_FATAL(...)     MYLOGGER_FATAL_WRAPPER(__VA_ARGS__)
 #define MYLOGGER_CRITICAL(...)  MYLOGGER_CRITICAL_WRAPPER(__VA_ARGS__)
 #define MYLOGGER_ERROR(...)     MYLOGGER_ERROR_WRAPPER(__VA_ARGS__)
@@ -88,8 +508,127 @@ mylogger_init_error_code_t mylogger_init(FILE* log_file, mylogger_feature_t feat
 #define MYLOGGER_INFO(...)      MYLOGGER_INFO_WRAPPER(__VA_ARGS__)
 #define MYLOGGER_DEBUG(...)     MYLOGGER_DEBUG_WRAPPER(__VA_ARGS__)
 
+#define MYLOGGER_FATAL_TO(LOGGER, ...)      MYLOGGER_LOGGER_WRAPPER(LOGGER, MYLOGGER_LEVEL_FATAL_WRAP, __VA_ARGS__)
+#define MYLOGGER_CRITICAL_TO(LOGGER, ...)   MYLOGGER_LOGGER_WRAPPER(LOGGER, MYLOGGER_LEVEL_CRITICAL_WRAP, __VA_ARGS__)
+#define MYLOGGER_ERROR_TO(LOGGER, ...)      MYLOGGER_LOGGER_WRAPPER(LOGGER, MYLOGGER_LEVEL_ERROR_WRAP, __VA_ARGS__)
+#define MYLOGGER_WARNING_TO(LOGGER, ...)    MYLOGGER_LOGGER_WRAPPER(LOGGER, MYLOGGER_LEVEL_WARNING_WRAP, __VA_ARGS__)
+#define MYLOGGER_INFO_TO(LOGGER, ...)       MYLOGGER_LOGGER_WRAPPER(LOGGER, MYLOGGER_LEVEL_INFO_WRAP, __VA_ARGS__)
+#define MYLOGGER_DEBUG_TO(LOGGER, ...)      MYLOGGER_LOGGER_WRAPPER(LOGGER, MYLOGGER_LEVEL_DEBUG_WRAP, __VA_ARGS__)
+
+/**
+ * Rate limited logging with lock-free state kept in the call site:
+ * - *_EVERY_N(n, ...)          - logs 1st, (n+1)th, (2n+1)th... call of the site
+ * - *_RATELIMIT(rate, ...)     - logs at most rate messages per second with bursts up to rate messages
+ * Suppressed calls do not evaluate their arguments and are counted in mylogger_site_info_t.suppressed.
+ * */
+#define MYLOGGER_FATAL_EVERY_N(N, ...)          MYLOGGER_EVERY_N_WRAPPER(MYLOGGER_LEVEL_FATAL_WRAP, N, __VA_ARGS__)
+#define MYLOGGER_CRITICAL_EVERY_N(N, ...)       MYLOGGER_EVERY_N_WRAPPER(MYLOGGER_LEVEL_CRITICAL_WRAP, N, __VA_ARGS__)
+#define MYLOGGER_ERROR_EVERY_N(N, ...)          MYLOGGER_EVERY_N_WRAPPER(MYLOGGER_LEVEL_ERROR_WRAP, N, __VA_ARGS__)
+#define MYLOGGER_WARNING_EVERY_N(N, ...)        MYLOGGER_EVERY_N_WRAPPER(MYLOGGER_LEVEL_WARNING_WRAP, N, __VA_ARGS__)
+#define MYLOGGER_INFO_EVERY_N(N, ...)           MYLOGGER_EVERY_N_WRAPPER(MYLOGGER_LEVEL_INFO_WRAP, N, __VA_ARGS__)
+#define MYLOGGER_DEBUG_EVERY_N(N, ...)          MYLOGGER_EVERY_N_WRAPPER(MYLOGGER_LEVEL_DEBUG_WRAP, N, __VA_ARGS__)
+
+#define MYLOGGER_FATAL_RATELIMIT(RATE, ...)     MYLOGGER_RATELIMIT_WRAPPER(MYLOGGER_LEVEL_FATAL_WRAP, RATE, __VA_ARGS__)
+#define MYLOGGER_CRITICAL_RATELIMIT(RATE, ...)  MYLOGGER_RATELIMIT_WRAPPER(MYLOGGER_LEVEL_CRITICAL_WRAP, RATE, __VA_ARGS__)
+#define MYLOGGER_ERROR_RATELIMIT(RATE, ...)     MYLOGGER_RATELIMIT_WRAPPER(MYLOGGER_LEVEL_ERROR_WRAP, RATE, __VA_ARGS__)
+#define MYLOGGER_WARNING_RATELIMIT(RATE, ...)   MYLOGGER_RATELIMIT_WRAPPER(MYLOGGER_LEVEL_WARNING_WRAP, RATE, __VA_ARGS__)
+#define MYLOGGER_INFO_RATELIMIT(RATE, ...)      MYLOGGER_RATELIMIT_WRAPPER(MYLOGGER_LEVEL_INFO_WRAP, RATE, __VA_ARGS__)
+#define MYLOGGER_DEBUG_RATELIMIT(RATE, ...)     MYLOGGER_RATELIMIT_WRAPPER(MYLOGGER_LEVEL_DEBUG_WRAP, RATE, __VA_ARGS__)
+
+/**
+ * Structured logging. Fields are typed key/value pairs written after the message by the encoder
+ * (see mylogger_encoder_t), strings are escaped and copied when the message is formatted:
+ *
+ *     MYLOGGER_INFO_KV((MYLOGGER_KV_STR("user", name), MYLOGGER_KV_INT("status", 200)), "request done in %d ms\n", ms);
+ *
+ * First argument is a parenthesized list of MYLOGGER_KV_* fields. Keys should be string literals.
+ * Fields are evaluated only when the message is logged. Messages with fields are never deferred or collapsed.
+ * */
+typedef enum mylogger_field_type_t
+{
+    MYLOGGER_FIELD_INT,
+    MYLOGGER_FIELD_UINT,
+    MYLOGGER_FIELD_DOUBLE,
+    MYLOGGER_FIELD_BOOL,
+    MYLOGGER_FIELD_STR      // NULL is written as null (JSON) or empty value
+} mylogger_field_type_t;
+
+typedef struct mylogger_field_t
+{
+    const char* key;
+    mylogger_field_type_t type;
+    union
+    {
+        int64_t i;
+        uint64_t u;
+        double d;
+        bool b;
+        const char* s;
+    } value;
+} mylogger_field_t;
+
+#define MYLOGGER_KV_INT(KEY, VALUE)     ((mylogger_field_t){.key = (KEY), .type = MYLOGGER_FIELD_INT, .value.i = (int64_t)(VALUE)})
+#define MYLOGGER_KV_UINT(KEY, VALUE)    ((mylogger_field_t){.key = (KEY), .type = MYLOGGER_FIELD_UINT, .value.u = (uint64_t)(VALUE)})
+#define MYLOGGER_KV_DOUBLE(KEY, VALUE)  ((mylogger_field_t){.key = (KEY), .type = MYLOGGER_FIELD_DOUBLE, .value.d = (double)(VALUE)})
+#define MYLOGGER_KV_BOOL(KEY, VALUE)    ((mylogger_field_t){.key = (KEY), .type = MYLOGGER_FIELD_BOOL, .value.b = (VALUE)})
+#define MYLOGGER_KV_STR(KEY, VALUE)     ((mylogger_field_t){.key = (KEY), .type = MYLOGGER_FIELD_STR, .value.s = (VALUE)})
+
+#define MYLOGGER_FATAL_KV(FIELDS, ...)      MYLOGGER_KV_WRAPPER(MYLOGGER_LEVEL_FATAL_WRAP, FIELDS, __VA_ARGS__)
+#define MYLOGGER_CRITICAL_KV(FIELDS, ...)   MYLOGGER_KV_WRAPPER(MYLOGGER_LEVEL_CRITICAL_WRAP, FIELDS, __VA_ARGS__)
+#define MYLOGGER_ERROR_KV(FIELDS, ...)      MYLOGGER_KV_WRAPPER(MYLOGGER_LEVEL_ERROR_WRAP, FIELDS, __VA_ARGS__)
+#define MYLOGGER_WARNING_KV(FIELDS, ...)    MYLOGGER_KV_WRAPPER(MYLOGGER_LEVEL_WARNING_WRAP, FIELDS, __VA_ARGS__)
+#define MYLOGGER_INFO_KV(FIELDS, ...)       MYLOGGER_KV_WRAPPER(MYLOGGER_LEVEL_INFO_WRAP, FIELDS, __VA_ARGS__)
+#define MYLOGGER_DEBUG_KV(FIELDS, ...)      MYLOGGER_KV_WRAPPER(MYLOGGER_LEVEL_DEBUG_WRAP, FIELDS, __VA_ARGS__)
+
+/**
+ * Log call site seen by mylogger_get_sites().
+ * - hits       - number of log calls that passed level, site and rate checks
+ * - suppressed - calls dropped by *_EVERY_N, *_RATELIMIT or MYLOGGER_FEATURE_COLLAPSE
+ * hits is approximate when threads use the site concurrently.
+ * */
+typedef struct mylogger_site_info_t
+{
+    const char* file;
+    const char* func;
+    uint32_t line;
+    mylogger_level_t level;
+    bool enabled;
+    uint64_t hits;
+    uint64_t suppressed;
+} mylogger_site_info_t;
+
+/**
+ * Returns log call sites. A site is known after it logs for the first time.
+ *
+ * @param[out] sites - array for the sites, can be NULL when max is 0
+ * @param[in] max - size of the array
+ * @return number of known sites, can be bigger than max.
+ * */
+size_t mylogger_get_sites(mylogger_site_info_t* sites, size_t max);
+
+/**
+ * Enables or disables known log call sites. Disabled site does not evaluate its arguments.
+ * Setting stays until it is changed again, even when the logger is destroyed.
+ *
+ * @param[in] file - file of the sites (__FILE__), NULL for all files
+ * @param[in] line - line of the sites, 0 for all lines
+ * @param[in] enabled - new state
+ * @return number of matching sites.
+ * */
+size_t mylogger_set_site_enabled(const char* file, uint32_t line, bool enabled);
+
+/**
+ * Converts log file written with MYLOGGER_FEATURE_BINARY to the text layout.
+ *
+ * @param[in] in - binary log file
+ * @param[out] out - text output
+ * @return 0 on success, -1 when input is not a valid binary log or memory cannot be allocated.
+ * */
+int mylogger_decode(FILE* in, FILE* out);
+
 /**
  * Destroys currently running logger instance.
+ * In MYLOGGER_FEATURE_ASYNC mode every message logged before this call is written out first.
  * */
 void mylogger_destroy(void);
 
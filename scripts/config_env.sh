@@ -53,4 +53,11 @@ if ! check_command gcovr; then
   sudo pip3 install gcovr
 fi
 
+# Check and install zlib headers (optional gzip compression, make ZLIB=1)
+if [ ! -f /usr/include/zlib.h ]; then
+  echo "zlib headers are not installed. Installing..."
+  sudo apt-get update
+  sudo apt-get install zlib1g-dev
+fi
+
 echo "All required dependencies are installed."
\ No newline at end of file
@@ -6,11 +6,33 @@
 #include <pthread.h>
 #include <stdlib.h>
 #include <stdio.h>
-#include <sys/time.h>       /* Functions used to get timestamp */
 #include <sys/syscall.h>    /* Definition of SYS_* constants */
 #include <unistd.h>         /* syscall() */
 #include <execinfo.h>       /* Stack trace */
 #include <stdarg.h>         /* va_start() */
+#include <string.h>         /* memcpy() */
+#include <sched.h>          /* sched_yield() */
+#include <sys/resource.h>   /* setpriority() */
+#include <time.h>           /* nanosleep() */
+#include <linux/membarrier.h>   /* MEMBARRIER_CMD_* */
+#include <sys/uio.h>        /* writev() */
+#include <errno.h>
+#include <inttypes.h>     /* PRIu32 */
+#include <sys/mman.h>       /* mmap() */
+#include <sys/stat.h>       /* fstat() */
+#include <fcntl.h>          /* posix_fallocate() */
+#include <signal.h>         /* sigaction() */
+#include <math.h>           /* isfinite() */
+#include <linux/io_uring.h> /* struct io_uring_sqe */
+#ifdef MYLOGGER_WITH_ZLIB
+#include <zlib.h>           /* gzopen() */
+#endif
+#ifdef MYLOGGER_WITH_ZSTD
+#include <zstd.h>           /* ZSTD_compressStream2() */
+#endif
+#if defined(MYLOGGER_WITH_ZLIB) || defined(MYLOGGER_WITH_ZSTD)
+#define MYLOGGER_WITH_COMPRESSION
+#endif
 
 #include <mylogger/mylogger.h>
 
@@ -25,27 +47,881 @@ typedef struct MyLogger_features
     bool feat_tid:1;            // MYLOGGER_FEATURE_THREAD_ID
     bool feat_no_file:1;        // MYLOGGER_FEATURE_NO_FILE
     bool feat_ansi_logs:1;      // MYLOGGER_FEATURE_STDOUT/STDERR | MYLOGGER_FEATURE_NO_FILE
+    bool feat_async:1;          // MYLOGGER_FEATURE_ASYNC | MYLOGGER_FEATURE_DEFERRED
+    bool feat_deferred:1;       // MYLOGGER_FEATURE_DEFERRED
+    bool feat_mmap:1;           // MYLOGGER_FEATURE_MMAP
+    bool feat_binary:1;         // MYLOGGER_FEATURE_BINARY
+    bool feat_collapse:1;       // MYLOGGER_FEATURE_COLLAPSE
+    bool feat_crash_handler:1;  // MYLOGGER_FEATURE_CRASH_HANDLER
+    bool feat_stats:1;          // MYLOGGER_FEATURE_STATS
+    bool feat_uring:1;          // MYLOGGER_FEATURE_IO_URING with MYLOGGER_FEATURE_ASYNC, without MYLOGGER_FEATURE_MMAP
+    bool feat_shared:1;         // MYLOGGER_FEATURE_SHARED
 } MyLogger_features_S;
 
+/**
+ * Timestamp options chosen during initialization (MYLOGGER_FEATURE_TIMESTAMPS).
+ * */
+typedef struct MyLogger_timestamp
+{
+    mylogger_clock_t clock;
+    mylogger_timestamp_format_t format;
+    mylogger_timestamp_precision_t precision;
+    // MYLOGGER_CLOCK_TSC calibration
+    uint64_t tsc_base;
+    struct timespec time_base;
+    double ns_per_tick;
+} MyLogger_timestamp_S;
+
+#define MYLOGGER_TIMESTAMP_PART_MAX_SIZE 32
+/**
+ * Per-thread cache of timestamp parts that change at most once per second.
+ * */
+typedef struct MyLogger_time_cache
+{
+    time_t second;                                  // second for which parts are rendered
+    mylogger_timestamp_format_t format;
+    size_t prefix_len;
+    size_t suffix_len;
+    char prefix[MYLOGGER_TIMESTAMP_PART_MAX_SIZE];  // "[HH:MM:SS" or "[YYYY-MM-DDTHH:MM:SS"
+    char suffix[MYLOGGER_TIMESTAMP_PART_MAX_SIZE];  // "] " or "+hh:mm] "
+} MyLogger_time_cache_S;
+
+/**
+ * Everything about single log call that is needed to format message prefix.
+ * */
+typedef struct MyLogger_call
+{
+    const char* file;
+    const char* func;
+    size_t line;
+    mylogger_level_t level;
+    struct timespec time;       // set only with MYLOGGER_FEATURE_TIMESTAMPS
+    const char* tid_tag;        // set only with MYLOGGER_FEATURE_THREAD_ID, "[TID: n]" rendered by the calling thread
+    size_t tid_tag_len;
+    mylogger_site_t* site;          // NULL when called without static descriptor
+    const mylogger_field_t* fields; // *_KV fields, never deferred
+    size_t fields_count;
+} MyLogger_call_S;
+
+/**
+ * Types of arguments captured by MYLOGGER_FEATURE_DEFERRED. Chosen from conversion specifier and length modifier.
+ * */
+typedef enum MyLogger_arg_type
+{
+    MYLOGGER_ARG_NONE,          // %%
+    MYLOGGER_ARG_INT,
+    MYLOGGER_ARG_UINT,
+    MYLOGGER_ARG_LONG,
+    MYLOGGER_ARG_ULONG,
+    MYLOGGER_ARG_LLONG,
+    MYLOGGER_ARG_ULLONG,
+    MYLOGGER_ARG_INTMAX,
+    MYLOGGER_ARG_UINTMAX,
+    MYLOGGER_ARG_SIZE,
+    MYLOGGER_ARG_PTRDIFF,
+    MYLOGGER_ARG_DOUBLE,
+    MYLOGGER_ARG_LDOUBLE,
+    MYLOGGER_ARG_PTR,
+    MYLOGGER_ARG_STR,
+    MYLOGGER_ARG_UNSUPPORTED    // %n, %m, %ls, positional arguments... message is formatted immediately
+} MyLogger_arg_type_E;
+
+#define MYLOGGER_CONVERSION_MAX_SIZE 32
+#define MYLOGGER_CONVERSION_MAX_WIDTH (1 << 20)    // larger width or precision is left to snprintf
+#define MYLOGGER_FORMAT_FALLBACK SIZE_MAX           // __mylogger_put_arg cannot format the value
+/**
+ * Single conversion specification found in format string.
+ * */
+typedef struct MyLogger_conversion
+{
+    size_t len;                 // length of the specification including '%'
+    MyLogger_arg_type_E type;
+    uint8_t stars;              // number of '*' int arguments before the value
+    bool precision_star;        // last '*' argument is precision
+    int precision;              // precision given in format, -1 if none
+    int width;                  // width given in format, -1 if none
+    char spec;                  // conversion character
+    bool left;                  // '-' flag
+    bool zero;                  // '0' flag
+    char sign;                  // '+' or ' ' flag, '\0' if none
+    bool fast;                  // __mylogger_put_arg can format it, otherwise snprintf is used
+} MyLogger_conversion_S;
+
+/**
+ * Value of one argument of the format string. Signed integers are sign extended into i,
+ * unsigned integers, sizes and pointers are stored in u, p or s.
+ * */
+typedef union MyLogger_arg
+{
+    intmax_t i;
+    uintmax_t u;
+    double d;
+    long double ld;
+    const void* p;
+    const char* s;
+} MyLogger_arg_U;
+
+/**
+ * Piece of the format string: literal text followed by one conversion.
+ * */
+typedef struct MyLogger_format_op
+{
+    const char* text;
+    size_t text_len;
+    const char* spec;           // conversion specification in the format string
+    MyLogger_conversion_S conv;
+} MyLogger_format_op_S;
+
+/**
+ * Format string parsed once per call site, cached in mylogger_site_t.parsed.
+ * */
+typedef struct MyLogger_format_program
+{
+    const char* format;         // the program is used only for the same format pointer
+    bool supported;             // false when the message has to be formatted by vsnprintf
+    const char* tail;           // text after the last conversion
+    size_t tail_len;
+    size_t ops_count;
+    MyLogger_format_op_S ops[];
+} MyLogger_format_program_S;
+
+/**
+ * Record header in the ring.
+ * */
+typedef enum MyLogger_record_type
+{
+    MYLOGGER_RECORD_TEXT     = 0,   // formatted message
+    MYLOGGER_RECORD_DEFERRED = 1    // MyLogger_deferred_S followed by captured arguments
+} MyLogger_record_type_E;
+
+typedef struct MyLogger_record_header
+{
+    uint32_t len;               // length of the record without header
+    uint16_t type;              // MyLogger_record_type_E
+    uint16_t level;             // mylogger_level_t, used by flush policy
+} MyLogger_record_header_S;
+
+/**
+ * Deferred message (MYLOGGER_FEATURE_DEFERRED). Format string has to be a string literal,
+ * strings passed as arguments are copied, message is formatted by the writer thread.
+ * Record is followed by TID tag (call.tid_tag_len bytes) and captured arguments.
+ * */
+typedef struct MyLogger_deferred
+{
+    MyLogger_call_S call;
+    const char* format;
+    size_t args_len;
+} MyLogger_deferred_S;
+
+/**
+ * Binary log file (MYLOGGER_FEATURE_BINARY) is a sequence of records, each starting with this header.
+ * Everything is stored in host byte order and ABI.
+ * */
+typedef struct MyLogger_binary_header
+{
+    uint32_t len;               // length of the record without header
+    uint16_t kind;              // MyLogger_binary_kind_E
+    uint16_t level;             // mylogger_level_t of MESSAGE and TEXT records
+} MyLogger_binary_header_S;
+
+typedef enum MyLogger_binary_kind
+{
+    MYLOGGER_BINARY_FILE = 1,       // MyLogger_binary_file_S, starts every logging session
+    MYLOGGER_BINARY_SITE = 2,       // MyLogger_binary_site_S followed by file, function and format with '\0'
+    MYLOGGER_BINARY_MESSAGE = 3,    // MyLogger_binary_message_S followed by TID tag and captured arguments
+    MYLOGGER_BINARY_TEXT = 4        // formatted message, used for FATAL and formats that cannot be captured
+} MyLogger_binary_kind_E;
+
+#define MYLOGGER_BINARY_MAGIC       "MYLOGBIN"
+#define MYLOGGER_BINARY_VERSION     1
+#define MYLOGGER_BINARY_SITES       4096    /* must be a power of 2 */
+
+typedef struct MyLogger_binary_file
+{
+    char magic[8];              // MYLOGGER_BINARY_MAGIC
+    uint32_t version;           // MYLOGGER_BINARY_VERSION
+    uint8_t timestamps;         // prefix options of the session
+    uint8_t tid;
+    uint8_t timestamp_format;
+    uint8_t timestamp_precision;
+} MyLogger_binary_file_S;
+
+typedef struct MyLogger_binary_site
+{
+    uint32_t site;              // call site ID used by messages of the session
+    uint32_t line;
+    uint32_t file_len;          // lengths without '\0'
+    uint32_t func_len;
+    uint32_t format_len;
+} MyLogger_binary_site_S;
+
+typedef struct MyLogger_binary_message
+{
+    uint64_t time_ns;           // since epoch, 0 without MYLOGGER_FEATURE_TIMESTAMPS
+    uint32_t site;
+    uint32_t tid_tag_len;
+} MyLogger_binary_message_S;
+
+/**
+ * Call site read by mylogger_decode, strings point into the decoded file.
+ * */
+typedef struct MyLogger_decoded_site
+{
+    const char* file;
+    const char* func;
+    const char* format;
+    uint32_t line;
+} MyLogger_decoded_site_S;
+
+#define MYLOGGER_CACHE_LINE_SIZE        64
+#define MYLOGGER_RING_SIZE              (1 << 20)   /* must be a power of 2 */
+#define MYLOGGER_ASYNC_MESSAGE_MAX_SIZE (1 << 16)
+#define MYLOGGER_THREAD_BUFFER_SIZE     (1 << 16)   /* initial size of per-thread formatting buffer */
+#define MYLOGGER_MESSAGE_MAX_SIZE       (1 << 20)   /* per-thread buffer does not grow above this size */
+#define MYLOGGER_TRUNCATED_MARK         "... [TRUNCATED]\n"
+#define MYLOGGER_CAPTURE_FAILED         SIZE_MAX
+#define MYLOGGER_SINK_BATCH_SIZE        (1 << 16)
+#define MYLOGGER_BATCH_MAX_SIZE         (1 << 20)   /* open batch of a thread is written early above this size */
+#define MYLOGGER_SINKS_MAX              (3 + MYLOGGER_CUSTOM_SINKS_MAX)
+#define MYLOGGER_MMAP_REGION_SIZE       (1 << 24)
+#define MYLOGGER_MMAP_SLOTS             4
+#define MYLOGGER_ROTATION_QUEUE_SIZE    4
+#define MYLOGGER_FILE_NAME_MAX_SIZE     256
+#define MYLOGGER_WRITER_MAX_SLEEP_NS    1000000L
+#define MYLOGGER_LEVELS_COUNT           (MYLOGGER_LEVEL_FATAL + 1)
+#define MYLOGGER_OVERLOAD_SAMPLE_RATE   8
+#define MYLOGGER_OVERLOAD_REPORT_MS     1000
+#define MYLOGGER_COLLAPSE_CAPTURE_SIZE  256         /* messages with longer arguments are not collapsed */
+#define MYLOGGER_COLLAPSE_FLUSH_MS      1000        /* pending repeats are written at least this often */
+#define MYLOGGER_TRACE_MODULES_MAX      128
+#define MYLOGGER_TRACE_NAMES_SIZE       (1 << 14)
+#define MYLOGGER_CRASH_SIGNALS_COUNT    5
+#define MYLOGGER_CRASH_BUFFER_SIZE      (1 << 15)
+#define MYLOGGER_CRASH_STACK_SIZE       (1 << 16)
+#define MYLOGGER_CRASH_FLUSH_TIMEOUT_MS 1000
+#define MYLOGGER_STATS_REPORT_SIZE      2048
+#define MYLOGGER_URING_DEPTH            8           /* batches in flight */
+#define MYLOGGER_URING_ENTRIES          16          /* must be a power of 2 above MYLOGGER_URING_DEPTH */
+#define MYLOGGER_URING_SYNC             UINT64_MAX  /* user_data of fdatasync request */
+#define MYLOGGER_RECORDER_MIN_SIZE      4096
+
+/**
+ * Executable mapping of a loaded module, read from /proc/self/maps for MYLOGGER_TRACE_ADDRESSES.
+ * */
+typedef struct MyLogger_trace_module
+{
+    uintptr_t start;
+    uintptr_t end;
+    uintptr_t base;             // address where the module file is mapped from offset 0
+    const char* name;
+} MyLogger_trace_module_S;
+
+/**
+ * Single producer single consumer ring buffer owned by one logging thread (MYLOGGER_FEATURE_ASYNC).
+ * Producer formats into its thread buffer, then copies [header][record] into data and publishes head.
+ * Writer thread consumes records and publishes tail. Both counters only grow, index is counter & (size - 1).
+ * */
+typedef struct MyLogger_ring
+{
+    atomic_size_t head;
+    char head_pad[MYLOGGER_CACHE_LINE_SIZE - sizeof(atomic_size_t)];
+    atomic_size_t tail;
+    char tail_pad[MYLOGGER_CACHE_LINE_SIZE - sizeof(atomic_size_t)];
+    atomic_bool abandoned;      // owner thread exited, ring can be freed once empty
+    struct MyLogger_ring* next;
+    char data[MYLOGGER_RING_SIZE];
+} MyLogger_ring_S;
+
+/**
+ * Latency histogram of one thread (MYLOGGER_FEATURE_STATS), see mylogger_histogram_t.
+ * */
+typedef struct MyLogger_histogram
+{
+    atomic_uint_fast64_t count;
+    atomic_uint_fast64_t sum_ns;
+    atomic_uint_fast64_t max_ns;
+    atomic_uint_fast64_t buckets[MYLOGGER_STATS_BUCKETS];
+} MyLogger_histogram_S;
+
+/**
+ * Counters of one thread that uses the instance (MYLOGGER_FEATURE_STATS). Only the owner thread writes them,
+ * with plain load and store, mylogger_get_stats() reads them. Allocated in whole cache lines.
+ * */
+typedef struct MyLogger_stats
+{
+    atomic_uint_fast64_t messages[MYLOGGER_LEVELS_COUNT];
+    atomic_uint_fast64_t bytes;
+    atomic_uint_fast64_t truncated;
+    MyLogger_histogram_S lock_wait;
+    MyLogger_histogram_S sink_write;
+    atomic_bool exited;         // owner thread exited, counters are moved to retired totals
+    struct MyLogger_stats* next;
+} MyLogger_stats_S;
+
+/**
+ * Flight recorder of one thread (config.recorder). Circular buffer of [MyLogger_record_header_S][record],
+ * oldest records are overwritten. Owner thread adds records, any thread can dump them, both under the mutex
+ * that is not contended otherwise. Counters only grow, index is counter & (size - 1).
+ * */
+typedef struct MyLogger_recorder
+{
+    pthread_mutex_t mutex;
+    size_t head;                // end of the newest record
+    size_t tail;                // start of the oldest record
+    atomic_bool exited;         // owner thread exited, next new thread takes the recorder over
+    struct MyLogger_recorder* next;
+    char data[];                // recorder_size bytes
+} MyLogger_recorder_S;
+
+#define MYLOGGER_THREAD_NAME_MAX_SIZE   32
+#define MYLOGGER_FALLBACK_BUFFER_SIZE   256
+#define MYLOGGER_TID_TAG_MAX_SIZE       (MYLOGGER_THREAD_NAME_MAX_SIZE + 32)
+/**
+ * State of the thread that uses logger. Every thread writes only to its own state.
+ * */
+typedef struct MyLogger_thread
+{
+    atomic_bool active;             // thread is inside __mylogger_print
+    char active_pad[MYLOGGER_CACHE_LINE_SIZE - sizeof(atomic_bool)];
+    bool registered;
+    struct MyLogger_thread* prev;
+    struct MyLogger_thread* next;
+    MyLogger_time_cache_S time_cache;
+    size_t tid_tag_len;                             // 0 when tag has to be rendered again
+    char tid_tag[MYLOGGER_TID_TAG_MAX_SIZE];        // "[TID: n]" or "[TID: n name]"
+    char name[MYLOGGER_THREAD_NAME_MAX_SIZE];       // set by mylogger_set_thread_name
+    uint32_t random;                                // xorshift state for MYLOGGER_OVERLOAD_SAMPLE, 0 until seeded
+    bool truncated;                                 // last message did not fit in the buffer
+    char* buffer;                                   // formatting buffer, grows for long messages
+    size_t buffer_size;
+    char fallback[MYLOGGER_FALLBACK_BUFFER_SIZE];   // used when buffer cannot be allocated
+    struct MyLogger_instance* batch_logger;         // instance of the open batch, NULL when none
+    char* batch;                                    // formatted messages of the open batch
+    size_t batch_len;
+    size_t batch_size;
+    size_t batch_count;                             // messages added since begin, including written ones
+    mylogger_level_t batch_level;                   // highest level of the messages in the buffer
+    char* crash_stack;                              // alternate signal stack set up by the logger, NULL when none
+} MyLogger_thread_S;
+
+/**
+ * Batch written through io_uring (MYLOGGER_FEATURE_IO_URING). Buffer belongs to the kernel while busy.
+ * */
+typedef struct MyLogger_uring_slot
+{
+    char* buffer;
+    size_t len;
+    size_t done;                    // bytes written by completed requests, short writes are resubmitted
+    uint64_t offset;                // file offset of the first byte
+    bool busy;
+} MyLogger_uring_slot_S;
+
+/**
+ * io_uring of the log file (MYLOGGER_FEATURE_IO_URING). Batches are written at explicit offsets through
+ * a second descriptor without O_APPEND, so that several of them can be in flight in any order.
+ * Used under instance mutex, the crash handler only reserves space with offset.
+ * */
+typedef struct MyLogger_uring
+{
+    int ring_fd;
+    int fd;                         // log file opened again for writing at offsets
+    int file_fd;                    // descriptor of the sink, its position follows offset when the ring is closed
+    bool append;                    // file_fd has O_APPEND
+    atomic_uint_fast64_t* offset;   // next free byte of the file, shared with forked children
+    size_t buffer_size;
+    unsigned in_flight;             // requests waiting for completion
+    pthread_t owner;                // writer thread, kernel cancels requests of a thread when it exits
+    bool owned;
+    bool sync_pending;
+    _Atomic(unsigned)* sq_tail;
+    unsigned* sq_array;
+    unsigned sq_mask;
+    struct io_uring_sqe* sqes;
+    _Atomic(unsigned)* cq_head;
+    _Atomic(unsigned)* cq_tail;
+    unsigned cq_mask;
+    struct io_uring_cqe* cqes;
+    void* sq_ring;                  // submission and completion rings are mapped at once (IORING_FEAT_SINGLE_MMAP)
+    size_t sq_ring_size;
+    size_t sqes_size;
+    MyLogger_uring_slot_S slots[MYLOGGER_URING_DEPTH];
+} MyLogger_uring_S;
+
+/**
+ * Single output of the logger: log file, stdout, stderr or custom sink. Owned by one instance.
+ * Sinks are used under instance mutex or by the writer thread only.
+ * */
+typedef struct MyLogger_sink
+{
+    int fd;                         // -1 for custom sinks
+    bool rotate;                    // log file with rotation enabled
+    bool sync;                      // log file synced every sync_interval_ms by the writer thread
+    MyLogger_uring_S* uring;        // NULL when the sink is written with writev
+    mylogger_sink_t custom;
+    char* batch;                    // NULL when every message is written immediately
+    size_t batch_len;
+    size_t batch_size;
+    struct timespec batch_time;     // when the first message in the batch was added
+} MyLogger_sink_S;
+
+/**
+ * Slot of one region of the log file (MYLOGGER_FEATURE_MMAP). Region is released by the thread that fills
+ * it completely, in whichever process, then the slot can map region index + MYLOGGER_MMAP_SLOTS.
+ * */
+typedef struct MyLogger_mmap_region
+{
+    atomic_size_t index;            // region held by this slot, SIZE_MAX when free
+    atomic_size_t committed;        // bytes of the region already copied
+    char pad[MYLOGGER_CACHE_LINE_SIZE - 2 * sizeof(size_t)];
+} MyLogger_mmap_region_S;
+
+/**
+ * Part of the memory mapped log file shared with forked children, so that every process reserves space
+ * in the same file.
+ * */
+typedef struct MyLogger_mmap_shared
+{
+    pthread_mutex_t map_mutex;      // process-shared, serializes mapping and unmapping of regions
+    atomic_bool failed;             // file could not grow, following messages are dropped
+    atomic_size_t lost;             // start of the first message that was not written, SIZE_MAX when none
+    char pad[MYLOGGER_CACHE_LINE_SIZE];
+    atomic_size_t offset;           // next free byte relative to base
+    char pad2[MYLOGGER_CACHE_LINE_SIZE - sizeof(size_t)];
+    MyLogger_mmap_region_S slots[MYLOGGER_MMAP_SLOTS];
+} MyLogger_mmap_shared_S;
+
+/**
+ * Memory mapped log file (MYLOGGER_FEATURE_MMAP). Threads reserve space with fetch-add on offset.
+ * Every process maps the regions on its own, a mapping is stale when the slot holds another region.
+ * */
+typedef struct MyLogger_mmap
+{
+    int fd;                         // -1 when disabled
+    size_t base;                    // page aligned file offset of region 0
+    size_t region_size;
+    bool forked;                    // copy in a forked child, parent truncates the file when it closes
+    MyLogger_mmap_shared_S* shared;
+    _Atomic(char*) addr[MYLOGGER_MMAP_SLOTS];       // mappings of this process, NULL when nothing is mapped
+    atomic_size_t mapped[MYLOGGER_MMAP_SLOTS];      // region mapped at addr
+} MyLogger_mmap_S;
+
+/**
+ * Rotated file waiting to be closed and compressed by the rotation thread.
+ * */
+typedef struct MyLogger_rotated_file
+{
+    int fd;
+    FILE* file;                     // first log file is a stream, it is closed with fclose()
+    uint32_t seq;
+} MyLogger_rotated_file_S;
+
+/**
+ * Rotation of the created log file (mylogger_rotation_t). Active file is the first sink and is
+ * swapped under instance mutex. Everything else is guarded by mutex of the rotation.
+ * */
+typedef struct MyLogger_rotation
+{
+    bool enabled;
+    mylogger_rotation_t config;
+    char base[MYLOGGER_FILE_NAME_MAX_SIZE];     // log file name without ".txt"
+    size_t file_size;                           // bytes written to the active file, instance mutex
+    uint32_t active_seq;                        // instance mutex
+    bool active_owned;                          // active fd was opened by rotation, instance mutex
+    atomic_bool due;                            // interval elapsed, set by the rotation thread
+    pthread_t thread;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    bool stop;
+    bool forked;                                // copy in a forked child, rotation thread stayed in the parent
+    int next_fd;                                // opened ahead of time, -1 when not ready
+    uint32_t next_seq;
+    MyLogger_rotated_file_S rotated[MYLOGGER_ROTATION_QUEUE_SIZE];
+    size_t rotated_count;
+} MyLogger_rotation_S;
+
+/**
+ * Timer of synchronous instances with flush interval. Writes expired batches when no thread logs.
+ * Batches are guarded by instance mutex, everything else by mutex of the flusher.
+ * */
+typedef struct MyLogger_flusher
+{
+    bool enabled;
+    pthread_t thread;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    bool stop;
+    bool forked;                                // copy in a forked child, flusher thread stayed in the parent
+} MyLogger_flusher_S;
 
 /**
  * Structure that contains the most important information about logger.
  */
 typedef struct MyLogger_instance
 {
+    mylogger_head_t head;                   // level of the instance, has to be first
+    struct MyLogger_instance* next;         // list of live instances, guarded by lifecycle mutex
     FILE* file_fd;
+    char file_name[MYLOGGER_FILE_NAME_MAX_SIZE];   // empty when log file was given by the caller
     pthread_mutex_t mutex;
     MyLogger_features_S features;
+    MyLogger_timestamp_S timestamp;
+    MyLogger_sink_S sinks[MYLOGGER_SINKS_MAX];
+    size_t sinks_count;
+    MyLogger_mmap_S mmap;
+    MyLogger_rotation_S rotation;
+    MyLogger_flusher_S flusher;
+    _Atomic(uint64_t)* binary_sites;        // MYLOGGER_FEATURE_BINARY call site keys, index is the site ID
+    uint32_t flush_interval_ms;
+    mylogger_level_t flush_level;
+    uint32_t repeats_interval_ms;           // MYLOGGER_FEATURE_COLLAPSE pending repeats are written periodically
+    struct timespec repeats_time;           // last periodic write of pending repeats, writer or flusher thread only
+    uint32_t sync_interval_ms;
+    struct timespec sync_time;              // last fdatasync of the log file, writer thread only
+
+    // MYLOGGER_FEATURE_ASYNC only
+    pthread_t writer;
+    pthread_key_t ring_key;
+    pthread_mutex_t rings_mutex;            // guards adding and removing rings
+    _Atomic(MyLogger_ring_S*) rings;
+    atomic_bool writer_stop;
+    char* writer_buffer;                    // MYLOGGER_FEATURE_DEFERRED message formatted by the writer thread
+    char* writer_record;                    // record copied out of the ring
+    mylogger_overload_policy_t overload;
+    atomic_uint_fast64_t dropped[MYLOGGER_LEVELS_COUNT];   // messages dropped by the overload policy
+    uint64_t dropped_reported[MYLOGGER_LEVELS_COUNT];      // drops already reported, writer thread only
+    struct timespec dropped_report_time;
+    atomic_long writer_tid;
+    atomic_bool crash_flush;                // crash handler waits for the writer thread to write everything
+    atomic_bool crash_flushed;
+
+    // MYLOGGER_FEATURE_STATS only
+    pthread_key_t stats_key;
+    pthread_mutex_t stats_mutex;            // guards list of thread counters and retired totals
+    MyLogger_stats_S* stats;
+    mylogger_stats_t stats_retired;         // counters of exited threads
+    uint32_t stats_interval_ms;
+    atomic_uint_fast64_t stats_report_ns;   // CLOCK_MONOTONIC_COARSE time of the next report
+
+    // flight recorder (config.recorder) only
+    atomic_int level;                       // output threshold, head.level and default threshold let recorded levels in
+    pthread_key_t recorder_key;
+    pthread_mutex_t recorder_mutex;         // guards list of thread recorders
+    MyLogger_recorder_S* recorders;
+    size_t recorder_size;                   // power of 2, 0 when disabled
+    mylogger_level_t recorder_level;
+    mylogger_level_t recorder_dump_level;
+
+    mylogger_trace_mode_t trace;
+    mylogger_encoder_t encoder;
 }MyLogger_instance_S;
 
+/**
+ * Steps of __mylogger_create, each failed step is undone with all steps before it.
+ * */
+typedef enum MyLogger_create_step
+{
+    MYLOGGER_CREATE_SINKS,
+    MYLOGGER_CREATE_RECORDER,
+    MYLOGGER_CREATE_STATS,
+    MYLOGGER_CREATE_THREAD
+} MyLogger_create_step_E;
+
 static MyLogger_features_S __mylogger_parse_features(const mylogger_feature_t features);
 static void __mylogger_create_file_name(char* fileName);
-static size_t __mylogger_add_timestamp(char* log_buffer, const size_t buf_size);
-static size_t __mylogger_add_trace(char* log_buffer, const size_t buf_size);
-static size_t __mylogger_add_tid(char* log_buffer, const size_t buf_size);
+static void __mylogger_clock_init(MyLogger_timestamp_S* timestamp);
+static void __mylogger_clock_now(const MyLogger_timestamp_S* timestamp, struct timespec* now);
+static void __mylogger_put_digits(char* out, uint32_t value, size_t digits);
+static void __mylogger_time_cache_update(MyLogger_time_cache_S* cache,
+                                         mylogger_timestamp_format_t format,
+                                         time_t second);
+static size_t __mylogger_add_timestamp(char* log_buffer,
+                                       const size_t buf_size,
+                                       const MyLogger_timestamp_S* timestamp,
+                                       const struct timespec* time);
+static size_t __mylogger_add_trace(char* log_buffer, const size_t buf_size, mylogger_trace_mode_t mode);
+static size_t __mylogger_put_hex(char* out, uintptr_t value);
+static void __mylogger_trace_modules_load(void);
+static size_t __mylogger_trace_addresses(char* buffer, const size_t buf_size, void* const* frames, int count);
+static void __mylogger_crash_install(void);
+static void __mylogger_crash_uninstall(void);
+static void __mylogger_crash_stack(MyLogger_thread_S* thread);
+static void __mylogger_crash_handler(int sig);
+static void __mylogger_crash_write(MyLogger_instance_S* instance, const char* buffer, size_t len);
+static size_t __mylogger_put(char* log_buffer, const size_t buf_size, const char* src, const size_t len);
+static size_t __mylogger_add_tid(char* log_buffer, const size_t buf_size, const MyLogger_call_S* call);
+static void __mylogger_thread_tag_render(MyLogger_thread_S* thread);
+static void __mylogger_atfork_prepare(void);
+static void __mylogger_atfork_parent(void);
+static void __mylogger_atfork_child(void);
+static void __mylogger_fork_lock(MyLogger_instance_S* instance);
+static void __mylogger_fork_unlock(MyLogger_instance_S* instance);
+static void __mylogger_fork_reset(MyLogger_instance_S* instance);
+static void __mylogger_call_init(const MyLogger_instance_S* instance,
+                                 MyLogger_call_S* call,
+                                 const char* file,
+                                 const char* func,
+                                 size_t line,
+                                 mylogger_level_t level);
+static size_t __mylogger_utf8_len(const char* text, const size_t len);
+static size_t __mylogger_escape_char(const char* text, const size_t len, size_t* width);
+static size_t __mylogger_escape_scan(const char* text, const size_t len);
+static size_t __mylogger_escape(char* buffer, const size_t len, const size_t buf_size);
+static size_t __mylogger_put_escaped(char* log_buffer, const size_t buf_size, const char* src, const size_t len);
+static size_t __mylogger_put_uint(char* log_buffer, const size_t buf_size, uint64_t value, bool negative);
+static size_t __mylogger_add_key(char* log_buffer, const size_t buf_size, const char* key, mylogger_encoder_t encoder);
+static size_t __mylogger_add_string(char* log_buffer, const size_t buf_size, const char* src, const size_t len, mylogger_encoder_t encoder);
+static size_t __mylogger_add_field(char* log_buffer, const size_t buf_size, const mylogger_field_t* field, mylogger_encoder_t encoder);
+static size_t __mylogger_encode_prefix(const MyLogger_instance_S* instance,
+                                       char* buffer,
+                                       const size_t buf_size,
+                                       const MyLogger_call_S* call);
+static size_t __mylogger_mark_truncated(char* buffer, const size_t buf_size, const size_t buffer_idx, const bool truncated);
+static size_t __mylogger_encode_truncated(char* buffer,
+                                          const size_t buf_size,
+                                          const size_t message_idx,
+                                          const size_t text_end,
+                                          const bool json);
+static size_t __mylogger_format_suffix(const MyLogger_instance_S* instance,
+                                       char* buffer,
+                                       const size_t buf_size,
+                                       const size_t message_idx,
+                                       size_t buffer_idx,
+                                       bool* truncated,
+                                       const MyLogger_call_S* call);
+static size_t __mylogger_format_prefix(const MyLogger_instance_S* instance,
+                                       char* buffer,
+                                       const size_t buf_size,
+                                       const MyLogger_call_S* call);
+static size_t __mylogger_format(const MyLogger_instance_S* instance,
+                                char* buffer,
+                                const size_t buf_size,
+                                const MyLogger_call_S* call,
+                                const char* format,
+                                va_list args,
+                                bool* truncated);
+static char* __mylogger_thread_buffer(MyLogger_thread_S* thread, const size_t size);
+static size_t __mylogger_format_thread(const MyLogger_instance_S* instance,
+                                       MyLogger_thread_S* thread,
+                                       const size_t max_size,
+                                       const MyLogger_call_S* call,
+                                       const char* format,
+                                       va_list args,
+                                       const char** message);
+static const char* __mylogger_next_conversion(const char* format, MyLogger_conversion_S* conv);
+static char* __mylogger_put_decimal(char* end, uintmax_t value);
+static char* __mylogger_put_xdigits(char* end, uintmax_t value, bool upper);
+static char* __mylogger_put_fixed(char* end, double value, int precision);
+static size_t __mylogger_put_fill(char* out, const size_t size, char c, size_t count);
+static size_t __mylogger_put_field(char* out,
+                                   const size_t size,
+                                   const MyLogger_conversion_S* conv,
+                                   bool pad_zero,
+                                   const char* prefix,
+                                   size_t prefix_len,
+                                   size_t zeros,
+                                   const char* body,
+                                   size_t body_len);
+static size_t __mylogger_put_arg(char* out, const size_t size, const MyLogger_conversion_S* conv, const MyLogger_arg_U* arg);
+static size_t __mylogger_put_arg_slow(char* out,
+                                      const size_t size,
+                                      const char* spec,
+                                      const MyLogger_conversion_S* conv,
+                                      const int* stars,
+                                      const MyLogger_arg_U* arg);
+static size_t __mylogger_put_conversion(char* out,
+                                        const size_t size,
+                                        const char* spec,
+                                        const MyLogger_conversion_S* conv,
+                                        const int* stars,
+                                        const MyLogger_arg_U* arg);
+static MyLogger_format_program_S* __mylogger_format_parse(const char* format);
+static const MyLogger_format_program_S* __mylogger_format_program(mylogger_site_t* site, const char* format);
+static size_t __mylogger_format_run(char* buffer, const size_t buf_size, const MyLogger_format_program_S* program, va_list args);
+static size_t __mylogger_capture(char* buffer,
+                                 const size_t buf_size,
+                                 const MyLogger_call_S* call,
+                                 const char* format,
+                                 va_list args);
+static size_t __mylogger_capture_args(char* buffer, const size_t buf_size, const char* format, va_list args);
+static size_t __mylogger_render_args(char* buffer, const size_t buf_size, const char* format, const char* args, const char* end);
+static uint32_t __mylogger_binary_site(MyLogger_instance_S* instance, uint64_t key, bool claim);
+static size_t __mylogger_binary_text(MyLogger_thread_S* thread, const char** message, size_t len, mylogger_level_t level);
+static size_t __mylogger_binary_encode(MyLogger_instance_S* instance,
+                                       MyLogger_thread_S* thread,
+                                       const size_t max_size,
+                                       const MyLogger_call_S* call,
+                                       const char* format,
+                                       va_list args,
+                                       const char** record);
+static size_t __mylogger_message(MyLogger_instance_S* instance,
+                                 MyLogger_thread_S* thread,
+                                 const size_t max_size,
+                                 const MyLogger_call_S* call,
+                                 const char* format,
+                                 va_list args,
+                                 const char** message);
+static void __mylogger_log(MyLogger_instance_S* instance, const MyLogger_call_S* call, const char* format, va_list args);
+static void __attribute__(( format(printf, 3, 4) )) __mylogger_log_site(MyLogger_instance_S* instance,
+                                                                      mylogger_site_t* site,
+                                                                      const char* format,
+                                                                      ...);
+static bool __mylogger_site_repeated(MyLogger_instance_S* instance, mylogger_site_t* site, const char* format, va_list args);
+static void __mylogger_sites_flush_repeats(MyLogger_instance_S* instance, bool forget);
+static void __mylogger_repeats_expired(MyLogger_instance_S* instance);
+static void __mylogger_print_site_va(MyLogger_instance_S* instance,
+                                     mylogger_site_t* site,
+                                     const mylogger_field_t* fields,
+                                     size_t fields_count,
+                                     const char* format,
+                                     va_list args);
+static MyLogger_instance_S* __mylogger_create(const mylogger_config_t* config, mylogger_init_error_code_t* error);
+static void __mylogger_create_unwind(MyLogger_instance_S* instance,
+                                     const mylogger_config_t* config,
+                                     MyLogger_create_step_E failed,
+                                     bool file_created);
+static void __mylogger_retire(MyLogger_instance_S* instance);
+static void __mylogger_free(MyLogger_instance_S* instance);
+static void __mylogger_site_prefix(mylogger_site_t* site);
+static void __mylogger_sites_prepare(void);
+static void __mylogger_sites_release(void);
+static int __mylogger_decode_session(const char* data, size_t len, MyLogger_decoded_site_S* sites, char* line, FILE* out);
+static mylogger_init_error_code_t __mylogger_sinks_open(MyLogger_instance_S* instance, const mylogger_config_t* config);
+static void __mylogger_sinks_close(MyLogger_instance_S* instance);
+static mylogger_init_error_code_t __mylogger_mmap_open(MyLogger_mmap_S* map, FILE* file, size_t region_size);
+static void __mylogger_mmap_close(MyLogger_mmap_S* map);
+static void __mylogger_mmap_lock(MyLogger_mmap_S* map);
+static char* __mylogger_mmap_region(MyLogger_mmap_S* map, size_t index);
+static void __mylogger_mmap_release(MyLogger_mmap_S* map, size_t index);
+static void __mylogger_mmap_drop(MyLogger_mmap_S* map, size_t start);
+static void __mylogger_mmap_write(MyLogger_mmap_S* map, const char* buffer, size_t len);
+static mylogger_init_error_code_t __mylogger_rotation_start(MyLogger_instance_S* instance, const mylogger_rotation_t* config);
+static void __mylogger_rotation_stop(MyLogger_instance_S* instance);
+static void __mylogger_rotation_file_name(const MyLogger_rotation_S* rotation, uint32_t seq, char* name, size_t size);
+static void __mylogger_rotation_swap(MyLogger_instance_S* instance, MyLogger_sink_S* sink);
+#ifdef MYLOGGER_WITH_COMPRESSION
+static bool __mylogger_compress_file(const char* name, mylogger_compression_t compression);
+#endif
+static void __mylogger_rotation_finish(MyLogger_rotation_S* rotation, const MyLogger_rotated_file_S* rotated);
+static void* __mylogger_rotation_thread(void* arg);
+static void __mylogger_sink_writev(MyLogger_sink_S* sink, struct iovec* iov, int iovcnt, MyLogger_stats_S* stats);
+static void __mylogger_sink_flush(MyLogger_sink_S* sink, MyLogger_stats_S* stats);
+static void __mylogger_sinks_sync(MyLogger_instance_S* instance);
+static MyLogger_uring_S* __mylogger_uring_open(int fd, size_t buffer_size);
+static void __mylogger_uring_close(MyLogger_uring_S* uring);
+static void __mylogger_uring_detach(MyLogger_uring_S* uring);
+static bool __mylogger_uring_push(MyLogger_uring_S* uring, const struct io_uring_sqe* sqe);
+static void __mylogger_uring_submit(MyLogger_uring_S* uring, MyLogger_uring_slot_S* slot);
+static void __mylogger_uring_pwrite(MyLogger_uring_S* uring, MyLogger_uring_slot_S* slot);
+static void __mylogger_uring_reap(MyLogger_uring_S* uring, bool wait);
+static void __mylogger_uring_wait(MyLogger_uring_S* uring);
+static void __mylogger_uring_settle(MyLogger_uring_S* uring);
+static MyLogger_uring_slot_S* __mylogger_uring_slot(MyLogger_uring_S* uring);
+static void __mylogger_uring_writev(MyLogger_uring_S* uring, const struct iovec* iov, int iovcnt);
+static void __mylogger_uring_flush(MyLogger_uring_S* uring, MyLogger_sink_S* sink);
+static void __mylogger_uring_sync(MyLogger_uring_S* uring);
+static void __mylogger_uring_pwritev(MyLogger_uring_S* uring, const struct iovec* iov, int iovcnt);
+static uint64_t __mylogger_elapsed_ms(const struct timespec* since, const struct timespec* now);
+static void __mylogger_sinks_flush_expired(MyLogger_instance_S* instance);
+static mylogger_init_error_code_t __mylogger_flusher_start(MyLogger_instance_S* instance);
+static void __mylogger_flusher_stop(MyLogger_instance_S* instance);
+static void* __mylogger_flusher_thread(void* arg);
+static void __mylogger_write(MyLogger_instance_S* instance,
+                             const char* buffer,
+                             const size_t len,
+                             mylogger_level_t level);
+static void __mylogger_batch_append(MyLogger_instance_S* instance,
+                                    MyLogger_thread_S* thread,
+                                    const char* message,
+                                    const size_t len,
+                                    mylogger_level_t level);
+static void __mylogger_batch_write(MyLogger_instance_S* instance,
+                                   MyLogger_thread_S* thread,
+                                   const char* message,
+                                   const size_t len,
+                                   mylogger_level_t level);
+static bool __mylogger_batch_begin(MyLogger_instance_S* instance);
+static void __mylogger_batch_close(MyLogger_instance_S* instance);
+static mylogger_init_error_code_t __mylogger_async_start(MyLogger_instance_S* instance);
+static void __mylogger_async_stop(MyLogger_instance_S* instance);
+static void __mylogger_ring_abandon(void* ring);
+static MyLogger_ring_S* __mylogger_get_thread_ring(MyLogger_instance_S* instance);
+static uint32_t __mylogger_random(MyLogger_thread_S* thread);
+static bool __mylogger_ring_admit(MyLogger_instance_S* instance, const MyLogger_ring_S* ring, mylogger_level_t level);
+static bool __mylogger_ring_push(MyLogger_instance_S* instance,
+                                 MyLogger_ring_S* ring,
+                                 MyLogger_record_type_E type,
+                                 mylogger_level_t level,
+                                 const char* record,
+                                 const size_t len);
+static void __mylogger_dropped_report(MyLogger_instance_S* instance, bool force);
+static mylogger_init_error_code_t __mylogger_stats_start(MyLogger_instance_S* instance, uint32_t interval_ms);
+static void __mylogger_stats_stop(MyLogger_instance_S* instance);
+static void __mylogger_stats_abandon(void* stats);
+static MyLogger_stats_S* __mylogger_get_thread_stats(MyLogger_instance_S* instance);
+static inline void __mylogger_stats_add(atomic_uint_fast64_t* counter, uint64_t value);
+static uint64_t __mylogger_stats_now(void);
+static void __mylogger_histogram_add(MyLogger_histogram_S* histogram, uint64_t ns);
+static void __mylogger_stats_merge(mylogger_stats_t* totals, const MyLogger_stats_S* stats);
+static void __mylogger_stats_collect(MyLogger_instance_S* instance, mylogger_stats_t* stats);
+static void __mylogger_lock(MyLogger_instance_S* instance, MyLogger_stats_S* stats);
+static bool __mylogger_stats_due(MyLogger_instance_S* instance);
+static void __mylogger_stats_report(MyLogger_instance_S* instance);
+static mylogger_init_error_code_t __mylogger_recorder_start(MyLogger_instance_S* instance, const mylogger_recorder_t* config);
+static void __mylogger_recorder_stop(MyLogger_instance_S* instance);
+static void __mylogger_recorder_abandon(void* recorder);
+static MyLogger_recorder_S* __mylogger_get_thread_recorder(MyLogger_instance_S* instance);
+static void __mylogger_recorder_copy(const MyLogger_recorder_S* recorder, size_t size, size_t pos, char* out, const size_t len);
+static void __mylogger_recorder_add(MyLogger_instance_S* instance, const MyLogger_call_S* call, const char* format, va_list args);
+static void __mylogger_recorder_output(MyLogger_instance_S* instance,
+                                       const char* message,
+                                       const size_t len,
+                                       mylogger_level_t level,
+                                       bool locked);
+static void __mylogger_recorder_dump(MyLogger_instance_S* instance,
+                                     MyLogger_recorder_S* recorder,
+                                     char* record,
+                                     char* msg,
+                                     bool crash);
+static void __mylogger_recorders_dump(MyLogger_instance_S* instance, bool crash);
+static void __mylogger_level_set(MyLogger_instance_S* instance, atomic_int* gate, mylogger_level_t level);
+static size_t __mylogger_render_deferred(const MyLogger_instance_S* instance, const char* record, size_t len, char* msg, bool* truncated);
+static void __mylogger_ring_read(const MyLogger_ring_S* ring, size_t pos, char* out, const size_t len);
+static size_t __mylogger_drain_rings(MyLogger_instance_S* instance);
+static void* __mylogger_writer_thread(void* arg);
+static void __mylogger_threads_init(void);
+static void __mylogger_thread_register(MyLogger_thread_S* thread);
+static void __mylogger_thread_unregister(void* thread);
+static inline MyLogger_instance_S* __mylogger_enter(void);
+static inline void __mylogger_leave(void);
+static void __mylogger_wait_for_readers(void);
+static void __mylogger_membarrier_register(void);
 
-static MyLogger_instance_S* g_mylogger_instance;
-static atomic_flag g_logger_is_initilized;
+static _Atomic(MyLogger_instance_S*) g_mylogger_instance;                          // default instance of MYLOGGER_* macros
+static _Atomic(MyLogger_instance_S*) g_mylogger_instances;                         // every live instance, read by crash handler
+static mylogger_site_t* g_mylogger_sites;                                           // registered call sites
+static pthread_mutex_t g_mylogger_sites_mutex = PTHREAD_MUTEX_INITIALIZER;
+static bool g_mylogger_sites_prefixed;                                              // some instance exists, sites mutex
+static pthread_mutex_t g_mylogger_lifecycle_mutex = PTHREAD_MUTEX_INITIALIZER;     // serializes init and destroy
+static _Thread_local MyLogger_thread_S g_mylogger_thread;
+static MyLogger_thread_S* g_mylogger_threads;                                       // every thread that used logger
+static pthread_mutex_t g_mylogger_threads_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_key_t g_mylogger_thread_key;
+static pthread_once_t g_mylogger_thread_key_once = PTHREAD_ONCE_INIT;
+static atomic_bool g_mylogger_membarrier;                                           // readers can use compiler fence
+static pthread_once_t g_mylogger_membarrier_once = PTHREAD_ONCE_INIT;
+static MyLogger_trace_module_S g_mylogger_trace_modules[MYLOGGER_TRACE_MODULES_MAX];   // MYLOGGER_TRACE_ADDRESSES
+static size_t g_mylogger_trace_modules_count;
+static char g_mylogger_trace_names[MYLOGGER_TRACE_NAMES_SIZE];
+static const int g_mylogger_crash_signals[MYLOGGER_CRASH_SIGNALS_COUNT] = {SIGSEGV, SIGBUS, SIGILL, SIGFPE, SIGABRT};
+static const char* g_mylogger_crash_names[MYLOGGER_CRASH_SIGNALS_COUNT] = {"SIGSEGV", "SIGBUS", "SIGILL", "SIGFPE", "SIGABRT"};
+static atomic_bool g_mylogger_crash_entered;                    // crash handler walks the instances
+static size_t g_mylogger_crash_users;                           // instances with crash handler, lifecycle mutex
+static atomic_bool g_mylogger_crash_installed;                  // threads get an alternate stack when they register
+static struct sigaction g_mylogger_crash_previous[MYLOGGER_CRASH_SIGNALS_COUNT];
+static void* g_mylogger_crash_frames[256];                      // preallocated, crash handler cannot allocate
+static char g_mylogger_crash_buffer[MYLOGGER_CRASH_BUFFER_SIZE];
+static char g_mylogger_crash_stack[MYLOGGER_CRASH_STACK_SIZE];  // alternate stack of the installing thread
+atomic_int __mylogger_level_threshold = MYLOGGER_LEVEL_DEBUG;
 static const char* mylogger_level_print[] = {"DEBUG",
                                              "INFO",
                                              "WARNING",
@@ -76,11 +952,20 @@ static MyLogger_features_S __mylogger_parse_features(const mylogger_feature_t fe
       .feat_timestamps =    features & MYLOGGER_FEATURE_TIMESTAMPS,
       .feat_tid =           features & MYLOGGER_FEATURE_THREAD_ID,
       .feat_no_file =       features & MYLOGGER_FEATURE_NO_FILE,
-      .feat_ansi_logs =     features & MYLOGGER_FEATURE_NO_FILE
+      .feat_ansi_logs =     features & MYLOGGER_FEATURE_NO_FILE,
+      .feat_async =         features & (MYLOGGER_FEATURE_ASYNC | MYLOGGER_FEATURE_DEFERRED),
+      .feat_deferred =      (features & MYLOGGER_FEATURE_DEFERRED) && !(features & MYLOGGER_FEATURE_BINARY),
+      .feat_mmap =          (features & MYLOGGER_FEATURE_MMAP) && !(features & MYLOGGER_FEATURE_NO_FILE),
+      .feat_binary =        features & MYLOGGER_FEATURE_BINARY,
+      .feat_collapse =      features & MYLOGGER_FEATURE_COLLAPSE,
+      .feat_crash_handler = features & MYLOGGER_FEATURE_CRASH_HANDLER,
+      .feat_stats =         features & MYLOGGER_FEATURE_STATS,
+      .feat_uring =         (features & MYLOGGER_FEATURE_IO_URING) && (features & (MYLOGGER_FEATURE_ASYNC | MYLOGGER_FEATURE_DEFERRED)) &&
+                            !(features & (MYLOGGER_FEATURE_MMAP | MYLOGGER_FEATURE_SHARED)),
+      .feat_shared =        features & MYLOGGER_FEATURE_SHARED
     };
 }
 
-#define MYLOGGER_FILE_NAME_MAX_SIZE 256
 /**
  * Creates name for the new log file with a timestamp.
  * @param[out] fileName - pointer where to save new log file name
@@ -88,51 +973,199 @@ static MyLogger_features_S __mylogger_parse_features(const mylogger_feature_t fe
 static void __mylogger_create_file_name(char* fileName)
 {
     time_t rawTime;
-    struct tm* timeInfo = malloc(sizeof(*timeInfo));
+    struct tm timeInfo;
 
     time(&rawTime);
-    localtime_r(&rawTime, timeInfo);
+    localtime_r(&rawTime, &timeInfo);
+
+    strftime(fileName, MYLOGGER_FILE_NAME_MAX_SIZE, "log_%Y%m%d_%H%M%S.txt", &timeInfo);
+}
+
+#define MYLOGGER_TSC_CALIBRATION_NS 10000000L
+/**
+ * Prepares chosen clock. MYLOGGER_CLOCK_TSC is calibrated against CLOCK_REALTIME.
+ *
+ * @param[in,out] timestamp - timestamp options
+ * */
+static void __mylogger_clock_init(MyLogger_timestamp_S* timestamp)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    if(timestamp->clock == MYLOGGER_CLOCK_TSC)
+    {
+        struct timespec end;
+        clock_gettime(CLOCK_REALTIME, &timestamp->time_base);
+        timestamp->tsc_base = __builtin_ia32_rdtsc();
+        nanosleep(&(struct timespec){.tv_sec = 0, .tv_nsec = MYLOGGER_TSC_CALIBRATION_NS}, NULL);
+        clock_gettime(CLOCK_REALTIME, &end);
+        const uint64_t ticks = __builtin_ia32_rdtsc() - timestamp->tsc_base;
+
+        const double elapsed_ns = (double)(end.tv_sec - timestamp->time_base.tv_sec) * 1e9 +
+                                  (double)(end.tv_nsec - timestamp->time_base.tv_nsec);
+        timestamp->ns_per_tick = ticks > 0 ? elapsed_ns / (double)ticks : 0.0;
+        if(timestamp->ns_per_tick <= 0.0)
+            timestamp->clock = MYLOGGER_CLOCK_REALTIME;
+    }
+#else
+    if(timestamp->clock == MYLOGGER_CLOCK_TSC)
+        timestamp->clock = MYLOGGER_CLOCK_REALTIME;
+#endif
+}
+
+/**
+ * Reads current time from chosen clock.
+ *
+ * @param[in] timestamp - timestamp options
+ * @param[out] now - current time
+ * */
+static void __mylogger_clock_now(const MyLogger_timestamp_S* timestamp, struct timespec* now)
+{
+    switch(timestamp->clock)
+    {
+#if defined(__x86_64__) || defined(__i386__)
+        case MYLOGGER_CLOCK_TSC:
+        {
+            const uint64_t ns = (uint64_t)((double)(__builtin_ia32_rdtsc() - timestamp->tsc_base) * timestamp->ns_per_tick) +
+                                (uint64_t)timestamp->time_base.tv_nsec;
+            now->tv_sec = timestamp->time_base.tv_sec + (time_t)(ns / 1000000000UL);
+            now->tv_nsec = (long)(ns % 1000000000UL);
+            break;
+        }
+#endif
+        case MYLOGGER_CLOCK_REALTIME_COARSE:
+            clock_gettime(CLOCK_REALTIME_COARSE, now);
+            break;
+        case MYLOGGER_CLOCK_REALTIME:
+        default:
+            clock_gettime(CLOCK_REALTIME, now);
+            break;
+    }
+}
+
+static const char mylogger_digit_pairs[] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+
+/**
+ * Writes value as exactly digits decimal digits, padded with zeros. Nothing else is written.
+ *
+ * @param[out] out - destination
+ * @param[in] value - value to write, has to fit in digits
+ * @param[in] digits - number of digits
+ * */
+static void __mylogger_put_digits(char* out, uint32_t value, size_t digits)
+{
+    while(digits >= 2)
+    {
+        digits -= 2;
+        memcpy(&out[digits], &mylogger_digit_pairs[(value % 100) * 2], 2);
+        value /= 100;
+    }
+    if(digits == 1)
+        out[0] = (char)('0' + value % 10);
+}
 
-    strftime(fileName, MYLOGGER_FILE_NAME_MAX_SIZE, "log_%Y%m%d_%H%M%S.txt", timeInfo);
-    free(timeInfo);
+/**
+ * Renders parts of the timestamp that change at most once per second.
+ *
+ * @param[out] cache - time cache of the calling thread
+ * @param[in] format - timestamp layout
+ * @param[in] second - seconds since epoch
+ * */
+static void __mylogger_time_cache_update(MyLogger_time_cache_S* cache,
+                                         mylogger_timestamp_format_t format,
+                                         time_t second)
+{
+    struct tm tm_time;
+    localtime_r(&second, &tm_time);
+
+    cache->second = second;
+    cache->format = format;
+    if(format == MYLOGGER_TIMESTAMP_ISO8601)
+    {
+        cache->prefix_len = strftime(cache->prefix, sizeof(cache->prefix), "[%Y-%m-%dT%H:%M:%S", &tm_time);
+
+        const bool negative = tm_time.tm_gmtoff < 0;
+        const uint32_t offset_min = (uint32_t)(negative ? -tm_time.tm_gmtoff : tm_time.tm_gmtoff) / 60;
+        cache->suffix[0] = negative ? '-' : '+';
+        __mylogger_put_digits(&cache->suffix[1], offset_min / 60, 2);
+        cache->suffix[3] = ':';
+        __mylogger_put_digits(&cache->suffix[4], offset_min % 60, 2);
+        memcpy(&cache->suffix[6], "] ", 3);
+        cache->suffix_len = 8;
+    }
+    else
+    {
+        cache->prefix_len = strftime(cache->prefix, sizeof(cache->prefix), "[%H:%M:%S", &tm_time);
+        memcpy(cache->suffix, "] ", 3);
+        cache->suffix_len = 2;
+    }
 }
 
 /**
- * Creates timestamp and adds it to the message buffer with snprinf function.
+ * Adds timestamp to the message buffer. Date and time are rendered once per second per thread,
+ * only fraction of second is formatted for every message.
  *
  * @param[in] log_buffer message buffer
  * @param[in] buf_size current buffer size
+ * @param[in] timestamp timestamp options
+ * @param[in] time time of the log call
  * @return The number of characters that would have been written on the buffer.
  * */
-static size_t __mylogger_add_timestamp(char* log_buffer, const size_t buf_size)
+static size_t __mylogger_add_timestamp(char* log_buffer,
+                                       const size_t buf_size,
+                                       const MyLogger_timestamp_S* timestamp,
+                                       const struct timespec* time)
 {
-    size_t new_buf_size = 0;
+    MyLogger_time_cache_S* cache = &g_mylogger_thread.time_cache;
+    if(cache->second != time->tv_sec || cache->format != timestamp->format || cache->prefix_len == 0)
+        __mylogger_time_cache_update(cache, timestamp->format, time->tv_sec);
 
-    struct timeval timeval_str;
-    gettimeofday(&timeval_str, NULL);
-
-    const struct tm tm_time = *localtime(&(time_t){timeval_str.tv_sec});
-    new_buf_size = strftime(&log_buffer[new_buf_size], buf_size - new_buf_size, "[%H:%M:%S", &tm_time);
-    new_buf_size += (size_t)snprintf(&log_buffer[new_buf_size], buf_size - new_buf_size, ".%06ld] ", (long)timeval_str.tv_usec);
+    char stamp[3 * MYLOGGER_TIMESTAMP_PART_MAX_SIZE];
+    size_t len = cache->prefix_len;
+    memcpy(stamp, cache->prefix, len);
+    stamp[len++] = '.';
+    if(timestamp->precision == MYLOGGER_TIMESTAMP_NSEC)
+    {
+        __mylogger_put_digits(&stamp[len], (uint32_t)time->tv_nsec, 9);
+        len += 9;
+    }
+    else
+    {
+        __mylogger_put_digits(&stamp[len], (uint32_t)time->tv_nsec / 1000, 6);
+        len += 6;
+    }
+    memcpy(&stamp[len], cache->suffix, cache->suffix_len);
+    len += cache->suffix_len;
 
-    return  new_buf_size;
+    return __mylogger_put(log_buffer, buf_size, stamp, len);
 }
 
 #define MYLOGGER_CALLSTACK_MAX_SIZE 256
 /**
- * Gets stack trace and adds it to the message buffer with snprinf function.
+ * Gets stack trace and adds it to the message buffer.
  *
  * @param[in] log_buffer message buffer
  * @param[in] buf_size current buffer size
+ * @param[in] mode - symbolized or raw addresses
  * @return The number of characters that would have been written on the buffer.
  * */
-static size_t __mylogger_add_trace(char* log_buffer, const size_t buf_size)
+static size_t __mylogger_add_trace(char* log_buffer, const size_t buf_size, mylogger_trace_mode_t mode)
 {
     size_t new_buf_size = 0;
     void* stack[MYLOGGER_CALLSTACK_MAX_SIZE];
     int frames = backtrace(stack, MYLOGGER_CALLSTACK_MAX_SIZE);
     if(frames < 0)
         return 0;
+    if(mode == MYLOGGER_TRACE_ADDRESSES)
+        return __mylogger_trace_addresses(log_buffer, buf_size, stack, frames);
 
     char** symbols = backtrace_symbols(stack, frames);
     if(symbols == NULL)
@@ -140,7 +1173,7 @@ static size_t __mylogger_add_trace(char* log_buffer, const size_t buf_size)
     new_buf_size = (size_t) snprintf(&log_buffer[new_buf_size],
                                      buf_size - new_buf_size,
                                      "TRACE:\n");
-    for(int i = 0; i < frames; i++)
+    for(int i = 0; i < frames && new_buf_size < buf_size; i++)
     {
         new_buf_size += (size_t) snprintf(&log_buffer[new_buf_size],
                                           buf_size - new_buf_size,
@@ -152,144 +1185,6227 @@ static size_t __mylogger_add_trace(char* log_buffer, const size_t buf_size)
 }
 
 /**
- * Gets Thread ID and adds it to the message buffer with snprinf function.
+ * Writes value as "0x..." hexadecimal number. Async-signal-safe.
  *
- * @param[in] log_buffer message buffer
- * @param[in] buf_size current buffer size
- * @return The number of characters that would have been written on the buffer.
+ * @param[out] out - buffer of at least 2 + 2 * sizeof(uintptr_t) characters
+ * @param[in] value - number to write
+ * @return number of written characters.
  * */
-static size_t __mylogger_add_tid(char* log_buffer, const size_t buf_size)
+static size_t __mylogger_put_hex(char* out, uintptr_t value)
 {
-    return (size_t) snprintf(log_buffer, buf_size, "[TID: %ld]", (long) syscall(__NR_gettid));
+    char digits[2 * sizeof(uintptr_t)];
+    size_t count = 0;
+    do
+    {
+        digits[count++] = "0123456789abcdef"[value & 0xF];
+        value >>= 4;
+    } while(value != 0);
+
+    out[0] = '0';
+    out[1] = 'x';
+    for(size_t i = 0; i < count; i++)
+        out[2 + i] = digits[count - 1 - i];
+    return 2 + count;
 }
 
-mylogger_init_error_code_t mylogger_init(FILE* log_file, mylogger_feature_t features)
+/**
+ * Reads executable mappings of loaded modules from /proc/self/maps, so that MYLOGGER_TRACE_ADDRESSES
+ * can print offsets inside modules without locks or allocation. Modules loaded later show only addresses.
+ * */
+static void __mylogger_trace_modules_load(void)
 {
-    // check if logger is not already initialized
-    if(atomic_flag_test_and_set(&g_logger_is_initilized) == 0)
-    {
-        g_mylogger_instance = malloc(sizeof(MyLogger_instance_S));
-        if(g_mylogger_instance == NULL)
-        {
-            atomic_flag_clear(&g_logger_is_initilized);
-            fprintf(stderr,"MyLogger malloc error!\n");
-            return MYLOGGER_INIT_OTHER_ERROR;
-        }
-
-        (*g_mylogger_instance) = (MyLogger_instance_S) {
-          .file_fd = log_file,
-          .mutex = PTHREAD_MUTEX_INITIALIZER,
-          .features = __mylogger_parse_features(features)
-        };
+    g_mylogger_trace_modules_count = 0;
+    const int fd = open("/proc/self/maps", O_RDONLY | O_CLOEXEC);
+    if(fd < 0)
+        return;
 
-        // if no logging file specified create new file
-        if(g_mylogger_instance->file_fd == NULL && !g_mylogger_instance->features.feat_no_file)
+    char data[4096];
+    char line[512];
+    size_t line_len = 0;
+    size_t names_len = 0;
+    ssize_t got;
+    while((got = read(fd, data, sizeof(data))) > 0)
+    {
+        for(ssize_t i = 0; i < got; i++)
         {
-            char filename[MYLOGGER_FILE_NAME_MAX_SIZE];
-            __mylogger_create_file_name(filename);
-            g_mylogger_instance->file_fd = fopen(filename, "a+");
-
-            if(g_mylogger_instance->file_fd == NULL)
+            if(data[i] != '\n')
             {
-                fprintf(stderr,"MyLogger file creation error!\n");
+                if(line_len < sizeof(line) - 1)
+                    line[line_len++] = data[i];
+                continue;
+            }
+            line[line_len] = '\0';
+            line_len = 0;
 
-                pthread_mutex_destroy(&g_mylogger_instance->mutex);
-                atomic_flag_clear(&g_logger_is_initilized);
-                free(g_mylogger_instance);
+            // start-end perms offset dev inode path
+            unsigned long start, end, offset;
+            char perms[5];
+            int path = 0;
+            if(sscanf(line, "%lx-%lx %4s %lx %*s %*s %n", &start, &end, perms, &offset, &path) < 4 ||
+               path == 0 || line[path] != '/' || perms[2] != 'x')
+                continue;
 
-                return MYLOGGER_INIT_FILE_CREATION_ERROR;
-            }
+            const size_t name_len = strlen(&line[path]) + 1;
+            if(g_mylogger_trace_modules_count == MYLOGGER_TRACE_MODULES_MAX || names_len + name_len > sizeof(g_mylogger_trace_names))
+                break;
+            memcpy(&g_mylogger_trace_names[names_len], &line[path], name_len);
+            g_mylogger_trace_modules[g_mylogger_trace_modules_count++] = (MyLogger_trace_module_S){
+                .start = start,
+                .end = end,
+                .base = start - offset,
+                .name = &g_mylogger_trace_names[names_len]
+            };
+            names_len += name_len;
         }
-        else if(g_mylogger_instance->file_fd == NULL && \
-                !g_mylogger_instance->features.feat_stdout && \
-                !g_mylogger_instance->features.feat_stderr )
-        {
-            fprintf(stderr,"MyLogger no file descriptors specified!\n");
+    }
+    close(fd);
+}
 
-            pthread_mutex_destroy(&g_mylogger_instance->mutex);
-            atomic_flag_clear(&g_logger_is_initilized);
-            free(g_mylogger_instance);
+/**
+ * Writes stack trace as "module(+0xoffset) [0xaddress]" lines. Async-signal-safe.
+ *
+ * @param[out] buffer - message buffer
+ * @param[in] buf_size - buffer size
+ * @param[in] frames - return addresses from backtrace()
+ * @param[in] count - number of frames
+ * @return length of the trace in the buffer, frames that do not fit are left out.
+ * */
+static size_t __mylogger_trace_addresses(char* buffer, const size_t buf_size, void* const* frames, int count)
+{
+    static const char header[] = "TRACE:\n";
+    size_t idx = 0;
+    if(buf_size <= sizeof(header))
+        return 0;
+    memcpy(buffer, header, sizeof(header) - 1);
+    idx += sizeof(header) - 1;
 
-            return MYLOGGER_INIT_OTHER_ERROR;
+    for(int i = 0; i < count; i++)
+    {
+        const uintptr_t addr = (uintptr_t)frames[i];
+        const MyLogger_trace_module_S* module = NULL;
+        for(size_t m = 0; m < g_mylogger_trace_modules_count && module == NULL; m++)
+        {
+            if(addr >= g_mylogger_trace_modules[m].start && addr < g_mylogger_trace_modules[m].end)
+                module = &g_mylogger_trace_modules[m];
         }
 
-        return MYLOGGER_INIT_SUCCESS;
+        char line[MYLOGGER_FILE_NAME_MAX_SIZE + 64];
+        size_t len = 0;
+        if(module != NULL)
+        {
+            const size_t name_len = strnlen(module->name, MYLOGGER_FILE_NAME_MAX_SIZE);
+            memcpy(line, module->name, name_len);
+            len = name_len;
+            line[len++] = '(';
+            line[len++] = '+';
+            len += __mylogger_put_hex(&line[len], addr - module->base);
+            line[len++] = ')';
+            line[len++] = ' ';
+        }
+        line[len++] = '[';
+        len += __mylogger_put_hex(&line[len], addr);
+        line[len++] = ']';
+        line[len++] = '\n';
+
+        if(buf_size - idx <= len)
+            break;
+        memcpy(&buffer[idx], line, len);
+        idx += len;
     }
-    fprintf(stderr,"MyLogger is already initialized!\n");
-    return MYLOGGER_INIT_ALREADY_RUNNING_ERROR;
+    buffer[idx] = '\0';
+    return idx;
 }
 
-void mylogger_destroy(void)
+/**
+ * Installs crash signal handlers (MYLOGGER_FEATURE_CRASH_HANDLER) on an alternate stack. Stack overflow is SIGSEGV
+ * too, so the calling thread gets a static alternate stack and threads registered from now on their own one.
+ * Handlers are shared by all instances, they are installed for the first one. Called under lifecycle mutex.
+ * */
+static void __mylogger_crash_install(void)
 {
-    if(atomic_flag_test_and_set(&g_logger_is_initilized) == 1)
+    if(g_mylogger_crash_users++ > 0)
+        return;
+
+    // first backtrace() loads libgcc, it must not happen inside the handler
+    backtrace(g_mylogger_crash_frames, 1);
+    __mylogger_trace_modules_load();
+
+    // alternate stack set up by the application is kept
+    stack_t current;
+    if(sigaltstack(NULL, &current) == 0 && (current.ss_flags & SS_DISABLE))
     {
-        // destroy the mutex
-        pthread_mutex_destroy(&g_mylogger_instance->mutex);
-        // close file
-        if(!g_mylogger_instance->features.feat_no_file)
-            fclose(g_mylogger_instance->file_fd);
-        free(g_mylogger_instance);
-        atomic_flag_clear(&g_logger_is_initilized);
+        const stack_t stack = {.ss_sp = g_mylogger_crash_stack, .ss_size = sizeof(g_mylogger_crash_stack)};
+        sigaltstack(&stack, NULL);
     }
-    else
+    atomic_store_explicit(&g_mylogger_crash_installed, true, memory_order_relaxed);
+
+    struct sigaction action = {.sa_handler = __mylogger_crash_handler, .sa_flags = (int)(SA_ONSTACK | SA_RESETHAND)};
+    sigemptyset(&action.sa_mask);
+    for(size_t i = 0; i < MYLOGGER_CRASH_SIGNALS_COUNT; i++)
+        sigaction(g_mylogger_crash_signals[i], &action, &g_mylogger_crash_previous[i]);
+}
+
+/**
+ * Restores signal handlers replaced by __mylogger_crash_install when last instance using them is gone.
+ * Called under lifecycle mutex.
+ * */
+static void __mylogger_crash_uninstall(void)
+{
+    if(--g_mylogger_crash_users > 0)
+        return;
+    atomic_store_explicit(&g_mylogger_crash_installed, false, memory_order_relaxed);
+    for(size_t i = 0; i < MYLOGGER_CRASH_SIGNALS_COUNT; i++)
+        sigaction(g_mylogger_crash_signals[i], &g_mylogger_crash_previous[i], NULL);
+}
+
+/**
+ * Gives the calling thread its own alternate signal stack, unless it already has one. The stack is freed
+ * by __mylogger_thread_unregister.
+ *
+ * @param[in,out] thread - state of the calling thread
+ * */
+static void __mylogger_crash_stack(MyLogger_thread_S* thread)
+{
+    stack_t current;
+    if(sigaltstack(NULL, &current) != 0 || !(current.ss_flags & SS_DISABLE))
+        return;
+    thread->crash_stack = malloc(MYLOGGER_CRASH_STACK_SIZE);
+    if(thread->crash_stack == NULL)
+        return;
+    const stack_t stack = {.ss_sp = thread->crash_stack, .ss_size = MYLOGGER_CRASH_STACK_SIZE};
+    if(sigaltstack(&stack, NULL) != 0)
     {
-        atomic_flag_clear(&g_logger_is_initilized);
-        fprintf(stderr,"Cannot destroy MyLogger because its not initialized!\n");
+        free(thread->crash_stack);
+        thread->crash_stack = NULL;
     }
 }
 
-void __attribute__(( format(printf, 5, 6) )) __mylogger_print(const char* file,
-                                                              const char* func,
-                                                              size_t line,
-                                                              mylogger_level_t level,
-                                                              const char* format,
-                                                              ...)
+/**
+ * Writes crash report to the log file, stdout and stderr. Async-signal-safe.
+ *
+ * @param[in] instance - logger instance
+ * @param[in] buffer - report
+ * @param[in] len - report length
+ * */
+static void __mylogger_crash_write(MyLogger_instance_S* instance, const char* buffer, size_t len)
 {
-    if(atomic_flag_test_and_set(&g_logger_is_initilized) == 0)
+    const MyLogger_binary_header_S header = {.len = (uint32_t)len, .kind = MYLOGGER_BINARY_TEXT, .level = MYLOGGER_LEVEL_FATAL};
+    struct iovec iov[2] = {
+        {.iov_base = (void*)&header, .iov_len = instance->features.feat_binary ? sizeof(header) : 0},
+        {.iov_base = (void*)buffer, .iov_len = len}
+    };
+
+    // mapping may be held by the crashed thread, write through the file into reserved space
+    if(instance->mmap.fd >= 0)
     {
-        fprintf(stderr, "You need to initialize MyLogger before using it!\n");
-        atomic_flag_clear(&g_logger_is_initilized);
-        return;
+        const size_t total = iov[0].iov_len + iov[1].iov_len;
+        const size_t offset = atomic_fetch_add_explicit(&instance->mmap.shared->offset, total, memory_order_relaxed);
+        pwritev(instance->mmap.fd, iov, 2, (off_t)(instance->mmap.base + offset));
     }
-    pthread_mutex_lock(&g_mylogger_instance->mutex);
-
-    static char buffer[1 << 20] = {0};
-    size_t buffer_idx = 0;
+    for(size_t i = 0; i < instance->sinks_count; i++)
+    {
+        MyLogger_sink_S* sink = &instance->sinks[i];
+        if(sink->fd < 0)
+            continue;
+        struct iovec sink_iov[2] = {iov[0], iov[1]};
+        // ring is used by the writer thread, write into reserved space instead
+        if(sink->uring != NULL)
+            __mylogger_uring_pwritev(sink->uring, sink_iov, 2);
+        else
+            __mylogger_sink_writev(sink, sink_iov, 2, NULL);
+    }
+}
 
-    // ADD LOG LEVEL
-    const char* level_print = g_mylogger_instance->features.feat_ansi_logs ? mylogger_level_print_ansi[level] : mylogger_level_print[level];
-    buffer_idx = (size_t)snprintf(&buffer[0],
-                                  sizeof(buffer) - buffer_idx,
+/**
+ * Handler of crash signals. Writes out buffered messages and the stack trace, then lets the signal
+ * kill the process. Only async-signal-safe functions are used, buffers are written as they are.
+ *
+ * @param[in] sig - signal number
+ * */
+static void __mylogger_crash_handler(int sig)
+{
+    const int saved_errno = errno;
+    if(!atomic_exchange(&g_mylogger_crash_entered, true))
+    {
+        // writer threads own the rings, give them a moment to write everything out
+        const long tid = syscall(SYS_gettid);
+        // ordered after the flag, __mylogger_free keeps instances the handler can still see
+        MyLogger_instance_S* first = atomic_load(&g_mylogger_instances);
+        for(MyLogger_instance_S* instance = first; instance != NULL; instance = instance->next)
+        {
+            if(instance->features.feat_crash_handler && instance->features.feat_async &&
+               atomic_load_explicit(&instance->writer_tid, memory_order_relaxed) != tid)
+                atomic_store_explicit(&instance->crash_flush, true, memory_order_release);
+        }
+        for(MyLogger_instance_S* instance = first; instance != NULL; instance = instance->next)
+        {
+            for(int waited = 0; waited < MYLOGGER_CRASH_FLUSH_TIMEOUT_MS &&
+                                atomic_load_explicit(&instance->crash_flush, memory_order_relaxed) &&
+                                !atomic_load_explicit(&instance->crash_flushed, memory_order_acquire); waited++)
+                nanosleep(&(struct timespec){.tv_sec = 0, .tv_nsec = 1000000}, NULL);
+        }
+
+        const char* name = "signal";
+        for(size_t i = 0; i < MYLOGGER_CRASH_SIGNALS_COUNT; i++)
+        {
+            if(g_mylogger_crash_signals[i] == sig)
+                name = g_mylogger_crash_names[i];
+        }
+        static const char prefix[] = "[FATAL] MyLogger: caught ";
+        char* buffer = g_mylogger_crash_buffer;
+        size_t len = sizeof(prefix) - 1;
+        memcpy(buffer, prefix, len);
+        memcpy(&buffer[len], name, strlen(name));
+        len += strlen(name);
+        buffer[len++] = '\n';
+
+        const int frames = backtrace(g_mylogger_crash_frames, (int)(sizeof(g_mylogger_crash_frames) / sizeof(g_mylogger_crash_frames[0])));
+        len += __mylogger_trace_addresses(&buffer[len], sizeof(g_mylogger_crash_buffer) - len, g_mylogger_crash_frames, frames);
+
+        for(MyLogger_instance_S* instance = first; instance != NULL; instance = instance->next)
+        {
+            if(!instance->features.feat_crash_handler)
+                continue;
+            // batches written by the writer thread are not touched. Otherwise there is no writer thread, it crashed
+            // or it is stuck, and batches are written as they are. Thread that holds the instance mutex can still
+            // be writing the same batch, a few messages may be written twice or torn, which beats losing them.
+            if(!atomic_load_explicit(&instance->crash_flushed, memory_order_acquire))
+            {
+                for(size_t i = 0; i < instance->sinks_count; i++)
+                {
+                    MyLogger_sink_S* sink = &instance->sinks[i];
+                    if(sink->fd >= 0 && sink->uring != NULL)
+                        __mylogger_uring_pwritev(sink->uring, &(struct iovec){.iov_base = sink->batch, .iov_len = sink->batch_len}, 1);
+                    else if(sink->fd >= 0)
+                        __mylogger_sink_flush(sink, NULL);
+                }
+            }
+            __mylogger_crash_write(instance, buffer, len);
+        }
+    }
+
+    // handler was reset to default by SA_RESETHAND, signal is delivered again when handler returns
+    errno = saved_errno;
+    raise(sig);
+}
+
+/**
+ * Copies already rendered part of the message to the message buffer, truncates it if it does not fit.
+ *
+ * @param[in] log_buffer message buffer
+ * @param[in] buf_size current buffer size
+ * @param[in] src rendered part
+ * @param[in] len length of the rendered part
+ * @return The number of characters that would have been written on the buffer.
+ * */
+static size_t __mylogger_put(char* log_buffer, const size_t buf_size, const char* src, const size_t len)
+{
+    if(buf_size > 0)
+    {
+        const size_t copied = len < buf_size - 1 ? len : buf_size - 1;
+        memcpy(log_buffer, src, copied);
+        log_buffer[copied] = '\0';
+    }
+    return len;
+}
+
+/**
+ * Adds Thread ID tag rendered by the logging thread to the message buffer.
+ *
+ * @param[in] log_buffer message buffer
+ * @param[in] buf_size current buffer size
+ * @param[in] call log call description
+ * @return The number of characters that would have been written on the buffer.
+ * */
+static size_t __mylogger_add_tid(char* log_buffer, const size_t buf_size, const MyLogger_call_S* call)
+{
+    return __mylogger_put(log_buffer, buf_size, call->tid_tag, call->tid_tag_len);
+}
+
+/**
+ * Renders TID tag of the calling thread. System call for TID is made only here.
+ *
+ * @param[in,out] thread - state of the calling thread
+ * */
+static void __mylogger_thread_tag_render(MyLogger_thread_S* thread)
+{
+    const long tid = (long) syscall(__NR_gettid);
+    const int len = thread->name[0] != '\0' ?
+                    snprintf(thread->tid_tag, sizeof(thread->tid_tag), "[TID: %ld %s]", tid, thread->name) :
+                    snprintf(thread->tid_tag, sizeof(thread->tid_tag), "[TID: %ld]", tid);
+    thread->tid_tag_len = len > 0 ? (size_t)len : 0;
+}
+
+/**
+ * Fork handler called before fork(). Takes every lock of the logger, so that the child gets consistent
+ * instances, and writes out batched messages, so that the child does not write them again.
+ * Lock order is the same as everywhere else: lifecycle, sites, instance locks, threads.
+ * */
+static void __mylogger_atfork_prepare(void)
+{
+    pthread_mutex_lock(&g_mylogger_lifecycle_mutex);
+    pthread_mutex_lock(&g_mylogger_sites_mutex);
+    MyLogger_instance_S* first = atomic_load_explicit(&g_mylogger_instances, memory_order_acquire);
+    for(MyLogger_instance_S* instance = first; instance != NULL; instance = instance->next)
+        __mylogger_fork_lock(instance);
+    pthread_mutex_lock(&g_mylogger_threads_mutex);
+}
+
+/**
+ * Fork handler called in the parent after fork(). Releases locks taken by __mylogger_atfork_prepare.
+ * */
+static void __mylogger_atfork_parent(void)
+{
+    pthread_mutex_unlock(&g_mylogger_threads_mutex);
+    MyLogger_instance_S* first = atomic_load_explicit(&g_mylogger_instances, memory_order_acquire);
+    for(MyLogger_instance_S* instance = first; instance != NULL; instance = instance->next)
+        __mylogger_fork_unlock(instance);
+    pthread_mutex_unlock(&g_mylogger_sites_mutex);
+    pthread_mutex_unlock(&g_mylogger_lifecycle_mutex);
+}
+
+/**
+ * Fork handler called in the child after fork(). Only the calling thread exists in the child, its TID is new
+ * and cached tag has to be rendered again. Releases the locks and drops state that belongs to the parent.
+ * */
+static void __mylogger_atfork_child(void)
+{
+    MyLogger_thread_S* self = &g_mylogger_thread;
+    self->tid_tag_len = 0;
+    // parent commits the open batch, child keeps adding to an empty one
+    self->batch_len = 0;
+
+    // other threads are gone, __mylogger_wait_for_readers must not wait for them
+    g_mylogger_threads = self->registered ? self : NULL;
+    self->prev = NULL;
+    self->next = NULL;
+    pthread_mutex_unlock(&g_mylogger_threads_mutex);
+
+    MyLogger_instance_S* first = atomic_load_explicit(&g_mylogger_instances, memory_order_acquire);
+    for(MyLogger_instance_S* instance = first; instance != NULL; instance = instance->next)
+    {
+        __mylogger_fork_unlock(instance);
+        __mylogger_fork_reset(instance);
+    }
+
+    // repetitions are counted by the parent, child starts clean
+    for(mylogger_site_t* site = g_mylogger_sites; site != NULL; site = site->next)
+    {
+        atomic_store_explicit(&site->last_hash, 0, memory_order_relaxed);
+        atomic_store_explicit(&site->repeats, 0, memory_order_relaxed);
+        atomic_store_explicit(&site->repeats_logger, NULL, memory_order_relaxed);
+    }
+    pthread_mutex_unlock(&g_mylogger_sites_mutex);
+    pthread_mutex_unlock(&g_mylogger_lifecycle_mutex);
+}
+
+/**
+ * Takes every lock of the instance before fork() and writes out batched messages. Offsets of io_uring and of
+ * the memory mapped file live in shared memory and stay valid in the child, mapping mutex is shared as well.
+ *
+ * @param[in,out] instance - logger instance
+ * */
+static void __mylogger_fork_lock(MyLogger_instance_S* instance)
+{
+    // recorders are locked before the instance mutex when they are dumped
+    if(instance->recorder_size > 0)
+    {
+        pthread_mutex_lock(&instance->recorder_mutex);
+        for(MyLogger_recorder_S* recorder = instance->recorders; recorder != NULL; recorder = recorder->next)
+            pthread_mutex_lock(&recorder->mutex);
+    }
+    pthread_mutex_lock(&instance->mutex);
+    for(size_t i = 0; i < instance->sinks_count; i++)
+    {
+        MyLogger_sink_S* sink = &instance->sinks[i];
+        __mylogger_sink_flush(sink, NULL);
+    }
+    if(instance->features.feat_async)
+        pthread_mutex_lock(&instance->rings_mutex);
+    if(instance->features.feat_stats)
+        pthread_mutex_lock(&instance->stats_mutex);
+    if(instance->rotation.enabled)
+        pthread_mutex_lock(&instance->rotation.mutex);
+    if(instance->flusher.enabled)
+        pthread_mutex_lock(&instance->flusher.mutex);
+}
+
+/**
+ * Releases locks taken by __mylogger_fork_lock, in the parent and in the child.
+ *
+ * @param[in,out] instance - logger instance
+ * */
+static void __mylogger_fork_unlock(MyLogger_instance_S* instance)
+{
+    if(instance->flusher.enabled)
+        pthread_mutex_unlock(&instance->flusher.mutex);
+    if(instance->rotation.enabled)
+        pthread_mutex_unlock(&instance->rotation.mutex);
+    if(instance->features.feat_stats)
+        pthread_mutex_unlock(&instance->stats_mutex);
+    if(instance->features.feat_async)
+        pthread_mutex_unlock(&instance->rings_mutex);
+    pthread_mutex_unlock(&instance->mutex);
+    if(instance->recorder_size > 0)
+    {
+        for(MyLogger_recorder_S* recorder = instance->recorders; recorder != NULL; recorder = recorder->next)
+            pthread_mutex_unlock(&recorder->mutex);
+        pthread_mutex_unlock(&instance->recorder_mutex);
+    }
+}
+
+/**
+ * Drops state of the parent in the child. Writer, rotation and flusher threads stayed in the parent, instance
+ * writes synchronously to the current log file. Messages waiting in rings, counters and recorded messages
+ * of other threads belong to the parent.
+ *
+ * @param[in,out] instance - logger instance
+ * */
+static void __mylogger_fork_reset(MyLogger_instance_S* instance)
+{
+    if(instance->features.feat_async)
+    {
+        pthread_key_delete(instance->ring_key);
+        MyLogger_ring_S* ring = atomic_load_explicit(&instance->rings, memory_order_relaxed);
+        while(ring != NULL)
+        {
+            MyLogger_ring_S* next = ring->next;
+            free(ring);
+            ring = next;
+        }
+        atomic_store_explicit(&instance->rings, NULL, memory_order_relaxed);
+        pthread_mutex_destroy(&instance->rings_mutex);
+        free(instance->writer_buffer);
+        free(instance->writer_record);
+        instance->writer_buffer = NULL;
+        instance->writer_record = NULL;
+        atomic_store_explicit(&instance->writer_tid, 0, memory_order_relaxed);
+        instance->features.feat_async = false;
+        instance->features.feat_deferred = false;
+        if(instance->sinks_count > 0)
+            instance->sinks[0].sync = false;
+    }
+
+    // parent rotates the file, its descriptors are only closed here
+    MyLogger_rotation_S* rotation = &instance->rotation;
+    if(rotation->enabled)
+    {
+        rotation->forked = true;
+        instance->sinks[0].rotate = false;
+        if(rotation->next_fd >= 0)
+            close(rotation->next_fd);
+        rotation->next_fd = -1;
+        for(size_t i = 0; i < rotation->rotated_count; i++)
+        {
+            if(rotation->rotated[i].file != NULL)
+                fclose(rotation->rotated[i].file);
+            else
+                close(rotation->rotated[i].fd);
+        }
+        rotation->rotated_count = 0;
+    }
+
+    // flusher thread stayed in the parent, expired batches of the child are written by its next log call
+    instance->flusher.forked = true;
+
+    // ring belongs to the parent, the child writes batches into space reserved with the shared offset
+    for(size_t i = 0; i < instance->sinks_count; i++)
+    {
+        if(instance->sinks[i].uring != NULL)
+            __mylogger_uring_detach(instance->sinks[i].uring);
+    }
+
+    // mapped file and its offset are shared with the parent, which truncates the file
+    instance->mmap.forked = true;
+
+    if(instance->features.feat_stats)
+    {
+        MyLogger_stats_S* own = pthread_getspecific(instance->stats_key);
+        MyLogger_stats_S* stats = instance->stats;
+        while(stats != NULL)
+        {
+            MyLogger_stats_S* next = stats->next;
+            if(stats != own)
+                free(stats);
+            stats = next;
+        }
+        if(own != NULL)
+            memset(own, 0, sizeof(*own));
+        instance->stats = own;
+        memset(&instance->stats_retired, 0, sizeof(instance->stats_retired));
+    }
+
+    if(instance->recorder_size > 0)
+    {
+        MyLogger_recorder_S* own = pthread_getspecific(instance->recorder_key);
+        for(MyLogger_recorder_S* recorder = instance->recorders; recorder != NULL; recorder = recorder->next)
+        {
+            recorder->head = 0;
+            recorder->tail = 0;
+            if(recorder != own)
+                atomic_store_explicit(&recorder->exited, true, memory_order_relaxed);
+        }
+    }
+}
+
+void mylogger_set_thread_name(const char* name)
+{
+    MyLogger_thread_S* self = &g_mylogger_thread;
+    if(name == NULL)
+        self->name[0] = '\0';
+    else
+    {
+        strncpy(self->name, name, sizeof(self->name) - 1);
+        self->name[sizeof(self->name) - 1] = '\0';
+    }
+    self->tid_tag_len = 0;
+}
+
+mylogger_init_error_code_t mylogger_init(FILE* log_file, mylogger_feature_t features)
+{
+    return mylogger_init_config(&(mylogger_config_t){
+        .log_file = log_file,
+        .features = features,
+        .level = MYLOGGER_LEVEL_DEBUG
+    });
+}
+
+mylogger_init_error_code_t mylogger_init_config(const mylogger_config_t* config)
+{
+    pthread_mutex_lock(&g_mylogger_lifecycle_mutex);
+
+    // check if logger is not already initialized
+    if(atomic_load_explicit(&g_mylogger_instance, memory_order_relaxed) != NULL)
+    {
+        pthread_mutex_unlock(&g_mylogger_lifecycle_mutex);
+        fprintf(stderr,"MyLogger is already initialized!\n");
+        return MYLOGGER_INIT_ALREADY_RUNNING_ERROR;
+    }
+
+    mylogger_init_error_code_t err;
+    MyLogger_instance_S* instance = __mylogger_create(config, &err);
+    if(instance != NULL)
+    {
+        __mylogger_level_set(instance, &__mylogger_level_threshold, config->level);
+        // publish fully initialized instance
+        atomic_store_explicit(&g_mylogger_instance, instance, memory_order_release);
+    }
+    pthread_mutex_unlock(&g_mylogger_lifecycle_mutex);
+
+    return err;
+}
+
+void mylogger_destroy(void)
+{
+    pthread_mutex_lock(&g_mylogger_lifecycle_mutex);
+
+    MyLogger_instance_S* instance = atomic_load_explicit(&g_mylogger_instance, memory_order_relaxed);
+    if(instance == NULL)
+    {
+        pthread_mutex_unlock(&g_mylogger_lifecycle_mutex);
+        fprintf(stderr,"Cannot destroy MyLogger because its not initialized!\n");
+        return;
+    }
+
+    __mylogger_batch_close(instance);
+    __mylogger_retire(instance);
+    // new log calls will not see the instance, wait for those that already use it
+    atomic_store_explicit(&g_mylogger_instance, NULL, memory_order_relaxed);
+    __mylogger_wait_for_readers();
+    __mylogger_free(instance);
+    __mylogger_sites_release();
+
+    // uninitialized logger has to report every use
+    mylogger_set_level(MYLOGGER_LEVEL_DEBUG);
+    // buffers of other threads are freed when they exit, this one may never exit (main thread)
+    free(g_mylogger_thread.buffer);
+    g_mylogger_thread.buffer = NULL;
+    g_mylogger_thread.buffer_size = 0;
+    if(g_mylogger_thread.batch_logger == NULL)
+    {
+        free(g_mylogger_thread.batch);
+        g_mylogger_thread.batch = NULL;
+        g_mylogger_thread.batch_size = 0;
+        g_mylogger_thread.batch_len = 0;
+        g_mylogger_thread.batch_logger = NULL;
+    }
+
+    pthread_mutex_unlock(&g_mylogger_lifecycle_mutex);
+}
+
+mylogger_t* mylogger_create(const mylogger_config_t* config, mylogger_init_error_code_t* error)
+{
+    mylogger_init_error_code_t err;
+    pthread_mutex_lock(&g_mylogger_lifecycle_mutex);
+    MyLogger_instance_S* instance = __mylogger_create(config, &err);
+    pthread_mutex_unlock(&g_mylogger_lifecycle_mutex);
+
+    if(error != NULL)
+        *error = err;
+    return instance;
+}
+
+void mylogger_close(mylogger_t* logger)
+{
+    if(logger == NULL)
+        return;
+
+    pthread_mutex_lock(&g_mylogger_lifecycle_mutex);
+    if(logger == atomic_load_explicit(&g_mylogger_instance, memory_order_relaxed))
+    {
+        pthread_mutex_unlock(&g_mylogger_lifecycle_mutex);
+        fprintf(stderr,"Default MyLogger instance is destroyed with mylogger_destroy!\n");
+        return;
+    }
+
+    __mylogger_batch_close(logger);
+    __mylogger_retire(logger);
+    __mylogger_wait_for_readers();
+    __mylogger_free(logger);
+    __mylogger_sites_release();
+    pthread_mutex_unlock(&g_mylogger_lifecycle_mutex);
+}
+
+/**
+ * Sets output threshold of the instance. Threshold checked by the macros (gate) lets recorded levels in too.
+ *
+ * @param[in,out] instance - logger instance
+ * @param[out] gate - head.level of the instance or threshold of the default instance
+ * @param[in] level - output threshold
+ * */
+static void __mylogger_level_set(MyLogger_instance_S* instance, atomic_int* gate, mylogger_level_t level)
+{
+    atomic_store_explicit(&instance->level, (int)level, memory_order_relaxed);
+    if(instance->recorder_size > 0 && instance->recorder_level < level)
+        level = instance->recorder_level;
+    atomic_store_explicit(gate, (int)level, memory_order_relaxed);
+}
+
+void mylogger_logger_set_level(mylogger_t* logger, mylogger_level_t level)
+{
+    if(logger == NULL)
+        return;
+    __mylogger_level_set(logger, &logger->head.level, level);
+}
+
+mylogger_level_t mylogger_logger_get_level(mylogger_t* logger)
+{
+    if(logger == NULL)
+        return MYLOGGER_LEVEL_DEBUG;
+    return (mylogger_level_t)atomic_load_explicit(&logger->level, memory_order_relaxed);
+}
+
+uint64_t mylogger_logger_get_dropped(mylogger_t* logger, mylogger_level_t level)
+{
+    if(logger == NULL || (size_t)level >= MYLOGGER_LEVELS_COUNT)
+        return 0;
+    return atomic_load_explicit(&logger->dropped[level], memory_order_relaxed);
+}
+
+bool mylogger_logger_get_stats(mylogger_t* logger, mylogger_stats_t* stats)
+{
+    if(logger == NULL || !logger->features.feat_stats)
+        return false;
+    __mylogger_stats_collect(logger, stats);
+    return true;
+}
+
+bool mylogger_logger_dump_recorder(mylogger_t* logger)
+{
+    if(logger == NULL || logger->recorder_size == 0)
+        return false;
+    __mylogger_recorders_dump(logger, false);
+    return true;
+}
+
+bool mylogger_logger_batch_begin(mylogger_t* logger)
+{
+    return logger != NULL && __mylogger_batch_begin(logger);
+}
+
+/**
+ * Creates and starts logger instance and adds it to the list of live instances.
+ * Called under lifecycle mutex.
+ *
+ * @param[in] config - logger configuration
+ * @param[out] error - MYLOGGER_INIT_SUCCESS or reason of the failure
+ * @return logger instance or NULL on failure.
+ * */
+static MyLogger_instance_S* __mylogger_create(const mylogger_config_t* config, mylogger_init_error_code_t* error)
+{
+    MyLogger_instance_S* instance = malloc(sizeof(MyLogger_instance_S));
+    if(instance == NULL)
+    {
+        fprintf(stderr,"MyLogger malloc error!\n");
+        *error = MYLOGGER_INIT_OTHER_ERROR;
+        return NULL;
+    }
+
+    (*instance) = (MyLogger_instance_S) {
+      .file_fd = config->log_file,
+      .mutex = PTHREAD_MUTEX_INITIALIZER,
+      .features = __mylogger_parse_features(config->features),
+      .trace = config->trace,
+      .encoder = config->encoder,
+      .timestamp = {
+        .clock = config->clock,
+        .format = config->timestamp_format,
+        .precision = config->timestamp_precision
+      }
+    };
+    if(instance->features.feat_timestamps)
+        __mylogger_clock_init(&instance->timestamp);
+
+    // binary records are decoded to text layout
+    if(instance->features.feat_binary)
+        instance->encoder = MYLOGGER_ENCODER_TEXT;
+
+    instance->overload = config->overload;
+    if((instance->overload.keep_level == 0 && !instance->overload.keep_level_set) ||
+       instance->overload.keep_level > MYLOGGER_LEVEL_FATAL)
+        instance->overload.keep_level = MYLOGGER_LEVEL_ERROR;
+    if(instance->overload.sample_rate == 0)
+        instance->overload.sample_rate = MYLOGGER_OVERLOAD_SAMPLE_RATE;
+    if(instance->overload.report_interval_ms == 0)
+        instance->overload.report_interval_ms = MYLOGGER_OVERLOAD_REPORT_MS;
+
+    // if no logging file specified create new file
+    bool file_created = false;
+    if(instance->file_fd == NULL && !instance->features.feat_no_file)
+    {
+        __mylogger_create_file_name(instance->file_name);
+        // instance created in the same second appends to the same file, that file is not removed on failure
+        file_created = access(instance->file_name, F_OK) != 0;
+        instance->file_fd = fopen(instance->file_name, "a+");
+
+        if(instance->file_fd == NULL)
+        {
+            fprintf(stderr,"MyLogger file creation error!\n");
+
+            pthread_mutex_destroy(&instance->mutex);
+            free(instance);
+
+            *error = MYLOGGER_INIT_FILE_CREATION_ERROR;
+            return NULL;
+        }
+    }
+    else if(instance->file_fd == NULL && \
+            !instance->features.feat_stdout && \
+            !instance->features.feat_stderr && \
+            config->sinks_count == 0)
+    {
+        fprintf(stderr,"MyLogger no file descriptors specified!\n");
+
+        pthread_mutex_destroy(&instance->mutex);
+        free(instance);
+
+        *error = MYLOGGER_INIT_OTHER_ERROR;
+        return NULL;
+    }
+
+    *error = __mylogger_sinks_open(instance, config);
+    if(*error != MYLOGGER_INIT_SUCCESS)
+    {
+        fprintf(stderr,"MyLogger sinks creation error!\n");
+        __mylogger_create_unwind(instance, config, MYLOGGER_CREATE_SINKS, file_created);
+        return NULL;
+    }
+
+    // recorded messages are dumped as text, binary log file has no place for them
+    if(config->recorder.size > 0 && !instance->features.feat_binary)
+    {
+        *error = __mylogger_recorder_start(instance, &config->recorder);
+        if(*error != MYLOGGER_INIT_SUCCESS)
+        {
+            fprintf(stderr,"MyLogger flight recorder creation error!\n");
+            __mylogger_create_unwind(instance, config, MYLOGGER_CREATE_RECORDER, file_created);
+            return NULL;
+        }
+    }
+
+    // writer thread counts its writes too
+    if(instance->features.feat_stats)
+    {
+        *error = __mylogger_stats_start(instance, config->stats_interval_ms);
+        if(*error != MYLOGGER_INIT_SUCCESS)
+        {
+            fprintf(stderr,"MyLogger stats creation error!\n");
+            __mylogger_create_unwind(instance, config, MYLOGGER_CREATE_STATS, file_created);
+            return NULL;
+        }
+    }
+
+    // writer thread of ASYNC writes expired batches and pending repeats itself
+    *error = instance->features.feat_async ? __mylogger_async_start(instance) : __mylogger_flusher_start(instance);
+    if(*error != MYLOGGER_INIT_SUCCESS)
+    {
+        fprintf(stderr,"MyLogger %s thread creation error!\n", instance->features.feat_async ? "writer" : "flusher");
+        __mylogger_create_unwind(instance, config, MYLOGGER_CREATE_THREAD, file_created);
+        return NULL;
+    }
+
+    if(instance->trace == MYLOGGER_TRACE_ADDRESSES && !instance->features.feat_crash_handler)
+        __mylogger_trace_modules_load();
+    if(instance->features.feat_crash_handler)
+        __mylogger_crash_install();
+
+    pthread_once(&g_mylogger_membarrier_once, __mylogger_membarrier_register);
+    // fork handlers are needed before the first fork, not only after the first log call
+    pthread_once(&g_mylogger_thread_key_once, __mylogger_threads_init);
+    __mylogger_level_set(instance, &instance->head.level, config->level);
+    instance->next = atomic_load_explicit(&g_mylogger_instances, memory_order_relaxed);
+    if(instance->next == NULL)
+        __mylogger_sites_prepare();
+    atomic_store_explicit(&g_mylogger_instances, instance, memory_order_release);
+
+    *error = MYLOGGER_INIT_SUCCESS;
+    return instance;
+}
+
+/**
+ * Undoes every step of __mylogger_create done before the failed one and frees the instance.
+ * Called under lifecycle mutex.
+ *
+ * @param[in] instance - logger instance
+ * @param[in] config - logger configuration
+ * @param[in] failed - step that failed, it cleaned up after itself
+ * @param[in] file_created - log file was created by this instance
+ * */
+static void __mylogger_create_unwind(MyLogger_instance_S* instance,
+                                     const mylogger_config_t* config,
+                                     MyLogger_create_step_E failed,
+                                     bool file_created)
+{
+    if(failed > MYLOGGER_CREATE_STATS && instance->features.feat_stats)
+        __mylogger_stats_stop(instance);
+    if(failed > MYLOGGER_CREATE_RECORDER && instance->recorder_size > 0)
+        __mylogger_recorder_stop(instance);
+    if(failed > MYLOGGER_CREATE_SINKS)
+        __mylogger_sinks_close(instance);
+    pthread_mutex_destroy(&instance->mutex);
+
+    // caller keeps ownership of the given file when initialization fails
+    if(config->log_file == NULL && !instance->features.feat_no_file)
+    {
+        fclose(instance->file_fd);
+        if(file_created)
+            unlink(instance->file_name);
+    }
+    free(instance);
+}
+
+/**
+ * Writes pending repeat counts and removes the instance from the list of live instances.
+ * Called under lifecycle mutex before the instance is freed.
+ *
+ * @param[in] instance - logger instance
+ * */
+static void __mylogger_retire(MyLogger_instance_S* instance)
+{
+    __mylogger_sites_flush_repeats(instance, true);
+
+    MyLogger_instance_S* prev = atomic_load_explicit(&g_mylogger_instances, memory_order_relaxed);
+    if(prev == instance)
+        atomic_store_explicit(&g_mylogger_instances, instance->next, memory_order_release);
+    else
+    {
+        while(prev->next != instance)
+            prev = prev->next;
+        prev->next = instance->next;
+    }
+    if(instance->features.feat_crash_handler)
+        __mylogger_crash_uninstall();
+}
+
+/**
+ * Writes everything that is still buffered and frees the instance. No thread can use the instance anymore.
+ *
+ * @param[in] instance - logger instance
+ * */
+static void __mylogger_free(MyLogger_instance_S* instance)
+{
+    // crash handler walks the instances without locks and could have loaded this one before
+    // it was retired, crashing process keeps it
+    atomic_thread_fence(memory_order_seq_cst);
+    if(atomic_load(&g_mylogger_crash_entered))
+        return;
+
+    if(instance->features.feat_async)
+        __mylogger_async_stop(instance);
+    __mylogger_flusher_stop(instance);
+    __mylogger_sinks_close(instance);
+    if(instance->features.feat_stats)
+        __mylogger_stats_stop(instance);
+    if(instance->recorder_size > 0)
+        __mylogger_recorder_stop(instance);
+    // destroy the mutex
+    pthread_mutex_destroy(&instance->mutex);
+    // close file, with rotation it could be already closed
+    if(!instance->features.feat_no_file && instance->file_fd != NULL)
+        fclose(instance->file_fd);
+    free(instance);
+}
+
+/**
+ * Creates key used to unregister exiting threads and registers fork handlers. Called once.
+ * */
+static void __mylogger_threads_init(void)
+{
+    pthread_key_create(&g_mylogger_thread_key, __mylogger_thread_unregister);
+    pthread_atfork(__mylogger_atfork_prepare, __mylogger_atfork_parent, __mylogger_atfork_child);
+}
+
+/**
+ * Adds calling thread to the list of threads checked by __mylogger_wait_for_readers.
+ *
+ * @param[in] thread - state of the calling thread
+ * */
+static void __mylogger_thread_register(MyLogger_thread_S* thread)
+{
+    pthread_once(&g_mylogger_thread_key_once, __mylogger_threads_init);
+
+    pthread_mutex_lock(&g_mylogger_threads_mutex);
+    thread->prev = NULL;
+    thread->next = g_mylogger_threads;
+    if(g_mylogger_threads != NULL)
+        g_mylogger_threads->prev = thread;
+    g_mylogger_threads = thread;
+    thread->registered = true;
+    pthread_mutex_unlock(&g_mylogger_threads_mutex);
+
+    pthread_setspecific(g_mylogger_thread_key, thread);
+    // crash handler runs on the alternate stack, also when this thread overflows its stack
+    if(atomic_load_explicit(&g_mylogger_crash_installed, memory_order_relaxed))
+        __mylogger_crash_stack(thread);
+}
+
+/**
+ * Thread exit handler. Writes uncommitted batch of exiting thread and removes it from the list of threads.
+ *
+ * @param[in] thread - state of the exiting thread
+ * */
+static void __mylogger_thread_unregister(void* thread)
+{
+    MyLogger_thread_S* self = thread;
+
+    // uncommitted batch is written when its instance was not closed yet
+    if(self->batch_logger != NULL)
+    {
+        pthread_mutex_lock(&g_mylogger_lifecycle_mutex);
+        MyLogger_instance_S* instance = atomic_load_explicit(&g_mylogger_instances, memory_order_relaxed);
+        while(instance != NULL && instance != self->batch_logger)
+            instance = instance->next;
+        if(instance != NULL)
+            __mylogger_batch_write(instance, self, NULL, 0, MYLOGGER_LEVEL_DEBUG);
+        pthread_mutex_unlock(&g_mylogger_lifecycle_mutex);
+    }
+
+    pthread_mutex_lock(&g_mylogger_threads_mutex);
+    if(self->prev != NULL)
+        self->prev->next = self->next;
+    else
+        g_mylogger_threads = self->next;
+    if(self->next != NULL)
+        self->next->prev = self->prev;
+    self->registered = false;
+    pthread_mutex_unlock(&g_mylogger_threads_mutex);
+
+    if(self->crash_stack != NULL)
+    {
+        sigaltstack(&(stack_t){.ss_flags = SS_DISABLE}, NULL);
+        free(self->crash_stack);
+        self->crash_stack = NULL;
+    }
+
+    free(self->buffer);
+    self->buffer = NULL;
+    self->buffer_size = 0;
+    free(self->batch);
+    self->batch = NULL;
+    self->batch_size = 0;
+    self->batch_len = 0;
+    self->batch_logger = NULL;
+}
+
+/**
+ * Registers process for expedited membarrier. When it succeeds log calls do not need a full memory fence.
+ * Called once.
+ * */
+static void __mylogger_membarrier_register(void)
+{
+    const long supported = syscall(__NR_membarrier, MEMBARRIER_CMD_QUERY, 0);
+    if(supported > 0 && (supported & MEMBARRIER_CMD_PRIVATE_EXPEDITED) &&
+       syscall(__NR_membarrier, MEMBARRIER_CMD_REGISTER_PRIVATE_EXPEDITED, 0) == 0)
+        atomic_store_explicit(&g_mylogger_membarrier, true, memory_order_relaxed);
+}
+
+/**
+ * Marks calling thread as using the logger and returns current instance.
+ * Only thread's own state is written, instance pointer is only read.
+ *
+ * @return current logger instance or NULL when logger is not initialized.
+ * */
+static inline MyLogger_instance_S* __mylogger_enter(void)
+{
+    MyLogger_thread_S* self = &g_mylogger_thread;
+    if(__builtin_expect(!self->registered, 0))
+        __mylogger_thread_register(self);
+
+    atomic_store_explicit(&self->active, true, memory_order_relaxed);
+    // pairs with the fence in __mylogger_wait_for_readers, active must be visible before instance is read
+    if(atomic_load_explicit(&g_mylogger_membarrier, memory_order_relaxed))
+        atomic_signal_fence(memory_order_seq_cst);
+    else
+        atomic_thread_fence(memory_order_seq_cst);
+    return atomic_load_explicit(&g_mylogger_instance, memory_order_acquire);
+}
+
+/**
+ * Marks calling thread as no longer using the logger instance.
+ * */
+static inline void __mylogger_leave(void)
+{
+    atomic_store_explicit(&g_mylogger_thread.active, false, memory_order_release);
+}
+
+/**
+ * Waits until every thread that could have seen the old instance pointer leaves the logger.
+ * Instance pointer has to be cleared before the call.
+ * */
+static void __mylogger_wait_for_readers(void)
+{
+    // with membarrier readers only use compiler fence, full fence is executed on their CPUs instead
+    if(atomic_load_explicit(&g_mylogger_membarrier, memory_order_relaxed))
+        syscall(__NR_membarrier, MEMBARRIER_CMD_PRIVATE_EXPEDITED, 0);
+    else
+        atomic_thread_fence(memory_order_seq_cst);
+
+    pthread_mutex_lock(&g_mylogger_threads_mutex);
+    for(MyLogger_thread_S* thread = g_mylogger_threads; thread != NULL; thread = thread->next)
+    {
+        while(atomic_load_explicit(&thread->active, memory_order_acquire))
+            sched_yield();
+    }
+    pthread_mutex_unlock(&g_mylogger_threads_mutex);
+}
+
+/**
+ * Collects information about the log call that has to be taken on the calling thread.
+ *
+ * @param[in] instance - logger instance
+ * @param[out] call - log call description
+ * */
+static void __mylogger_call_init(const MyLogger_instance_S* instance,
+                                 MyLogger_call_S* call,
+                                 const char* file,
+                                 const char* func,
+                                 size_t line,
+                                 mylogger_level_t level)
+{
+    *call = (MyLogger_call_S) {
+        .file = file,
+        .func = func,
+        .line = line,
+        .level = level
+    };
+    if(instance->features.feat_timestamps == 1)
+        __mylogger_clock_now(&instance->timestamp, &call->time);
+    if(instance->features.feat_tid == 1)
+    {
+        MyLogger_thread_S* self = &g_mylogger_thread;
+        if(self->tid_tag_len == 0)
+            __mylogger_thread_tag_render(self);
+        call->tid_tag = self->tid_tag;
+        call->tid_tag_len = self->tid_tag_len;
+    }
+}
+
+// arguments are evaluated once, idx is usually a call that writes into the buffer
+#define MYLOGGER_CLAMP(idx, buf_size) __extension__ ({ \
+        const size_t __mylogger_idx = (idx); \
+        const size_t __mylogger_size = (buf_size); \
+        __mylogger_idx < __mylogger_size ? __mylogger_idx : __mylogger_size - 1; \
+    })
+/**
+ * Formats message prefix: level, timestamp, TID and call site.
+ *
+ * @param[in] instance - logger instance
+ * @param[out] buffer - message buffer
+ * @param[in] buf_size - buffer size
+ * @param[in] call - log call description
+ * @return Length of the prefix in the buffer. Prefix is truncated if it does not fit.
+ * */
+static size_t __mylogger_format_prefix(const MyLogger_instance_S* instance,
+                                       char* buffer,
+                                       const size_t buf_size,
+                                       const MyLogger_call_S* call)
+{
+    if(instance->encoder != MYLOGGER_ENCODER_TEXT)
+        return __mylogger_encode_prefix(instance, buffer, buf_size, call);
+
+    size_t buffer_idx = 0;
+
+    // ADD LOG LEVEL
+    const char* level_print = instance->features.feat_ansi_logs ? mylogger_level_print_ansi[call->level] : mylogger_level_print[call->level];
+    buffer_idx = (size_t)snprintf(&buffer[0],
+                                  buf_size - buffer_idx,
                                   "[%s] ", level_print);
+    buffer_idx = MYLOGGER_CLAMP(buffer_idx, buf_size);
     // ADD TIMESTAMP
-    if(g_mylogger_instance->features.feat_timestamps == 1)
-        buffer_idx += __mylogger_add_timestamp(&buffer[buffer_idx], sizeof(buffer) - buffer_idx);
+    if(instance->features.feat_timestamps == 1)
+        buffer_idx = MYLOGGER_CLAMP(buffer_idx + __mylogger_add_timestamp(&buffer[buffer_idx], buf_size - buffer_idx, &instance->timestamp, &call->time), buf_size);
+
+    // ADD TID
+    if(instance->features.feat_tid == 1)
+        buffer_idx = MYLOGGER_CLAMP(buffer_idx + __mylogger_add_tid(&buffer[buffer_idx], buf_size - buffer_idx, call), buf_size);
+
+    if(call->site != NULL && call->site->prefix != NULL)
+        buffer_idx += __mylogger_put(&buffer[buffer_idx], buf_size - buffer_idx, call->site->prefix, call->site->prefix_len);
+    else
+        buffer_idx += (size_t) snprintf(&buffer[buffer_idx],
+                                        buf_size - buffer_idx,
+                                        "%s:%zu %s: ", call->file, call->line, call->func);
+    return MYLOGGER_CLAMP(buffer_idx, buf_size);
+}
+
+/**
+ * Output length of every byte in JSON string and quoted logfmt value: 1 copied, 2 short escape (\" \\ \n...),
+ * 6 \u00XX escape of other control characters. Bytes above 0x7F are copied only as parts of valid UTF-8.
+ * */
+static const uint8_t mylogger_escape_len[256] = {
+    6, 6, 6, 6, 6, 6, 6, 6, 2, 2, 2, 6, 2, 2, 6, 6,
+    6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6,
+    1, 1, 2, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 2, 1, 1, 1,
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1
+};
+
+/**
+ * Checks UTF-8 character at the beginning of the text.
+ *
+ * @param[in] text - text starting with a byte above 0x7F
+ * @param[in] len - length of the text, at least 1
+ * @return length of the character or 0 when it is not valid UTF-8 (overlong form, surrogate,
+ *         code point above U+10FFFF or incomplete character).
+ * */
+static size_t __mylogger_utf8_len(const char* text, const size_t len)
+{
+    const uint8_t c = (uint8_t)text[0];
+    // allowed range of the second byte excludes overlong forms, surrogates and code points above U+10FFFF
+    size_t utf8_len;
+    uint8_t min = 0x80;
+    uint8_t max = 0xBF;
+    if(c >= 0xC2 && c <= 0xDF)
+        utf8_len = 2;
+    else if(c >= 0xE0 && c <= 0xEF)
+    {
+        utf8_len = 3;
+        min = c == 0xE0 ? 0xA0 : 0x80;
+        max = c == 0xED ? 0x9F : 0xBF;
+    }
+    else if(c >= 0xF0 && c <= 0xF4)
+    {
+        utf8_len = 4;
+        min = c == 0xF0 ? 0x90 : 0x80;
+        max = c == 0xF4 ? 0x8F : 0xBF;
+    }
+    else
+        return 0;
+
+    if(utf8_len > len || (uint8_t)text[1] < min || (uint8_t)text[1] > max)
+        return 0;
+    for(size_t i = 2; i < utf8_len; i++)
+        if(((uint8_t)text[i] & 0xC0) != 0x80)
+            return 0;
+    return utf8_len;
+}
+
+/**
+ * Measures escaped form of the character at the beginning of the text. Byte that is not part
+ * of valid UTF-8 is escaped as \u00XX.
+ *
+ * @param[in] text - text
+ * @param[in] len - length of the text, at least 1
+ * @param[out] width - output length of the character
+ * @return number of bytes of the character.
+ * */
+static size_t __mylogger_escape_char(const char* text, const size_t len, size_t* width)
+{
+    const uint8_t c = (uint8_t)text[0];
+    if(c < 0x80)
+    {
+        *width = mylogger_escape_len[c];
+        return 1;
+    }
+    const size_t utf8_len = __mylogger_utf8_len(text, len);
+    *width = utf8_len == 0 ? 6 : utf8_len;
+    return utf8_len == 0 ? 1 : utf8_len;
+}
+
+#define MYLOGGER_BYTES(byte)            (0x0101010101010101ULL * (byte))
+// any byte of word is below byte (byte <= 0x80)
+#define MYLOGGER_HAS_LESS(word, byte)   (((word) - MYLOGGER_BYTES(byte)) & ~(word) & MYLOGGER_BYTES(0x80))
+/**
+ * Finds first character that has to be escaped. Eight characters are checked at once,
+ * messages are mostly plain text.
+ *
+ * @param[in] text - text
+ * @param[in] len - length of the text
+ * @return index of the first character to escape or len.
+ * */
+static size_t __mylogger_escape_scan(const char* text, const size_t len)
+{
+    size_t i = 0;
+    while(true)
+    {
+        for(; i + sizeof(uint64_t) <= len; i += sizeof(uint64_t))
+        {
+            uint64_t word;
+            memcpy(&word, &text[i], sizeof(word));
+            if(MYLOGGER_HAS_LESS(word, 0x20) |
+               MYLOGGER_HAS_LESS(word ^ MYLOGGER_BYTES('"'), 1) |
+               MYLOGGER_HAS_LESS(word ^ MYLOGGER_BYTES('\\'), 1) |
+               (word & MYLOGGER_BYTES(0x80)))
+                break;
+        }
+        while(i < len && (uint8_t)text[i] < 0x80 && mylogger_escape_len[(uint8_t)text[i]] == 1)
+            i++;
+        if(i == len || (uint8_t)text[i] < 0x80)
+            return i;
+
+        // valid UTF-8 character is copied, scan continues after it
+        const size_t utf8_len = __mylogger_utf8_len(&text[i], len - i);
+        if(utf8_len == 0)
+            return i;
+        i += utf8_len;
+    }
+}
+#undef MYLOGGER_HAS_LESS
+#undef MYLOGGER_BYTES
+
+/**
+ * Escapes text in the buffer in place for JSON string or quoted logfmt value. Text is expanded
+ * from its end, so escaped characters never overwrite characters that were not moved yet.
+ *
+ * @param[in,out] buffer - text at the beginning of the buffer
+ * @param[in] len - length of the text
+ * @param[in] buf_size - buffer size
+ * @return The number of characters that would have been written on the buffer.
+ * */
+static size_t __mylogger_escape(char* buffer, const size_t len, const size_t buf_size)
+{
+    const size_t first = __mylogger_escape_scan(buffer, len);
+    if(first == len)
+    {
+        buffer[len] = '\0';
+        return len;
+    }
+
+    // part that fits with '\0', UTF-8 characters are never split
+    size_t escaped = first;
+    size_t end = first;
+    while(end < len)
+    {
+        size_t width;
+        const size_t bytes = __mylogger_escape_char(&buffer[end], len - end, &width);
+        if(escaped + width >= buf_size)
+            break;
+        escaped += width;
+        end += bytes;
+    }
+    size_t total = escaped;
+    for(size_t i = end; i < len;)
+    {
+        size_t width;
+        i += __mylogger_escape_char(&buffer[i], len - i, &width);
+        total += width;
+    }
+
+    size_t out = escaped;
+    while(end > first)
+    {
+        const uint8_t c = (uint8_t)buffer[end - 1];
+        if(c >= 0x80)
+        {
+            // character that ends here, it starts at most 3 continuation bytes back
+            size_t lead = end - 1;
+            while(lead > first && end - lead < 4 && ((uint8_t)buffer[lead] & 0xC0) == 0x80)
+                lead--;
+            const size_t utf8_len = end - lead;
+            if(__mylogger_utf8_len(&buffer[lead], utf8_len) == utf8_len)
+            {
+                out -= utf8_len;
+                memmove(&buffer[out], &buffer[lead], utf8_len);
+                end = lead;
+                continue;
+            }
+        }
+
+        end--;
+        const size_t width = c < 0x80 ? mylogger_escape_len[c] : 6;
+        out -= width;
+        if(width == 1)
+            buffer[out] = (char)c;
+        else if(width == 2)
+        {
+            buffer[out] = '\\';
+            buffer[out + 1] = c == '"' || c == '\\' ? (char)c : "btn\0fr"[c - '\b'];
+        }
+        else
+        {
+            memcpy(&buffer[out], "\\u00", 4);
+            buffer[out + 4] = "0123456789abcdef"[c >> 4];
+            buffer[out + 5] = "0123456789abcdef"[c & 0xF];
+        }
+    }
+
+    // escape that did not fit leaves a gap, returned length covers it
+    if(total > escaped)
+    {
+        memset(&buffer[escaped], ' ', buf_size - 1 - escaped);
+        escaped = buf_size - 1;
+    }
+    buffer[escaped] = '\0';
+    return total;
+}
+
+/**
+ * Adds escaped text to the message buffer.
+ *
+ * @param[in] log_buffer message buffer
+ * @param[in] buf_size current buffer size
+ * @param[in] src text
+ * @param[in] len length of the text
+ * @return The number of characters that would have been written on the buffer.
+ * */
+static size_t __mylogger_put_escaped(char* log_buffer, const size_t buf_size, const char* src, const size_t len)
+{
+    const size_t copied = len < buf_size - 1 ? len : buf_size - 1;
+    memcpy(log_buffer, src, copied);
+    size_t escaped = __mylogger_escape(log_buffer, copied, buf_size);
+    for(size_t i = copied; i < len;)
+    {
+        size_t width;
+        i += __mylogger_escape_char(&src[i], len - i, &width);
+        escaped += width;
+    }
+    return escaped;
+}
+
+/**
+ * Adds decimal number to the message buffer.
+ *
+ * @param[in] log_buffer message buffer
+ * @param[in] buf_size current buffer size
+ * @param[in] value absolute value of the number
+ * @param[in] negative number is negative
+ * @return The number of characters that would have been written on the buffer.
+ * */
+static size_t __mylogger_put_uint(char* log_buffer, const size_t buf_size, uint64_t value, bool negative)
+{
+    char digits[21];
+    size_t idx = sizeof(digits);
+    while(value >= 100)
+    {
+        idx -= 2;
+        memcpy(&digits[idx], &mylogger_digit_pairs[(value % 100) * 2], 2);
+        value /= 100;
+    }
+    if(value >= 10)
+    {
+        idx -= 2;
+        memcpy(&digits[idx], &mylogger_digit_pairs[value * 2], 2);
+    }
+    else
+        digits[--idx] = (char)('0' + value);
+    if(negative)
+        digits[--idx] = '-';
+    return __mylogger_put(log_buffer, buf_size, &digits[idx], sizeof(digits) - idx);
+}
+
+/**
+ * Adds key of the next field: ,"key": (JSON) or  key= (logfmt and text).
+ *
+ * @param[in] log_buffer message buffer
+ * @param[in] buf_size current buffer size
+ * @param[in] key field key
+ * @param[in] encoder message layout
+ * @return The number of characters that would have been written on the buffer.
+ * */
+static size_t __mylogger_add_key(char* log_buffer, const size_t buf_size, const char* key, mylogger_encoder_t encoder)
+{
+    const bool json = encoder == MYLOGGER_ENCODER_JSON;
+    size_t buffer_idx = __mylogger_put(log_buffer, buf_size, json ? ",\"" : " ", json ? 2 : 1);
+    size_t at = MYLOGGER_CLAMP(buffer_idx, buf_size);
+    if(json)
+        buffer_idx += __mylogger_put_escaped(&log_buffer[at], buf_size - at, key, strlen(key));
+    else
+        buffer_idx += __mylogger_put(&log_buffer[at], buf_size - at, key, strlen(key));
+    at = MYLOGGER_CLAMP(buffer_idx, buf_size);
+    return buffer_idx + __mylogger_put(&log_buffer[at], buf_size - at, json ? "\":" : "=", json ? 2 : 1);
+}
+
+/**
+ * Adds string value: always quoted in JSON, quoted in logfmt only when it is empty or contains
+ * spaces, '=', '"' or control characters.
+ *
+ * @param[in] log_buffer message buffer
+ * @param[in] buf_size current buffer size
+ * @param[in] src string
+ * @param[in] len length of the string
+ * @param[in] encoder message layout
+ * @return The number of characters that would have been written on the buffer.
+ * */
+static size_t __mylogger_add_string(char* log_buffer, const size_t buf_size, const char* src, const size_t len, mylogger_encoder_t encoder)
+{
+    bool quote = encoder == MYLOGGER_ENCODER_JSON || len == 0;
+    for(size_t i = 0; i < len && !quote; i++)
+    {
+        const uint8_t c = (uint8_t)src[i];
+        quote = c <= ' ' || c == '=' || c == '"' || c == 0x7F;
+        if(c >= 0x80)
+        {
+            // invalid UTF-8 is escaped in quotes
+            const size_t utf8_len = __mylogger_utf8_len(&src[i], len - i);
+            quote = utf8_len == 0;
+            i += utf8_len > 0 ? utf8_len - 1 : 0;
+        }
+    }
+    if(!quote)
+        return __mylogger_put(log_buffer, buf_size, src, len);
+
+    size_t buffer_idx = __mylogger_put(log_buffer, buf_size, "\"", 1);
+    size_t at = MYLOGGER_CLAMP(buffer_idx, buf_size);
+    buffer_idx += __mylogger_put_escaped(&log_buffer[at], buf_size - at, src, len);
+    at = MYLOGGER_CLAMP(buffer_idx, buf_size);
+    return buffer_idx + __mylogger_put(&log_buffer[at], buf_size - at, "\"", 1);
+}
+
+/**
+ * Adds structured field (key and typed value) to the message buffer.
+ *
+ * @param[in] log_buffer message buffer
+ * @param[in] buf_size current buffer size
+ * @param[in] field field of *_KV log call
+ * @param[in] encoder message layout
+ * @return The number of characters that would have been written on the buffer.
+ * */
+static size_t __mylogger_add_field(char* log_buffer, const size_t buf_size, const mylogger_field_t* field, mylogger_encoder_t encoder)
+{
+    const bool json = encoder == MYLOGGER_ENCODER_JSON;
+    size_t buffer_idx = __mylogger_add_key(log_buffer, buf_size, field->key != NULL ? field->key : "", encoder);
+    const size_t at = MYLOGGER_CLAMP(buffer_idx, buf_size);
+    char* out = &log_buffer[at];
+    const size_t out_size = buf_size - at;
+
+    switch(field->type)
+    {
+        case MYLOGGER_FIELD_INT:
+        {
+            const bool negative = field->value.i < 0;
+            const uint64_t value = negative ? 0 - (uint64_t)field->value.i : (uint64_t)field->value.i;
+            buffer_idx += __mylogger_put_uint(out, out_size, value, negative);
+            break;
+        }
+        case MYLOGGER_FIELD_UINT:
+            buffer_idx += __mylogger_put_uint(out, out_size, field->value.u, false);
+            break;
+        case MYLOGGER_FIELD_DOUBLE:
+            // JSON has no NaN and Infinity
+            if(json && !isfinite(field->value.d))
+                buffer_idx += __mylogger_put(out, out_size, "null", 4);
+            else
+                buffer_idx += (size_t)snprintf(out, out_size, "%.17g", field->value.d);
+            break;
+        case MYLOGGER_FIELD_BOOL:
+            buffer_idx += __mylogger_put(out, out_size, field->value.b ? "true" : "false", field->value.b ? 4 : 5);
+            break;
+        case MYLOGGER_FIELD_STR:
+            if(field->value.s != NULL)
+                buffer_idx += __mylogger_add_string(out, out_size, field->value.s, strlen(field->value.s), encoder);
+            else if(json)
+                buffer_idx += __mylogger_put(out, out_size, "null", 4);
+            break;
+        default:
+            buffer_idx += __mylogger_put(out, out_size, json ? "null" : "", json ? 4 : 0);
+            break;
+    }
+    return buffer_idx;
+}
+
+/**
+ * Formats message prefix of JSON and logfmt layouts: level, time, thread and call site. Prefix ends
+ * with opened "msg" string, message follows it and __mylogger_format_suffix closes it.
+ *
+ * @param[in] instance - logger instance
+ * @param[out] buffer - message buffer
+ * @param[in] buf_size - buffer size
+ * @param[in] call - log call description
+ * @return Length of the prefix in the buffer. Prefix is truncated if it does not fit.
+ * */
+static size_t __mylogger_encode_prefix(const MyLogger_instance_S* instance,
+                                       char* buffer,
+                                       const size_t buf_size,
+                                       const MyLogger_call_S* call)
+{
+    const mylogger_encoder_t encoder = instance->encoder;
+    const bool json = encoder == MYLOGGER_ENCODER_JSON;
+    const char* level_print = mylogger_level_print[call->level];
+
+    size_t buffer_idx = __mylogger_put(buffer, buf_size, json ? "{\"level\":\"" : "level=", json ? 10 : 6);
+    buffer_idx = MYLOGGER_CLAMP(buffer_idx, buf_size);
+    buffer_idx = MYLOGGER_CLAMP(buffer_idx + __mylogger_put(&buffer[buffer_idx], buf_size - buffer_idx, level_print, strlen(level_print)), buf_size);
+    if(json)
+        buffer_idx = MYLOGGER_CLAMP(buffer_idx + __mylogger_put(&buffer[buffer_idx], buf_size - buffer_idx, "\"", 1), buf_size);
+
+    // ADD TIMESTAMP without "[" and "] "
+    if(instance->features.feat_timestamps == 1)
+    {
+        char stamp[3 * MYLOGGER_TIMESTAMP_PART_MAX_SIZE];
+        const size_t stamp_len = __mylogger_add_timestamp(stamp, sizeof(stamp), &instance->timestamp, &call->time);
+        buffer_idx = MYLOGGER_CLAMP(buffer_idx + __mylogger_add_key(&buffer[buffer_idx], buf_size - buffer_idx, "time", encoder), buf_size);
+        buffer_idx = MYLOGGER_CLAMP(buffer_idx + __mylogger_add_string(&buffer[buffer_idx], buf_size - buffer_idx, &stamp[1], stamp_len - 3, encoder), buf_size);
+    }
+
+    // ADD TID without "[TID: " and "]"
+    if(instance->features.feat_tid == 1 && call->tid_tag_len > 7)
+    {
+        buffer_idx = MYLOGGER_CLAMP(buffer_idx + __mylogger_add_key(&buffer[buffer_idx], buf_size - buffer_idx, "thread", encoder), buf_size);
+        buffer_idx = MYLOGGER_CLAMP(buffer_idx + __mylogger_add_string(&buffer[buffer_idx], buf_size - buffer_idx, &call->tid_tag[6], call->tid_tag_len - 7, encoder), buf_size);
+    }
+
+    // ADD CALL SITE
+    buffer_idx = MYLOGGER_CLAMP(buffer_idx + __mylogger_add_key(&buffer[buffer_idx], buf_size - buffer_idx, "file", encoder), buf_size);
+    buffer_idx = MYLOGGER_CLAMP(buffer_idx + __mylogger_add_string(&buffer[buffer_idx], buf_size - buffer_idx, call->file, strlen(call->file), encoder), buf_size);
+    buffer_idx = MYLOGGER_CLAMP(buffer_idx + __mylogger_add_key(&buffer[buffer_idx], buf_size - buffer_idx, "line", encoder), buf_size);
+    buffer_idx = MYLOGGER_CLAMP(buffer_idx + __mylogger_put_uint(&buffer[buffer_idx], buf_size - buffer_idx, call->line, false), buf_size);
+    buffer_idx = MYLOGGER_CLAMP(buffer_idx + __mylogger_add_key(&buffer[buffer_idx], buf_size - buffer_idx, "func", encoder), buf_size);
+    buffer_idx = MYLOGGER_CLAMP(buffer_idx + __mylogger_add_string(&buffer[buffer_idx], buf_size - buffer_idx, call->func, strlen(call->func), encoder), buf_size);
+
+    // OPEN MESSAGE
+    buffer_idx = MYLOGGER_CLAMP(buffer_idx + __mylogger_add_key(&buffer[buffer_idx], buf_size - buffer_idx, "msg", encoder), buf_size);
+    buffer_idx += __mylogger_put(&buffer[buffer_idx], buf_size - buffer_idx, "\"", 1);
+    return MYLOGGER_CLAMP(buffer_idx, buf_size);
+}
+
+/**
+ * Ends message that did not fit with MYLOGGER_TRUNCATED_MARK, so output stays line oriented.
+ *
+ * @param[in,out] buffer - message buffer
+ * @param[in] buf_size - buffer size
+ * @param[in] buffer_idx - length of the message in the buffer
+ * @param[in] truncated - message did not fit
+ * @return Length of the message in the buffer.
+ * */
+static size_t __mylogger_mark_truncated(char* buffer, const size_t buf_size, const size_t buffer_idx, const bool truncated)
+{
+    if(truncated && buf_size > sizeof(MYLOGGER_TRUNCATED_MARK))
+        memcpy(&buffer[buf_size - sizeof(MYLOGGER_TRUNCATED_MARK)], MYLOGGER_TRUNCATED_MARK, sizeof(MYLOGGER_TRUNCATED_MARK));
+    return buffer_idx;
+}
+
+/**
+ * Ends JSON or logfmt message that did not fit. Escaped text is cut between characters, so that
+ * MYLOGGER_TRUNCATED_MARK fits into the "msg" string, and the line is closed. Fields and stack trace
+ * after the text are dropped.
+ *
+ * @param[in,out] buffer - message buffer
+ * @param[in] buf_size - buffer size
+ * @param[in] message_idx - start of the escaped text
+ * @param[in] text_end - end of the escaped text
+ * @param[in] json - JSON layout, otherwise logfmt
+ * @return Length of the message in the buffer.
+ * */
+static size_t __mylogger_encode_truncated(char* buffer,
+                                          const size_t buf_size,
+                                          const size_t message_idx,
+                                          const size_t text_end,
+                                          const bool json)
+{
+    // mark without '\n', then closing quote and the end of the line
+    const size_t mark_len = sizeof(MYLOGGER_TRUNCATED_MARK) - 2;
+    const char* close = json ? "\"}\n" : "\"\n";
+    const size_t close_len = json ? 3 : 2;
+    if(message_idx + mark_len + close_len >= buf_size)
+        return __mylogger_mark_truncated(buffer, buf_size, buf_size - 1, true);
+
+    const size_t limit = buf_size - 1 - mark_len - close_len;
+    const size_t end = text_end < limit ? text_end : limit;
+    size_t cut = message_idx;
+    while(cut < end)
+    {
+        // escape sequences and UTF-8 characters are never split
+        const uint8_t c = (uint8_t)buffer[cut];
+        size_t width = 1;
+        if(c == '\\')
+            width = buffer[cut + 1] == 'u' ? 6 : 2;
+        else if(c >= 0xC0)
+            width = c >= 0xF0 ? 4 : c >= 0xE0 ? 3 : 2;
+        if(cut + width > end)
+            break;
+        cut += width;
+    }
+
+    memcpy(&buffer[cut], MYLOGGER_TRUNCATED_MARK, mark_len);
+    memcpy(&buffer[cut + mark_len], close, close_len + 1);
+    return cut + mark_len + close_len;
+}
+
+/**
+ * Finishes the message after its text: escapes the text of JSON and logfmt layouts, adds fields of *_KV call
+ * and stack trace of FATAL message. Trailing newline of the text is moved after the fields.
+ *
+ * @param[in] instance - logger instance
+ * @param[in,out] buffer - message buffer
+ * @param[in] buf_size - buffer size
+ * @param[in] message_idx - start of the message text
+ * @param[in] buffer_idx - end of the message text
+ * @param[in,out] truncated - text did not fit, set when the rest of the message does not fit
+ * @param[in] call - log call description
+ * @return Length of the message in the buffer. Message is truncated if it does not fit.
+ * */
+static size_t __mylogger_format_suffix(const MyLogger_instance_S* instance,
+                                       char* buffer,
+                                       const size_t buf_size,
+                                       const size_t message_idx,
+                                       size_t buffer_idx,
+                                       bool* truncated,
+                                       const MyLogger_call_S* call)
+{
+#define MYLOGGER_SUFFIX_ADD(expr)                                       \
+    do {                                                                \
+        const size_t __mylogger_next = buffer_idx + (expr);             \
+        *truncated |= __mylogger_next >= buf_size;                      \
+        buffer_idx = MYLOGGER_CLAMP(__mylogger_next, buf_size);         \
+    } while(0)
+
+    const mylogger_encoder_t encoder = instance->encoder;
+    const bool fatal = call->level == MYLOGGER_LEVEL_FATAL;
+
+    if(encoder == MYLOGGER_ENCODER_TEXT && call->fields_count == 0)
+    {
+        if(fatal)
+            MYLOGGER_SUFFIX_ADD(__mylogger_add_trace(&buffer[buffer_idx], buf_size - buffer_idx, instance->trace));
+        return __mylogger_mark_truncated(buffer, buf_size, buffer_idx, *truncated);
+    }
+
+    const bool newline = buffer_idx > message_idx && buffer[buffer_idx - 1] == '\n';
+    if(newline)
+        buffer_idx--;
+    size_t text_end = buffer_idx;
+    if(encoder != MYLOGGER_ENCODER_TEXT)
+    {
+        const size_t text_len = buffer_idx - message_idx;
+        buffer_idx = message_idx;
+        MYLOGGER_SUFFIX_ADD(__mylogger_escape(&buffer[message_idx], text_len, buf_size - message_idx));
+        text_end = buffer_idx;
+        MYLOGGER_SUFFIX_ADD(__mylogger_put(&buffer[buffer_idx], buf_size - buffer_idx, "\"", 1));
+    }
+
+    // ADD FIELDS
+    for(size_t i = 0; i < call->fields_count; i++)
+        MYLOGGER_SUFFIX_ADD(__mylogger_add_field(&buffer[buffer_idx], buf_size - buffer_idx, &call->fields[i], encoder));
+
+    if(encoder == MYLOGGER_ENCODER_TEXT)
+    {
+        if(newline)
+            MYLOGGER_SUFFIX_ADD(__mylogger_put(&buffer[buffer_idx], buf_size - buffer_idx, "\n", 1));
+        if(fatal)
+            MYLOGGER_SUFFIX_ADD(__mylogger_add_trace(&buffer[buffer_idx], buf_size - buffer_idx, instance->trace));
+        return __mylogger_mark_truncated(buffer, buf_size, buffer_idx, *truncated);
+    }
+
+    // ADD STACKTRACE as one escaped string
+    if(fatal)
+    {
+        MYLOGGER_SUFFIX_ADD(__mylogger_add_key(&buffer[buffer_idx], buf_size - buffer_idx, "trace", encoder));
+        MYLOGGER_SUFFIX_ADD(__mylogger_put(&buffer[buffer_idx], buf_size - buffer_idx, "\"", 1));
+        const size_t trace_idx = buffer_idx;
+        MYLOGGER_SUFFIX_ADD(__mylogger_add_trace(&buffer[buffer_idx], buf_size - buffer_idx, instance->trace));
+        if(buffer_idx > trace_idx && buffer[buffer_idx - 1] == '\n')
+            buffer_idx--;
+        const size_t trace_len = buffer_idx - trace_idx;
+        buffer_idx = trace_idx;
+        MYLOGGER_SUFFIX_ADD(__mylogger_escape(&buffer[trace_idx], trace_len, buf_size - trace_idx));
+        MYLOGGER_SUFFIX_ADD(__mylogger_put(&buffer[buffer_idx], buf_size - buffer_idx, "\"", 1));
+    }
+
+    const bool json = encoder == MYLOGGER_ENCODER_JSON;
+    MYLOGGER_SUFFIX_ADD(__mylogger_put(&buffer[buffer_idx], buf_size - buffer_idx, json ? "}\n" : "\n", json ? 2 : 1));
+    if(*truncated)
+        return __mylogger_encode_truncated(buffer, buf_size, message_idx, text_end, json);
+    return buffer_idx;
+#undef MYLOGGER_SUFFIX_ADD
+}
+
+/**
+ * Formats whole log message (prefix, message and optional stack trace) into the buffer.
+ *
+ * @param[in] instance - logger instance
+ * @param[out] buffer - message buffer
+ * @param[in] buf_size - buffer size
+ * @param[in] call - log call description
+ * @param[in] args - arguments for format
+ * @param[out] truncated - message did not fit, it ends with MYLOGGER_TRUNCATED_MARK
+ * @return Length of the message in the buffer (without '\0'). Message is truncated if it does not fit.
+ * */
+static size_t __mylogger_format(const MyLogger_instance_S* instance,
+                                char* buffer,
+                                const size_t buf_size,
+                                const MyLogger_call_S* call,
+                                const char* format,
+                                va_list args,
+                                bool* truncated)
+{
+    size_t buffer_idx = __mylogger_format_prefix(instance, buffer, buf_size, call);
+    const size_t message_idx = buffer_idx;
+
+    // ADD LOG MESSAGE, format of the call site is parsed only once
+    const MyLogger_format_program_S* program = call->site != NULL ? __mylogger_format_program(call->site, format) : NULL;
+    if(program != NULL)
+        buffer_idx += __mylogger_format_run(&buffer[buffer_idx], buf_size - buffer_idx, program, args);
+    else
+        buffer_idx += (size_t)vsnprintf(&buffer[buffer_idx],
+                                        buf_size - buffer_idx,
+                                        format, args);
+    // untruncated length tells whether the text fit, message that fills the buffer exactly is whole
+    *truncated = buffer_idx >= buf_size;
+    buffer_idx = MYLOGGER_CLAMP(buffer_idx, buf_size);
+
+    // ADD FIELDS AND STACKTRACE
+    return __mylogger_format_suffix(instance, buffer, buf_size, message_idx, buffer_idx, truncated, call);
+}
+
+/**
+ * Returns formatting buffer of the calling thread with at least size bytes.
+ *
+ * @param[in,out] thread - state of the calling thread
+ * @param[in] size - required size
+ * @return buffer or NULL when it cannot be allocated.
+ * */
+static char* __mylogger_thread_buffer(MyLogger_thread_S* thread, const size_t size)
+{
+    if(thread->buffer_size >= size)
+        return thread->buffer;
+
+    char* buffer = realloc(thread->buffer, size);
+    if(buffer == NULL)
+        return NULL;
+    thread->buffer = buffer;
+    thread->buffer_size = size;
+    return buffer;
+}
+
+/**
+ * Formats whole log message into the buffer of the calling thread. No lock is needed.
+ * Buffer grows up to max_size when message does not fit, longer messages are truncated.
+ *
+ * @param[in] instance - logger instance
+ * @param[in,out] thread - state of the calling thread
+ * @param[in] max_size - maximal size of the message with '\0'
+ * @param[in] call - log call description
+ * @param[in] args - arguments for format
+ * @param[out] message - formatted message
+ * @return Length of the message (without '\0').
+ * */
+static size_t __mylogger_format_thread(const MyLogger_instance_S* instance,
+                                       MyLogger_thread_S* thread,
+                                       const size_t max_size,
+                                       const MyLogger_call_S* call,
+                                       const char* format,
+                                       va_list args,
+                                       const char** message)
+{
+    size_t size = thread->buffer_size > MYLOGGER_THREAD_BUFFER_SIZE ? thread->buffer_size : MYLOGGER_THREAD_BUFFER_SIZE;
+    size = size < max_size ? size : max_size;
+
+    while(true)
+    {
+        char* buffer = __mylogger_thread_buffer(thread, size);
+        if(buffer == NULL)
+        {
+            buffer = thread->fallback;
+            size = sizeof(thread->fallback);
+        }
+
+        va_list attempt;
+        va_copy(attempt, args);
+        bool truncated;
+        const size_t len = __mylogger_format(instance, buffer, size, call, format, attempt, &truncated);
+        va_end(attempt);
+
+        if(!truncated || size >= max_size || buffer == thread->fallback)
+        {
+            thread->truncated = truncated;
+            *message = buffer;
+            return len;
+        }
+        size = size * 2 < max_size ? size * 2 : max_size;
+    }
+}
+
+/**
+ * Finds next conversion specification in printf format string and recognizes type of its argument.
+ *
+ * @param[in] format - format string
+ * @param[out] conv - found conversion
+ * @return pointer to '%' of the found conversion or NULL when there are no more conversions.
+ * */
+static const char* __mylogger_next_conversion(const char* format, MyLogger_conversion_S* conv)
+{
+    const char* start = strchr(format, '%');
+    if(start == NULL)
+        return NULL;
+
+    const char* p = start + 1;
+    *conv = (MyLogger_conversion_S){.type = MYLOGGER_ARG_UNSUPPORTED, .precision = -1, .width = -1};
+
+    // FLAGS
+    bool plain = true;  // no flags that only snprintf handles
+    while(*p != '\0' && strchr("-+ #0'I", *p) != NULL)
+    {
+        if(*p == '-')
+            conv->left = true;
+        else if(*p == '0')
+            conv->zero = true;
+        else if(*p == '+')
+            conv->sign = '+';
+        else if(*p == ' ')
+            conv->sign = conv->sign == '+' ? '+' : ' ';
+        else
+            plain = false;
+        p++;
+    }
+    // WIDTH
+    if(*p == '*')
+    {
+        conv->stars++;
+        p++;
+    }
+    while(*p >= '0' && *p <= '9')
+    {
+        if(conv->width <= MYLOGGER_CONVERSION_MAX_WIDTH)
+            conv->width = (conv->width > 0 ? conv->width * 10 : 0) + (*p - '0');
+        p++;
+    }
+    // PRECISION
+    if(*p == '.')
+    {
+        p++;
+        conv->precision = 0;
+        if(*p == '*')
+        {
+            conv->stars++;
+            conv->precision_star = true;
+            p++;
+        }
+        while(*p >= '0' && *p <= '9')
+        {
+            if(conv->precision <= MYLOGGER_CONVERSION_MAX_WIDTH)
+                conv->precision = conv->precision * 10 + (*p - '0');
+            p++;
+        }
+    }
+    // LENGTH MODIFIER
+    int longs = 0;
+    char modifier = '\0';
+    while(*p != '\0' && strchr("hlLqjzZt", *p) != NULL)
+    {
+        if(*p == 'l')
+            longs++;
+        else
+            modifier = *p;
+        p++;
+    }
+    // CONVERSION
+    const bool is_signed = *p == 'd' || *p == 'i';
+    switch(*p)
+    {
+        case '%':
+            conv->type = p == start + 1 ? MYLOGGER_ARG_NONE : MYLOGGER_ARG_UNSUPPORTED;
+            break;
+        case 'd': case 'i': case 'u': case 'o': case 'x': case 'X':
+            if(modifier == 'j')
+                conv->type = is_signed ? MYLOGGER_ARG_INTMAX : MYLOGGER_ARG_UINTMAX;
+            else if(modifier == 'z' || modifier == 'Z')
+                conv->type = MYLOGGER_ARG_SIZE;
+            else if(modifier == 't')
+                conv->type = MYLOGGER_ARG_PTRDIFF;
+            else if(longs >= 2 || modifier == 'q' || modifier == 'L')
+                conv->type = is_signed ? MYLOGGER_ARG_LLONG : MYLOGGER_ARG_ULLONG;
+            else if(longs == 1)
+                conv->type = is_signed ? MYLOGGER_ARG_LONG : MYLOGGER_ARG_ULONG;
+            else
+                conv->type = is_signed ? MYLOGGER_ARG_INT : MYLOGGER_ARG_UINT;
+            break;
+        case 'c':
+            // glibc reads wide characters and strings for every length modifier except "h"
+            conv->type = longs == 0 && (modifier == '\0' || modifier == 'h') ? MYLOGGER_ARG_INT : MYLOGGER_ARG_UINT;
+            break;
+        case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A':
+            // glibc reads long double for "ll" and "q" too
+            conv->type = modifier == 'L' || modifier == 'q' || longs >= 2 ? MYLOGGER_ARG_LDOUBLE : MYLOGGER_ARG_DOUBLE;
+            break;
+        case 'p':
+            conv->type = MYLOGGER_ARG_PTR;
+            break;
+        case 's':
+            conv->type = longs == 0 && (modifier == '\0' || modifier == 'h') ? MYLOGGER_ARG_STR : MYLOGGER_ARG_UNSUPPORTED;
+            break;
+        default:
+            break;
+    }
+    conv->spec = *p;
+    if(*p != '\0')
+        p++;
+
+    conv->len = (size_t)(p - start);
+    if(conv->len >= MYLOGGER_CONVERSION_MAX_SIZE)
+        conv->type = MYLOGGER_ARG_UNSUPPORTED;
+
+    // FAST PATH, anything unusual is formatted by snprintf
+    plain = plain && conv->stars == 0 && modifier != 'h' && conv->type != MYLOGGER_ARG_UNSUPPORTED &&
+            conv->width <= MYLOGGER_CONVERSION_MAX_WIDTH && conv->precision <= MYLOGGER_CONVERSION_MAX_WIDTH;
+    const bool padded = !conv->zero && conv->sign == '\0';
+    switch(conv->spec)
+    {
+        case 'd': case 'i':
+            conv->fast = plain;
+            break;
+        case 'u': case 'x': case 'X':
+            conv->fast = plain && conv->sign == '\0';
+            break;
+        case 'c':
+            conv->fast = plain && padded && longs == 0 && modifier == '\0' && conv->precision < 0;
+            break;
+        case 's':
+            conv->fast = plain && padded && modifier == '\0';
+            break;
+        case 'p':
+            conv->fast = plain && padded && longs == 0 && modifier == '\0' && conv->precision < 0;
+            break;
+        case 'f': case 'F':
+            conv->fast = plain && conv->type == MYLOGGER_ARG_DOUBLE && modifier == '\0' && conv->precision <= 9;
+            break;
+        default:
+            break;
+    }
+    return start;
+}
+
+/**
+ * Writes decimal digits of value backwards, two digits at a time.
+ *
+ * @param[out] end - end of the destination, at least 20 characters before it are available
+ * @param[in] value - number to write
+ * @return pointer to the first written digit.
+ * */
+static char* __mylogger_put_decimal(char* end, uintmax_t value)
+{
+    while(value >= 100)
+    {
+        end -= 2;
+        memcpy(end, &mylogger_digit_pairs[(value % 100) * 2], 2);
+        value /= 100;
+    }
+    if(value >= 10)
+    {
+        end -= 2;
+        memcpy(end, &mylogger_digit_pairs[value * 2], 2);
+    }
+    else
+        *--end = (char)('0' + value);
+    return end;
+}
+
+/**
+ * Writes hexadecimal digits of value backwards.
+ *
+ * @param[out] end - end of the destination, at least 16 characters before it are available
+ * @param[in] value - number to write
+ * @param[in] upper - use upper case letters
+ * @return pointer to the first written digit.
+ * */
+static char* __mylogger_put_xdigits(char* end, uintmax_t value, bool upper)
+{
+    const char* digits = upper ? "0123456789ABCDEF" : "0123456789abcdef";
+    do
+    {
+        *--end = digits[value & 0xF];
+        value >>= 4;
+    } while(value != 0);
+    return end;
+}
+
+/**
+ * Writes digits of value in %.Nf notation backwards. The value is rounded exactly like glibc printf does:
+ * binary value is scaled by 10^precision in 128-bit integer and the rest is rounded half to even.
+ *
+ * @param[out] end - end of the destination, at least 30 characters before it are available
+ * @param[in] value - number to write, sign is ignored
+ * @param[in] precision - number of digits after the decimal point, at most 9
+ * @return pointer to the first written digit or NULL for infinity, NaN and values from 2^63.
+ * */
+static char* __mylogger_put_fixed(char* end, double value, int precision)
+{
+    __extension__ typedef unsigned __int128 uint128;
+    static const uint32_t pow10[] = {1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000};
+
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    const int exponent = (int)((bits >> 52) & 0x7FF);
+    uint64_t mantissa = bits & ((UINT64_C(1) << 52) - 1);
+    if(exponent >= 1023 + 63)
+        return NULL;
+    int shift = -1074;
+    if(exponent != 0)
+    {
+        mantissa |= UINT64_C(1) << 52;
+        shift = exponent - 1075;
+    }
+
+    // value * 10^precision = mantissa * 2^shift * 10^precision
+    const uint128 scaled = (uint128)mantissa * pow10[precision];
+    uint128 rounded = 0;
+    if(shift >= 0)
+        rounded = scaled << shift;
+    else if(shift > -128)
+    {
+        const int right = -shift;
+        rounded = scaled >> right;
+        const uint128 rest = scaled - (rounded << right);
+        const uint128 half = (uint128)1 << (right - 1);
+        if(rest > half || (rest == half && (rounded & 1) != 0))
+            rounded++;
+    }
+
+    const uint64_t integer = (uint64_t)(rounded / pow10[precision]);
+    if(precision > 0)
+    {
+        end -= precision;
+        __mylogger_put_digits(end, (uint32_t)(rounded % pow10[precision]), (size_t)precision);
+        *--end = '.';
+    }
+    return __mylogger_put_decimal(end, integer);
+}
+
+/**
+ * Fills the buffer with count copies of the character, truncates it if it does not fit.
+ *
+ * @param[out] out - destination
+ * @param[in] size - destination size
+ * @param[in] c - fill character
+ * @param[in] count - number of characters
+ * @return The number of characters that would have been written on the buffer.
+ * */
+static size_t __mylogger_put_fill(char* out, const size_t size, char c, size_t count)
+{
+    if(size > 0)
+    {
+        const size_t filled = count < size - 1 ? count : size - 1;
+        memset(out, c, filled);
+        out[filled] = '\0';
+    }
+    return count;
+}
+
+/**
+ * Writes padded field of a conversion: prefix (sign or "0x"), zeros and body.
+ *
+ * @param[out] out - destination
+ * @param[in] size - destination size
+ * @param[in] conv - conversion with width and '-' flag
+ * @param[in] pad_zero - pad with zeros after the prefix instead of spaces
+ * @param[in] prefix - sign or "0x"
+ * @param[in] prefix_len - length of prefix
+ * @param[in] zeros - zeros required by precision
+ * @param[in] body - digits or string
+ * @param[in] body_len - length of body
+ * @return The number of characters that would have been written on the buffer.
+ * */
+static size_t __mylogger_put_field(char* out,
+                                   const size_t size,
+                                   const MyLogger_conversion_S* conv,
+                                   bool pad_zero,
+                                   const char* prefix,
+                                   size_t prefix_len,
+                                   size_t zeros,
+                                   const char* body,
+                                   size_t body_len)
+{
+    const size_t len = prefix_len + zeros + body_len;
+    const size_t pad = conv->width > 0 && (size_t)conv->width > len ? (size_t)conv->width - len : 0;
+    if(!conv->left && pad_zero)
+        zeros += pad;
+
+    size_t idx = !conv->left && !pad_zero ? __mylogger_put_fill(out, size, ' ', pad) : 0;
+    size_t at = MYLOGGER_CLAMP(idx, size);
+    idx += __mylogger_put(&out[at], size - at, prefix, prefix_len);
+    at = MYLOGGER_CLAMP(idx, size);
+    idx += __mylogger_put_fill(&out[at], size - at, '0', zeros);
+    at = MYLOGGER_CLAMP(idx, size);
+    idx += __mylogger_put(&out[at], size - at, body, body_len);
+    if(conv->left)
+    {
+        at = MYLOGGER_CLAMP(idx, size);
+        idx += __mylogger_put_fill(&out[at], size - at, ' ', pad);
+    }
+    return idx;
+}
+
+/**
+ * Formats one conversion without snprintf. Output is the same as from snprintf.
+ *
+ * @param[out] out - destination
+ * @param[in] size - destination size, at least 1
+ * @param[in] conv - conversion with fast flag set
+ * @param[in] arg - argument of the conversion
+ * @return The number of characters that would have been written on the buffer
+ *         or MYLOGGER_FORMAT_FALLBACK when snprintf has to format the value (NULL, infinity, NaN...).
+ * */
+static size_t __mylogger_put_arg(char* out, const size_t size, const MyLogger_conversion_S* conv, const MyLogger_arg_U* arg)
+{
+    char digits[48];
+    char* const end = &digits[sizeof(digits)];
+    const char* body = end;
+    size_t body_len = 0;
+    char sign[1] = {conv->sign};
+    size_t sign_len = conv->sign != '\0' ? 1 : 0;
+    size_t zeros = 0;
+    bool pad_zero = conv->zero && !conv->left;
+
+    switch(conv->spec)
+    {
+        case 'd': case 'i': case 'u': case 'x': case 'X':
+        {
+            uintmax_t value = arg->u;
+            if(conv->spec == 'd' || conv->spec == 'i')
+            {
+                if(arg->i < 0)
+                {
+                    sign[0] = '-';
+                    sign_len = 1;
+                    value = -(uintmax_t)arg->i;
+                }
+            }
+            body = conv->spec == 'x' || conv->spec == 'X' ? __mylogger_put_xdigits(end, value, conv->spec == 'X')
+                                                          : __mylogger_put_decimal(end, value);
+            body_len = (size_t)(end - body);
+            if(conv->precision >= 0)
+            {
+                // precision is the minimal number of digits, zero flag is ignored
+                if(conv->precision == 0 && value == 0)
+                    body_len = 0;
+                zeros = (size_t)conv->precision > body_len ? (size_t)conv->precision - body_len : 0;
+                pad_zero = false;
+            }
+            break;
+        }
+        case 'c':
+            digits[0] = (char)(unsigned char)arg->i;
+            body = digits;
+            body_len = 1;
+            break;
+        case 's':
+            if(arg->s == NULL)
+                return MYLOGGER_FORMAT_FALLBACK;
+            body = arg->s;
+            body_len = conv->precision >= 0 ? strnlen(arg->s, (size_t)conv->precision) : strlen(arg->s);
+            break;
+        case 'p':
+            if(arg->p == NULL)
+                return MYLOGGER_FORMAT_FALLBACK;
+            body = __mylogger_put_xdigits(end, (uintptr_t)arg->p, false);
+            body_len = (size_t)(end - body);
+            return __mylogger_put_field(out, size, conv, false, "0x", 2, 0, body, body_len);
+        default:
+            // 'f' and 'F', other conversions are not fast
+            body = __mylogger_put_fixed(end, arg->d, conv->precision >= 0 ? conv->precision : 6);
+            if(body == NULL)
+                return MYLOGGER_FORMAT_FALLBACK;
+            body_len = (size_t)(end - body);
+            if(signbit(arg->d))
+            {
+                sign[0] = '-';
+                sign_len = 1;
+            }
+            break;
+    }
+    return __mylogger_put_field(out, size, conv, pad_zero, sign, sign_len, zeros, body, body_len);
+}
+
+/**
+ * Formats one conversion with snprintf.
+ *
+ * @param[out] out - destination
+ * @param[in] size - destination size
+ * @param[in] spec - conversion specification from the format string
+ * @param[in] conv - conversion
+ * @param[in] stars - values of '*' arguments
+ * @param[in] arg - argument of the conversion
+ * @return The number of characters that would have been written on the buffer.
+ * */
+static size_t __mylogger_put_arg_slow(char* out,
+                                      const size_t size,
+                                      const char* spec,
+                                      const MyLogger_conversion_S* conv,
+                                      const int* stars,
+                                      const MyLogger_arg_U* arg)
+{
+#define MYLOGGER_RENDER(value)                                                              \
+    do {                                                                                    \
+        if(conv->stars == 0)                                                                \
+            written = snprintf(out, size, spec_copy, value);                                \
+        else if(conv->stars == 1)                                                           \
+            written = snprintf(out, size, spec_copy, stars[0], value);                      \
+        else                                                                                \
+            written = snprintf(out, size, spec_copy, stars[0], stars[1], value);            \
+    } while(0)
+
+    char spec_copy[MYLOGGER_CONVERSION_MAX_SIZE];
+    memcpy(spec_copy, spec, conv->len);
+    spec_copy[conv->len] = '\0';
+
+    int written = 0;
+    switch(conv->type)
+    {
+        case MYLOGGER_ARG_INT:          MYLOGGER_RENDER((int)arg->i); break;
+        case MYLOGGER_ARG_UINT:         MYLOGGER_RENDER((unsigned int)arg->u); break;
+        case MYLOGGER_ARG_LONG:         MYLOGGER_RENDER((long)arg->i); break;
+        case MYLOGGER_ARG_ULONG:        MYLOGGER_RENDER((unsigned long)arg->u); break;
+        case MYLOGGER_ARG_LLONG:        MYLOGGER_RENDER((long long)arg->i); break;
+        case MYLOGGER_ARG_ULLONG:       MYLOGGER_RENDER((unsigned long long)arg->u); break;
+        case MYLOGGER_ARG_INTMAX:       MYLOGGER_RENDER(arg->i); break;
+        case MYLOGGER_ARG_UINTMAX:      MYLOGGER_RENDER(arg->u); break;
+        case MYLOGGER_ARG_SIZE:         MYLOGGER_RENDER((size_t)arg->u); break;
+        case MYLOGGER_ARG_PTRDIFF:      MYLOGGER_RENDER((ptrdiff_t)arg->i); break;
+        case MYLOGGER_ARG_DOUBLE:       MYLOGGER_RENDER(arg->d); break;
+        case MYLOGGER_ARG_LDOUBLE:      MYLOGGER_RENDER(arg->ld); break;
+        case MYLOGGER_ARG_PTR:          MYLOGGER_RENDER(arg->p); break;
+        case MYLOGGER_ARG_STR:          MYLOGGER_RENDER(arg->s); break;
+        case MYLOGGER_ARG_NONE:
+        case MYLOGGER_ARG_UNSUPPORTED:
+        default:
+            written = snprintf(out, size, "%%");
+            break;
+    }
+    return written > 0 ? (size_t)written : 0;
+#undef MYLOGGER_RENDER
+}
+
+/**
+ * Formats one conversion, common conversions are formatted without snprintf.
+ *
+ * @param[out] out - destination
+ * @param[in] size - destination size, at least 1
+ * @param[in] spec - conversion specification from the format string
+ * @param[in] conv - conversion
+ * @param[in] stars - values of '*' arguments
+ * @param[in] arg - argument of the conversion
+ * @return The number of characters that would have been written on the buffer.
+ * */
+static size_t __mylogger_put_conversion(char* out,
+                                        const size_t size,
+                                        const char* spec,
+                                        const MyLogger_conversion_S* conv,
+                                        const int* stars,
+                                        const MyLogger_arg_U* arg)
+{
+    if(conv->fast)
+    {
+        const size_t len = __mylogger_put_arg(out, size, conv, arg);
+        if(len != MYLOGGER_FORMAT_FALLBACK)
+            return len;
+    }
+    return __mylogger_put_arg_slow(out, size, spec, conv, stars, arg);
+}
+
+/**
+ * Parses format string into literal texts and conversions.
+ *
+ * @param[in] format - format string
+ * @return parsed format or NULL when it cannot be allocated.
+ * */
+static MyLogger_format_program_S* __mylogger_format_parse(const char* format)
+{
+    MyLogger_conversion_S conv;
+    size_t count = 0;
+    for(const char* p = format; (p = __mylogger_next_conversion(p, &conv)) != NULL; p += conv.len)
+        count++;
+
+    MyLogger_format_program_S* program = malloc(sizeof(*program) + count * sizeof(program->ops[0]));
+    if(program == NULL)
+        return NULL;
+    program->format = format;
+    program->supported = true;
+    program->ops_count = count;
+
+    const char* p = format;
+    for(size_t i = 0; i < count; i++)
+    {
+        MyLogger_format_op_S* op = &program->ops[i];
+        op->spec = __mylogger_next_conversion(p, &op->conv);
+        op->text = p;
+        op->text_len = (size_t)(op->spec - p);
+        program->supported = program->supported && op->conv.type != MYLOGGER_ARG_UNSUPPORTED;
+        p = op->spec + op->conv.len;
+    }
+    program->tail = p;
+    program->tail_len = strlen(p);
+    return program;
+}
+
+/**
+ * Returns parsed format string of the call site, the format is parsed at the first call.
+ *
+ * @param[in,out] site - call site
+ * @param[in] format - format string
+ * @return parsed format or NULL when the format has to be formatted by vsnprintf.
+ * */
+static const MyLogger_format_program_S* __mylogger_format_program(mylogger_site_t* site, const char* format)
+{
+    const MyLogger_format_program_S* program = atomic_load_explicit(&site->parsed, memory_order_acquire);
+    if(program == NULL)
+    {
+        MyLogger_format_program_S* parsed = __mylogger_format_parse(format);
+        if(parsed == NULL)
+            return NULL;
+        // another thread can parse the format at the same time, the first program stays
+        const void* expected = NULL;
+        if(atomic_compare_exchange_strong_explicit(&site->parsed, &expected, parsed,
+                                                   memory_order_acq_rel, memory_order_acquire))
+            program = parsed;
+        else
+        {
+            free(parsed);
+            program = expected;
+        }
+    }
+    // the same site can be used with different formats by a wrapper
+    return program->supported && program->format == format ? program : NULL;
+}
+
+/**
+ * Formats message from parsed format string, like vsnprintf.
+ *
+ * @param[out] buffer - message buffer
+ * @param[in] buf_size - buffer size, at least 1
+ * @param[in] program - parsed format string
+ * @param[in] args - arguments for format
+ * @return The number of characters that would have been written on the buffer.
+ * */
+static size_t __mylogger_format_run(char* buffer, const size_t buf_size, const MyLogger_format_program_S* program, va_list args)
+{
+    size_t buffer_idx = 0;
+    for(size_t i = 0; i < program->ops_count; i++)
+    {
+        const MyLogger_format_op_S* op = &program->ops[i];
+        size_t at = MYLOGGER_CLAMP(buffer_idx, buf_size);
+        buffer_idx += __mylogger_put(&buffer[at], buf_size - at, op->text, op->text_len);
+
+        int stars[2] = {0, 0};
+        for(uint8_t j = 0; j < op->conv.stars; j++)
+            stars[j] = va_arg(args, int);
+
+        MyLogger_arg_U arg = {.u = 0};
+        switch(op->conv.type)
+        {
+            // programs with unsupported conversions are never run
+            case MYLOGGER_ARG_NONE:
+            case MYLOGGER_ARG_UNSUPPORTED:
+            default:
+                at = MYLOGGER_CLAMP(buffer_idx, buf_size);
+                buffer_idx += __mylogger_put(&buffer[at], buf_size - at, "%", 1);
+                continue;
+            case MYLOGGER_ARG_INT:          arg.i = va_arg(args, int); break;
+            case MYLOGGER_ARG_UINT:         arg.u = va_arg(args, unsigned int); break;
+            case MYLOGGER_ARG_LONG:         arg.i = va_arg(args, long); break;
+            case MYLOGGER_ARG_ULONG:        arg.u = va_arg(args, unsigned long); break;
+            case MYLOGGER_ARG_LLONG:        arg.i = va_arg(args, long long); break;
+            case MYLOGGER_ARG_ULLONG:       arg.u = va_arg(args, unsigned long long); break;
+            case MYLOGGER_ARG_INTMAX:       arg.i = va_arg(args, intmax_t); break;
+            case MYLOGGER_ARG_UINTMAX:      arg.u = va_arg(args, uintmax_t); break;
+            case MYLOGGER_ARG_SIZE:         arg.u = va_arg(args, size_t); break;
+            case MYLOGGER_ARG_PTRDIFF:      arg.i = va_arg(args, ptrdiff_t); break;
+            case MYLOGGER_ARG_DOUBLE:       arg.d = va_arg(args, double); break;
+            case MYLOGGER_ARG_LDOUBLE:      arg.ld = va_arg(args, long double); break;
+            case MYLOGGER_ARG_PTR:          arg.p = va_arg(args, void*); break;
+            case MYLOGGER_ARG_STR:          arg.s = va_arg(args, const char*); break;
+        }
+        at = MYLOGGER_CLAMP(buffer_idx, buf_size);
+        buffer_idx += __mylogger_put_conversion(&buffer[at], buf_size - at, op->spec, &op->conv, stars, &arg);
+    }
+
+    const size_t at = MYLOGGER_CLAMP(buffer_idx, buf_size);
+    return buffer_idx + __mylogger_put(&buffer[at], buf_size - at, program->tail, program->tail_len);
+}
+
+/**
+ * Captures log call and binary copy of its arguments into the buffer as MyLogger_deferred_S record.
+ *
+ * @param[out] buffer - record buffer
+ * @param[in] buf_size - buffer size
+ * @param[in] call - log call description
+ * @param[in] format - format string, only pointer is stored
+ * @param[in] args - arguments for format
+ * @return record length or 0 when arguments cannot be captured (unsupported conversion or too long).
+ * */
+static size_t __mylogger_capture(char* buffer,
+                                 const size_t buf_size,
+                                 const MyLogger_call_S* call,
+                                 const char* format,
+                                 va_list args)
+{
+    size_t buffer_idx = sizeof(MyLogger_deferred_S);
+    // TID tag belongs to the calling thread, writer thread cannot render it
+    if(sizeof(MyLogger_deferred_S) + call->tid_tag_len > buf_size)
+        return 0;
+    if(call->tid_tag_len > 0)
+        memcpy(&buffer[buffer_idx], call->tid_tag, call->tid_tag_len);
+    buffer_idx += call->tid_tag_len;
+
+    const size_t args_len = __mylogger_capture_args(&buffer[buffer_idx], buf_size - buffer_idx, format, args);
+    if(args_len == MYLOGGER_CAPTURE_FAILED)
+        return 0;
+
+    const MyLogger_deferred_S deferred = {
+        .call = *call,
+        .format = format,
+        .args_len = args_len
+    };
+    memcpy(buffer, &deferred, sizeof(deferred));
+    return buffer_idx + args_len;
+}
+
+/**
+ * Stores binary copy of arguments of the format string, strings are copied.
+ *
+ * @param[out] buffer - arguments buffer
+ * @param[in] buf_size - buffer size
+ * @param[in] format - format string
+ * @param[in] args - arguments for format
+ * @return length of captured arguments or MYLOGGER_CAPTURE_FAILED (unsupported conversion or too long).
+ * */
+static size_t __mylogger_capture_args(char* buffer, const size_t buf_size, const char* format, va_list args)
+{
+#define MYLOGGER_CAPTURE(type)                          \
+    do {                                                \
+        const type value = va_arg(args, type);          \
+        if(buffer_idx + sizeof(value) > buf_size)       \
+            return MYLOGGER_CAPTURE_FAILED;             \
+        memcpy(&buffer[buffer_idx], &value, sizeof(value)); \
+        buffer_idx += sizeof(value);                    \
+    } while(0)
+
+    size_t buffer_idx = 0;
+    MyLogger_conversion_S conv;
+    const char* p = format;
+    while((p = __mylogger_next_conversion(p, &conv)) != NULL)
+    {
+        p += conv.len;
+        int star = 0;
+        for(uint8_t i = 0; i < conv.stars; i++)
+        {
+            star = va_arg(args, int);
+            if(buffer_idx + sizeof(star) > buf_size)
+                return MYLOGGER_CAPTURE_FAILED;
+            memcpy(&buffer[buffer_idx], &star, sizeof(star));
+            buffer_idx += sizeof(star);
+        }
+        switch(conv.type)
+        {
+            case MYLOGGER_ARG_NONE:         break;
+            case MYLOGGER_ARG_INT:          MYLOGGER_CAPTURE(int); break;
+            case MYLOGGER_ARG_UINT:         MYLOGGER_CAPTURE(unsigned int); break;
+            case MYLOGGER_ARG_LONG:         MYLOGGER_CAPTURE(long); break;
+            case MYLOGGER_ARG_ULONG:        MYLOGGER_CAPTURE(unsigned long); break;
+            case MYLOGGER_ARG_LLONG:        MYLOGGER_CAPTURE(long long); break;
+            case MYLOGGER_ARG_ULLONG:       MYLOGGER_CAPTURE(unsigned long long); break;
+            case MYLOGGER_ARG_INTMAX:       MYLOGGER_CAPTURE(intmax_t); break;
+            case MYLOGGER_ARG_UINTMAX:      MYLOGGER_CAPTURE(uintmax_t); break;
+            case MYLOGGER_ARG_SIZE:         MYLOGGER_CAPTURE(size_t); break;
+            case MYLOGGER_ARG_PTRDIFF:      MYLOGGER_CAPTURE(ptrdiff_t); break;
+            case MYLOGGER_ARG_DOUBLE:       MYLOGGER_CAPTURE(double); break;
+            case MYLOGGER_ARG_LDOUBLE:      MYLOGGER_CAPTURE(long double); break;
+            case MYLOGGER_ARG_PTR:          MYLOGGER_CAPTURE(void*); break;
+            case MYLOGGER_ARG_STR:
+            {
+                // string is stored as uint32_t length and characters with '\0', UINT32_MAX length means NULL
+                const char* str = va_arg(args, const char*);
+                const int precision = conv.precision_star ? star : conv.precision;
+                uint32_t str_len = UINT32_MAX;
+                if(str != NULL)
+                    str_len = (uint32_t)(precision >= 0 ? strnlen(str, (size_t)precision) : strlen(str));
+                const size_t stored = str != NULL ? (size_t)str_len + 1 : 0;
+                if(buffer_idx + sizeof(str_len) + stored > buf_size)
+                    return MYLOGGER_CAPTURE_FAILED;
+                memcpy(&buffer[buffer_idx], &str_len, sizeof(str_len));
+                buffer_idx += sizeof(str_len);
+                if(str != NULL)
+                {
+                    memcpy(&buffer[buffer_idx], str, str_len);
+                    buffer[buffer_idx + str_len] = '\0';
+                    buffer_idx += stored;
+                }
+                break;
+            }
+            case MYLOGGER_ARG_UNSUPPORTED:
+            default:
+                return MYLOGGER_CAPTURE_FAILED;
+        }
+    }
+
+    return buffer_idx;
+#undef MYLOGGER_CAPTURE
+}
+
+/**
+ * Formats message from format string and arguments captured by __mylogger_capture.
+ * Every conversion is formatted separately, so output is the same as from vsnprintf.
+ *
+ * @param[out] buffer - message buffer
+ * @param[in] buf_size - buffer size
+ * @param[in] format - format string
+ * @param[in] args - captured arguments
+ * @param[in] end - end of the captured arguments
+ * @return The number of characters that would have been written on the buffer
+ *         or MYLOGGER_CAPTURE_FAILED when the arguments do not match the format (corrupted binary log).
+ * */
+static size_t __mylogger_render_args(char* buffer, const size_t buf_size, const char* format, const char* args, const char* end)
+{
+#define MYLOGGER_RENDER(type, field)                                    \
+    do {                                                                \
+        type value;                                                     \
+        if((size_t)(end - args) < sizeof(value))                        \
+            return MYLOGGER_CAPTURE_FAILED;                             \
+        memcpy(&value, args, sizeof(value));                            \
+        args += sizeof(value);                                          \
+        arg.field = value;                                              \
+    } while(0)
+
+    size_t buffer_idx = 0;
+    MyLogger_conversion_S conv;
+    const char* p = format;
+    const char* conv_start;
+    while((conv_start = __mylogger_next_conversion(p, &conv)) != NULL)
+    {
+        // TEXT BEFORE CONVERSION
+        size_t at = MYLOGGER_CLAMP(buffer_idx, buf_size);
+        buffer_idx += __mylogger_put(&buffer[at], buf_size - at, p, (size_t)(conv_start - p));
+        p = conv_start + conv.len;
+
+        int stars[2] = {0, 0};
+        for(uint8_t i = 0; i < conv.stars; i++)
+        {
+            if((size_t)(end - args) < sizeof(stars[i]))
+                return MYLOGGER_CAPTURE_FAILED;
+            memcpy(&stars[i], args, sizeof(stars[i]));
+            args += sizeof(stars[i]);
+        }
+
+        MyLogger_arg_U arg = {.u = 0};
+        switch(conv.type)
+        {
+            case MYLOGGER_ARG_INT:          MYLOGGER_RENDER(int, i); break;
+            case MYLOGGER_ARG_UINT:         MYLOGGER_RENDER(unsigned int, u); break;
+            case MYLOGGER_ARG_LONG:         MYLOGGER_RENDER(long, i); break;
+            case MYLOGGER_ARG_ULONG:        MYLOGGER_RENDER(unsigned long, u); break;
+            case MYLOGGER_ARG_LLONG:        MYLOGGER_RENDER(long long, i); break;
+            case MYLOGGER_ARG_ULLONG:       MYLOGGER_RENDER(unsigned long long, u); break;
+            case MYLOGGER_ARG_INTMAX:       MYLOGGER_RENDER(intmax_t, i); break;
+            case MYLOGGER_ARG_UINTMAX:      MYLOGGER_RENDER(uintmax_t, u); break;
+            case MYLOGGER_ARG_SIZE:         MYLOGGER_RENDER(size_t, u); break;
+            case MYLOGGER_ARG_PTRDIFF:      MYLOGGER_RENDER(ptrdiff_t, i); break;
+            case MYLOGGER_ARG_DOUBLE:       MYLOGGER_RENDER(double, d); break;
+            case MYLOGGER_ARG_LDOUBLE:      MYLOGGER_RENDER(long double, ld); break;
+            case MYLOGGER_ARG_PTR:          MYLOGGER_RENDER(void*, p); break;
+            case MYLOGGER_ARG_STR:
+            {
+                uint32_t str_len;
+                if((size_t)(end - args) < sizeof(str_len))
+                    return MYLOGGER_CAPTURE_FAILED;
+                memcpy(&str_len, args, sizeof(str_len));
+                args += sizeof(str_len);
+                arg.s = str_len == UINT32_MAX ? NULL : args;
+                if(arg.s != NULL)
+                {
+                    // characters and '\0' inside the record
+                    if((size_t)str_len >= (size_t)(end - args) || args[str_len] != '\0')
+                        return MYLOGGER_CAPTURE_FAILED;
+                    args += (size_t)str_len + 1;
+                }
+                break;
+            }
+            case MYLOGGER_ARG_NONE:
+            case MYLOGGER_ARG_UNSUPPORTED:
+            default:
+                break;
+        }
+        at = MYLOGGER_CLAMP(buffer_idx, buf_size);
+        buffer_idx += __mylogger_put_conversion(&buffer[at], buf_size - at, conv_start, &conv, stars, &arg);
+    }
+
+    // TEXT AFTER LAST CONVERSION
+    const size_t at = MYLOGGER_CLAMP(buffer_idx, buf_size);
+    return buffer_idx + __mylogger_put(&buffer[at], buf_size - at, p, strlen(p));
+#undef MYLOGGER_RENDER
+}
+
+/**
+ * Finds ID of the call site in binary log file.
+ *
+ * @param[in] instance - logger instance
+ * @param[in] key - non-zero hash of the call site
+ * @param[in] claim - assign new ID when the call site is not known yet
+ * @return site ID or UINT32_MAX when it is unknown (or table is full).
+ * */
+static uint32_t __mylogger_binary_site(MyLogger_instance_S* instance, uint64_t key, bool claim)
+{
+    size_t idx = (size_t)key & (MYLOGGER_BINARY_SITES - 1);
+    for(size_t i = 0; i < MYLOGGER_BINARY_SITES; i++, idx = (idx + 1) & (MYLOGGER_BINARY_SITES - 1))
+    {
+        uint64_t current = atomic_load_explicit(&instance->binary_sites[idx], memory_order_relaxed);
+        // entry claimed by another thread meanwhile leaves its key in current, it can be the same site
+        if(current == 0 && claim &&
+           atomic_compare_exchange_strong_explicit(&instance->binary_sites[idx], &current, key,
+                                                   memory_order_relaxed, memory_order_relaxed))
+            return (uint32_t)idx;
+        if(current == key)
+            return (uint32_t)idx;
+        if(current == 0)
+            return UINT32_MAX;
+    }
+    return UINT32_MAX;
+}
+
+/**
+ * Turns formatted message in the buffer of the calling thread into MYLOGGER_BINARY_TEXT record.
+ *
+ * @param[in,out] thread - state of the calling thread
+ * @param[in,out] message - formatted message, record on return
+ * @param[in] len - length of the message
+ * @param[in] level - level of the message
+ * @return length of the record.
+ * */
+static size_t __mylogger_binary_text(MyLogger_thread_S* thread, const char** message, size_t len, mylogger_level_t level)
+{
+    char* buffer;
+    if(*message == thread->fallback || __mylogger_thread_buffer(thread, len + sizeof(MyLogger_binary_header_S)) == NULL)
+    {
+        // message is in the fallback buffer or cannot be moved out of the way, end is cut off
+        buffer = thread->fallback;
+        if(len > sizeof(thread->fallback) - sizeof(MyLogger_binary_header_S))
+            len = sizeof(thread->fallback) - sizeof(MyLogger_binary_header_S);
+        if(*message != thread->fallback)
+            memcpy(buffer, *message, len);
+    }
+    else
+        buffer = thread->buffer;    // realloc kept the message at the beginning
+
+    memmove(&buffer[sizeof(MyLogger_binary_header_S)], buffer, len);
+    const MyLogger_binary_header_S header = {.len = (uint32_t)len, .kind = MYLOGGER_BINARY_TEXT, .level = (uint16_t)level};
+    memcpy(buffer, &header, sizeof(header));
+    *message = buffer;
+    return sizeof(header) + len;
+}
+
+/**
+ * Encodes log call as binary MYLOGGER_BINARY_MESSAGE record into the buffer of the calling thread.
+ * Record of unknown call site is preceded by its MYLOGGER_BINARY_SITE record.
+ *
+ * @param[in] instance - logger instance
+ * @param[in,out] thread - state of the calling thread
+ * @param[in] max_size - maximal size of the text record
+ * @param[in] call - log call description
+ * @param[in] format - format string
+ * @param[in] args - arguments for format
+ * @param[out] record - encoded records
+ * @return length of the records.
+ * */
+static size_t __mylogger_binary_encode(MyLogger_instance_S* instance,
+                                       MyLogger_thread_S* thread,
+                                       const size_t max_size,
+                                       const MyLogger_call_S* call,
+                                       const char* format,
+                                       va_list args,
+                                       const char** record)
+{
+    // stack trace of FATAL message is taken now, it is stored as text like messages with fields
+    char* buffer = call->level != MYLOGGER_LEVEL_FATAL && call->fields_count == 0 ?
+                   __mylogger_thread_buffer(thread, MYLOGGER_THREAD_BUFFER_SIZE) : NULL;
+    if(buffer != NULL)
+    {
+        // same literal can be used at more places, file and line tell them apart
+        uint64_t key = (uint64_t)(uintptr_t)format * 0x9E3779B97F4A7C15ULL;
+        key ^= ((uint64_t)(uintptr_t)call->file + call->line) * 0xC2B2AE3D27D4EB4FULL;
+        key ^= (key >> 29) + (uint64_t)call->level;
+        key = key != 0 ? key : 1;
+        uint32_t site = __mylogger_binary_site(instance, key, false);
+
+        size_t site_len = 0;
+        size_t file_len = 0;
+        size_t func_len = 0;
+        size_t format_len = 0;
+        if(site == UINT32_MAX)
+        {
+            file_len = strlen(call->file);
+            func_len = strlen(call->func);
+            format_len = strlen(format);
+            site_len = sizeof(MyLogger_binary_header_S) + sizeof(MyLogger_binary_site_S) + file_len + func_len + format_len + 3;
+        }
+
+        const size_t args_idx = site_len + sizeof(MyLogger_binary_header_S) + sizeof(MyLogger_binary_message_S) + call->tid_tag_len;
+        size_t args_len = MYLOGGER_CAPTURE_FAILED;
+        if(args_idx < MYLOGGER_THREAD_BUFFER_SIZE)
+        {
+            va_list args_copy;
+            va_copy(args_copy, args);
+            args_len = __mylogger_capture_args(&buffer[args_idx], MYLOGGER_THREAD_BUFFER_SIZE - args_idx, format, args_copy);
+            va_end(args_copy);
+        }
+        if(args_len != MYLOGGER_CAPTURE_FAILED && site == UINT32_MAX)
+            site = __mylogger_binary_site(instance, key, true);
+
+        if(args_len != MYLOGGER_CAPTURE_FAILED && site != UINT32_MAX)
+        {
+            size_t idx = 0;
+            if(site_len > 0)
+            {
+                // another thread can write the same site, decoder keeps the first one
+                const MyLogger_binary_header_S header = {.len = (uint32_t)(site_len - sizeof(header)), .kind = MYLOGGER_BINARY_SITE};
+                const MyLogger_binary_site_S site_record = {
+                    .site = site,
+                    .line = (uint32_t)call->line,
+                    .file_len = (uint32_t)file_len,
+                    .func_len = (uint32_t)func_len,
+                    .format_len = (uint32_t)format_len
+                };
+                memcpy(&buffer[idx], &header, sizeof(header));
+                idx += sizeof(header);
+                memcpy(&buffer[idx], &site_record, sizeof(site_record));
+                idx += sizeof(site_record);
+                memcpy(&buffer[idx], call->file, file_len + 1);
+                idx += file_len + 1;
+                memcpy(&buffer[idx], call->func, func_len + 1);
+                idx += func_len + 1;
+                memcpy(&buffer[idx], format, format_len + 1);
+                idx += format_len + 1;
+            }
+
+            const MyLogger_binary_header_S header = {
+                .len = (uint32_t)(sizeof(MyLogger_binary_message_S) + call->tid_tag_len + args_len),
+                .kind = MYLOGGER_BINARY_MESSAGE,
+                .level = (uint16_t)call->level
+            };
+            const MyLogger_binary_message_S message = {
+                .time_ns = (uint64_t)call->time.tv_sec * 1000000000ULL + (uint64_t)call->time.tv_nsec,
+                .site = site,
+                .tid_tag_len = (uint32_t)call->tid_tag_len
+            };
+            memcpy(&buffer[idx], &header, sizeof(header));
+            idx += sizeof(header);
+            memcpy(&buffer[idx], &message, sizeof(message));
+            idx += sizeof(message);
+            if(call->tid_tag_len > 0)
+                memcpy(&buffer[idx], call->tid_tag, call->tid_tag_len);
+
+            *record = buffer;
+            return args_idx + args_len;
+        }
+    }
+
+    const size_t len = __mylogger_format_thread(instance, thread, max_size - sizeof(MyLogger_binary_header_S), call, format, args, record);
+    return __mylogger_binary_text(thread, record, len, call->level);
+}
+
+/**
+ * Prepares message of the log call for outputs: formatted text or binary records.
+ *
+ * @param[in] instance - logger instance
+ * @param[in,out] thread - state of the calling thread
+ * @param[in] max_size - maximal size of the message
+ * @param[in] call - log call description
+ * @param[in] format - format string
+ * @param[in] args - arguments for format
+ * @param[out] message - message in the buffer of the calling thread
+ * @return length of the message.
+ * */
+static size_t __mylogger_message(MyLogger_instance_S* instance,
+                                 MyLogger_thread_S* thread,
+                                 const size_t max_size,
+                                 const MyLogger_call_S* call,
+                                 const char* format,
+                                 va_list args,
+                                 const char** message)
+{
+    thread->truncated = false;
+    if(instance->features.feat_binary)
+        return __mylogger_binary_encode(instance, thread, max_size, call, format, args, message);
+    return __mylogger_format_thread(instance, thread, max_size, call, format, args, message);
+}
+
+/**
+ * Writes text of one logging session of binary log file. Call sites are collected first,
+ * so records can be in any order (MYLOGGER_FEATURE_MMAP).
+ *
+ * @param[in] data - records of the session starting with MYLOGGER_BINARY_FILE record
+ * @param[in] len - length of the session
+ * @param[in] sites - MYLOGGER_BINARY_SITES call sites
+ * @param[in] line - MYLOGGER_MESSAGE_MAX_SIZE buffer for formatted message
+ * @param[out] out - text output
+ * @return 0 on success, -1 when records are malformed.
+ * */
+static int __mylogger_decode_session(const char* data, size_t len, MyLogger_decoded_site_S* sites, char* line, FILE* out)
+{
+    MyLogger_binary_file_S session;
+    memcpy(&session, data + sizeof(MyLogger_binary_header_S), sizeof(session));
+    MyLogger_instance_S instance = {
+        .features = {.feat_timestamps = session.timestamps, .feat_tid = session.tid},
+        .timestamp = {
+            .format = (mylogger_timestamp_format_t)session.timestamp_format,
+            .precision = (mylogger_timestamp_precision_t)session.timestamp_precision
+        }
+    };
+    memset(sites, 0, MYLOGGER_BINARY_SITES * sizeof(*sites));
+
+    for(int pass = 0; pass < 2; pass++)
+    {
+        size_t idx = sizeof(MyLogger_binary_header_S) + sizeof(MyLogger_binary_file_S);
+        while(idx < len)
+        {
+            // session holds only whole records, mylogger_decode ends it before an incomplete one
+            MyLogger_binary_header_S header;
+            memcpy(&header, &data[idx], sizeof(header));
+            idx += sizeof(header);
+            if(header.level > MYLOGGER_LEVEL_FATAL)
+                return -1;
+            const char* record = &data[idx];
+            idx += header.len;
+
+            if(pass == 0 && header.kind == MYLOGGER_BINARY_SITE)
+            {
+                MyLogger_binary_site_S site;
+                if(header.len < sizeof(site))
+                    return -1;
+                memcpy(&site, record, sizeof(site));
+                if(site.site >= MYLOGGER_BINARY_SITES ||
+                   (uint64_t)site.file_len + site.func_len + site.format_len + 3 != header.len - sizeof(site))
+                    return -1;
+                const char* strings = record + sizeof(site);
+                if(strings[site.file_len] != '\0' || strings[site.file_len + 1 + site.func_len] != '\0' ||
+                   strings[site.file_len + 1 + site.func_len + 1 + site.format_len] != '\0')
+                    return -1;
+                if(sites[site.site].file == NULL)
+                    sites[site.site] = (MyLogger_decoded_site_S){
+                        .file = strings,
+                        .func = strings + site.file_len + 1,
+                        .format = strings + site.file_len + 1 + site.func_len + 1,
+                        .line = site.line
+                    };
+            }
+            else if(pass == 1 && header.kind == MYLOGGER_BINARY_TEXT)
+                fwrite(record, 1, header.len, out);
+            else if(pass == 1 && header.kind == MYLOGGER_BINARY_MESSAGE)
+            {
+                MyLogger_binary_message_S message;
+                if(header.len < sizeof(message))
+                    return -1;
+                memcpy(&message, record, sizeof(message));
+                if(message.site >= MYLOGGER_BINARY_SITES || sites[message.site].file == NULL ||
+                   message.tid_tag_len > header.len - sizeof(message))
+                    return -1;
+
+                const MyLogger_decoded_site_S* site = &sites[message.site];
+                const MyLogger_call_S call = {
+                    .file = site->file,
+                    .func = site->func,
+                    .line = site->line,
+                    .level = (mylogger_level_t)header.level,
+                    .time = {
+                        .tv_sec = (time_t)(message.time_ns / 1000000000ULL),
+                        .tv_nsec = (long)(message.time_ns % 1000000000ULL)
+                    },
+                    .tid_tag = record + sizeof(message),
+                    .tid_tag_len = message.tid_tag_len
+                };
+                size_t line_len = __mylogger_format_prefix(&instance, line, MYLOGGER_MESSAGE_MAX_SIZE, &call);
+                const size_t args_len = __mylogger_render_args(&line[line_len],
+                                                               MYLOGGER_MESSAGE_MAX_SIZE - line_len,
+                                                               site->format,
+                                                               record + sizeof(message) + message.tid_tag_len,
+                                                               record + header.len);
+                if(args_len == MYLOGGER_CAPTURE_FAILED)
+                    return -1;
+                line_len = MYLOGGER_CLAMP(line_len + args_len, MYLOGGER_MESSAGE_MAX_SIZE);
+                fwrite(line, 1, line_len, out);
+            }
+        }
+    }
+    return 0;
+}
+
+int mylogger_decode(FILE* in, FILE* out)
+{
+    // READ WHOLE FILE
+    size_t len = 0;
+    size_t size = MYLOGGER_THREAD_BUFFER_SIZE;
+    char* data = malloc(size);
+    char* line = malloc(MYLOGGER_MESSAGE_MAX_SIZE);
+    MyLogger_decoded_site_S* sites = malloc(MYLOGGER_BINARY_SITES * sizeof(*sites));
+    int ret = data != NULL && line != NULL && sites != NULL ? 0 : -1;
+    while(ret == 0)
+    {
+        len += fread(&data[len], 1, size - len, in);
+        if(len < size)
+            break;
+        char* bigger = realloc(data, size * 2);
+        if(bigger == NULL)
+            ret = -1;
+        else
+        {
+            data = bigger;
+            size *= 2;
+        }
+    }
+
+    // DECODE SESSIONS
+    size_t start = 0;
+    while(ret == 0 && start < len)
+    {
+        MyLogger_binary_header_S header;
+        MyLogger_binary_file_S session;
+        if(len - start < sizeof(header) + sizeof(session))
+        {
+            ret = -1;
+            break;
+        }
+        memcpy(&header, &data[start], sizeof(header));
+        memcpy(&session, &data[start + sizeof(header)], sizeof(session));
+        if(header.kind != MYLOGGER_BINARY_FILE || header.len != sizeof(session) ||
+           memcmp(session.magic, MYLOGGER_BINARY_MAGIC, sizeof(session.magic)) != 0 ||
+           session.version != MYLOGGER_BINARY_VERSION)
+        {
+            ret = -1;
+            break;
+        }
+
+        // session ends where the next one starts
+        size_t end = start + sizeof(header) + header.len;
+        while(end < len)
+        {
+            MyLogger_binary_header_S next;
+            if(len - end < sizeof(next))
+                break;
+            memcpy(&next, &data[end], sizeof(next));
+            if(next.kind == MYLOGGER_BINARY_FILE || len - end - sizeof(next) < next.len)
+                break;
+            end += sizeof(next) + next.len;
+        }
+
+        ret = __mylogger_decode_session(&data[start], end - start, sites, line, out);
+        start = end;
+    }
+
+    free(sites);
+    free(line);
+    free(data);
+    return ret;
+}
+
+/**
+ * Creates sinks for log file, stdout, stderr and custom outputs.
+ *
+ * @param[in,out] instance - logger instance, file has to be already opened
+ * @param[in] config - logger configuration
+ * @return MYLOGGER_INIT_SUCCESS on success, MYLOGGER_INIT_OTHER_ERROR otherwise.
+ * */
+static mylogger_init_error_code_t __mylogger_sinks_open(MyLogger_instance_S* instance, const mylogger_config_t* config)
+{
+    if(config->sinks_count > MYLOGGER_CUSTOM_SINKS_MAX)
+        return MYLOGGER_INIT_OTHER_ERROR;
+    for(size_t i = 0; i < config->sinks_count; i++)
+    {
+        if(config->sinks[i].write == NULL)
+            return MYLOGGER_INIT_OTHER_ERROR;
+    }
+
+    const size_t batch_size = config->flush.size > 0 ? config->flush.size : MYLOGGER_SINK_BATCH_SIZE;
+    instance->flush_interval_ms = config->flush.interval_ms;
+    instance->repeats_interval_ms = instance->flush_interval_ms > 0 ? instance->flush_interval_ms : MYLOGGER_COLLAPSE_FLUSH_MS;
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &instance->repeats_time);
+    instance->sync_interval_ms = config->sync_interval_ms;
+    instance->flush_level = config->flush.level > 0 || config->flush.level_set ? config->flush.level : MYLOGGER_LEVEL_ERROR;
+    instance->sinks_count = 0;
+    instance->mmap.fd = -1;
+    instance->flusher.enabled = false;
+    instance->binary_sites = NULL;
+
+    // other processes write the same file, it cannot be mapped, rotated or hold binary sessions
+    if(instance->features.feat_shared &&
+       (instance->features.feat_mmap || instance->features.feat_binary ||
+        config->rotation.max_size > 0 || config->rotation.interval_s > 0))
+        return MYLOGGER_INIT_OTHER_ERROR;
+
+    // binary records can be written only to the log file
+    if(instance->features.feat_binary &&
+       (instance->file_fd == NULL || instance->features.feat_stdout || instance->features.feat_stderr ||
+        config->sinks_count > 0 || config->rotation.max_size > 0 || config->rotation.interval_s > 0))
+        return MYLOGGER_INIT_OTHER_ERROR;
+
+    if(instance->features.feat_mmap)
+    {
+        mylogger_init_error_code_t err = __mylogger_mmap_open(&instance->mmap, instance->file_fd, config->mmap_region_size);
+        if(err != MYLOGGER_INIT_SUCCESS)
+            return err;
+    }
+    else if(instance->file_fd != NULL)
+    {
+        // anything written to the stream before has to stay before log messages
+        fflush(instance->file_fd);
+        // every write goes to the end of the file, whichever process wrote last
+        if(instance->features.feat_shared)
+        {
+            const int flags = fcntl(fileno(instance->file_fd), F_GETFL);
+            if(flags < 0 || fcntl(fileno(instance->file_fd), F_SETFL, flags | O_APPEND) != 0)
+                return MYLOGGER_INIT_OTHER_ERROR;
+        }
+        instance->sinks[instance->sinks_count++] = (MyLogger_sink_S){.fd = fileno(instance->file_fd), .batch_size = batch_size};
+    }
+
+    instance->rotation.enabled = false;
+    if(config->rotation.max_size > 0 || config->rotation.interval_s > 0)
+    {
+        // only the file created by MyLogger is rotated, it is always the first sink
+        if(instance->file_name[0] == '\0' || instance->features.feat_mmap)
+            return MYLOGGER_INIT_OTHER_ERROR;
+        mylogger_init_error_code_t err = __mylogger_rotation_start(instance, &config->rotation);
+        if(err != MYLOGGER_INIT_SUCCESS)
+            return err;
+        instance->sinks[0].rotate = true;
+    }
+    if(instance->features.feat_stdout)
+    {
+        fflush(stdout);
+        instance->sinks[instance->sinks_count++] = (MyLogger_sink_S){.fd = STDOUT_FILENO};
+    }
+    if(instance->features.feat_stderr)
+        instance->sinks[instance->sinks_count++] = (MyLogger_sink_S){.fd = STDERR_FILENO};
+    for(size_t i = 0; i < config->sinks_count; i++)
+    {
+        instance->sinks[instance->sinks_count++] = (MyLogger_sink_S){
+            .fd = -1,
+            .custom = config->sinks[i],
+            .batch_size = batch_size
+        };
+    }
+
+    // batch of size 1 could not hold any message, such sinks write every message immediately
+    for(size_t i = 0; i < instance->sinks_count; i++)
+    {
+        MyLogger_sink_S* sink = &instance->sinks[i];
+        if(sink->batch_size <= 1)
+            continue;
+        sink->batch = malloc(sink->batch_size);
+        if(sink->batch == NULL)
+        {
+            for(size_t j = 0; j < i; j++)
+                free(instance->sinks[j].batch);
+            __mylogger_mmap_close(&instance->mmap);
+            __mylogger_rotation_stop(instance);
+            return MYLOGGER_INIT_OTHER_ERROR;
+        }
+    }
+
+    // log file is the first sink, rotation changes its descriptor under the ring
+    if(instance->file_fd != NULL && !instance->features.feat_mmap)
+    {
+        MyLogger_sink_S* sink = &instance->sinks[0];
+        sink->sync = instance->sync_interval_ms > 0 && instance->features.feat_async;
+        // without io_uring (old kernel, seccomp) the sink is written with writev
+        if(instance->features.feat_uring && !sink->rotate)
+            sink->uring = __mylogger_uring_open(sink->fd, sink->batch != NULL ? sink->batch_size : MYLOGGER_SINK_BATCH_SIZE);
+    }
+
+    if(instance->features.feat_binary)
+    {
+        instance->binary_sites = calloc(MYLOGGER_BINARY_SITES, sizeof(*instance->binary_sites));
+        if(instance->binary_sites == NULL)
+        {
+            __mylogger_sinks_close(instance);
+            return MYLOGGER_INIT_OTHER_ERROR;
+        }
+
+        struct
+        {
+            MyLogger_binary_header_S header;
+            MyLogger_binary_file_S file;
+        } session = {
+            .header = {.len = sizeof(MyLogger_binary_file_S), .kind = MYLOGGER_BINARY_FILE},
+            .file = {
+                .magic = MYLOGGER_BINARY_MAGIC,
+                .version = MYLOGGER_BINARY_VERSION,
+                .timestamps = instance->features.feat_timestamps,
+                .tid = instance->features.feat_tid,
+                .timestamp_format = (uint8_t)instance->timestamp.format,
+                .timestamp_precision = (uint8_t)instance->timestamp.precision
+            }
+        };
+        if(instance->mmap.fd >= 0)
+            __mylogger_mmap_write(&instance->mmap, (const char*)&session, sizeof(session));
+        else
+            __mylogger_write(instance, (const char*)&session, sizeof(session), MYLOGGER_LEVEL_DEBUG);
+    }
+    return MYLOGGER_INIT_SUCCESS;
+}
+
+/**
+ * Writes everything that is batched, closes custom sinks and frees batches. Files are not closed.
+ *
+ * @param[in,out] instance - logger instance
+ * */
+static void __mylogger_sinks_close(MyLogger_instance_S* instance)
+{
+    for(size_t i = 0; i < instance->sinks_count; i++)
+    {
+        MyLogger_sink_S* sink = &instance->sinks[i];
+        __mylogger_sink_flush(sink, NULL);
+        if(sink->uring != NULL)
+            __mylogger_uring_close(sink->uring);
+        if(sink->fd < 0 && sink->custom.close != NULL)
+            sink->custom.close(sink->custom.user_data);
+        free(sink->batch);
+    }
+    __mylogger_mmap_close(&instance->mmap);
+    __mylogger_rotation_stop(instance);
+    instance->sinks_count = 0;
+    free(instance->binary_sites);
+    instance->binary_sites = NULL;
+}
+
+/**
+ * Prepares memory mapped log file. Messages are appended after current content of the file.
+ *
+ * @param[out] map - mapping to initialize
+ * @param[in] file - log file opened for reading and writing
+ * @param[in] region_size - file growth step, 0 for default
+ * @return MYLOGGER_INIT_SUCCESS on success, MYLOGGER_INIT_FILE_CREATION_ERROR otherwise.
+ * */
+static mylogger_init_error_code_t __mylogger_mmap_open(MyLogger_mmap_S* map, FILE* file, size_t region_size)
+{
+    const size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+    if(region_size == 0)
+        region_size = MYLOGGER_MMAP_REGION_SIZE;
+    region_size = (region_size + page_size - 1) / page_size * page_size;
+
+    map->fd = -1;
+    struct stat st;
+    fflush(file);
+    const int fd = fileno(file);
+    if(fstat(fd, &st) != 0 || !S_ISREG(st.st_mode))
+        return MYLOGGER_INIT_FILE_CREATION_ERROR;
+
+    // forked children reserve space with the same offset and map the same regions
+    MyLogger_mmap_shared_S* shared = mmap(NULL, sizeof(*shared), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if(shared == MAP_FAILED)
+        return MYLOGGER_INIT_FILE_CREATION_ERROR;
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+    pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
+    pthread_mutex_init(&shared->map_mutex, &attr);
+    pthread_mutexattr_destroy(&attr);
+
+    map->base = (size_t)st.st_size / page_size * page_size;
+    map->region_size = region_size;
+    map->forked = false;
+    map->shared = shared;
+    // existing content of the first page belongs to nobody, it is committed up front
+    const size_t used = (size_t)st.st_size - map->base;
+    atomic_init(&shared->offset, used);
+    for(size_t i = 0; i < MYLOGGER_MMAP_SLOTS; i++)
+    {
+        atomic_init(&shared->slots[i].index, SIZE_MAX);
+        atomic_init(&shared->slots[i].committed, 0);
+        atomic_init(&map->addr[i], NULL);
+        atomic_init(&map->mapped[i], SIZE_MAX);
+    }
+    atomic_init(&shared->failed, false);
+    atomic_init(&shared->lost, SIZE_MAX);
+
+    map->fd = fd;
+    if(__mylogger_mmap_region(map, 0) == NULL)
+    {
+        map->fd = -1;
+        munmap(shared, sizeof(*shared));
+        return MYLOGGER_INIT_FILE_CREATION_ERROR;
+    }
+    atomic_store_explicit(&shared->slots[0].committed, used, memory_order_relaxed);
+    return MYLOGGER_INIT_SUCCESS;
+}
+
+/**
+ * Unmaps the file and truncates it to the written length, which ends before the first message that was not
+ * written when the file could not grow. No thread can write at this point. Forked child leaves the file as it is,
+ * the parent may still write into it.
+ *
+ * @param[in,out] map - mapping to close
+ * */
+static void __mylogger_mmap_close(MyLogger_mmap_S* map)
+{
+    if(map->fd < 0)
+        return;
+
+    for(size_t i = 0; i < MYLOGGER_MMAP_SLOTS; i++)
+    {
+        char* addr = atomic_load_explicit(&map->addr[i], memory_order_relaxed);
+        if(addr != NULL)
+            munmap(addr, map->region_size);
+    }
+    if(!map->forked)
+    {
+        size_t length = atomic_load_explicit(&map->shared->offset, memory_order_relaxed);
+        const size_t lost = atomic_load_explicit(&map->shared->lost, memory_order_relaxed);
+        if(lost < length)
+            length = lost;
+        if(ftruncate(map->fd, (off_t)(map->base + length)) != 0)
+            fprintf(stderr, "MyLogger log file truncation error!\n");
+    }
+    // mutex is not destroyed, forked children may still use their copy of the shared memory
+    munmap(map->shared, sizeof(*map->shared));
+    map->fd = -1;
+}
+
+/**
+ * Locks the mutex shared with forked children. Process that died while holding it does not block the others,
+ * the mutex guards no state that could stay inconsistent.
+ *
+ * @param[in] map - memory mapped file
+ * */
+static void __mylogger_mmap_lock(MyLogger_mmap_S* map)
+{
+    if(pthread_mutex_lock(&map->shared->map_mutex) == EOWNERDEAD)
+        pthread_mutex_consistent(&map->shared->map_mutex);
+}
+
+/**
+ * Returns mapping of the region, maps it when needed. Waits while the slot still holds an older region.
+ *
+ * @param[in] map - memory mapped file
+ * @param[in] index - region index
+ * @return address of the region or NULL when the file could not grow.
+ * */
+static char* __mylogger_mmap_region(MyLogger_mmap_S* map, size_t index)
+{
+    const size_t i = index % MYLOGGER_MMAP_SLOTS;
+    MyLogger_mmap_region_S* slot = &map->shared->slots[i];
+    while(true)
+    {
+        if(atomic_load_explicit(&slot->index, memory_order_acquire) == index &&
+           atomic_load_explicit(&map->mapped[i], memory_order_acquire) == index)
+            return atomic_load_explicit(&map->addr[i], memory_order_relaxed);
+        if(atomic_load_explicit(&map->shared->failed, memory_order_relaxed))
+            return NULL;
+
+        __mylogger_mmap_lock(map);
+        const size_t held = atomic_load_explicit(&slot->index, memory_order_relaxed);
+        if((held == SIZE_MAX || held == index) && atomic_load_explicit(&map->mapped[i], memory_order_relaxed) != index)
+        {
+            // mapping left from a region released by another process is not used by anyone
+            char* stale = atomic_load_explicit(&map->addr[i], memory_order_relaxed);
+            if(stale != NULL)
+                munmap(stale, map->region_size);
+            atomic_store_explicit(&map->addr[i], NULL, memory_order_relaxed);
+            atomic_store_explicit(&map->mapped[i], SIZE_MAX, memory_order_relaxed);
+
+            const off_t offset = (off_t)(map->base + index * map->region_size);
+            char* addr = NULL;
+            // preallocation makes sure that writing into the mapping never ends with SIGBUS,
+            // forked child allocates only what it writes, the parent may have truncated the file already
+            if(map->forked || posix_fallocate(map->fd, offset, (off_t)map->region_size) == 0)
+            {
+                addr = mmap(NULL, map->region_size, PROT_READ | PROT_WRITE, MAP_SHARED, map->fd, offset);
+                if(addr == MAP_FAILED)
+                    addr = NULL;
+            }
+            if(addr == NULL)
+            {
+                atomic_store_explicit(&map->shared->failed, true, memory_order_relaxed);
+                pthread_mutex_unlock(&map->shared->map_mutex);
+                return NULL;
+            }
+            if(held == SIZE_MAX)
+            {
+                atomic_store_explicit(&slot->committed, 0, memory_order_relaxed);
+                atomic_store_explicit(&slot->index, index, memory_order_release);
+            }
+            atomic_store_explicit(&map->addr[i], addr, memory_order_relaxed);
+            atomic_store_explicit(&map->mapped[i], index, memory_order_release);
+        }
+        pthread_mutex_unlock(&map->shared->map_mutex);
+
+        // slot is mapped by us or another thread, or still holds region index - MYLOGGER_MMAP_SLOTS
+        if(atomic_load_explicit(&map->mapped[i], memory_order_relaxed) != index)
+            sched_yield();
+    }
+}
+
+/**
+ * Unmaps completely written region and frees its slot. Other processes unmap their mappings of the region
+ * when they map the next one.
+ *
+ * @param[in] map - memory mapped file
+ * @param[in] index - index of the filled region
+ * */
+static void __mylogger_mmap_release(MyLogger_mmap_S* map, size_t index)
+{
+    const size_t i = index % MYLOGGER_MMAP_SLOTS;
+    __mylogger_mmap_lock(map);
+    if(atomic_load_explicit(&map->mapped[i], memory_order_relaxed) == index)
+    {
+        munmap(atomic_load_explicit(&map->addr[i], memory_order_relaxed), map->region_size);
+        atomic_store_explicit(&map->addr[i], NULL, memory_order_relaxed);
+        atomic_store_explicit(&map->mapped[i], SIZE_MAX, memory_order_relaxed);
+    }
+    atomic_store_explicit(&map->shared->slots[i].index, SIZE_MAX, memory_order_release);
+    pthread_mutex_unlock(&map->shared->map_mutex);
+}
+
+/**
+ * Records message that could not be written completely. Nothing is written from now on and the file is
+ * truncated before the earliest such message, so that it holds neither zeros nor parts of messages.
+ *
+ * @param[in] map - memory mapped file
+ * @param[in] start - offset of the message
+ * */
+static void __mylogger_mmap_drop(MyLogger_mmap_S* map, size_t start)
+{
+    atomic_store_explicit(&map->shared->failed, true, memory_order_relaxed);
+    size_t lost = atomic_load_explicit(&map->shared->lost, memory_order_relaxed);
+    while(start < lost && !atomic_compare_exchange_weak_explicit(&map->shared->lost, &lost, start,
+                                                                  memory_order_relaxed, memory_order_relaxed))
+        ;
+}
+
+/**
+ * Copies formatted messages into the memory mapped file. Safe to call from many threads at once.
+ *
+ * @param[in] map - memory mapped file
+ * @param[in] buffer - formatted messages
+ * @param[in] len - number of bytes to write
+ * */
+static void __mylogger_mmap_write(MyLogger_mmap_S* map, const char* buffer, size_t len)
+{
+    if(atomic_load_explicit(&map->shared->failed, memory_order_relaxed))
+        return;
+
+    const size_t start = atomic_fetch_add_explicit(&map->shared->offset, len, memory_order_relaxed);
+    size_t offset = start;
+    while(len > 0)
+    {
+        // message can span regions, every part is copied into its own mapping
+        const size_t index = offset / map->region_size;
+        const size_t in_region = offset % map->region_size;
+        const size_t chunk = len < map->region_size - in_region ? len : map->region_size - in_region;
+
+        char* addr = __mylogger_mmap_region(map, index);
+        // parent truncates the file when it closes, forked child grows it again before every write
+        if(addr == NULL || (map->forked && posix_fallocate(map->fd, (off_t)(map->base + offset), (off_t)chunk) != 0))
+        {
+            __mylogger_mmap_drop(map, start);
+            return;
+        }
+        memcpy(&addr[in_region], buffer, chunk);
+
+        MyLogger_mmap_region_S* slot = &map->shared->slots[index % MYLOGGER_MMAP_SLOTS];
+        if(atomic_fetch_add_explicit(&slot->committed, chunk, memory_order_acq_rel) + chunk == map->region_size)
+            __mylogger_mmap_release(map, index);
+
+        buffer += chunk;
+        offset += chunk;
+        len -= chunk;
+    }
+}
+
+/**
+ * Writes all the buffers to the sink. Partial writes and interrupted writes are retried.
+ *
+ * @param[in] sink - output
+ * @param[in] iov - buffers, modified during the call
+ * @param[in] iovcnt - number of buffers
+ * @param[in,out] stats - counters of the calling thread where write time is added, can be NULL
+ * */
+static void __mylogger_sink_writev(MyLogger_sink_S* sink, struct iovec* iov, int iovcnt, MyLogger_stats_S* stats)
+{
+    const uint64_t start = stats != NULL ? __mylogger_stats_now() : 0;
+
+    if(sink->fd < 0)
+    {
+        for(int i = 0; i < iovcnt; i++)
+        {
+            if(iov[i].iov_len > 0)
+                sink->custom.write(sink->custom.user_data, iov[i].iov_base, iov[i].iov_len);
+        }
+        iovcnt = 0;
+    }
+    else if(sink->uring != NULL)
+    {
+        __mylogger_uring_writev(sink->uring, iov, iovcnt);
+        iovcnt = 0;
+    }
+
+    while(iovcnt > 0)
+    {
+        const ssize_t written = writev(sink->fd, iov, iovcnt);
+        if(written < 0)
+        {
+            if(errno == EINTR)
+                continue;
+            break;      // nowhere to report, message is lost like with fprintf
+        }
+
+        size_t left = (size_t)written;
+        while(iovcnt > 0 && left >= iov->iov_len)
+        {
+            left -= iov->iov_len;
+            iov++;
+            iovcnt--;
+        }
+        if(iovcnt > 0)
+        {
+            iov->iov_base = (char*)iov->iov_base + left;
+            iov->iov_len -= left;
+        }
+    }
+
+    if(stats != NULL)
+        __mylogger_histogram_add(&stats->sink_write, __mylogger_stats_now() - start);
+}
+
+/**
+ * Writes batched messages of the sink.
+ *
+ * @param[in] sink - output
+ * @param[in,out] stats - counters of the calling thread, can be NULL
+ * */
+static void __mylogger_sink_flush(MyLogger_sink_S* sink, MyLogger_stats_S* stats)
+{
+    if(sink->batch_len == 0)
+        return;
+    if(sink->uring != NULL)
+    {
+        const uint64_t start = stats != NULL ? __mylogger_stats_now() : 0;
+        __mylogger_uring_flush(sink->uring, sink);
+        if(stats != NULL)
+            __mylogger_histogram_add(&stats->sink_write, __mylogger_stats_now() - start);
+        return;
+    }
+    struct iovec iov = {.iov_base = sink->batch, .iov_len = sink->batch_len};
+    __mylogger_sink_writev(sink, &iov, 1, stats);
+    sink->batch_len = 0;
+}
+
+/**
+ * Syncs log file data when sync interval elapsed. Writer thread only, under instance mutex.
+ * With io_uring the writer thread does not wait for the disk.
+ *
+ * @param[in] instance - logger instance
+ * */
+static void __mylogger_sinks_sync(MyLogger_instance_S* instance)
+{
+    if(instance->sync_interval_ms == 0 || instance->sinks_count == 0 || !instance->sinks[0].sync)
+        return;
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &now);
+    if(__mylogger_elapsed_ms(&instance->sync_time, &now) < instance->sync_interval_ms)
+        return;
+    instance->sync_time = now;
+
+    MyLogger_sink_S* sink = &instance->sinks[0];
+    __mylogger_sink_flush(sink, __mylogger_get_thread_stats(instance));
+    if(sink->uring != NULL)
+        __mylogger_uring_sync(sink->uring);
+    else
+        fdatasync(sink->fd);
+}
+
+#ifndef SYS_io_uring_setup
+#define SYS_io_uring_setup 425  // same number on every architecture, missing in old libc headers
+#define SYS_io_uring_enter 426
+#endif
+/**
+ * Sets up io_uring for the log file. Requests are submitted by io_uring_enter without liburing.
+ *
+ * @param[in] fd - descriptor of the log file
+ * @param[in] buffer_size - size of the batch buffers, equal to the batch of the sink
+ * @return ring or NULL when io_uring is not available.
+ * */
+static MyLogger_uring_S* __mylogger_uring_open(int fd, size_t buffer_size)
+{
+    MyLogger_uring_S* uring = calloc(1, sizeof(*uring));
+    if(uring == NULL)
+        return NULL;
+    uring->file_fd = fd;
+    uring->buffer_size = buffer_size;
+    uring->sq_ring = MAP_FAILED;
+    uring->sqes = MAP_FAILED;
+    // forked children write at offsets reserved from the same counter
+    uring->offset = mmap(NULL, sizeof(*uring->offset), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+
+    // descriptor without O_APPEND, writes at offsets would be appended in completion order otherwise
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/self/fd/%d", fd);
+    const int flags = fcntl(fd, F_GETFL);
+    uring->append = flags >= 0 && (flags & O_APPEND);
+    uring->fd = open(path, O_WRONLY | O_CLOEXEC);
+    struct stat st;
+    const off_t position = uring->append ? (fstat(fd, &st) == 0 ? st.st_size : -1) : lseek(fd, 0, SEEK_CUR);
+    if(uring->offset != MAP_FAILED)
+        atomic_init(uring->offset, (uint64_t)position);
+
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    uring->ring_fd = uring->fd >= 0 && flags >= 0 && position >= 0 && uring->offset != MAP_FAILED ?
+                     (int)syscall(SYS_io_uring_setup, MYLOGGER_URING_ENTRIES, &params) : -1;
+    // IORING_OP_WRITE needs Linux 5.6, every such kernel maps both rings at once
+    if(uring->ring_fd >= 0 && (params.features & IORING_FEAT_SINGLE_MMAP))
+    {
+        const size_t sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        const size_t cq_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+        uring->sq_ring_size = sq_size > cq_size ? sq_size : cq_size;
+        uring->sq_ring = mmap(NULL, uring->sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED, uring->ring_fd, IORING_OFF_SQ_RING);
+        uring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+        uring->sqes = mmap(NULL, uring->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED, uring->ring_fd, IORING_OFF_SQES);
+    }
+
+    bool ready = uring->sq_ring != MAP_FAILED && uring->sqes != MAP_FAILED;
+    for(size_t i = 0; ready && i < MYLOGGER_URING_DEPTH; i++)
+    {
+        uring->slots[i].buffer = malloc(buffer_size);
+        ready = uring->slots[i].buffer != NULL;
+    }
+    if(!ready)
+    {
+        uring->in_flight = 0;
+        __mylogger_uring_close(uring);
+        return NULL;
+    }
+
+    char* sq = uring->sq_ring;
+    uring->sq_tail = (_Atomic(unsigned)*)(void*)&sq[params.sq_off.tail];
+    uring->sq_array = (unsigned*)(void*)&sq[params.sq_off.array];
+    uring->sq_mask = *(unsigned*)(void*)&sq[params.sq_off.ring_mask];
+    uring->cq_head = (_Atomic(unsigned)*)(void*)&sq[params.cq_off.head];
+    uring->cq_tail = (_Atomic(unsigned)*)(void*)&sq[params.cq_off.tail];
+    uring->cq_mask = *(unsigned*)(void*)&sq[params.cq_off.ring_mask];
+    uring->cqes = (struct io_uring_cqe*)(void*)&sq[params.cq_off.cqes];
+    return uring;
+}
+
+/**
+ * Waits for every request, moves position of the sink descriptor behind written data and frees the ring.
+ *
+ * @param[in] uring - ring of the log file
+ * */
+static void __mylogger_uring_close(MyLogger_uring_S* uring)
+{
+    // ring failed to start when there is no completion queue
+    if(uring->cqes != NULL)
+    {
+        __mylogger_uring_wait(uring);
+        if(!uring->append)
+            lseek(uring->file_fd, (off_t)atomic_load_explicit(uring->offset, memory_order_relaxed), SEEK_SET);
+    }
+
+    for(size_t i = 0; i < MYLOGGER_URING_DEPTH; i++)
+        free(uring->slots[i].buffer);
+    if(uring->sqes != MAP_FAILED)
+        munmap(uring->sqes, uring->sqes_size);
+    if(uring->sq_ring != MAP_FAILED)
+        munmap(uring->sq_ring, uring->sq_ring_size);
+    if(uring->ring_fd >= 0)
+        close(uring->ring_fd);
+    if(uring->fd >= 0)
+        close(uring->fd);
+    if(uring->offset != MAP_FAILED)
+        munmap(uring->offset, sizeof(*uring->offset));
+    free(uring);
+}
+
+/**
+ * Drops the ring of the parent in a forked child. Requests of the parent complete in the parent, the child
+ * writes every batch with pwrite into space reserved with the shared offset.
+ *
+ * @param[in,out] uring - ring of the log file
+ * */
+static void __mylogger_uring_detach(MyLogger_uring_S* uring)
+{
+    if(uring->sqes != MAP_FAILED)
+        munmap(uring->sqes, uring->sqes_size);
+    if(uring->sq_ring != MAP_FAILED)
+        munmap(uring->sq_ring, uring->sq_ring_size);
+    close(uring->ring_fd);
+    uring->ring_fd = -1;
+    uring->sq_ring = MAP_FAILED;
+    uring->sqes = MAP_FAILED;
+    uring->cqes = NULL;
+    uring->in_flight = 0;
+    uring->sync_pending = false;
+    for(size_t i = 0; i < MYLOGGER_URING_DEPTH; i++)
+        uring->slots[i].busy = false;
+}
+
+/**
+ * Adds request to the submission queue and submits it.
+ *
+ * @param[in] uring - ring of the log file
+ * @param[in] sqe - request
+ * @return false when the request could not be submitted.
+ * */
+static bool __mylogger_uring_push(MyLogger_uring_S* uring, const struct io_uring_sqe* sqe)
+{
+    if(uring->ring_fd < 0)
+        return false;
+    // kernel consumes entries during io_uring_enter, queue is empty between calls
+    const unsigned tail = atomic_load_explicit(uring->sq_tail, memory_order_relaxed);
+    const unsigned idx = tail & uring->sq_mask;
+    uring->sqes[idx] = *sqe;
+    uring->sq_array[idx] = idx;
+    atomic_store_explicit(uring->sq_tail, tail + 1, memory_order_release);
+
+    while(syscall(SYS_io_uring_enter, uring->ring_fd, 1, 0, 0, NULL, 0) < 0)
+    {
+        if(errno == EINTR)
+            continue;
+        if((errno == EAGAIN || errno == EBUSY) && uring->in_flight > 0)
+        {
+            __mylogger_uring_reap(uring, true);
+            continue;
+        }
+        atomic_store_explicit(uring->sq_tail, tail, memory_order_relaxed);
+        return false;
+    }
+    uring->in_flight++;
+    return true;
+}
+
+/**
+ * Submits the part of the batch that has not been written yet. Batch is written directly when
+ * the request cannot be submitted.
+ *
+ * @param[in] uring - ring of the log file
+ * @param[in,out] slot - busy batch
+ * */
+static void __mylogger_uring_submit(MyLogger_uring_S* uring, MyLogger_uring_slot_S* slot)
+{
+    struct io_uring_sqe sqe;
+    memset(&sqe, 0, sizeof(sqe));
+    sqe.opcode = IORING_OP_WRITE;
+    sqe.fd = uring->fd;
+    sqe.off = slot->offset + slot->done;
+    sqe.addr = (uint64_t)(uintptr_t)&slot->buffer[slot->done];
+    sqe.len = (uint32_t)(slot->len - slot->done);
+    sqe.user_data = (uint64_t)(slot - uring->slots);
+    if(!__mylogger_uring_push(uring, &sqe))
+        __mylogger_uring_pwrite(uring, slot);
+}
+
+/**
+ * Writes the part of the batch that has not been written yet directly and frees the batch.
+ *
+ * @param[in] uring - ring of the log file
+ * @param[in,out] slot - busy batch
+ * */
+static void __mylogger_uring_pwrite(MyLogger_uring_S* uring, MyLogger_uring_slot_S* slot)
+{
+    while(slot->done < slot->len)
+    {
+        const ssize_t written = pwrite(uring->fd, &slot->buffer[slot->done], slot->len - slot->done, (off_t)(slot->offset + slot->done));
+        if(written < 0 && errno == EINTR)
+            continue;
+        if(written <= 0)
+            break;      // nowhere to report, message is lost like with fprintf
+        slot->done += (size_t)written;
+    }
+    slot->busy = false;
+}
+
+/**
+ * Handles completed requests. Short and interrupted writes are submitted again, the rest of a failed
+ * request is written directly.
+ *
+ * @param[in] uring - ring of the log file
+ * @param[in] wait - wait for at least one completion
+ * */
+static void __mylogger_uring_reap(MyLogger_uring_S* uring, bool wait)
+{
+    if(uring->ring_fd < 0)
+        return;
+    if(wait)
+    {
+        while(syscall(SYS_io_uring_enter, uring->ring_fd, 0, 1, IORING_ENTER_GETEVENTS, NULL, 0) < 0 && errno == EINTR)
+            ;
+    }
+
+    // resubmission can reap recursively, so each completion is consumed before it is handled
+    while(true)
+    {
+        const unsigned head = atomic_load_explicit(uring->cq_head, memory_order_relaxed);
+        if(head == atomic_load_explicit(uring->cq_tail, memory_order_acquire))
+            break;
+        const struct io_uring_cqe cqe = uring->cqes[head & uring->cq_mask];
+        atomic_store_explicit(uring->cq_head, head + 1, memory_order_release);
+        uring->in_flight--;
+        if(cqe.user_data == MYLOGGER_URING_SYNC)
+        {
+            uring->sync_pending = false;
+            continue;
+        }
+
+        MyLogger_uring_slot_S* slot = &uring->slots[cqe.user_data];
+        if(cqe.res > 0)
+            slot->done += (size_t)cqe.res;
+        if((cqe.res > 0 && slot->done < slot->len) || cqe.res == -EINTR || cqe.res == -EAGAIN)
+            __mylogger_uring_submit(uring, slot);
+        else if(slot->done < slot->len)
+            __mylogger_uring_pwrite(uring, slot);
+        else
+            slot->busy = false;
+    }
+}
+
+/**
+ * Waits until every request is completed.
+ *
+ * @param[in] uring - ring of the log file
+ * */
+static void __mylogger_uring_wait(MyLogger_uring_S* uring)
+{
+    while(uring->in_flight > 0)
+        __mylogger_uring_reap(uring, true);
+}
+
+/**
+ * Waits for requests submitted by a thread other than the writer thread, which may exit
+ * before they are completed.
+ *
+ * @param[in] uring - ring of the log file
+ * */
+static void __mylogger_uring_settle(MyLogger_uring_S* uring)
+{
+    if(!uring->owned || !pthread_equal(uring->owner, pthread_self()))
+        __mylogger_uring_wait(uring);
+}
+
+/**
+ * Returns free batch, waits for a completion when every batch is in flight.
+ *
+ * @param[in] uring - ring of the log file
+ * @return free batch.
+ * */
+static MyLogger_uring_slot_S* __mylogger_uring_slot(MyLogger_uring_S* uring)
+{
+    __mylogger_uring_reap(uring, false);
+    while(true)
+    {
+        for(size_t i = 0; i < MYLOGGER_URING_DEPTH; i++)
+        {
+            if(!uring->slots[i].busy)
+                return &uring->slots[i];
+        }
+        __mylogger_uring_reap(uring, true);
+    }
+}
+
+/**
+ * Copies the buffers into free batches and submits them.
+ *
+ * @param[in] uring - ring of the log file
+ * @param[in] iov - buffers
+ * @param[in] iovcnt - number of buffers
+ * */
+static void __mylogger_uring_writev(MyLogger_uring_S* uring, const struct iovec* iov, int iovcnt)
+{
+    MyLogger_uring_slot_S* slot = NULL;
+    for(int i = 0; i < iovcnt; i++)
+    {
+        size_t copied = 0;
+        while(copied < iov[i].iov_len)
+        {
+            if(slot == NULL)
+            {
+                slot = __mylogger_uring_slot(uring);
+                slot->len = 0;
+            }
+            const size_t left = iov[i].iov_len - copied;
+            const size_t chunk = left < uring->buffer_size - slot->len ? left : uring->buffer_size - slot->len;
+            memcpy(&slot->buffer[slot->len], (const char*)iov[i].iov_base + copied, chunk);
+            slot->len += chunk;
+            copied += chunk;
+            if(slot->len == uring->buffer_size)
+            {
+                slot->offset = atomic_fetch_add_explicit(uring->offset, slot->len, memory_order_relaxed);
+                slot->done = 0;
+                slot->busy = true;
+                __mylogger_uring_submit(uring, slot);
+                slot = NULL;
+            }
+        }
+    }
+    if(slot != NULL && slot->len > 0)
+    {
+        slot->offset = atomic_fetch_add_explicit(uring->offset, slot->len, memory_order_relaxed);
+        slot->done = 0;
+        slot->busy = true;
+        __mylogger_uring_submit(uring, slot);
+    }
+    __mylogger_uring_settle(uring);
+}
+
+/**
+ * Hands batch of the sink over to io_uring without copying, sink gets a free buffer of the same size.
+ *
+ * @param[in] uring - ring of the log file
+ * @param[in,out] sink - log file sink with non-empty batch
+ * */
+static void __mylogger_uring_flush(MyLogger_uring_S* uring, MyLogger_sink_S* sink)
+{
+    MyLogger_uring_slot_S* slot = __mylogger_uring_slot(uring);
+    char* free_buffer = slot->buffer;
+    slot->buffer = sink->batch;
+    slot->len = sink->batch_len;
+    slot->offset = atomic_fetch_add_explicit(uring->offset, slot->len, memory_order_relaxed);
+    slot->done = 0;
+    slot->busy = true;
+    sink->batch = free_buffer;
+    sink->batch_len = 0;
+    __mylogger_uring_submit(uring, slot);
+    __mylogger_uring_settle(uring);
+}
+
+/**
+ * Submits fdatasync that starts after every previous write. Nothing is submitted while previous sync runs.
+ *
+ * @param[in] uring - ring of the log file
+ * */
+static void __mylogger_uring_sync(MyLogger_uring_S* uring)
+{
+    __mylogger_uring_reap(uring, false);
+    if(uring->sync_pending)
+        return;
+
+    struct io_uring_sqe sqe;
+    memset(&sqe, 0, sizeof(sqe));
+    sqe.opcode = IORING_OP_FSYNC;
+    sqe.flags = IOSQE_IO_DRAIN;
+    sqe.fd = uring->fd;
+    sqe.fsync_flags = IORING_FSYNC_DATASYNC;
+    sqe.user_data = MYLOGGER_URING_SYNC;
+    uring->sync_pending = __mylogger_uring_push(uring, &sqe);
+    if(!uring->sync_pending)
+        fdatasync(uring->fd);
+    __mylogger_uring_settle(uring);
+}
+
+/**
+ * Writes the buffers into space reserved after everything submitted so far. Used by the crash handler,
+ * async-signal-safe.
+ *
+ * @param[in] uring - ring of the log file
+ * @param[in] iov - buffers
+ * @param[in] iovcnt - number of buffers
+ * */
+static void __mylogger_uring_pwritev(MyLogger_uring_S* uring, const struct iovec* iov, int iovcnt)
+{
+    size_t total = 0;
+    for(int i = 0; i < iovcnt; i++)
+        total += iov[i].iov_len;
+    const uint64_t offset = atomic_fetch_add_explicit(uring->offset, total, memory_order_relaxed);
+    pwritev(uring->fd, iov, iovcnt, (off_t)offset);
+}
+
+#define MYLOGGER_ROTATION_RETRY_S 1
+#define MYLOGGER_ROTATION_NICE 19
+/**
+ * Prepares rotation of the created log file and starts the rotation thread.
+ *
+ * @param[in,out] instance - logger instance with opened log file
+ * @param[in] config - rotation options
+ * @return MYLOGGER_INIT_SUCCESS on success, MYLOGGER_INIT_OTHER_ERROR otherwise.
+ * */
+static mylogger_init_error_code_t __mylogger_rotation_start(MyLogger_instance_S* instance, const mylogger_rotation_t* config)
+{
+    MyLogger_rotation_S* rotation = &instance->rotation;
+
+    switch(config->compression)
+    {
+        case MYLOGGER_COMPRESSION_NONE:
+            break;
+#ifdef MYLOGGER_WITH_ZLIB
+        case MYLOGGER_COMPRESSION_GZIP:
+            break;
+#endif
+#ifdef MYLOGGER_WITH_ZSTD
+        case MYLOGGER_COMPRESSION_ZSTD:
+            break;
+#endif
+        default:
+            return MYLOGGER_INIT_OTHER_ERROR;
+    }
+
+    struct stat st;
+    if(fstat(fileno(instance->file_fd), &st) != 0)
+        return MYLOGGER_INIT_OTHER_ERROR;
+
+    (*rotation) = (MyLogger_rotation_S) {
+        .enabled = true,
+        .config = *config,
+        .file_size = (size_t)st.st_size,
+        .mutex = PTHREAD_MUTEX_INITIALIZER,
+        .next_fd = -1,
+        .next_seq = 1
+    };
+    atomic_init(&rotation->due, false);
+    // "log_<date>_<time>.txt" without extension
+    const size_t len = strlen(instance->file_name) - strlen(".txt");
+    memcpy(rotation->base, instance->file_name, len);
+    rotation->base[len] = '\0';
+
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&rotation->cond, &attr);
+    pthread_condattr_destroy(&attr);
+
+    if(pthread_create(&rotation->thread, NULL, __mylogger_rotation_thread, rotation) != 0)
+    {
+        pthread_cond_destroy(&rotation->cond);
+        pthread_mutex_destroy(&rotation->mutex);
+        rotation->enabled = false;
+        return MYLOGGER_INIT_OTHER_ERROR;
+    }
+    return MYLOGGER_INIT_SUCCESS;
+}
+
+/**
+ * Stops the rotation thread after it finished every rotated file. Closes active file unless it is
+ * the first log file, removes file opened ahead of time. No thread can write at this point.
+ *
+ * @param[in,out] instance - logger instance
+ * */
+static void __mylogger_rotation_stop(MyLogger_instance_S* instance)
+{
+    MyLogger_rotation_S* rotation = &instance->rotation;
+    if(!rotation->enabled)
+        return;
+
+    if(!rotation->forked)
+    {
+        pthread_mutex_lock(&rotation->mutex);
+        rotation->stop = true;
+        pthread_cond_signal(&rotation->cond);
+        pthread_mutex_unlock(&rotation->mutex);
+        pthread_join(rotation->thread, NULL);
+        // forked child keeps the condition, it still counts the rotation thread of the parent as a waiter
+        pthread_cond_destroy(&rotation->cond);
+    }
+
+    if(rotation->next_fd >= 0)
+    {
+        char name[MYLOGGER_FILE_NAME_MAX_SIZE + 16];
+        __mylogger_rotation_file_name(rotation, rotation->next_seq, name, sizeof(name));
+        close(rotation->next_fd);
+        unlink(name);
+    }
+    if(rotation->active_owned)
+        close(instance->sinks[0].fd);
+
+    pthread_mutex_destroy(&rotation->mutex);
+    rotation->enabled = false;
+}
+
+/**
+ * Creates name of the log file with the given sequence number.
+ *
+ * @param[in] rotation - rotation of the log file
+ * @param[in] seq - sequence number, 0 is the first file
+ * @param[out] name - file name
+ * @param[in] size - size of name
+ * */
+static void __mylogger_rotation_file_name(const MyLogger_rotation_S* rotation, uint32_t seq, char* name, size_t size)
+{
+    if(seq == 0)
+        snprintf(name, size, "%s.txt", rotation->base);
+    else
+        snprintf(name, size, "%s_%" PRIu32 ".txt", rotation->base, seq);
+}
+
+/**
+ * Switches the log sink to the file opened ahead of time and passes the old file to the rotation thread.
+ * Keeps writing to the old file when next file is not ready yet. Called under instance mutex.
+ *
+ * @param[in,out] instance - logger instance
+ * @param[in,out] sink - log file sink
+ * */
+static void __mylogger_rotation_swap(MyLogger_instance_S* instance, MyLogger_sink_S* sink)
+{
+    MyLogger_rotation_S* rotation = &instance->rotation;
+
+    pthread_mutex_lock(&rotation->mutex);
+    if(rotation->next_fd >= 0 && rotation->rotated_count < MYLOGGER_ROTATION_QUEUE_SIZE)
+    {
+        __mylogger_sink_flush(sink, NULL);
+        MyLogger_rotated_file_S* rotated = &rotation->rotated[rotation->rotated_count++];
+        (*rotated) = (MyLogger_rotated_file_S){.fd = sink->fd, .seq = rotation->active_seq};
+        if(!rotation->active_owned)
+        {
+            rotated->file = instance->file_fd;
+            instance->file_fd = NULL;
+        }
+
+        sink->fd = rotation->next_fd;
+        rotation->active_seq = rotation->next_seq++;
+        rotation->active_owned = true;
+        rotation->next_fd = -1;
+        rotation->file_size = 0;
+        atomic_store_explicit(&rotation->due, false, memory_order_relaxed);
+        pthread_cond_signal(&rotation->cond);
+    }
+    pthread_mutex_unlock(&rotation->mutex);
+}
+
+#ifdef MYLOGGER_WITH_COMPRESSION
+#define MYLOGGER_COMPRESS_BUFFER_SIZE (1 << 16)
+/**
+ * Compresses the file into name.gz or name.zst and removes it.
+ *
+ * @param[in] name - file to compress
+ * @param[in] compression - compression method
+ * @return true on success, false otherwise (original file is kept).
+ * */
+static bool __mylogger_compress_file(const char* name, mylogger_compression_t compression)
+{
+    char out_name[MYLOGGER_FILE_NAME_MAX_SIZE + 32];
+    snprintf(out_name, sizeof(out_name), "%s%s", name, compression == MYLOGGER_COMPRESSION_GZIP ? ".gz" : ".zst");
+
+    FILE* in = fopen(name, "rb");
+    if(in == NULL)
+        return false;
+    char* buffer = malloc(MYLOGGER_COMPRESS_BUFFER_SIZE);
+    if(buffer == NULL)
+    {
+        fclose(in);
+        return false;
+    }
+
+    bool success = false;
+    size_t len;
+#ifdef MYLOGGER_WITH_ZLIB
+    if(compression == MYLOGGER_COMPRESSION_GZIP)
+    {
+        gzFile out = gzopen(out_name, "wb");
+        if(out != NULL)
+        {
+            success = true;
+            while(success && (len = fread(buffer, 1, MYLOGGER_COMPRESS_BUFFER_SIZE, in)) > 0)
+                success = gzwrite(out, buffer, (unsigned)len) == (int)len;
+            success = gzclose(out) == Z_OK && success && !ferror(in);
+        }
+    }
+#endif
+#ifdef MYLOGGER_WITH_ZSTD
+    if(compression == MYLOGGER_COMPRESSION_ZSTD)
+    {
+        const size_t out_size = ZSTD_CStreamOutSize();
+        char* out_buffer = malloc(out_size);
+        ZSTD_CCtx* ctx = ZSTD_createCCtx();
+        FILE* out = fopen(out_name, "wb");
+        if(out_buffer != NULL && ctx != NULL && out != NULL)
+        {
+            success = true;
+            bool last = false;
+            while(success && !last)
+            {
+                len = fread(buffer, 1, MYLOGGER_COMPRESS_BUFFER_SIZE, in);
+                last = len < MYLOGGER_COMPRESS_BUFFER_SIZE;
+                ZSTD_inBuffer input = {buffer, len, 0};
+                size_t remaining;
+                do
+                {
+                    ZSTD_outBuffer output = {out_buffer, out_size, 0};
+                    remaining = ZSTD_compressStream2(ctx, &output, &input, last ? ZSTD_e_end : ZSTD_e_continue);
+                    success = !ZSTD_isError(remaining) && fwrite(out_buffer, 1, output.pos, out) == output.pos;
+                } while(success && (last ? remaining != 0 : input.pos != input.size));
+            }
+            success = success && !ferror(in);
+        }
+        if(out != NULL && fclose(out) != 0)
+            success = false;
+        ZSTD_freeCCtx(ctx);
+        free(out_buffer);
+    }
+#endif
+    (void)len;
+    free(buffer);
+    fclose(in);
+
+    if(success)
+        unlink(name);
+    else
+        unlink(out_name);
+    return success;
+}
+#endif
+
+/**
+ * Closes and compresses rotated file, removes files above retention limit. Called by the rotation thread.
+ *
+ * @param[in] rotation - rotation of the log file
+ * @param[in] rotated - rotated file
+ * */
+static void __mylogger_rotation_finish(MyLogger_rotation_S* rotation, const MyLogger_rotated_file_S* rotated)
+{
+    char name[MYLOGGER_FILE_NAME_MAX_SIZE + 16];
+    char compressed[MYLOGGER_FILE_NAME_MAX_SIZE + 32];
+
+    if(rotated->file != NULL)
+        fclose(rotated->file);
+    else
+        close(rotated->fd);
+
+#ifdef MYLOGGER_WITH_COMPRESSION
+    if(rotation->config.compression != MYLOGGER_COMPRESSION_NONE)
+    {
+        __mylogger_rotation_file_name(rotation, rotated->seq, name, sizeof(name));
+        __mylogger_compress_file(name, rotation->config.compression);
+    }
+#endif
+
+    const uint32_t keep = rotation->config.keep;
+    if(keep > 0 && rotated->seq >= keep)
+    {
+        // file could stay uncompressed when compression failed
+        __mylogger_rotation_file_name(rotation, rotated->seq - keep, name, sizeof(name));
+        unlink(name);
+        snprintf(compressed, sizeof(compressed), "%s.gz", name);
+        unlink(compressed);
+        snprintf(compressed, sizeof(compressed), "%s.zst", name);
+        unlink(compressed);
+    }
+}
+
+/**
+ * Rotation thread main loop. Opens next file ahead of time, finishes rotated files and signals
+ * elapsed rotation interval. Runs with the lowest priority (nice 19).
+ *
+ * @param[in] arg - rotation of the log file
+ * */
+static void* __mylogger_rotation_thread(void* arg)
+{
+    MyLogger_rotation_S* rotation = arg;
+    // Linux applies PRIO_PROCESS with a thread id to that thread only
+    setpriority(PRIO_PROCESS, (id_t)syscall(SYS_gettid), MYLOGGER_ROTATION_NICE);
+
+    struct timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    deadline.tv_sec += rotation->config.interval_s;
+
+    pthread_mutex_lock(&rotation->mutex);
+    while(true)
+    {
+        bool open_failed = false;
+        if(rotation->next_fd < 0 && !rotation->stop)
+        {
+            char name[MYLOGGER_FILE_NAME_MAX_SIZE + 16];
+            __mylogger_rotation_file_name(rotation, rotation->next_seq, name, sizeof(name));
+            pthread_mutex_unlock(&rotation->mutex);
+            const int fd = open(name, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+            pthread_mutex_lock(&rotation->mutex);
+            rotation->next_fd = fd;
+            open_failed = fd < 0;
+        }
+
+        if(rotation->rotated_count > 0)
+        {
+            const MyLogger_rotated_file_S rotated = rotation->rotated[0];
+            rotation->rotated_count--;
+            memmove(&rotation->rotated[0], &rotation->rotated[1], rotation->rotated_count * sizeof(rotated));
+
+            // interval starts again with the new file
+            clock_gettime(CLOCK_MONOTONIC, &deadline);
+            deadline.tv_sec += rotation->config.interval_s;
+
+            pthread_mutex_unlock(&rotation->mutex);
+            __mylogger_rotation_finish(rotation, &rotated);
+            pthread_mutex_lock(&rotation->mutex);
+            continue;
+        }
+        if(rotation->stop)
+            break;
+
+        if(open_failed)
+        {
+            // e.g. too many open files, try again later
+            struct timespec retry;
+            clock_gettime(CLOCK_MONOTONIC, &retry);
+            retry.tv_sec += MYLOGGER_ROTATION_RETRY_S;
+            pthread_cond_timedwait(&rotation->cond, &rotation->mutex, &retry);
+        }
+        else if(rotation->config.interval_s > 0)
+        {
+            if(pthread_cond_timedwait(&rotation->cond, &rotation->mutex, &deadline) == ETIMEDOUT)
+            {
+                atomic_store_explicit(&rotation->due, true, memory_order_relaxed);
+                deadline.tv_sec += rotation->config.interval_s;
+            }
+        }
+        else
+            pthread_cond_wait(&rotation->cond, &rotation->mutex);
+    }
+    pthread_mutex_unlock(&rotation->mutex);
+    return NULL;
+}
+
+/**
+ * Returns milliseconds elapsed since the given time.
+ * */
+static uint64_t __mylogger_elapsed_ms(const struct timespec* since, const struct timespec* now)
+{
+    return (uint64_t)(now->tv_sec - since->tv_sec) * 1000U + (uint64_t)(now->tv_nsec / 1000000) - (uint64_t)(since->tv_nsec / 1000000);
+}
+
+/**
+ * Writes batches older than flush interval. Used by the writer thread when there is nothing else to do.
+ *
+ * @param[in] instance - logger instance
+ * */
+static void __mylogger_sinks_flush_expired(MyLogger_instance_S* instance)
+{
+    if(instance->flush_interval_ms == 0)
+        return;
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &now);
+    for(size_t i = 0; i < instance->sinks_count; i++)
+    {
+        MyLogger_sink_S* sink = &instance->sinks[i];
+        if(sink->batch_len > 0 && __mylogger_elapsed_ms(&sink->batch_time, &now) >= instance->flush_interval_ms)
+            __mylogger_sink_flush(sink, __mylogger_get_thread_stats(instance));
+    }
+}
+
+/**
+ * Starts the flusher thread of synchronous instance with flush interval and batched sinks
+ * or with MYLOGGER_FEATURE_COLLAPSE. Other instances do not need it.
+ *
+ * @param[in,out] instance - logger instance with opened sinks
+ * @return MYLOGGER_INIT_SUCCESS on success, MYLOGGER_INIT_OTHER_ERROR otherwise.
+ * */
+static mylogger_init_error_code_t __mylogger_flusher_start(MyLogger_instance_S* instance)
+{
+    bool batched = false;
+    for(size_t i = 0; i < instance->sinks_count; i++)
+        batched |= instance->sinks[i].batch != NULL;
+    if(!(instance->flush_interval_ms > 0 && batched) && !instance->features.feat_collapse)
+        return MYLOGGER_INIT_SUCCESS;
+
+    MyLogger_flusher_S* flusher = &instance->flusher;
+    (*flusher) = (MyLogger_flusher_S) {
+        .enabled = true,
+        .mutex = PTHREAD_MUTEX_INITIALIZER
+    };
+
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&flusher->cond, &attr);
+    pthread_condattr_destroy(&attr);
+
+    if(pthread_create(&flusher->thread, NULL, __mylogger_flusher_thread, instance) != 0)
+    {
+        pthread_cond_destroy(&flusher->cond);
+        pthread_mutex_destroy(&flusher->mutex);
+        flusher->enabled = false;
+        return MYLOGGER_INIT_OTHER_ERROR;
+    }
+    return MYLOGGER_INIT_SUCCESS;
+}
+
+/**
+ * Stops the flusher thread. Batches and pending repeats are written by the caller.
+ *
+ * @param[in,out] instance - logger instance
+ * */
+static void __mylogger_flusher_stop(MyLogger_instance_S* instance)
+{
+    MyLogger_flusher_S* flusher = &instance->flusher;
+    if(!flusher->enabled)
+        return;
+
+    if(!flusher->forked)
+    {
+        pthread_mutex_lock(&flusher->mutex);
+        flusher->stop = true;
+        pthread_cond_signal(&flusher->cond);
+        pthread_mutex_unlock(&flusher->mutex);
+        pthread_join(flusher->thread, NULL);
+        // copy in a forked child still counts the waiting thread of the parent, destroy would block
+        pthread_cond_destroy(&flusher->cond);
+    }
+    pthread_mutex_destroy(&flusher->mutex);
+    flusher->enabled = false;
+}
+
+/**
+ * Flusher thread main loop. Every half of the interval writes batches older than flush interval
+ * and pending repeats, so that messages of an idle program do not wait for the next log call.
+ *
+ * @param[in] arg - logger instance
+ * */
+static void* __mylogger_flusher_thread(void* arg)
+{
+    MyLogger_instance_S* instance = arg;
+    MyLogger_flusher_S* flusher = &instance->flusher;
+    const uint32_t interval_ms = instance->features.feat_collapse ? instance->repeats_interval_ms : instance->flush_interval_ms;
+    const uint64_t period_ns = (uint64_t)interval_ms * 1000000U / 2 + 1;
+
+    struct timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    pthread_mutex_lock(&flusher->mutex);
+    while(!flusher->stop)
+    {
+        const uint64_t nsec = (uint64_t)deadline.tv_nsec + period_ns;
+        deadline.tv_sec += (time_t)(nsec / 1000000000U);
+        deadline.tv_nsec = (long)(nsec % 1000000000U);
+        if(pthread_cond_timedwait(&flusher->cond, &flusher->mutex, &deadline) != ETIMEDOUT)
+            continue;
+
+        // instance mutex is never taken under the flusher mutex, fork handlers take them the other way
+        pthread_mutex_unlock(&flusher->mutex);
+        __mylogger_repeats_expired(instance);
+        pthread_mutex_lock(&instance->mutex);
+        __mylogger_sinks_flush_expired(instance);
+        pthread_mutex_unlock(&instance->mutex);
+        pthread_mutex_lock(&flusher->mutex);
+    }
+    pthread_mutex_unlock(&flusher->mutex);
+    return NULL;
+}
+
+/**
+ * Passes formatted messages to every sink according to the flush policy. Memory mapped file is written separately.
+ * Has to be called under instance mutex.
+ *
+ * @param[in] instance - logger instance
+ * @param[in] buffer - formatted messages
+ * @param[in] len - number of bytes to write
+ * @param[in] level - highest level of the messages
+ * */
+static void __mylogger_write(MyLogger_instance_S* instance,
+                             const char* buffer,
+                             const size_t len,
+                             mylogger_level_t level)
+{
+    MyLogger_stats_S* stats = __mylogger_get_thread_stats(instance);
+    struct timespec now = {0};
+    if(instance->flush_interval_ms > 0)
+        clock_gettime(CLOCK_MONOTONIC_COARSE, &now);
+
+    for(size_t i = 0; i < instance->sinks_count; i++)
+    {
+        MyLogger_sink_S* sink = &instance->sinks[i];
+        if(sink->rotate)
+        {
+            MyLogger_rotation_S* rotation = &instance->rotation;
+            // messages are never split, message bigger than max_size gets its own file
+            if(rotation->file_size > 0 &&
+               ((rotation->config.max_size > 0 && rotation->file_size + len > rotation->config.max_size) ||
+                atomic_load_explicit(&rotation->due, memory_order_relaxed)))
+                __mylogger_rotation_swap(instance, sink);
+            rotation->file_size += len;
+        }
+        if(sink->batch == NULL)
+        {
+            struct iovec iov = {.iov_base = (void*)buffer, .iov_len = len};
+            __mylogger_sink_writev(sink, &iov, 1, stats);
+            continue;
+        }
+
+        // batch is handed over to io_uring without copying, message starts the next one
+        if(sink->uring != NULL && sink->batch_len + len > sink->batch_size)
+            __mylogger_sink_flush(sink, stats);
+        if(sink->batch_len + len > sink->batch_size)
+        {
+            // batch and message with one system call
+            struct iovec iov[2] = {
+                {.iov_base = sink->batch, .iov_len = sink->batch_len},
+                {.iov_base = (void*)buffer, .iov_len = len}
+            };
+            __mylogger_sink_writev(sink, iov, 2, stats);
+            sink->batch_len = 0;
+            continue;
+        }
+
+        if(sink->batch_len == 0)
+            sink->batch_time = now;
+        memcpy(&sink->batch[sink->batch_len], buffer, len);
+        sink->batch_len += len;
+
+        if(level >= instance->flush_level ||
+           (instance->flush_interval_ms > 0 && __mylogger_elapsed_ms(&sink->batch_time, &now) >= instance->flush_interval_ms))
+            __mylogger_sink_flush(sink, stats);
+    }
+}
+
+/**
+ * Adds formatted message to the open batch of the calling thread. Batch is written when it is full,
+ * when it cannot grow and for FATAL message.
+ *
+ * @param[in] instance - logger instance of the batch
+ * @param[in,out] thread - state of the calling thread
+ * @param[in] message - formatted message
+ * @param[in] len - message length
+ * @param[in] level - level of the message
+ * */
+static void __mylogger_batch_append(MyLogger_instance_S* instance,
+                                    MyLogger_thread_S* thread,
+                                    const char* message,
+                                    const size_t len,
+                                    mylogger_level_t level)
+{
+    thread->batch_count++;
+    if(thread->batch_len + len > MYLOGGER_BATCH_MAX_SIZE)
+        __mylogger_batch_write(instance, thread, NULL, 0, MYLOGGER_LEVEL_DEBUG);
+    if(thread->batch_len + len > thread->batch_size)
+    {
+        size_t size = thread->batch_size > 0 ? thread->batch_size : MYLOGGER_SINK_BATCH_SIZE;
+        while(size < thread->batch_len + len)
+            size *= 2;
+        char* batch = realloc(thread->batch, size);
+        if(batch == NULL)
+        {
+            // message is written together with the batched ones
+            __mylogger_batch_write(instance, thread, message, len, level);
+            return;
+        }
+        thread->batch = batch;
+        thread->batch_size = size;
+    }
+
+    memcpy(&thread->batch[thread->batch_len], message, len);
+    thread->batch_len += len;
+    if(level > thread->batch_level)
+        thread->batch_level = level;
+    // program is about to die, make sure FATAL message reaches the outputs
+    if(level == MYLOGGER_LEVEL_FATAL)
+        __mylogger_batch_write(instance, thread, NULL, 0, level);
+}
+
+/**
+ * Writes the open batch of the calling thread and the message after it with one lock acquisition
+ * and empties the batch. Batch stays open.
+ *
+ * @param[in] instance - logger instance of the batch
+ * @param[in,out] thread - state of the calling thread
+ * @param[in] message - formatted message written after the batch, NULL when none
+ * @param[in] len - message length
+ * @param[in] level - level of the message
+ * */
+static void __mylogger_batch_write(MyLogger_instance_S* instance,
+                                   MyLogger_thread_S* thread,
+                                   const char* message,
+                                   const size_t len,
+                                   mylogger_level_t level)
+{
+    if(thread->batch_len == 0 && message == NULL)
+        return;
+    if(level < thread->batch_level)
+        level = thread->batch_level;
+
+    if(instance->mmap.fd >= 0)
+    {
+        if(thread->batch_len > 0)
+            __mylogger_mmap_write(&instance->mmap, thread->batch, thread->batch_len);
+        if(message != NULL)
+            __mylogger_mmap_write(&instance->mmap, message, len);
+    }
+    if(instance->sinks_count > 0)
+    {
+        __mylogger_lock(instance, __mylogger_get_thread_stats(instance));
+        if(thread->batch_len > 0)
+            __mylogger_write(instance, thread->batch, thread->batch_len, level);
+        if(message != NULL)
+            __mylogger_write(instance, message, len, level);
+        pthread_mutex_unlock(&instance->mutex);
+    }
+    thread->batch_len = 0;
+    thread->batch_level = MYLOGGER_LEVEL_DEBUG;
+}
+
+/**
+ * Opens batch of the calling thread for the instance.
+ *
+ * @param[in] instance - logger instance
+ * @return false when the thread already has an open batch or the instance is asynchronous.
+ * */
+static bool __mylogger_batch_begin(MyLogger_instance_S* instance)
+{
+    MyLogger_thread_S* self = &g_mylogger_thread;
+    if(self->batch_logger != NULL || instance->features.feat_async)
+        return false;
+    self->batch_logger = instance;
+    self->batch_len = 0;
+    self->batch_count = 0;
+    self->batch_level = MYLOGGER_LEVEL_DEBUG;
+    return true;
+}
+
+/**
+ * Writes the open batch of the calling thread when it belongs to the instance that is being closed
+ * and closes the batch. Called under lifecycle mutex.
+ *
+ * @param[in] instance - logger instance
+ * */
+static void __mylogger_batch_close(MyLogger_instance_S* instance)
+{
+    MyLogger_thread_S* self = &g_mylogger_thread;
+    if(self->batch_logger != instance)
+        return;
+    __mylogger_batch_write(instance, self, NULL, 0, MYLOGGER_LEVEL_DEBUG);
+    self->batch_logger = NULL;
+}
+
+/**
+ * Prepares ring registry and starts the writer thread (MYLOGGER_FEATURE_ASYNC).
+ *
+ * @param[in] instance - logger instance
+ * @return MYLOGGER_INIT_SUCCESS on success, MYLOGGER_INIT_OTHER_ERROR otherwise.
+ * */
+static mylogger_init_error_code_t __mylogger_async_start(MyLogger_instance_S* instance)
+{
+    instance->writer_buffer = malloc(MYLOGGER_ASYNC_MESSAGE_MAX_SIZE);
+    instance->writer_record = malloc(MYLOGGER_ASYNC_MESSAGE_MAX_SIZE);
+    if(instance->writer_buffer == NULL || instance->writer_record == NULL)
+    {
+        free(instance->writer_buffer);
+        free(instance->writer_record);
+        return MYLOGGER_INIT_OTHER_ERROR;
+    }
+
+    if(pthread_key_create(&instance->ring_key, __mylogger_ring_abandon) != 0)
+    {
+        free(instance->writer_buffer);
+        free(instance->writer_record);
+        return MYLOGGER_INIT_OTHER_ERROR;
+    }
+
+    pthread_mutex_init(&instance->rings_mutex, NULL);
+    atomic_init(&instance->rings, NULL);
+    atomic_init(&instance->writer_stop, false);
+
+    if(pthread_create(&instance->writer, NULL, __mylogger_writer_thread, instance) != 0)
+    {
+        pthread_mutex_destroy(&instance->rings_mutex);
+        pthread_key_delete(instance->ring_key);
+        free(instance->writer_buffer);
+        free(instance->writer_record);
+        return MYLOGGER_INIT_OTHER_ERROR;
+    }
+
+    return MYLOGGER_INIT_SUCCESS;
+}
+
+/**
+ * Stops the writer thread after it drained every ring and frees all rings.
+ *
+ * @param[in] instance - logger instance
+ * */
+static void __mylogger_async_stop(MyLogger_instance_S* instance)
+{
+    atomic_store_explicit(&instance->writer_stop, true, memory_order_release);
+    pthread_join(instance->writer, NULL);
+
+    pthread_key_delete(instance->ring_key);
+
+    MyLogger_ring_S* ring = atomic_load_explicit(&instance->rings, memory_order_acquire);
+    while(ring != NULL)
+    {
+        MyLogger_ring_S* next = ring->next;
+        free(ring);
+        ring = next;
+    }
+
+    pthread_mutex_destroy(&instance->rings_mutex);
+    free(instance->writer_buffer);
+    free(instance->writer_record);
+}
+
+/**
+ * Thread exit handler. Marks the ring of exiting thread, writer frees it when it is empty.
+ *
+ * @param[in] ring - ring of the exiting thread
+ * */
+static void __mylogger_ring_abandon(void* ring)
+{
+    atomic_store_explicit(&((MyLogger_ring_S*)ring)->abandoned, true, memory_order_release);
+}
+
+/**
+ * Returns ring of the calling thread. Ring is created and registered on first use.
+ *
+ * @param[in] instance - logger instance
+ * @return ring of the calling thread or NULL when it could not be allocated.
+ * */
+static MyLogger_ring_S* __mylogger_get_thread_ring(MyLogger_instance_S* instance)
+{
+    MyLogger_ring_S* ring = pthread_getspecific(instance->ring_key);
+    if(ring != NULL)
+        return ring;
+
+    ring = malloc(sizeof(*ring));
+    if(ring == NULL)
+        return NULL;
+
+    atomic_init(&ring->head, 0);
+    atomic_init(&ring->tail, 0);
+    atomic_init(&ring->abandoned, false);
+    pthread_setspecific(instance->ring_key, ring);
+
+    pthread_mutex_lock(&instance->rings_mutex);
+    ring->next = atomic_load_explicit(&instance->rings, memory_order_relaxed);
+    atomic_store_explicit(&instance->rings, ring, memory_order_release);
+    pthread_mutex_unlock(&instance->rings_mutex);
+
+    return ring;
+}
+
+/**
+ * Returns next pseudo random number of the thread (xorshift32).
+ *
+ * @param[in,out] thread - state of the calling thread
+ * @return random number.
+ * */
+static uint32_t __mylogger_random(MyLogger_thread_S* thread)
+{
+    uint32_t x = thread->random;
+    if(x == 0)
+        x = (uint32_t)(uintptr_t)thread | 1U;   // thread states have different addresses
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    thread->random = x;
+    return x;
+}
+
+/**
+ * Decides by the overload policy whether message is formatted and pushed into the ring.
+ * Dropped message is counted.
+ *
+ * @param[in] instance - logger instance
+ * @param[in] ring - ring of the calling thread
+ * @param[in] level - level of the message
+ * @return true when message should be logged.
+ * */
+static bool __mylogger_ring_admit(MyLogger_instance_S* instance, const MyLogger_ring_S* ring, mylogger_level_t level)
+{
+    const mylogger_overload_policy_t* policy = &instance->overload;
+    if(policy->mode == MYLOGGER_OVERLOAD_BLOCK || policy->mode == MYLOGGER_OVERLOAD_DROP_NEWEST || level >= policy->keep_level)
+        return true;
+
+    const size_t used = atomic_load_explicit(&ring->head, memory_order_relaxed) -
+                        atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    bool admit;
+    if(policy->mode == MYLOGGER_OVERLOAD_DROP_LOW_LEVELS)
+        admit = used <= MYLOGGER_RING_SIZE / ((size_t)policy->keep_level + 1) * ((size_t)level + 1);
+    else
+        admit = used <= MYLOGGER_RING_SIZE / 2 || __mylogger_random(&g_mylogger_thread) % policy->sample_rate == 0;
+
+    if(!admit)
+        atomic_fetch_add_explicit(&instance->dropped[level], 1, memory_order_relaxed);
+    return admit;
+}
+
+/**
+ * Copies record into the ring. When there is not enough space, waits for the writer thread
+ * or drops the record according to the overload policy.
+ *
+ * @param[in] instance - logger instance
+ * @param[in] ring - ring of the calling thread
+ * @param[in] type - type of the record
+ * @param[in] level - level of the message
+ * @param[in] record - formatted message or deferred record
+ * @param[in] len - record length
+ * @return false when the record was dropped.
+ * */
+static bool __mylogger_ring_push(MyLogger_instance_S* instance,
+                                 MyLogger_ring_S* ring,
+                                 MyLogger_record_type_E type,
+                                 mylogger_level_t level,
+                                 const char* record,
+                                 const size_t len)
+{
+    const MyLogger_record_header_S header = {.len = (uint32_t)len, .type = (uint16_t)type, .level = (uint16_t)level};
+    const size_t needed = sizeof(header) + len;
+    const size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+
+    while(MYLOGGER_RING_SIZE - (head - atomic_load_explicit(&ring->tail, memory_order_acquire)) < needed)
+    {
+        if(instance->overload.mode != MYLOGGER_OVERLOAD_BLOCK && level < instance->overload.keep_level)
+        {
+            atomic_fetch_add_explicit(&instance->dropped[level], 1, memory_order_relaxed);
+            return false;
+        }
+        sched_yield();
+    }
+
+    const char* parts[] = {(const char*)&header, record};
+    const size_t parts_len[] = {sizeof(header), len};
+    size_t pos = head;
+    for(size_t i = 0; i < 2; i++)
+    {
+        const size_t idx = pos & (MYLOGGER_RING_SIZE - 1);
+        const size_t first = parts_len[i] < MYLOGGER_RING_SIZE - idx ? parts_len[i] : MYLOGGER_RING_SIZE - idx;
+        memcpy(&ring->data[idx], parts[i], first);
+        memcpy(&ring->data[0], parts[i] + first, parts_len[i] - first);
+        pos += parts_len[i];
+    }
+
+    atomic_store_explicit(&ring->head, pos, memory_order_release);
+    return true;
+}
+
+/**
+ * Prepares flight recorder (config.recorder), buffers of threads are allocated on first use.
+ *
+ * @param[in,out] instance - logger instance
+ * @param[in] config - recorder options with non-zero size
+ * @return MYLOGGER_INIT_SUCCESS on success, MYLOGGER_INIT_OTHER_ERROR otherwise.
+ * */
+static mylogger_init_error_code_t __mylogger_recorder_start(MyLogger_instance_S* instance, const mylogger_recorder_t* config)
+{
+    if(pthread_key_create(&instance->recorder_key, __mylogger_recorder_abandon) != 0)
+        return MYLOGGER_INIT_OTHER_ERROR;
+
+    pthread_mutex_init(&instance->recorder_mutex, NULL);
+    instance->recorders = NULL;
+    instance->recorder_size = MYLOGGER_RECORDER_MIN_SIZE;
+    while(instance->recorder_size < config->size)
+        instance->recorder_size *= 2;
+    instance->recorder_level = config->level;
+    instance->recorder_dump_level = config->dump_level;
+    if((instance->recorder_dump_level == 0 && !config->dump_level_set) || instance->recorder_dump_level > MYLOGGER_LEVEL_FATAL)
+        instance->recorder_dump_level = MYLOGGER_LEVEL_ERROR;
+    return MYLOGGER_INIT_SUCCESS;
+}
+
+/**
+ * Frees recorders of every thread. No thread can use the instance anymore.
+ *
+ * @param[in] instance - logger instance
+ * */
+static void __mylogger_recorder_stop(MyLogger_instance_S* instance)
+{
+    pthread_key_delete(instance->recorder_key);
+
+    MyLogger_recorder_S* recorder = instance->recorders;
+    while(recorder != NULL)
+    {
+        MyLogger_recorder_S* next = recorder->next;
+        pthread_mutex_destroy(&recorder->mutex);
+        free(recorder);
+        recorder = next;
+    }
+    instance->recorders = NULL;
+    pthread_mutex_destroy(&instance->recorder_mutex);
+}
+
+/**
+ * Thread exit handler. Recorded messages are kept until a new thread takes the recorder over.
+ *
+ * @param[in] recorder - recorder of the exiting thread
+ * */
+static void __mylogger_recorder_abandon(void* recorder)
+{
+    atomic_store_explicit(&((MyLogger_recorder_S*)recorder)->exited, true, memory_order_release);
+}
+
+/**
+ * Returns recorder of the calling thread. Recorder of an exited thread is reused, new one is allocated otherwise.
+ *
+ * @param[in] instance - logger instance with flight recorder
+ * @return recorder of the calling thread or NULL when memory cannot be allocated.
+ * */
+static MyLogger_recorder_S* __mylogger_get_thread_recorder(MyLogger_instance_S* instance)
+{
+    MyLogger_recorder_S* recorder = pthread_getspecific(instance->recorder_key);
+    if(recorder != NULL)
+        return recorder;
+
+    pthread_mutex_lock(&instance->recorder_mutex);
+    for(recorder = instance->recorders; recorder != NULL; recorder = recorder->next)
+    {
+        if(atomic_load_explicit(&recorder->exited, memory_order_acquire))
+        {
+            pthread_mutex_lock(&recorder->mutex);
+            recorder->head = 0;
+            recorder->tail = 0;
+            atomic_store_explicit(&recorder->exited, false, memory_order_relaxed);
+            pthread_mutex_unlock(&recorder->mutex);
+            break;
+        }
+    }
+    if(recorder == NULL)
+    {
+        recorder = malloc(sizeof(*recorder) + instance->recorder_size);
+        if(recorder != NULL)
+        {
+            pthread_mutex_init(&recorder->mutex, NULL);
+            recorder->head = 0;
+            recorder->tail = 0;
+            atomic_init(&recorder->exited, false);
+            recorder->next = instance->recorders;
+            instance->recorders = recorder;
+        }
+    }
+    pthread_mutex_unlock(&instance->recorder_mutex);
+
+    if(recorder != NULL)
+        pthread_setspecific(instance->recorder_key, recorder);
+    return recorder;
+}
+
+/**
+ * Copies bytes out of the recorder, handling wrap around.
+ *
+ * @param[in] recorder - recorder to read from
+ * @param[in] size - size of the recorder data
+ * @param[in] pos - position (counter value) of the first byte
+ * @param[out] out - destination buffer
+ * @param[in] len - number of bytes to copy
+ * */
+static void __mylogger_recorder_copy(const MyLogger_recorder_S* recorder, size_t size, size_t pos, char* out, const size_t len)
+{
+    const size_t idx = pos & (size - 1);
+    const size_t first = len < size - idx ? len : size - idx;
+    memcpy(out, &recorder->data[idx], first);
+    memcpy(out + first, &recorder->data[0], len - first);
+}
+
+/**
+ * Keeps message below the level threshold in the recorder of the calling thread. Arguments are captured
+ * without formatting, messages that cannot be captured are formatted.
+ *
+ * @param[in] instance - logger instance with flight recorder
+ * @param[in] call - log call description
+ * @param[in] format - format string, only pointer is stored
+ * @param[in] args - arguments for format
+ * */
+static void __mylogger_recorder_add(MyLogger_instance_S* instance, const MyLogger_call_S* call, const char* format, va_list args)
+{
+    MyLogger_thread_S* self = &g_mylogger_thread;
+    MyLogger_recorder_S* recorder = __mylogger_get_thread_recorder(instance);
+    char* record = __mylogger_thread_buffer(self, MYLOGGER_ASYNC_MESSAGE_MAX_SIZE);
+    if(recorder == NULL || record == NULL)
+        return;
+
+    const size_t size = instance->recorder_size;
+    const size_t max_len = size - sizeof(MyLogger_record_header_S) < MYLOGGER_ASYNC_MESSAGE_MAX_SIZE ?
+                           size - sizeof(MyLogger_record_header_S) : MYLOGGER_ASYNC_MESSAGE_MAX_SIZE;
+    MyLogger_record_type_E type = MYLOGGER_RECORD_DEFERRED;
+    size_t len = 0;
+    if(call->fields_count == 0)
+    {
+        va_list args_copy;
+        va_copy(args_copy, args);
+        len = __mylogger_capture(record, max_len, call, format, args_copy);
+        va_end(args_copy);
+    }
+    const char* message = record;
+    if(len == 0)
+    {
+        type = MYLOGGER_RECORD_TEXT;
+        len = __mylogger_format_thread(instance, self, max_len, call, format, args, &message);
+    }
+
+    const MyLogger_record_header_S header = {.len = (uint32_t)len, .type = (uint16_t)type, .level = (uint16_t)call->level};
+    const char* parts[] = {(const char*)&header, message};
+    const size_t parts_len[] = {sizeof(header), len};
+
+    pthread_mutex_lock(&recorder->mutex);
+    // oldest records make room for the new one
+    while(recorder->head + sizeof(header) + len - recorder->tail > size)
+    {
+        MyLogger_record_header_S oldest;
+        __mylogger_recorder_copy(recorder, size, recorder->tail, (char*)&oldest, sizeof(oldest));
+        recorder->tail += sizeof(oldest) + oldest.len;
+    }
+    for(size_t i = 0; i < 2; i++)
+    {
+        const size_t idx = recorder->head & (size - 1);
+        const size_t first = parts_len[i] < size - idx ? parts_len[i] : size - idx;
+        memcpy(&recorder->data[idx], parts[i], first);
+        memcpy(&recorder->data[0], parts[i] + first, parts_len[i] - first);
+        recorder->head += parts_len[i];
+    }
+    pthread_mutex_unlock(&recorder->mutex);
+}
+
+/**
+ * Writes dumped message the same way as logged messages.
+ *
+ * @param[in] instance - logger instance
+ * @param[in] message - formatted message
+ * @param[in] len - message length
+ * @param[in] level - level of the message
+ * @param[in] locked - caller is the writer thread and holds instance mutex
+ * */
+static void __mylogger_recorder_output(MyLogger_instance_S* instance,
+                                       const char* message,
+                                       const size_t len,
+                                       mylogger_level_t level,
+                                       bool locked)
+{
+    // open batch keeps dumped messages in front of the message that triggered the dump
+    if(!locked && g_mylogger_thread.batch_logger == instance)
+    {
+        __mylogger_batch_append(instance, &g_mylogger_thread, message, len, level);
+        return;
+    }
+    // ring keeps dumped messages in front of the message that triggered the dump
+    if(!locked && instance->features.feat_async)
+    {
+        MyLogger_ring_S* ring = __mylogger_get_thread_ring(instance);
+        if(ring != NULL)
+        {
+            __mylogger_ring_push(instance, ring, MYLOGGER_RECORD_TEXT, level, message, len);
+            return;
+        }
+    }
+
+    if(instance->mmap.fd >= 0)
+        __mylogger_mmap_write(&instance->mmap, message, len);
+    if(instance->sinks_count > 0)
+    {
+        if(!locked)
+            __mylogger_lock(instance, __mylogger_get_thread_stats(instance));
+        __mylogger_write(instance, message, len, level);
+        if(!locked)
+            pthread_mutex_unlock(&instance->mutex);
+    }
+}
+
+/**
+ * Writes out messages of one recorder, oldest first, and empties it.
+ *
+ * @param[in] instance - logger instance with flight recorder
+ * @param[in,out] recorder - recorder to dump
+ * @param[out] record - MYLOGGER_ASYNC_MESSAGE_MAX_SIZE buffer for record copied out of the recorder
+ * @param[out] msg - MYLOGGER_ASYNC_MESSAGE_MAX_SIZE buffer for formatted message
+ * @param[in] crash - called by the writer thread for the crash handler, it holds instance mutex and
+ *                    recorder locked by the crashed thread is skipped
+ * */
+static void __mylogger_recorder_dump(MyLogger_instance_S* instance,
+                                     MyLogger_recorder_S* recorder,
+                                     char* record,
+                                     char* msg,
+                                     bool crash)
+{
+    if(crash)
+    {
+        if(pthread_mutex_trylock(&recorder->mutex) != 0)
+            return;
+    }
+    else
+        pthread_mutex_lock(&recorder->mutex);
+
+    const size_t size = instance->recorder_size;
+    while(recorder->tail != recorder->head)
+    {
+        MyLogger_record_header_S header;
+        __mylogger_recorder_copy(recorder, size, recorder->tail, (char*)&header, sizeof(header));
+        __mylogger_recorder_copy(recorder, size, recorder->tail + sizeof(header), record, header.len);
+        recorder->tail += sizeof(header) + header.len;
+
+        if(header.type == MYLOGGER_RECORD_TEXT)
+            __mylogger_recorder_output(instance, record, header.len, (mylogger_level_t)header.level, crash);
+        else
+        {
+            bool truncated;
+            const size_t msg_len = __mylogger_render_deferred(instance, record, header.len, msg, &truncated);
+            __mylogger_recorder_output(instance, msg, msg_len, (mylogger_level_t)header.level, crash);
+        }
+    }
+    pthread_mutex_unlock(&recorder->mutex);
+}
+
+/**
+ * Writes out messages of every recorder.
+ *
+ * @param[in] instance - logger instance with flight recorder
+ * @param[in] crash - called by the writer thread for the crash handler, see __mylogger_recorder_dump
+ * */
+static void __mylogger_recorders_dump(MyLogger_instance_S* instance, bool crash)
+{
+    char* record = instance->writer_record;
+    char* msg = instance->writer_buffer;
+    if(!crash)
+    {
+        record = __mylogger_thread_buffer(&g_mylogger_thread, 2 * MYLOGGER_ASYNC_MESSAGE_MAX_SIZE);
+        if(record == NULL)
+            return;
+        msg = &record[MYLOGGER_ASYNC_MESSAGE_MAX_SIZE];
+        pthread_mutex_lock(&instance->recorder_mutex);
+    }
+    else if(pthread_mutex_trylock(&instance->recorder_mutex) != 0)
+        return;
+
+    for(MyLogger_recorder_S* recorder = instance->recorders; recorder != NULL; recorder = recorder->next)
+        __mylogger_recorder_dump(instance, recorder, record, msg, crash);
+    pthread_mutex_unlock(&instance->recorder_mutex);
+}
+
+/**
+ * Copies bytes out of the ring, handling wrap around.
+ *
+ * @param[in] ring - ring to read from
+ * @param[in] pos - position (counter value) of the first byte
+ * @param[out] out - destination buffer
+ * @param[in] len - number of bytes to copy
+ * */
+static void __mylogger_ring_read(const MyLogger_ring_S* ring, size_t pos, char* out, const size_t len)
+{
+    const size_t idx = pos & (MYLOGGER_RING_SIZE - 1);
+    const size_t first = len < MYLOGGER_RING_SIZE - idx ? len : MYLOGGER_RING_SIZE - idx;
+    memcpy(out, &ring->data[idx], first);
+    memcpy(out + first, &ring->data[0], len - first);
+}
+
+/**
+ * Formats deferred record the way the logging thread would have formatted the message.
+ *
+ * @param[in] instance - logger instance
+ * @param[in] record - MyLogger_deferred_S followed by TID tag and captured arguments
+ * @param[in] len - record length
+ * @param[out] msg - MYLOGGER_ASYNC_MESSAGE_MAX_SIZE buffer for the message
+ * @param[out] truncated - message did not fit
+ * @return length of the message.
+ * */
+static size_t __mylogger_render_deferred(const MyLogger_instance_S* instance, const char* record, size_t len, char* msg, bool* truncated)
+{
+    MyLogger_deferred_S deferred;
+    memcpy(&deferred, record, sizeof(deferred));
+    deferred.call.tid_tag = &record[sizeof(deferred)];
+
+    const size_t prefix_len = __mylogger_format_prefix(instance, msg, MYLOGGER_ASYNC_MESSAGE_MAX_SIZE, &deferred.call);
+    const size_t args_len = __mylogger_render_args(&msg[prefix_len],
+                                                   MYLOGGER_ASYNC_MESSAGE_MAX_SIZE - prefix_len,
+                                                   deferred.format,
+                                                   &record[sizeof(deferred) + deferred.call.tid_tag_len],
+                                                   &record[len]);
+    // arguments captured by this process always match the format
+    const size_t msg_len = prefix_len + (args_len != MYLOGGER_CAPTURE_FAILED ? args_len : 0);
+    *truncated = msg_len >= MYLOGGER_ASYNC_MESSAGE_MAX_SIZE;
+    return __mylogger_format_suffix(instance, msg, MYLOGGER_ASYNC_MESSAGE_MAX_SIZE, prefix_len,
+                                    MYLOGGER_CLAMP(msg_len, MYLOGGER_ASYNC_MESSAGE_MAX_SIZE), truncated, &deferred.call);
+}
+
+/**
+ * Moves every published record from all rings to the outputs. Frees empty rings of exited threads.
+ * Called only from the writer thread.
+ *
+ * @param[in] instance - logger instance
+ * @return number of drained bytes.
+ * */
+static size_t __mylogger_drain_rings(MyLogger_instance_S* instance)
+{
+    size_t drained = 0;
+    MyLogger_stats_S* stats = __mylogger_get_thread_stats(instance);
+
+    // producers write synchronously only when their ring could not be allocated
+    pthread_mutex_lock(&instance->mutex);
+
+    MyLogger_ring_S* prev = NULL;
+    MyLogger_ring_S* ring = atomic_load_explicit(&instance->rings, memory_order_acquire);
+    while(ring != NULL)
+    {
+        // abandoned has to be checked before head, otherwise last records could be lost
+        const bool abandoned = atomic_load_explicit(&ring->abandoned, memory_order_acquire);
+        const size_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+        size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+
+        while(tail != head)
+        {
+            MyLogger_record_header_S header;
+            __mylogger_ring_read(ring, tail, (char*)&header, sizeof(header));
+            __mylogger_ring_read(ring, tail + sizeof(header), instance->writer_record, header.len);
+            if(header.type == MYLOGGER_RECORD_TEXT)
+            {
+                if(instance->mmap.fd >= 0)
+                    __mylogger_mmap_write(&instance->mmap, instance->writer_record, header.len);
+                __mylogger_write(instance, instance->writer_record, header.len, header.level);
+                if(stats != NULL)
+                    __mylogger_stats_add(&stats->bytes, header.len);
+            }
+            else
+            {
+                char* msg = instance->writer_buffer;
+                bool truncated;
+                const size_t msg_len = __mylogger_render_deferred(instance, instance->writer_record, header.len, msg, &truncated);
+                if(instance->mmap.fd >= 0)
+                    __mylogger_mmap_write(&instance->mmap, msg, msg_len);
+                __mylogger_write(instance, msg, msg_len, header.level);
+                if(stats != NULL)
+                {
+                    __mylogger_stats_add(&stats->bytes, msg_len);
+                    __mylogger_stats_add(&stats->truncated, truncated);
+                }
+            }
+            tail += sizeof(header) + header.len;
+        }
+        drained += tail - atomic_load_explicit(&ring->tail, memory_order_relaxed);
+        atomic_store_explicit(&ring->tail, tail, memory_order_release);
+
+        MyLogger_ring_S* next = ring->next;
+        if(abandoned)
+        {
+            pthread_mutex_lock(&instance->rings_mutex);
+            MyLogger_ring_S* first = atomic_load_explicit(&instance->rings, memory_order_relaxed);
+            if(prev != NULL)
+                prev->next = next;
+            else if(first == ring)
+                atomic_store_explicit(&instance->rings, next, memory_order_relaxed);
+            else
+            {
+                // new rings are only added at the front, predecessor is between the new front and the ring
+                while(first->next != ring)
+                    first = first->next;
+                first->next = next;
+            }
+            pthread_mutex_unlock(&instance->rings_mutex);
+            free(ring);
+        }
+        else
+            prev = ring;
+        ring = next;
+    }
+
+    __mylogger_dropped_report(instance, false);
+    if(__mylogger_stats_due(instance))
+        __mylogger_stats_report(instance);
+    __mylogger_sinks_sync(instance);
+    pthread_mutex_unlock(&instance->mutex);
+    return drained;
+}
+
+/**
+ * Logs WARNING with the number of messages dropped since the last report. Called by the writer thread
+ * under instance mutex.
+ *
+ * @param[in] instance - logger instance
+ * @param[in] force - report even when report interval has not elapsed yet
+ * */
+static void __mylogger_dropped_report(MyLogger_instance_S* instance, bool force)
+{
+    uint64_t dropped[MYLOGGER_LEVELS_COUNT];
+    uint64_t total = 0;
+    for(size_t i = 0; i < MYLOGGER_LEVELS_COUNT; i++)
+    {
+        dropped[i] = atomic_load_explicit(&instance->dropped[i], memory_order_relaxed) - instance->dropped_reported[i];
+        total += dropped[i];
+    }
+    if(total == 0)
+        return;
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &now);
+    if(!force && __mylogger_elapsed_ms(&instance->dropped_report_time, &now) < instance->overload.report_interval_ms)
+        return;
+
+    MyLogger_call_S call;
+    __mylogger_call_init(instance, &call, __FILE__, __func__, __LINE__, MYLOGGER_LEVEL_WARNING);
+
+    // binary log gets the report as text record
+    const size_t offset = instance->features.feat_binary ? sizeof(MyLogger_binary_header_S) : 0;
+    const size_t size = MYLOGGER_ASYNC_MESSAGE_MAX_SIZE - offset;
+    char* msg = &instance->writer_buffer[offset];
+    const size_t prefix_len = __mylogger_format_prefix(instance, msg, size, &call);
+    size_t len = MYLOGGER_CLAMP(prefix_len + (size_t)snprintf(&msg[prefix_len], size - prefix_len, "%" PRIu64 " messages dropped (", total), size);
+    const char* separator = "";
+    for(size_t i = 0; i < MYLOGGER_LEVELS_COUNT; i++)
+    {
+        if(dropped[i] == 0)
+            continue;
+        len = MYLOGGER_CLAMP(len + (size_t)snprintf(&msg[len], size - len, "%s%s: %" PRIu64,
+                                                    separator, mylogger_level_print[i], dropped[i]), size);
+        separator = ", ";
+        instance->dropped_reported[i] += dropped[i];
+    }
+    len = MYLOGGER_CLAMP(len + (size_t)snprintf(&msg[len], size - len, ")\n"), size);
+    bool truncated = false;
+    len = __mylogger_format_suffix(instance, msg, size, prefix_len, len, &truncated, &call);
+    instance->dropped_report_time = now;
+
+    if(instance->features.feat_binary)
+    {
+        const MyLogger_binary_header_S header = {.len = (uint32_t)len, .kind = MYLOGGER_BINARY_TEXT, .level = MYLOGGER_LEVEL_WARNING};
+        memcpy(instance->writer_buffer, &header, sizeof(header));
+        msg = instance->writer_buffer;
+        len += sizeof(header);
+    }
+    if(instance->mmap.fd >= 0)
+        __mylogger_mmap_write(&instance->mmap, msg, len);
+    __mylogger_write(instance, msg, len, MYLOGGER_LEVEL_WARNING);
+}
+
+/**
+ * Prepares per-thread counters (MYLOGGER_FEATURE_STATS).
+ *
+ * @param[in] instance - logger instance
+ * @param[in] interval_ms - report interval, 0 disables reports
+ * @return MYLOGGER_INIT_SUCCESS on success, MYLOGGER_INIT_OTHER_ERROR otherwise.
+ * */
+static mylogger_init_error_code_t __mylogger_stats_start(MyLogger_instance_S* instance, uint32_t interval_ms)
+{
+    if(pthread_key_create(&instance->stats_key, __mylogger_stats_abandon) != 0)
+        return MYLOGGER_INIT_OTHER_ERROR;
+
+    pthread_mutex_init(&instance->stats_mutex, NULL);
+    instance->stats = NULL;
+    memset(&instance->stats_retired, 0, sizeof(instance->stats_retired));
+    instance->stats_interval_ms = interval_ms;
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &now);
+    atomic_init(&instance->stats_report_ns,
+                (uint64_t)now.tv_sec * 1000000000U + (uint64_t)now.tv_nsec + (uint64_t)interval_ms * 1000000U);
+    return MYLOGGER_INIT_SUCCESS;
+}
+
+/**
+ * Frees counters of every thread. No thread can use the instance anymore.
+ *
+ * @param[in] instance - logger instance
+ * */
+static void __mylogger_stats_stop(MyLogger_instance_S* instance)
+{
+    pthread_key_delete(instance->stats_key);
+
+    MyLogger_stats_S* stats = instance->stats;
+    while(stats != NULL)
+    {
+        MyLogger_stats_S* next = stats->next;
+        free(stats);
+        stats = next;
+    }
+    instance->stats = NULL;
+    pthread_mutex_destroy(&instance->stats_mutex);
+}
+
+/**
+ * Thread exit handler. Marks counters of exiting thread, they are moved to retired totals
+ * by the next __mylogger_stats_collect.
+ *
+ * @param[in] stats - counters of the exiting thread
+ * */
+static void __mylogger_stats_abandon(void* stats)
+{
+    atomic_store_explicit(&((MyLogger_stats_S*)stats)->exited, true, memory_order_release);
+}
+
+/**
+ * Returns counters of the calling thread. Counters are created and registered on first use.
+ *
+ * @param[in] instance - logger instance
+ * @return counters of the calling thread or NULL when MYLOGGER_FEATURE_STATS is disabled or memory cannot be allocated.
+ * */
+static MyLogger_stats_S* __mylogger_get_thread_stats(MyLogger_instance_S* instance)
+{
+    if(!instance->features.feat_stats)
+        return NULL;
+
+    MyLogger_stats_S* stats = pthread_getspecific(instance->stats_key);
+    if(stats != NULL)
+        return stats;
+
+    // counters of different threads never share cache line
+    const size_t size = (sizeof(*stats) + MYLOGGER_CACHE_LINE_SIZE - 1) & ~(size_t)(MYLOGGER_CACHE_LINE_SIZE - 1);
+    stats = aligned_alloc(MYLOGGER_CACHE_LINE_SIZE, size);
+    if(stats == NULL)
+        return NULL;
+    memset(stats, 0, size);
+    pthread_setspecific(instance->stats_key, stats);
+
+    pthread_mutex_lock(&instance->stats_mutex);
+    stats->next = instance->stats;
+    instance->stats = stats;
+    pthread_mutex_unlock(&instance->stats_mutex);
+
+    return stats;
+}
+
+/**
+ * Adds value to the counter of the calling thread. Plain load and store, only the owner writes the counter.
+ * */
+static inline void __mylogger_stats_add(atomic_uint_fast64_t* counter, uint64_t value)
+{
+    atomic_store_explicit(counter, atomic_load_explicit(counter, memory_order_relaxed) + value, memory_order_relaxed);
+}
+
+/**
+ * Returns CLOCK_MONOTONIC time in ns.
+ * */
+static uint64_t __mylogger_stats_now(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000U + (uint64_t)now.tv_nsec;
+}
+
+/**
+ * Adds duration to the histogram of the calling thread.
+ *
+ * @param[in,out] histogram - histogram owned by the calling thread
+ * @param[in] ns - duration
+ * */
+static void __mylogger_histogram_add(MyLogger_histogram_S* histogram, uint64_t ns)
+{
+    // bucket is index of the highest set bit
+    size_t bucket = ns < 2 ? 0 : (size_t)(63 - __builtin_clzll(ns));
+    bucket = bucket < MYLOGGER_STATS_BUCKETS ? bucket : MYLOGGER_STATS_BUCKETS - 1;
+    __mylogger_stats_add(&histogram->buckets[bucket], 1);
+    __mylogger_stats_add(&histogram->count, 1);
+    __mylogger_stats_add(&histogram->sum_ns, ns);
+    if(ns > atomic_load_explicit(&histogram->max_ns, memory_order_relaxed))
+        atomic_store_explicit(&histogram->max_ns, ns, memory_order_relaxed);
+}
+
+/**
+ * Adds counters of one thread to the totals.
+ *
+ * @param[in,out] totals - totals
+ * @param[in] stats - counters of one thread
+ * */
+static void __mylogger_stats_merge(mylogger_stats_t* totals, const MyLogger_stats_S* stats)
+{
+    for(size_t i = 0; i < MYLOGGER_LEVELS_COUNT; i++)
+        totals->messages[i] += atomic_load_explicit(&stats->messages[i], memory_order_relaxed);
+    totals->bytes += atomic_load_explicit(&stats->bytes, memory_order_relaxed);
+    totals->truncated += atomic_load_explicit(&stats->truncated, memory_order_relaxed);
+
+    mylogger_histogram_t* totals_histograms[] = {&totals->lock_wait, &totals->sink_write};
+    const MyLogger_histogram_S* histograms[] = {&stats->lock_wait, &stats->sink_write};
+    for(size_t h = 0; h < 2; h++)
+    {
+        mylogger_histogram_t* total = totals_histograms[h];
+        const MyLogger_histogram_S* histogram = histograms[h];
+        total->count += atomic_load_explicit(&histogram->count, memory_order_relaxed);
+        total->sum_ns += atomic_load_explicit(&histogram->sum_ns, memory_order_relaxed);
+        const uint64_t max_ns = atomic_load_explicit(&histogram->max_ns, memory_order_relaxed);
+        total->max_ns = max_ns > total->max_ns ? max_ns : total->max_ns;
+        for(size_t i = 0; i < MYLOGGER_STATS_BUCKETS; i++)
+            total->buckets[i] += atomic_load_explicit(&histogram->buckets[i], memory_order_relaxed);
+    }
+}
+
+/**
+ * Adds up counters of every thread that used the instance. Counters of exited threads are moved
+ * to retired totals and freed.
+ *
+ * @param[in] instance - logger instance with MYLOGGER_FEATURE_STATS
+ * @param[out] stats - totals
+ * */
+static void __mylogger_stats_collect(MyLogger_instance_S* instance, mylogger_stats_t* stats)
+{
+    pthread_mutex_lock(&instance->stats_mutex);
+    MyLogger_stats_S** link = &instance->stats;
+    while(*link != NULL)
+    {
+        MyLogger_stats_S* thread_stats = *link;
+        if(atomic_load_explicit(&thread_stats->exited, memory_order_acquire))
+        {
+            __mylogger_stats_merge(&instance->stats_retired, thread_stats);
+            *link = thread_stats->next;
+            free(thread_stats);
+        }
+        else
+            link = &thread_stats->next;
+    }
+
+    (*stats) = instance->stats_retired;
+    for(const MyLogger_stats_S* thread_stats = instance->stats; thread_stats != NULL; thread_stats = thread_stats->next)
+        __mylogger_stats_merge(stats, thread_stats);
+    pthread_mutex_unlock(&instance->stats_mutex);
+
+    for(size_t i = 0; i < MYLOGGER_LEVELS_COUNT; i++)
+        stats->dropped[i] = atomic_load_explicit(&instance->dropped[i], memory_order_relaxed);
+}
+
+/**
+ * Locks instance mutex and adds the wait to the lock histogram of the calling thread.
+ * Clock is read only when the mutex is already held by another thread.
+ *
+ * @param[in] instance - logger instance
+ * @param[in,out] stats - counters of the calling thread, can be NULL
+ * */
+static void __mylogger_lock(MyLogger_instance_S* instance, MyLogger_stats_S* stats)
+{
+    if(stats == NULL)
+    {
+        pthread_mutex_lock(&instance->mutex);
+        return;
+    }
+    if(pthread_mutex_trylock(&instance->mutex) == 0)
+    {
+        __mylogger_histogram_add(&stats->lock_wait, 0);
+        return;
+    }
+
+    const uint64_t start = __mylogger_stats_now();
+    pthread_mutex_lock(&instance->mutex);
+    __mylogger_histogram_add(&stats->lock_wait, __mylogger_stats_now() - start);
+}
+
+/**
+ * Checks whether stats report interval elapsed. Only one thread gets true for every interval.
+ *
+ * @param[in] instance - logger instance
+ * @return true when the caller should log the report.
+ * */
+static bool __mylogger_stats_due(MyLogger_instance_S* instance)
+{
+    if(instance->stats_interval_ms == 0)
+        return false;
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &now);
+    const uint64_t now_ns = (uint64_t)now.tv_sec * 1000000000U + (uint64_t)now.tv_nsec;
+    uint64_t due = atomic_load_explicit(&instance->stats_report_ns, memory_order_relaxed);
+    return now_ns >= due &&
+           atomic_compare_exchange_strong_explicit(&instance->stats_report_ns, &due,
+                                                   now_ns + (uint64_t)instance->stats_interval_ms * 1000000U,
+                                                   memory_order_relaxed, memory_order_relaxed);
+}
+
+/**
+ * Logs INFO "logger stats" message with totals as fields. Has to be called under instance mutex
+ * when the instance has sinks.
+ *
+ * @param[in] instance - logger instance
+ * */
+static void __mylogger_stats_report(MyLogger_instance_S* instance)
+{
+    mylogger_stats_t stats;
+    __mylogger_stats_collect(instance, &stats);
+    uint64_t messages = 0;
+    uint64_t dropped = 0;
+    for(size_t i = 0; i < MYLOGGER_LEVELS_COUNT; i++)
+    {
+        messages += stats.messages[i];
+        dropped += stats.dropped[i];
+    }
 
-    // ADD TID
-    if(g_mylogger_instance->features.feat_tid == 1)
-        buffer_idx += __mylogger_add_tid(&buffer[buffer_idx], sizeof(buffer) - buffer_idx);
+    const mylogger_field_t fields[] = {
+        MYLOGGER_KV_UINT("messages", messages),
+        MYLOGGER_KV_UINT("dropped", dropped),
+        MYLOGGER_KV_UINT("bytes", stats.bytes),
+        MYLOGGER_KV_UINT("truncated", stats.truncated),
+        MYLOGGER_KV_UINT("lock_wait_p50_ns", mylogger_histogram_percentile(&stats.lock_wait, 50.0)),
+        MYLOGGER_KV_UINT("lock_wait_p99_ns", mylogger_histogram_percentile(&stats.lock_wait, 99.0)),
+        MYLOGGER_KV_UINT("lock_wait_max_ns", stats.lock_wait.max_ns),
+        MYLOGGER_KV_UINT("sink_write_p50_ns", mylogger_histogram_percentile(&stats.sink_write, 50.0)),
+        MYLOGGER_KV_UINT("sink_write_p99_ns", mylogger_histogram_percentile(&stats.sink_write, 99.0)),
+        MYLOGGER_KV_UINT("sink_write_max_ns", stats.sink_write.max_ns)
+    };
+    MyLogger_call_S call;
+    __mylogger_call_init(instance, &call, __FILE__, __func__, __LINE__, MYLOGGER_LEVEL_INFO);
+    call.fields = fields;
+    call.fields_count = sizeof(fields) / sizeof(fields[0]);
+
+    // binary log gets the report as text record
+    char buffer[MYLOGGER_STATS_REPORT_SIZE];
+    const size_t offset = instance->features.feat_binary ? sizeof(MyLogger_binary_header_S) : 0;
+    const size_t size = sizeof(buffer) - offset;
+    char* msg = &buffer[offset];
+    const size_t prefix_len = __mylogger_format_prefix(instance, msg, size, &call);
+    size_t len = MYLOGGER_CLAMP(prefix_len + (size_t)snprintf(&msg[prefix_len], size - prefix_len, "logger stats\n"), size);
+    bool truncated = false;
+    len = __mylogger_format_suffix(instance, msg, size, prefix_len, len, &truncated, &call);
+
+    if(instance->features.feat_binary)
+    {
+        const MyLogger_binary_header_S header = {.len = (uint32_t)len, .kind = MYLOGGER_BINARY_TEXT, .level = MYLOGGER_LEVEL_INFO};
+        memcpy(buffer, &header, sizeof(header));
+        msg = buffer;
+        len += sizeof(header);
+    }
+    if(instance->mmap.fd >= 0)
+        __mylogger_mmap_write(&instance->mmap, msg, len);
+    if(instance->sinks_count > 0)
+        __mylogger_write(instance, msg, len, MYLOGGER_LEVEL_INFO);
+}
+
+/**
+ * Writer thread main loop. Drains rings until stop is requested and nothing is left to write.
+ *
+ * @param[in] arg - logger instance
+ * */
+static void* __mylogger_writer_thread(void* arg)
+{
+    MyLogger_instance_S* instance = arg;
+    long sleep_ns = 0;
+    atomic_store_explicit(&instance->writer_tid, syscall(SYS_gettid), memory_order_relaxed);
+
+    pthread_mutex_lock(&instance->mutex);
+    for(size_t i = 0; i < instance->sinks_count; i++)
+    {
+        if(instance->sinks[i].uring != NULL)
+        {
+            instance->sinks[i].uring->owner = pthread_self();
+            instance->sinks[i].uring->owned = true;
+        }
+    }
+    pthread_mutex_unlock(&instance->mutex);
+
+    while(true)
+    {
+        // stop flag has to be read before draining so that final pass sees all messages
+        const bool stop = atomic_load_explicit(&instance->writer_stop, memory_order_acquire);
+        if(__mylogger_drain_rings(instance) > 0)
+        {
+            sleep_ns = 0;
+            continue;
+        }
+        if(atomic_load_explicit(&instance->crash_flush, memory_order_acquire) &&
+           !atomic_load_explicit(&instance->crash_flushed, memory_order_relaxed))
+        {
+            pthread_mutex_lock(&instance->mutex);
+            if(instance->recorder_size > 0)
+                __mylogger_recorders_dump(instance, true);
+            for(size_t i = 0; i < instance->sinks_count; i++)
+            {
+                __mylogger_sink_flush(&instance->sinks[i], NULL);
+                if(instance->sinks[i].uring != NULL)
+                    __mylogger_uring_wait(instance->sinks[i].uring);
+            }
+            pthread_mutex_unlock(&instance->mutex);
+            atomic_store_explicit(&instance->crash_flushed, true, memory_order_release);
+        }
+        if(stop)
+        {
+            pthread_mutex_lock(&instance->mutex);
+            __mylogger_dropped_report(instance, true);
+            for(size_t i = 0; i < instance->sinks_count; i++)
+            {
+                if(instance->sinks[i].uring != NULL)
+                {
+                    __mylogger_uring_wait(instance->sinks[i].uring);
+                    instance->sinks[i].uring->owned = false;
+                }
+            }
+            pthread_mutex_unlock(&instance->mutex);
+            break;
+        }
+
+        __mylogger_repeats_expired(instance);
+        pthread_mutex_lock(&instance->mutex);
+        __mylogger_sinks_flush_expired(instance);
+        pthread_mutex_unlock(&instance->mutex);
+
+        // nothing to write, back off up to MYLOGGER_WRITER_MAX_SLEEP_NS
+        if(sleep_ns == 0)
+        {
+            sched_yield();
+            sleep_ns = 1000;
+        }
+        else
+        {
+            nanosleep(&(struct timespec){.tv_sec = 0, .tv_nsec = sleep_ns}, NULL);
+            sleep_ns = sleep_ns * 2 < MYLOGGER_WRITER_MAX_SLEEP_NS ? sleep_ns * 2 : MYLOGGER_WRITER_MAX_SLEEP_NS;
+        }
+    }
+
+    return NULL;
+}
+
+void mylogger_set_level(mylogger_level_t level)
+{
+    MyLogger_instance_S* instance = __mylogger_enter();
+    if(instance != NULL)
+        __mylogger_level_set(instance, &__mylogger_level_threshold, level);
+    else
+        atomic_store_explicit(&__mylogger_level_threshold, (int)level, memory_order_relaxed);
+    __mylogger_leave();
+}
+
+mylogger_level_t mylogger_get_level(void)
+{
+    MyLogger_instance_S* instance = __mylogger_enter();
+    const mylogger_level_t level = (mylogger_level_t)atomic_load_explicit(instance != NULL ? &instance->level : &__mylogger_level_threshold,
+                                                                          memory_order_relaxed);
+    __mylogger_leave();
+    return level;
+}
+
+uint64_t mylogger_get_dropped(mylogger_level_t level)
+{
+    uint64_t dropped = 0;
+    MyLogger_instance_S* instance = __mylogger_enter();
+    if(instance != NULL && (size_t)level < MYLOGGER_LEVELS_COUNT)
+        dropped = atomic_load_explicit(&instance->dropped[level], memory_order_relaxed);
+    __mylogger_leave();
+    return dropped;
+}
+
+bool mylogger_dump_recorder(void)
+{
+    bool dumped = false;
+    MyLogger_instance_S* instance = __mylogger_enter();
+    if(instance != NULL && instance->recorder_size > 0)
+    {
+        __mylogger_recorders_dump(instance, false);
+        dumped = true;
+    }
+    __mylogger_leave();
+    return dumped;
+}
+
+bool mylogger_batch_begin(void)
+{
+    MyLogger_instance_S* instance = __mylogger_enter();
+    const bool begun = instance != NULL && __mylogger_batch_begin(instance);
+    __mylogger_leave();
+    return begun;
+}
+
+size_t mylogger_batch_commit(void)
+{
+    MyLogger_thread_S* self = &g_mylogger_thread;
+    MyLogger_instance_S* instance = self->batch_logger;
+    if(instance == NULL)
+        return 0;
+
+    // instance is owned by the caller, entering only makes mylogger_destroy and mylogger_close wait for the write
+    __mylogger_enter();
+    __mylogger_batch_write(instance, self, NULL, 0, MYLOGGER_LEVEL_DEBUG);
+    __mylogger_leave();
+    self->batch_logger = NULL;
+    return self->batch_count;
+}
+
+bool mylogger_get_stats(mylogger_stats_t* stats)
+{
+    bool collected = false;
+    MyLogger_instance_S* instance = __mylogger_enter();
+    if(instance != NULL && instance->features.feat_stats)
+    {
+        __mylogger_stats_collect(instance, stats);
+        collected = true;
+    }
+    __mylogger_leave();
+    return collected;
+}
+
+uint64_t mylogger_histogram_percentile(const mylogger_histogram_t* histogram, double percentile)
+{
+    const double rank = percentile / 100.0 * (double)histogram->count;
+    uint64_t seen = 0;
+    for(size_t i = 0; i < MYLOGGER_STATS_BUCKETS; i++)
+    {
+        seen += histogram->buckets[i];
+        if(seen > 0 && (double)seen >= rank)
+        {
+            const uint64_t upper = i == MYLOGGER_STATS_BUCKETS - 1 ? UINT64_MAX : (UINT64_C(2) << i) - 1;
+            return upper < histogram->max_ns ? upper : histogram->max_ns;
+        }
+    }
+    return histogram->max_ns;
+}
+
+/**
+ * Renders "file:line func: " prefix of the call site. Without prefix the site is still usable,
+ * prefix is formatted on every call. Called under sites mutex.
+ *
+ * @param[in,out] site - call site
+ * */
+static void __mylogger_site_prefix(mylogger_site_t* site)
+{
+    const int len = snprintf(NULL, 0, "%s:%" PRIu32 " %s: ", site->file, site->line, site->func);
+    char* prefix = len > 0 ? malloc((size_t)len + 1) : NULL;
+    if(prefix != NULL)
+    {
+        snprintf(prefix, (size_t)len + 1, "%s:%" PRIu32 " %s: ", site->file, site->line, site->func);
+        site->prefix = prefix;
+        site->prefix_len = (size_t)len;
+    }
+}
+
+/**
+ * Renders prefixes of the call sites for the first instance, sites registered while there was no instance
+ * have none. Called under lifecycle mutex before the instance is published.
+ * */
+static void __mylogger_sites_prepare(void)
+{
+    pthread_mutex_lock(&g_mylogger_sites_mutex);
+    g_mylogger_sites_prefixed = true;
+    for(mylogger_site_t* site = g_mylogger_sites; site != NULL; site = site->next)
+    {
+        if(site->prefix == NULL)
+            __mylogger_site_prefix(site);
+    }
+    pthread_mutex_unlock(&g_mylogger_sites_mutex);
+}
+
+/**
+ * Frees prefixes and parsed formats of the call sites when the last instance is freed, no message can be
+ * formatted without an instance. Sites stay registered with their settings and counters.
+ * Called under lifecycle mutex.
+ * */
+static void __mylogger_sites_release(void)
+{
+    // crashing process keeps its instances, see __mylogger_free
+    if(atomic_load_explicit(&g_mylogger_instances, memory_order_relaxed) != NULL || atomic_load(&g_mylogger_crash_entered))
+        return;
+
+    pthread_mutex_lock(&g_mylogger_sites_mutex);
+    g_mylogger_sites_prefixed = false;
+    for(mylogger_site_t* site = g_mylogger_sites; site != NULL; site = site->next)
+    {
+        free((void*)site->prefix);
+        site->prefix = NULL;
+        site->prefix_len = 0;
+        free((void*)atomic_exchange_explicit(&site->parsed, NULL, memory_order_relaxed));
+    }
+    pthread_mutex_unlock(&g_mylogger_sites_mutex);
+}
+
+bool __mylogger_site_register(mylogger_site_t* site)
+{
+    pthread_mutex_lock(&g_mylogger_sites_mutex);
+    if(atomic_load_explicit(&site->state, memory_order_relaxed) == MYLOGGER_SITE_UNREGISTERED_WRAP)
+    {
+        if(g_mylogger_sites_prefixed)
+            __mylogger_site_prefix(site);
+        site->next = g_mylogger_sites;
+        g_mylogger_sites = site;
+        atomic_store_explicit(&site->state, MYLOGGER_SITE_ENABLED_WRAP, memory_order_release);
+    }
+    pthread_mutex_unlock(&g_mylogger_sites_mutex);
+    return atomic_load_explicit(&site->state, memory_order_acquire) == MYLOGGER_SITE_ENABLED_WRAP;
+}
+
+size_t mylogger_get_sites(mylogger_site_info_t* sites, size_t max)
+{
+    size_t count = 0;
+    pthread_mutex_lock(&g_mylogger_sites_mutex);
+    for(const mylogger_site_t* site = g_mylogger_sites; site != NULL; site = site->next, count++)
+    {
+        if(count < max)
+            sites[count] = (mylogger_site_info_t){
+                .file = site->file,
+                .func = site->func,
+                .line = site->line,
+                .level = site->level,
+                .enabled = atomic_load_explicit(&site->state, memory_order_relaxed) == MYLOGGER_SITE_ENABLED_WRAP,
+                .hits = atomic_load_explicit(&site->hits, memory_order_relaxed),
+                .suppressed = atomic_load_explicit(&site->suppressed, memory_order_relaxed)
+            };
+    }
+    pthread_mutex_unlock(&g_mylogger_sites_mutex);
+    return count;
+}
+
+size_t mylogger_set_site_enabled(const char* file, uint32_t line, bool enabled)
+{
+    size_t count = 0;
+    pthread_mutex_lock(&g_mylogger_sites_mutex);
+    for(mylogger_site_t* site = g_mylogger_sites; site != NULL; site = site->next)
+    {
+        if((file == NULL || strcmp(site->file, file) == 0) && (line == 0 || site->line == line))
+        {
+            atomic_store_explicit(&site->state,
+                                  enabled ? MYLOGGER_SITE_ENABLED_WRAP : MYLOGGER_SITE_DISABLED_WRAP,
+                                  memory_order_release);
+            count++;
+        }
+    }
+    pthread_mutex_unlock(&g_mylogger_sites_mutex);
+    return count;
+}
+
+bool __mylogger_site_ratelimit(mylogger_site_t* site, uint32_t rate)
+{
+    if(rate == 0)
+        return false;
+
+    // generic cell rate algorithm, the bucket is a single timestamp
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+    const uint64_t now = (uint64_t)ts.tv_sec * 1000000000U + (uint64_t)ts.tv_nsec;
+    const uint64_t interval = 1000000000U / rate;
+    const uint64_t burst = interval * (rate - 1);
+
+    uint64_t next = atomic_load_explicit(&site->limit, memory_order_relaxed);
+    do
+    {
+        if(next > now + burst)
+        {
+            atomic_fetch_add_explicit(&site->suppressed, 1, memory_order_relaxed);
+            return false;
+        }
+    } while(!atomic_compare_exchange_weak_explicit(&site->limit, &next, (next > now ? next : now) + interval,
+                                                   memory_order_relaxed, memory_order_relaxed));
+    return true;
+}
+
+void __attribute__(( format(printf, 2, 3) )) __mylogger_print_site(mylogger_site_t* site, const char* format, ...)
+{
+    MyLogger_instance_S* instance = __mylogger_enter();
+    if(instance == NULL)
+    {
+        __mylogger_leave();
+        fprintf(stderr, "You need to initialize MyLogger before using it!\n");
+        return;
+    }
 
-    buffer_idx += (size_t) snprintf(&buffer[buffer_idx],
-                                    sizeof(buffer) - buffer_idx,
-                                    "%s:%zu %s: ", file, line, func);
-    // ADD LOG MESSAGE
     va_list args;
     va_start(args, format);
-    buffer_idx += (size_t)vsnprintf(&buffer[buffer_idx],
-                                      sizeof(buffer) - buffer_idx,
-                                      format, args);
+    __mylogger_print_site_va(instance, site, NULL, 0, format, args);
+    va_end(args);
+    __mylogger_leave();
+}
 
-    // ADD STACKTRACE
-    if(level == MYLOGGER_LEVEL_FATAL)
-        buffer_idx += __mylogger_add_trace(&buffer[buffer_idx], sizeof(buffer) - buffer_idx);
+void __attribute__(( format(printf, 4, 5) )) __mylogger_print_site_kv(mylogger_site_t* site,
+                                                                      const mylogger_field_t* fields,
+                                                                      size_t fields_count,
+                                                                      const char* format,
+                                                                      ...)
+{
+    MyLogger_instance_S* instance = __mylogger_enter();
+    if(instance == NULL)
+    {
+        __mylogger_leave();
+        fprintf(stderr, "You need to initialize MyLogger before using it!\n");
+        return;
+    }
+
+    va_list args;
+    va_start(args, format);
+    __mylogger_print_site_va(instance, site, fields, fields_count, format, args);
+    va_end(args);
+    __mylogger_leave();
+}
+
+void __attribute__(( format(printf, 3, 4) )) __mylogger_print_site_to(struct MyLogger_instance* logger,
+                                                                      mylogger_site_t* site,
+                                                                      const char* format,
+                                                                      ...)
+{
+    // instance is owned by the caller, entering only makes mylogger_close wait for this call
+    __mylogger_enter();
+
+    va_list args;
+    va_start(args, format);
+    __mylogger_print_site_va(logger, site, NULL, 0, format, args);
+    va_end(args);
+    __mylogger_leave();
+}
+
+/**
+ * Logs message of the call site. Caller is inside the logger (__mylogger_enter).
+ *
+ * @param[in] instance - logger instance
+ * @param[in,out] site - call site
+ * @param[in] fields - *_KV fields, NULL when fields_count is 0
+ * @param[in] fields_count - number of fields
+ * @param[in] format - format string
+ * @param[in] args - arguments for format
+ * */
+static void __mylogger_print_site_va(MyLogger_instance_S* instance,
+                                     mylogger_site_t* site,
+                                     const mylogger_field_t* fields,
+                                     size_t fields_count,
+                                     const char* format,
+                                     va_list args)
+{
+    // plain load and store, lock prefixed increment would serialize threads logging from the same place
+    atomic_store_explicit(&site->hits, atomic_load_explicit(&site->hits, memory_order_relaxed) + 1, memory_order_relaxed);
+
+    // fields are not part of the collapse hash
+    if(!instance->features.feat_collapse || fields_count > 0 || !__mylogger_site_repeated(instance, site, format, args))
+    {
+        MyLogger_call_S call;
+        __mylogger_call_init(instance, &call, site->file, site->func, site->line, site->level);
+        call.site = site;
+        call.fields = fields;
+        call.fields_count = fields_count;
+        __mylogger_log(instance, &call, format, args);
+    }
+}
+
+/**
+ * Logs message from the call site. Caller is inside the logger (__mylogger_enter).
+ *
+ * @param[in] instance - logger instance
+ * @param[in] site - call site
+ * @param[in] format - format string
+ * */
+static void __attribute__(( format(printf, 3, 4) )) __mylogger_log_site(MyLogger_instance_S* instance,
+                                                                      mylogger_site_t* site,
+                                                                      const char* format,
+                                                                      ...)
+{
+    MyLogger_call_S call;
+    __mylogger_call_init(instance, &call, site->file, site->func, site->line, site->level);
+    call.site = site;
+
+    va_list args;
+    va_start(args, format);
+    __mylogger_log(instance, &call, format, args);
+    va_end(args);
+}
+
+/**
+ * Checks whether message repeats the last message of the call site (MYLOGGER_FEATURE_COLLAPSE).
+ * Messages are compared by hash of format and captured arguments. When a different message
+ * follows repetitions, "last message repeated N times" is logged first.
+ *
+ * @param[in] instance - logger instance
+ * @param[in,out] site - call site
+ * @param[in] format - format string
+ * @param[in] args - arguments for format
+ * @return true when the message should be skipped.
+ * */
+static bool __mylogger_site_repeated(MyLogger_instance_S* instance, mylogger_site_t* site, const char* format, va_list args)
+{
+    char captured[MYLOGGER_COLLAPSE_CAPTURE_SIZE];
+    va_list args_copy;
+    va_copy(args_copy, args);
+    const size_t len = __mylogger_capture_args(captured, sizeof(captured), format, args_copy);
+    va_end(args_copy);
+
+    // FNV-1a, 0 is reserved for messages that cannot be compared
+    uint64_t hash = 0;
+    if(len != MYLOGGER_CAPTURE_FAILED)
+    {
+        hash = (0xCBF29CE484222325ULL ^ (uint64_t)(uintptr_t)format) * 0x100000001B3ULL ^ (uint64_t)(uintptr_t)instance;
+        for(size_t i = 0; i < len; i++)
+            hash = (hash ^ (uint8_t)captured[i]) * 0x100000001B3ULL;
+        hash = hash != 0 ? hash : 1;
+    }
+
+    if(hash != 0 && atomic_exchange_explicit(&site->last_hash, hash, memory_order_relaxed) == hash)
+    {
+        atomic_fetch_add_explicit(&site->repeats, 1, memory_order_relaxed);
+        atomic_fetch_add_explicit(&site->suppressed, 1, memory_order_relaxed);
+        return true;
+    }
+    if(hash == 0)
+        atomic_store_explicit(&site->last_hash, 0, memory_order_relaxed);
+
+    // repeats belong to the instance that got the previous message
+    const MyLogger_instance_S* owner = atomic_exchange_explicit(&site->repeats_logger, instance, memory_order_relaxed);
+    const uint64_t repeats = atomic_exchange_explicit(&site->repeats, 0, memory_order_relaxed);
+    if(repeats > 0 && owner == instance)
+        __mylogger_log_site(instance, site, "last message repeated %" PRIu64 " times\n", repeats);
+    return false;
+}
+
+/**
+ * Logs pending "last message repeated N times" of every call site of the instance. When the instance is retired,
+ * before it is unpublished, last messages are forgotten so that next logger instance starts clean.
+ *
+ * @param[in] instance - logger instance
+ * @param[in] forget - forget last messages, otherwise following repetitions are still collapsed
+ * */
+static void __mylogger_sites_flush_repeats(MyLogger_instance_S* instance, bool forget)
+{
+    __mylogger_enter();
+    pthread_mutex_lock(&g_mylogger_sites_mutex);
+    for(mylogger_site_t* site = g_mylogger_sites; site != NULL; site = site->next)
+    {
+        if(atomic_load_explicit(&site->repeats_logger, memory_order_relaxed) != instance)
+            continue;
+        if(forget)
+        {
+            atomic_store_explicit(&site->repeats_logger, NULL, memory_order_relaxed);
+            atomic_store_explicit(&site->last_hash, 0, memory_order_relaxed);
+        }
+        const uint64_t repeats = atomic_exchange_explicit(&site->repeats, 0, memory_order_relaxed);
+        if(repeats > 0)
+            __mylogger_log_site(instance, site, "last message repeated %" PRIu64 " times\n", repeats);
+    }
+    pthread_mutex_unlock(&g_mylogger_sites_mutex);
+    __mylogger_leave();
+}
+
+/**
+ * Logs pending repeats once per repeats interval, so that repetitions are reported while the site is quiet.
+ * Called by the writer or flusher thread without instance mutex.
+ *
+ * @param[in] instance - logger instance
+ * */
+static void __mylogger_repeats_expired(MyLogger_instance_S* instance)
+{
+    if(!instance->features.feat_collapse)
+        return;
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &now);
+    if(__mylogger_elapsed_ms(&instance->repeats_time, &now) < instance->repeats_interval_ms)
+        return;
+    instance->repeats_time = now;
+    __mylogger_sites_flush_repeats(instance, false);
+}
+
+void __attribute__(( format(printf, 5, 6) )) __mylogger_print(const char* file,
+                                                              const char* func,
+                                                              size_t line,
+                                                              mylogger_level_t level,
+                                                              const char* format,
+                                                              ...)
+{
+    MyLogger_instance_S* instance = __mylogger_enter();
+    if(instance == NULL)
+    {
+        __mylogger_leave();
+        fprintf(stderr, "You need to initialize MyLogger before using it!\n");
+        return;
+    }
+    MyLogger_call_S call;
+    __mylogger_call_init(instance, &call, file, func, line, level);
+
+    va_list args;
+    va_start(args, format);
+    __mylogger_log(instance, &call, format, args);
+    va_end(args);
+    __mylogger_leave();
+}
+
+/**
+ * Formats and writes the message of the log call. Caller is inside the logger (__mylogger_enter).
+ *
+ * @param[in] instance - logger instance
+ * @param[in] call - log call description
+ * @param[in] format - format string
+ * @param[in] args - arguments for format
+ * */
+static void __mylogger_log(MyLogger_instance_S* instance, const MyLogger_call_S* call, const char* format, va_list args)
+{
+    const mylogger_level_t level = call->level;
+    MyLogger_thread_S* self = &g_mylogger_thread;
+
+    // flight recorder keeps messages below the threshold, error writes them out ahead of itself
+    if(instance->recorder_size > 0)
+    {
+        if((int)level < atomic_load_explicit(&instance->level, memory_order_relaxed))
+        {
+            if(level >= instance->recorder_level)
+                __mylogger_recorder_add(instance, call, format, args);
+            return;
+        }
+        MyLogger_recorder_S* recorder = level >= instance->recorder_dump_level ? pthread_getspecific(instance->recorder_key) : NULL;
+        char* buffer = recorder != NULL ? __mylogger_thread_buffer(self, 2 * MYLOGGER_ASYNC_MESSAGE_MAX_SIZE) : NULL;
+        if(buffer != NULL)
+            __mylogger_recorder_dump(instance, recorder, buffer, &buffer[MYLOGGER_ASYNC_MESSAGE_MAX_SIZE], false);
+    }
+
+    MyLogger_stats_S* stats = __mylogger_get_thread_stats(instance);
+    const char* message;
+    size_t len;
+
+    if(stats != NULL)
+        __mylogger_stats_add(&stats->messages[level], 1);
+
+    // open batch of the thread collects messages, mylogger_batch_commit writes them at once
+    if(self->batch_logger == instance)
+    {
+        len = __mylogger_message(instance, self, MYLOGGER_MESSAGE_MAX_SIZE, call, format, args, &message);
+        if(stats != NULL)
+        {
+            __mylogger_stats_add(&stats->bytes, len);
+            __mylogger_stats_add(&stats->truncated, self->truncated);
+        }
+        __mylogger_batch_append(instance, self, message, len, level);
+        return;
+    }
+
+    // writer thread writes its own messages (pending repeats) directly, its ring would wait for itself
+    if(instance->features.feat_async && !pthread_equal(pthread_self(), instance->writer))
+    {
+        MyLogger_ring_S* ring = __mylogger_get_thread_ring(instance);
+        if(ring != NULL)
+        {
+            if(!__mylogger_ring_admit(instance, ring, level))
+                return;
+
+            len = 0;
+            // stack trace has to be taken on the calling thread, FATAL is never deferred
+            char* record = __mylogger_thread_buffer(self, MYLOGGER_ASYNC_MESSAGE_MAX_SIZE);
+            if(record != NULL && instance->features.feat_deferred && level != MYLOGGER_LEVEL_FATAL && call->fields_count == 0)
+            {
+                va_list args_copy;
+                va_copy(args_copy, args);
+                len = __mylogger_capture(record, MYLOGGER_ASYNC_MESSAGE_MAX_SIZE, call, format, args_copy);
+                va_end(args_copy);
+            }
+
+            if(len > 0)
+                __mylogger_ring_push(instance, ring, MYLOGGER_RECORD_DEFERRED, level, record, len);
+            else
+            {
+                len = __mylogger_message(instance, self, MYLOGGER_ASYNC_MESSAGE_MAX_SIZE, call, format, args, &message);
+                __mylogger_ring_push(instance, ring, MYLOGGER_RECORD_TEXT, level, message, len);
+                if(stats != NULL)
+                    __mylogger_stats_add(&stats->truncated, self->truncated);
+            }
+
+            // program is about to die, make sure FATAL message reaches the outputs
+            if(level == MYLOGGER_LEVEL_FATAL)
+            {
+                const size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+                while(atomic_load_explicit(&ring->tail, memory_order_acquire) != head)
+                    sched_yield();
+            }
+            return;
+        }
+        // no memory for the ring, fall back to synchronous write
+    }
+
+    // formatting is done in parallel, only writing is serialized
+    len = __mylogger_message(instance, self, MYLOGGER_MESSAGE_MAX_SIZE, call, format, args, &message);
+    if(stats != NULL)
+    {
+        __mylogger_stats_add(&stats->bytes, len);
+        __mylogger_stats_add(&stats->truncated, self->truncated);
+    }
 
     // WRITE LOG MESSAGE
-    if(g_mylogger_instance->file_fd != NULL)
-        fprintf(g_mylogger_instance->file_fd, "%s", buffer);
-    if(g_mylogger_instance->features.feat_stdout)
-        fprintf(stdout, "%s", buffer);
-    if(g_mylogger_instance->features.feat_stderr)
-        fprintf(stderr, "%s", buffer);
-
-    pthread_mutex_unlock(&g_mylogger_instance->mutex);
+    if(instance->mmap.fd >= 0)
+        __mylogger_mmap_write(&instance->mmap, message, len);
+    if(instance->sinks_count > 0)
+    {
+        __mylogger_lock(instance, stats);
+        __mylogger_write(instance, message, len, level);
+        pthread_mutex_unlock(&instance->mutex);
+    }
+
+    if(__mylogger_stats_due(instance))
+    {
+        if(instance->sinks_count > 0)
+            pthread_mutex_lock(&instance->mutex);
+        __mylogger_stats_report(instance);
+        if(instance->sinks_count > 0)
+            pthread_mutex_unlock(&instance->mutex);
+    }
 }
@@ -1,17 +1,180 @@
 #include <assert.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <wchar.h>
+#include <limits.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+#include <signal.h>
+#include <unistd.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <sys/uio.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <stdarg.h>
+#include <execinfo.h>
 
 static size_t g_malloc_mock_counter = 0;
-// Malloc mock function. Fails only on the first use.
+static void (*g_malloc_mock_hook)(void) = NULL;
+// Malloc mock function. Fails only on the first use. Hook runs once before the next allocation, it acts like
+// another thread.
 static inline void* mock_malloc(size_t size)
 {
+    void (*hook)(void) = g_malloc_mock_hook;
+    g_malloc_mock_hook = NULL;
+    if(hook != NULL)
+        hook();
     if(g_malloc_mock_counter++ == 0)
         return NULL;
     return malloc(size);
 }
 #define malloc(size) mock_malloc(size)
 
+static size_t g_realloc_mock_counter = 1;
+// realloc mock function. Fails when the counter is zero.
+static inline void* mock_realloc(void* ptr, size_t size)
+{
+    if(g_realloc_mock_counter++ == 0)
+        return NULL;
+    return realloc(ptr, size);
+}
+#define realloc(ptr, size) mock_realloc(ptr, size)
+
+static size_t g_aligned_alloc_mock_counter = 1;
+// aligned_alloc mock function. Fails when the counter is zero.
+static inline void* mock_aligned_alloc(size_t alignment, size_t size)
+{
+    if(g_aligned_alloc_mock_counter++ == 0)
+        return NULL;
+    return aligned_alloc(alignment, size);
+}
+#define aligned_alloc(alignment, size) mock_aligned_alloc(alignment, size)
+
+static size_t g_writev_mock_counter = 1;
+static size_t g_writev_mock_max = SIZE_MAX;
+static int g_writev_mock_errno = EINTR;
+// writev mock function. Fails with g_writev_mock_errno when the counter is zero, writes at most g_writev_mock_max bytes
+// of the first buffer.
+static inline ssize_t mock_writev(int fd, const struct iovec* iov, int iovcnt)
+{
+    if(g_writev_mock_counter++ == 0)
+    {
+        errno = g_writev_mock_errno;
+        return -1;
+    }
+    if(g_writev_mock_max == SIZE_MAX)
+        return writev(fd, iov, iovcnt);
+    return write(fd, iov[0].iov_base, iov[0].iov_len < g_writev_mock_max ? iov[0].iov_len : g_writev_mock_max);
+}
+#define writev(fd, iov, iovcnt) mock_writev(fd, iov, iovcnt)
+
+static size_t g_mmap_mock_counter = 1;
+// mmap mock function. Fails when the counter is zero.
+static inline void* mock_mmap(void* addr, size_t len, int prot, int flags, int fd, off_t offset)
+{
+    if(g_mmap_mock_counter++ == 0)
+    {
+        errno = ENOMEM;
+        return MAP_FAILED;
+    }
+    return mmap(addr, len, prot, flags, fd, offset);
+}
+#define mmap(addr, len, prot, flags, fd, offset) mock_mmap(addr, len, prot, flags, fd, offset)
+
+static size_t g_ftruncate_mock_counter = 1;
+// ftruncate mock function. Fails when the counter is zero.
+static inline int mock_ftruncate(int fd, off_t length)
+{
+    if(g_ftruncate_mock_counter++ == 0)
+    {
+        errno = EIO;
+        return -1;
+    }
+    return ftruncate(fd, length);
+}
+#define ftruncate(fd, length) mock_ftruncate(fd, length)
+
+static size_t g_open_mock_counter = 1;
+// open mock function. Fails when the counter is zero.
+static inline int mock_open(const char* name, int flags, ...)
+{
+    mode_t mode = 0;
+    if(flags & O_CREAT)
+    {
+        va_list args;
+        va_start(args, flags);
+        mode = va_arg(args, mode_t);
+        va_end(args);
+    }
+    if(g_open_mock_counter++ == 0)
+    {
+        errno = EMFILE;
+        return -1;
+    }
+    return open(name, flags, mode);
+}
+#define open(...) mock_open(__VA_ARGS__)
+
+static size_t g_sigaltstack_mock_counter = 1;
+// sigaltstack mock function. Fails when the counter is zero.
+static inline int mock_sigaltstack(const stack_t* stack, stack_t* old)
+{
+    if(g_sigaltstack_mock_counter++ == 0)
+    {
+        errno = ENOMEM;
+        return -1;
+    }
+    return sigaltstack(stack, old);
+}
+#define sigaltstack(stack, old) mock_sigaltstack(stack, old)
+
+static size_t g_pwrite_mock_counter = 1;
+// pwrite mock function. Interrupted when the counter is zero.
+static inline ssize_t mock_pwrite(int fd, const void* data, size_t len, off_t offset)
+{
+    if(g_pwrite_mock_counter++ == 0)
+    {
+        errno = EINTR;
+        return -1;
+    }
+    return pwrite(fd, data, len, offset);
+}
+#define pwrite(fd, data, len, offset) mock_pwrite(fd, data, len, offset)
+
+static size_t g_uring_enter_mock_counter = 1;
+static int g_uring_enter_mock_errno = EINTR;
+// io_uring_enter mock. Fails with g_uring_enter_mock_errno when the counter is zero, other system calls are not mocked.
+#define syscall(number, ...) \
+    ((number) == SYS_io_uring_enter && g_uring_enter_mock_counter++ == 0 ? \
+     (errno = g_uring_enter_mock_errno, -1L) : syscall(number, ##__VA_ARGS__))
+
+static size_t g_fstat_mock_counter = 1;
+// fstat mock function. Fails when the counter is zero.
+static inline int mock_fstat(int fd, struct stat* st)
+{
+    if(g_fstat_mock_counter++ == 0)
+    {
+        errno = EIO;
+        return -1;
+    }
+    return fstat(fd, st);
+}
+#define fstat(fd, st) mock_fstat(fd, st)
+
+static size_t g_calloc_mock_counter = 1;
+// calloc mock function. Fails when the counter is zero.
+static inline void* mock_calloc(size_t count, size_t size)
+{
+    if(g_calloc_mock_counter++ == 0)
+        return NULL;
+    return calloc(count, size);
+}
+#define calloc(count, size) mock_calloc(count, size)
+
 static size_t g_fopen_mock_counter = 0;
 // fopen mock function. Fails only oon the first use.
 static inline FILE *mock_fopen(const char *__filename, const char *__modes)
@@ -22,12 +185,176 @@ static inline FILE *mock_fopen(const char *__filename, const char *__modes)
 }
 #define fopen(__filename, __modes) mock_fopen(__filename, __modes)
 
+static size_t g_pthread_create_mock_counter = 1;
+// pthread_create mock function. Fails when the counter is zero, tests set it to fail a thread of the logger.
+static inline int mock_pthread_create(pthread_t* thread, const pthread_attr_t* attr, void* (*start)(void*), void* arg)
+{
+    if(g_pthread_create_mock_counter++ == 0)
+        return EAGAIN;
+    return pthread_create(thread, attr, start, arg);
+}
+#define pthread_create(thread, attr, start, arg) mock_pthread_create(thread, attr, start, arg)
+
+static size_t g_pthread_key_create_mock_counter = 1;
+// pthread_key_create mock function. Fails when the counter is zero.
+static inline int mock_pthread_key_create(pthread_key_t* key, void (*destructor)(void*))
+{
+    if(g_pthread_key_create_mock_counter++ == 0)
+        return EAGAIN;
+    return pthread_key_create(key, destructor);
+}
+#define pthread_key_create(key, destructor) mock_pthread_key_create(key, destructor)
+
+static size_t g_backtrace_mock_counter = 1;
+// backtrace mock function. Fails when the counter is zero.
+static inline int mock_backtrace(void** buffer, int size)
+{
+    if(g_backtrace_mock_counter++ == 0)
+        return -1;
+    return backtrace(buffer, size);
+}
+#define backtrace(buffer, size) mock_backtrace(buffer, size)
+
+static size_t g_backtrace_symbols_mock_counter = 1;
+// backtrace_symbols mock function. Fails when the counter is zero.
+static inline char** mock_backtrace_symbols(void* const* buffer, int size)
+{
+    if(g_backtrace_symbols_mock_counter++ == 0)
+        return NULL;
+    return backtrace_symbols(buffer, size);
+}
+#define backtrace_symbols(buffer, size) mock_backtrace_symbols(buffer, size)
+
+#if defined(__x86_64__) || defined(__i386__)
+static bool g_rdtsc_mock_stopped = false;
+// TSC mock function. Stopped counter cannot be calibrated.
+static inline unsigned long long mock_rdtsc(void)
+{
+    return g_rdtsc_mock_stopped ? 0 : __builtin_ia32_rdtsc();
+}
+#define __builtin_ia32_rdtsc() mock_rdtsc()
+#endif
+
+// Makes the n-th following call of the mocked function fail, n = 1 fails the next call.
+#define MOCK_FAIL_AT(counter, n) ((counter) = (size_t)1 - (n))
+// No call of the mocked function fails.
+#define MOCK_RESET(counter) ((counter) = 1)
+
+// Forked children leave with _exit() or a signal, their coverage counters are written before that.
+#ifdef MYLOGGER_TEST_COVERAGE
+void __gcov_dump(void);
+#endif
+static inline void mock_gcov_dump(void)
+{
+#ifdef MYLOGGER_TEST_COVERAGE
+    __gcov_dump();
+#endif
+}
+static inline int mock_raise(int sig)
+{
+    // counters are written once, installed handler still runs and raises the signal again
+    struct sigaction action;
+    if(sigaction(sig, NULL, &action) == 0 && action.sa_handler == SIG_DFL)
+        mock_gcov_dump();
+    return raise(sig);
+}
+#define raise(sig) mock_raise(sig)
+static inline void mock_exit(int status)
+{
+    mock_gcov_dump();
+    _exit(status);
+}
+#define _exit(status) mock_exit(status)
+static inline pid_t mock_fork(void)
+{
+#ifdef MYLOGGER_TEST_COVERAGE
+    // instrumented fork() clears counters of the child after the fork handlers ran, pointer call is not instrumented
+    pid_t (*volatile real_fork)(void) = fork;
+    return real_fork();
+#else
+    return fork();
+#endif
+}
+#define fork() mock_fork()
+
 #include <../src/mylogger.c>    // Including .c allows us to mock functions and test statics.
 
 static void test_mylogger_init_destroy(void);
 static void test_mylogger_full_log_to_file(void);
 static void test_mylogger_log_to_stdout(void);
 static void test_mylogger_log_to_stderr(void);
+static void test_mylogger_async_log_to_file(void);
+static void test_mylogger_deferred_render(void);
+static void test_mylogger_deferred_log_to_file(void);
+static void test_mylogger_level_threshold(void);
+static void test_mylogger_destroy_waits_for_readers(void);
+static void test_mylogger_timestamps(void);
+static void test_mylogger_thread_tag(void);
+static void test_mylogger_long_messages(void);
+static void test_mylogger_custom_sinks(void);
+static void test_mylogger_mmap_log_to_file(void);
+static void test_mylogger_rotation(void);
+static void test_mylogger_binary_log(void);
+static void test_mylogger_call_sites(void);
+static void test_mylogger_overload(void);
+static void test_mylogger_rate_limits(void);
+static void test_mylogger_crash_trace(void);
+static void test_mylogger_instances(void);
+static void test_mylogger_structured(void);
+static void test_mylogger_stats(void);
+static void test_mylogger_io_uring(void);
+static void test_mylogger_recorder(void);
+static void test_mylogger_fast_format(void);
+static void test_mylogger_fork_writers(void);
+static void test_mylogger_batch(void);
+
+/**
+ * Initializes logger with the config while every allocation, thread and thread key of the initialization
+ * fails in turn. Each failure has to be reported and cleaned up, initialization succeeds when nothing fails.
+ *
+ * @param[in] config - logger configuration
+ * */
+static void test_mylogger_init_failures(const mylogger_config_t* config)
+{
+    size_t* const counters[] = {&g_malloc_mock_counter, &g_realloc_mock_counter, &g_calloc_mock_counter, &g_mmap_mock_counter,
+                                &g_pthread_create_mock_counter, &g_pthread_key_create_mock_counter};
+
+    fprintf(stderr, "\033[0;32mExpected errors:\033[0m\n");
+    for(size_t c = 0; c < sizeof(counters) / sizeof(counters[0]); c++)
+    {
+        for(size_t n = 1;; n++)
+        {
+            // log file name could change during initialization
+            char names[2][MYLOGGER_FILE_NAME_MAX_SIZE];
+            __mylogger_create_file_name(names[0]);
+            remove(names[0]);
+            MOCK_FAIL_AT(*counters[c], n);
+            const mylogger_init_error_code_t error = mylogger_init_config(config);
+            // counter is above zero once the n-th call failed
+            const bool reached = *counters[c] > 0 && *counters[c] < SIZE_MAX / 2;
+            MOCK_RESET(*counters[c]);
+            __mylogger_create_file_name(names[1]);
+
+            if(error != MYLOGGER_INIT_SUCCESS)
+                assert(reached);
+            else
+                mylogger_destroy();
+            // failed initialization leaves no log file behind, successful one is not left for other tests
+            if(config->log_file == NULL && !(config->features & MYLOGGER_FEATURE_NO_FILE))
+            {
+                for(size_t i = 0; i < 2; i++)
+                {
+                    if(error != MYLOGGER_INIT_SUCCESS)
+                        assert(access(names[i], F_OK) != 0);
+                    else
+                        remove(names[i]);
+                }
+            }
+            if(!reached)
+                break;
+        }
+    }
+}
 
 /**
  * Testing mylogger_init and mylogger_destroy functions.
@@ -150,6 +477,3151 @@ static void test_mylogger_log_to_stderr(void)
     mylogger_destroy();
 }
 
+#define TEST_ASYNC_THREADS              8
+#define TEST_ASYNC_MESSAGES_PER_THREAD  5000
+
+static void* test_mylogger_async_worker(void* arg)
+{
+    (void)arg;
+    for(size_t i = 0; i < TEST_ASYNC_MESSAGES_PER_THREAD; i++)
+        MYLOGGER_INFO("Test - async %zu\n", i);
+    return NULL;
+}
+
+static void test_mylogger_async_warning(const char* thread)
+{
+    MYLOGGER_WARNING("Test - async %s\n", thread);
+}
+
+static void* test_mylogger_async_no_ring_worker(void* arg)
+{
+    (void)arg;
+    // call site is registered, ring is the first allocation of the thread, message is written without it
+    MOCK_FAIL_AT(g_malloc_mock_counter, 1);
+    test_mylogger_async_warning("without ring");
+    assert(g_malloc_mock_counter > 0);
+    assert(pthread_getspecific(atomic_load(&g_mylogger_instance)->ring_key) == NULL);
+    return NULL;
+}
+
+static void* test_mylogger_async_exit_worker(void* arg)
+{
+    MYLOGGER_INFO("Test - async exited %zu\n", (size_t)arg);
+    return NULL;
+}
+
+typedef struct test_gate_sink_t
+{
+    atomic_bool entered;        // writer is inside the sink
+    atomic_bool released;       // writes wait until the test releases the sink
+    atomic_size_t messages;
+} test_gate_sink_t;
+
+static void test_gate_sink_write(void* user_data, const char* data, size_t len)
+{
+    (void)data;
+    (void)len;
+    test_gate_sink_t* sink = user_data;
+    atomic_store(&sink->entered, true);
+    while(!atomic_load(&sink->released))
+        sched_yield();
+    atomic_fetch_add(&sink->messages, 1);
+}
+
+/**
+ * Testing MyLogger async mode. Every message logged before mylogger_destroy has to be in the file.
+ * */
+static void test_mylogger_async_log_to_file(void)
+{
+    FILE* f = fopen("test_async_log_file.txt", "w+");
+    assert(f != NULL);
+    assert(mylogger_init(f, MYLOGGER_FEATURE_ASYNC | MYLOGGER_FEATURE_THREAD_ID) == MYLOGGER_INIT_SUCCESS);
+
+    pthread_t threads[TEST_ASYNC_THREADS];
+    for(size_t i = 0; i < TEST_ASYNC_THREADS; i++)
+        assert(pthread_create(&threads[i], NULL, test_mylogger_async_worker, NULL) == 0);
+    for(size_t i = 0; i < TEST_ASYNC_THREADS; i++)
+        pthread_join(threads[i], NULL);
+
+    // rings of exited threads may already be freed, main thread ring is still alive
+    test_mylogger_async_warning("main thread");
+    // thread without ring writes directly
+    pthread_t thread;
+    assert(pthread_create(&thread, NULL, test_mylogger_async_no_ring_worker, NULL) == 0);
+    pthread_join(thread, NULL);
+    mylogger_destroy();
+
+    f = fopen("test_async_log_file.txt", "r");
+    assert(f != NULL);
+    size_t lines = 0;
+    char line[512];
+    while(fgets(line, sizeof(line), f) != NULL)
+        lines++;
+    fclose(f);
+    remove("test_async_log_file.txt");
+
+    assert(lines == TEST_ASYNC_THREADS * TEST_ASYNC_MESSAGES_PER_THREAD + 2);
+
+    // ring of a thread that exited is unlinked behind rings added while the writer drained it
+    static test_gate_sink_t sink;
+    assert(mylogger_init_config(&(mylogger_config_t){
+        .features = MYLOGGER_FEATURE_ASYNC | MYLOGGER_FEATURE_NO_FILE,
+        .flush = {.size = 1},
+        .sinks = &(mylogger_sink_t){.write = test_gate_sink_write, .user_data = &sink},
+        .sinks_count = 1
+    }) == MYLOGGER_INIT_SUCCESS);
+    MyLogger_instance_S* instance = atomic_load(&g_mylogger_instance);
+    // writer loads the list after the thread exited, its ring is in front
+    pthread_mutex_lock(&instance->mutex);
+    assert(pthread_create(&thread, NULL, test_mylogger_async_exit_worker, (void*)0) == 0);
+    pthread_join(thread, NULL);
+    pthread_mutex_unlock(&instance->mutex);
+    while(!atomic_load(&sink.entered))
+        sched_yield();
+    for(size_t i = 1; i < 3; i++)
+    {
+        assert(pthread_create(&thread, NULL, test_mylogger_async_exit_worker, (void*)i) == 0);
+        pthread_join(thread, NULL);
+    }
+    atomic_store(&sink.released, true);
+    mylogger_destroy();
+    assert(atomic_load(&sink.messages) == 3);
+
+    // every failure of the initialization is cleaned up
+    test_mylogger_init_failures(&(mylogger_config_t){
+        .features = MYLOGGER_FEATURE_ASYNC | MYLOGGER_FEATURE_NO_FILE | MYLOGGER_FEATURE_STDOUT
+    });
+
+    // ring records are clamped to the buffer, clamped length is evaluated once
+    size_t evaluations = 0;
+    assert(MYLOGGER_CLAMP((evaluations++, (size_t)10), 4) == 3);
+    assert(evaluations == 1);
+}
+
+// Captures arguments like MYLOGGER_FEATURE_DEFERRED does and checks that rendered message equals vsnprintf output.
+static void __attribute__(( format(printf, 1, 2) )) test_mylogger_deferred_check(const char* format, ...)
+{
+    static char record[MYLOGGER_ASYNC_MESSAGE_MAX_SIZE];
+    char expected[1024];
+    char rendered[1024];
+    const MyLogger_call_S call = {.file = __FILE__, .func = __func__, .line = __LINE__, .level = MYLOGGER_LEVEL_INFO};
+
+    va_list args;
+    va_start(args, format);
+    va_list args_copy;
+    va_copy(args_copy, args);
+    vsnprintf(expected, sizeof(expected), format, args);
+    const size_t len = __mylogger_capture(record, sizeof(record), &call, format, args_copy);
+    va_end(args_copy);
+    va_end(args);
+
+    assert(len >= sizeof(MyLogger_deferred_S));
+    __mylogger_render_args(rendered, sizeof(rendered), format, &record[sizeof(MyLogger_deferred_S)], &record[len]);
+    assert(strcmp(expected, rendered) == 0);
+}
+
+// Captures arguments like MYLOGGER_FEATURE_DEFERRED does. Returns record length, 0 if not captured.
+static size_t test_mylogger_deferred_capture(const char* format, ...)
+{
+    static char record[MYLOGGER_ASYNC_MESSAGE_MAX_SIZE];
+    const MyLogger_call_S call = {.level = MYLOGGER_LEVEL_INFO};
+
+    va_list args;
+    va_start(args, format);
+    const size_t len = __mylogger_capture(record, sizeof(record), &call, format, args);
+    va_end(args);
+    return len;
+}
+
+/**
+ * Testing MYLOGGER_FEATURE_DEFERRED argument capturing and rendering.
+ * */
+static void test_mylogger_deferred_render(void)
+{
+    char volatile_str[] = "changed later";
+
+    test_mylogger_deferred_check("no conversions");
+    test_mylogger_deferred_check("%d %i %u %x %X %o %c %%", -1, 42, 7u, 255u, 255u, 8u, 'a');
+    test_mylogger_deferred_check("%hhd %hd %ld %lu %lld %llu", -3, -300, -70000L, 70000UL, -1LL, 1ULL << 40);
+    test_mylogger_deferred_check("%zu %zd %td %jd %ju", (size_t)12, (ssize_t)-12, (ptrdiff_t)-5, (intmax_t)-9, (uintmax_t)9);
+    test_mylogger_deferred_check("%f %.3e %g %10.2f %-8.1f| %a %Lf", 3.14159, 1e-10, 0.5, 2.5, -1.25, 1.0, 2.5L);
+    test_mylogger_deferred_check("%*d|%-*d|%.*f|%*.*s|", 6, 42, 6, 42, 2, 1.23456, 8, 3, "abcdef");
+    test_mylogger_deferred_check("%s|%10s|%-10s|%.2s|%p", volatile_str, "ab", "ab", "abcdef", (void*)volatile_str);
+    const char* volatile null_str = NULL;
+    test_mylogger_deferred_check("%s", null_str);
+    test_mylogger_deferred_check("%#x %+d % d %05d", 255u, 5, 5, 5);
+
+    // Unsupported conversions are not captured
+    assert(test_mylogger_deferred_capture("%m") == 0);
+    assert(test_mylogger_deferred_capture("%1$d", 1) == 0);
+    assert(test_mylogger_deferred_capture("%ls", L"wide") == 0);
+    // conversion longer than the rendering buffer of one argument
+    assert(test_mylogger_deferred_capture("%------------------------------5d", 1) == 0);
+}
+
+/**
+ * Testing MyLogger deferred mode. Messages are formatted by the writer thread.
+ * */
+static void test_mylogger_deferred_log_to_file(void)
+{
+    FILE* f = fopen("test_deferred_log_file.txt", "w+");
+    assert(f != NULL);
+    assert(mylogger_init(f, MYLOGGER_FEATURE_DEFERRED | MYLOGGER_FEATURE_TIMESTAMPS) == MYLOGGER_INIT_SUCCESS);
+
+    char str[] = "original";
+    MYLOGGER_INFO("Test - deferred %s %d %.2f\n", str, 42, 0.125);
+    strcpy(str, "modified");    // string was copied, log has to contain original value
+    MYLOGGER_ERROR("Test - immediate %ls\n", L"wide");
+    MYLOGGER_FATAL("Test - fatal\n");
+    mylogger_destroy();
+
+    f = fopen("test_deferred_log_file.txt", "r");
+    assert(f != NULL);
+    char line[512];
+    assert(fgets(line, sizeof(line), f) != NULL);
+    assert(strstr(line, "[INFO] [") == line);
+    assert(strstr(line, "test_mylogger_deferred_log_to_file: Test - deferred original 42 0.12\n") != NULL);
+    assert(fgets(line, sizeof(line), f) != NULL);
+    assert(strstr(line, "Test - immediate") != NULL);
+    assert(fgets(line, sizeof(line), f) != NULL);
+    assert(strstr(line, "Test - fatal") != NULL);
+    fclose(f);
+    remove("test_deferred_log_file.txt");
+}
+
+static size_t g_evaluated_args = 0;
+static int test_mylogger_count_evaluation(void)
+{
+    return (int)g_evaluated_args++;
+}
+
+/**
+ * Testing runtime log level threshold. Arguments of skipped messages are not evaluated.
+ * */
+static void test_mylogger_level_threshold(void)
+{
+    FILE* f = fopen("test_level_log_file.txt", "w+");
+    assert(f != NULL);
+    assert(mylogger_init_config(&(mylogger_config_t){
+        .log_file = f,
+        .level = MYLOGGER_LEVEL_WARNING
+    }) == MYLOGGER_INIT_SUCCESS);
+    assert(mylogger_get_level() == MYLOGGER_LEVEL_WARNING);
+
+    MYLOGGER_DEBUG("Test - skipped %d\n", test_mylogger_count_evaluation());
+    MYLOGGER_INFO("Test - skipped %d\n", test_mylogger_count_evaluation());
+    MYLOGGER_WARNING("Test - logged %d\n", test_mylogger_count_evaluation());
+    assert(g_evaluated_args == 1);
+
+    mylogger_set_level(MYLOGGER_LEVEL_DEBUG);
+    MYLOGGER_DEBUG("Test - logged %d\n", test_mylogger_count_evaluation());
+    assert(g_evaluated_args == 2);
+    mylogger_destroy();
+
+    // after destroy every level is reported again
+    assert(mylogger_get_level() == MYLOGGER_LEVEL_DEBUG);
+
+    f = fopen("test_level_log_file.txt", "r");
+    assert(f != NULL);
+    size_t lines = 0;
+    char line[512];
+    while(fgets(line, sizeof(line), f) != NULL)
+        lines++;
+    fclose(f);
+    remove("test_level_log_file.txt");
+    assert(lines == 2);
+}
+
+static atomic_bool g_reader_entered;
+static atomic_bool g_reader_left;
+
+static void* test_mylogger_slow_reader(void* arg)
+{
+    (void)arg;
+    assert(__mylogger_enter() != NULL);
+    atomic_store(&g_reader_entered, true);
+    nanosleep(&(struct timespec){.tv_sec = 0, .tv_nsec = 50000000L}, NULL);
+    atomic_store(&g_reader_left, true);
+    __mylogger_leave();
+    return NULL;
+}
+
+/**
+ * Testing that mylogger_destroy waits until threads already using the instance leave the logger.
+ * */
+static void test_mylogger_destroy_waits_for_readers(void)
+{
+    // without membarrier (old kernel) readers and destroy use full fences
+    const bool membarrier = atomic_load(&g_mylogger_membarrier);
+    for(size_t m = 0; m < 2; m++)
+    {
+        atomic_store(&g_mylogger_membarrier, membarrier && m == 0);
+        atomic_store(&g_reader_entered, false);
+        atomic_store(&g_reader_left, false);
+        assert(mylogger_init(NULL, MYLOGGER_FEATURE_NO_FILE | MYLOGGER_FEATURE_STDOUT) == MYLOGGER_INIT_SUCCESS);
+
+        pthread_t reader;
+        assert(pthread_create(&reader, NULL, test_mylogger_slow_reader, NULL) == 0);
+        while(!atomic_load(&g_reader_entered))
+            sched_yield();
+
+        mylogger_destroy();
+        assert(atomic_load(&g_reader_left));
+        pthread_join(reader, NULL);
+    }
+    atomic_store(&g_mylogger_membarrier, membarrier);
+
+    // thread already exited, logger still works and new threads are registered
+    assert(mylogger_init(NULL, MYLOGGER_FEATURE_NO_FILE | MYLOGGER_FEATURE_STDOUT) == MYLOGGER_INIT_SUCCESS);
+    assert(__mylogger_enter() != NULL);
+    __mylogger_leave();
+    mylogger_destroy();
+    assert(__mylogger_enter() == NULL);
+    __mylogger_leave();
+}
+
+/**
+ * Testing timestamp layouts, precisions and clocks.
+ * */
+static void test_mylogger_timestamps(void)
+{
+    setenv("TZ", "UTC", 1);
+    tzset();
+
+    char buffer[64];
+    const struct timespec time = {.tv_sec = 1700000000, .tv_nsec = 123456789};    // 2023-11-14 22:13:20 UTC
+
+    MyLogger_timestamp_S options = {.format = MYLOGGER_TIMESTAMP_TIME, .precision = MYLOGGER_TIMESTAMP_USEC};
+    assert(__mylogger_add_timestamp(buffer, sizeof(buffer), &options, &time) == strlen("[22:13:20.123456] "));
+    assert(strcmp(buffer, "[22:13:20.123456] ") == 0);
+
+    options.precision = MYLOGGER_TIMESTAMP_NSEC;
+    __mylogger_add_timestamp(buffer, sizeof(buffer), &options, &time);
+    assert(strcmp(buffer, "[22:13:20.123456789] ") == 0);
+
+    options.format = MYLOGGER_TIMESTAMP_ISO8601;
+    options.precision = MYLOGGER_TIMESTAMP_USEC;
+    __mylogger_add_timestamp(buffer, sizeof(buffer), &options, &time);
+    assert(strcmp(buffer, "[2023-11-14T22:13:20.123456+00:00] ") == 0);
+
+    // next second and small buffer
+    const struct timespec next = {.tv_sec = 1700000001, .tv_nsec = 5000};
+    assert(__mylogger_add_timestamp(buffer, 12, &options, &next) == strlen("[2023-11-14T22:13:21.000005+00:00] "));
+    assert(strcmp(buffer, "[2023-11-14") == 0);
+
+    // every clock has to be close to CLOCK_REALTIME
+    for(mylogger_clock_t clock = MYLOGGER_CLOCK_REALTIME; clock <= MYLOGGER_CLOCK_TSC; clock++)
+    {
+        FILE* f = fopen("test_timestamp_log_file.txt", "w+");
+        assert(f != NULL);
+        assert(mylogger_init_config(&(mylogger_config_t){
+            .log_file = f,
+            .features = MYLOGGER_FEATURE_TIMESTAMPS,
+            .clock = clock,
+            .timestamp_format = MYLOGGER_TIMESTAMP_ISO8601,
+            .timestamp_precision = MYLOGGER_TIMESTAMP_NSEC
+        }) == MYLOGGER_INIT_SUCCESS);
+
+        struct timespec now, real;
+        __mylogger_clock_now(&atomic_load(&g_mylogger_instance)->timestamp, &now);
+        clock_gettime(CLOCK_REALTIME, &real);
+        assert(real.tv_sec - now.tv_sec <= 1 && now.tv_sec - real.tv_sec <= 1);
+
+        MYLOGGER_INFO("Test - clock %d\n", (int)clock);
+        mylogger_destroy();
+        remove("test_timestamp_log_file.txt");
+    }
+
+#if defined(__x86_64__) || defined(__i386__)
+    // stopped TSC falls back to CLOCK_REALTIME
+    MyLogger_timestamp_S tsc = {.clock = MYLOGGER_CLOCK_TSC};
+    g_rdtsc_mock_stopped = true;
+    __mylogger_clock_init(&tsc);
+    g_rdtsc_mock_stopped = false;
+    assert(tsc.clock == MYLOGGER_CLOCK_REALTIME);
+#endif
+
+    unsetenv("TZ");
+    tzset();
+}
+
+// Captures arguments of the call into a record of the given size. Returns record length, 0 if not captured.
+static size_t test_mylogger_tag_capture(const MyLogger_call_S* call, size_t size, const char* format, ...)
+{
+    static char record[MYLOGGER_ASYNC_MESSAGE_MAX_SIZE];
+
+    va_list args;
+    va_start(args, format);
+    const size_t len = __mylogger_capture(record, size, call, format, args);
+    va_end(args);
+    return len;
+}
+
+/**
+ * Testing cached TID tag, thread names and tag invalidation after fork.
+ * */
+static void test_mylogger_thread_tag(void)
+{
+    FILE* f = fopen("test_tid_log_file.txt", "w+");
+    assert(f != NULL);
+    assert(mylogger_init(f, MYLOGGER_FEATURE_THREAD_ID) == MYLOGGER_INIT_SUCCESS);
+    MyLogger_instance_S* instance = atomic_load(&g_mylogger_instance);
+
+    char expected[MYLOGGER_TID_TAG_MAX_SIZE];
+    MyLogger_call_S call;
+
+    mylogger_set_thread_name("main-thread");
+    __mylogger_call_init(instance, &call, __FILE__, __func__, __LINE__, MYLOGGER_LEVEL_INFO);
+    snprintf(expected, sizeof(expected), "[TID: %ld main-thread]", (long)syscall(__NR_gettid));
+    assert(call.tid_tag_len == strlen(expected) && memcmp(call.tid_tag, expected, call.tid_tag_len) == 0);
+    MYLOGGER_INFO("Test - named thread\n");
+
+    pid_t child = fork();
+    assert(child >= 0);
+    if(child == 0)
+    {
+        __mylogger_call_init(instance, &call, __FILE__, __func__, __LINE__, MYLOGGER_LEVEL_INFO);
+        snprintf(expected, sizeof(expected), "[TID: %ld main-thread]", (long)syscall(__NR_gettid));
+        _exit(call.tid_tag_len == strlen(expected) && memcmp(call.tid_tag, expected, call.tid_tag_len) == 0 ? 0 : 1);
+    }
+    int status;
+    assert(waitpid(child, &status, 0) == child);
+    assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+
+    mylogger_set_thread_name(NULL);
+    __mylogger_call_init(instance, &call, __FILE__, __func__, __LINE__, MYLOGGER_LEVEL_INFO);
+    snprintf(expected, sizeof(expected), "[TID: %ld]", (long)syscall(__NR_gettid));
+    assert(call.tid_tag_len == strlen(expected) && memcmp(call.tid_tag, expected, call.tid_tag_len) == 0);
+    // deferred record carries the tag, record without space for it is not captured
+    assert(test_mylogger_tag_capture(&call, MYLOGGER_ASYNC_MESSAGE_MAX_SIZE, "Test - %d\n", 1) > 0);
+    assert(test_mylogger_tag_capture(&call, sizeof(MyLogger_deferred_S) + call.tid_tag_len - 1, "Test - %d\n", 1) == 0);
+    mylogger_destroy();
+
+    f = fopen("test_tid_log_file.txt", "r");
+    assert(f != NULL);
+    char line[512];
+    assert(fgets(line, sizeof(line), f) != NULL);
+    assert(strstr(line, " main-thread]test/main.c:") != NULL);
+    fclose(f);
+    remove("test_tid_log_file.txt");
+}
+
+// Logs message with payload_len characters and returns length of the longest line in the log file.
+static size_t test_mylogger_log_long_message(mylogger_feature_t features, size_t payload_len, bool* truncated)
+{
+    FILE* f = fopen("test_long_log_file.txt", "w+");
+    assert(f != NULL);
+    assert(mylogger_init(f, features) == MYLOGGER_INIT_SUCCESS);
+
+    char* payload = malloc(payload_len + 1);
+    assert(payload != NULL);
+    memset(payload, 'x', payload_len);
+    payload[payload_len] = '\0';
+    MYLOGGER_INFO("%s\n", payload);
+    free(payload);
+    mylogger_destroy();
+
+    f = fopen("test_long_log_file.txt", "r");
+    assert(f != NULL);
+    size_t len = 0;
+    int c;
+    while((c = fgetc(f)) != EOF && c != '\n')
+        len++;
+    assert(c == '\n');
+    fclose(f);
+
+    f = fopen("test_long_log_file.txt", "r");
+    char tail[64] = {0};
+    fseek(f, -(long)strlen(MYLOGGER_TRUNCATED_MARK), SEEK_END);
+    assert(fgets(tail, sizeof(tail), f) != NULL);
+    *truncated = strcmp(tail, MYLOGGER_TRUNCATED_MARK) == 0;
+    fclose(f);
+    remove("test_long_log_file.txt");
+    return len;
+}
+
+/**
+ * Testing messages longer than the initial per-thread buffer.
+ * */
+static void test_mylogger_long_messages(void)
+{
+    bool truncated;
+
+    // buffer grows, whole message is written
+    assert(test_mylogger_log_long_message(0, 3 * MYLOGGER_THREAD_BUFFER_SIZE, &truncated) > 3 * MYLOGGER_THREAD_BUFFER_SIZE);
+    assert(!truncated);
+
+    // longer than the limit, truncated with a mark
+    assert(test_mylogger_log_long_message(0, 2 * MYLOGGER_MESSAGE_MAX_SIZE, &truncated) < MYLOGGER_MESSAGE_MAX_SIZE);
+    assert(truncated);
+
+    // async messages are limited by MYLOGGER_ASYNC_MESSAGE_MAX_SIZE
+    assert(test_mylogger_log_long_message(MYLOGGER_FEATURE_ASYNC, 2 * MYLOGGER_ASYNC_MESSAGE_MAX_SIZE, &truncated) < MYLOGGER_ASYNC_MESSAGE_MAX_SIZE);
+    assert(truncated);
+
+    // message that fills the buffer exactly is not truncated
+    const size_t prefix_len = test_mylogger_log_long_message(0, 0, &truncated);
+    assert(test_mylogger_log_long_message(0, MYLOGGER_MESSAGE_MAX_SIZE - 2 - prefix_len, &truncated) == MYLOGGER_MESSAGE_MAX_SIZE - 2);
+    assert(!truncated);
+    assert(test_mylogger_log_long_message(0, MYLOGGER_MESSAGE_MAX_SIZE - 1 - prefix_len, &truncated) == MYLOGGER_MESSAGE_MAX_SIZE - 2);
+    assert(truncated);
+    assert(test_mylogger_log_long_message(MYLOGGER_FEATURE_ASYNC, MYLOGGER_ASYNC_MESSAGE_MAX_SIZE - 2 - prefix_len, &truncated) == MYLOGGER_ASYNC_MESSAGE_MAX_SIZE - 2);
+    assert(!truncated);
+
+    // buffer cannot be allocated, message is truncated to the fallback buffer
+    MOCK_FAIL_AT(g_realloc_mock_counter, 1);
+    assert(test_mylogger_log_long_message(0, MYLOGGER_THREAD_BUFFER_SIZE, &truncated) < MYLOGGER_FALLBACK_BUFFER_SIZE);
+    assert(truncated);
+}
+
+typedef struct test_sink_t
+{
+    char data[4096];
+    size_t len;
+    size_t writes;
+    bool closed;
+} test_sink_t;
+
+static void test_sink_write(void* user_data, const char* data, size_t len)
+{
+    test_sink_t* sink = user_data;
+    assert(sink->len + len <= sizeof(sink->data));
+    memcpy(&sink->data[sink->len], data, len);
+    sink->len += len;
+    // flusher thread writes while the test polls
+    __atomic_store_n(&sink->writes, sink->writes + 1, __ATOMIC_RELEASE);
+}
+
+static void test_sink_close(void* user_data)
+{
+    ((test_sink_t*)user_data)->closed = true;
+}
+
+/**
+ * Testing custom sinks and flush policy. Messages are batched until ERROR or destroy.
+ * */
+static void test_mylogger_custom_sinks(void)
+{
+    static test_sink_t batched;
+    static test_sink_t unbatched;
+    const mylogger_sink_t sinks[] = {
+        {.write = test_sink_write, .close = test_sink_close, .user_data = &batched},
+        {.write = test_sink_write, .user_data = &unbatched}
+    };
+
+    // more custom sinks than supported
+    assert(mylogger_init_config(&(mylogger_config_t){
+        .features = MYLOGGER_FEATURE_NO_FILE,
+        .sinks = sinks,
+        .sinks_count = MYLOGGER_CUSTOM_SINKS_MAX + 1
+    }) == MYLOGGER_INIT_OTHER_ERROR);
+    // sink without write function
+    assert(mylogger_init_config(&(mylogger_config_t){
+        .features = MYLOGGER_FEATURE_NO_FILE,
+        .sinks = &(mylogger_sink_t){.close = test_sink_close, .user_data = &batched},
+        .sinks_count = 1
+    }) == MYLOGGER_INIT_OTHER_ERROR);
+
+    assert(mylogger_init_config(&(mylogger_config_t){
+        .features = MYLOGGER_FEATURE_NO_FILE,
+        .flush = {.size = 256},
+        .sinks = sinks,
+        .sinks_count = 1
+    }) == MYLOGGER_INIT_SUCCESS);
+    MYLOGGER_INFO("Test - batched 1\n");
+    MYLOGGER_WARNING("Test - batched 2\n");
+    assert(batched.writes == 0);
+    MYLOGGER_ERROR("Test - flushed\n");
+    assert(batched.writes == 1);
+    assert(strstr(batched.data, "Test - batched 1") < strstr(batched.data, "Test - flushed"));
+
+    // batch overflow writes batch and message together
+    for(size_t i = 0; i < 20; i++)
+        MYLOGGER_INFO("Test - overflow %zu\n", i);
+    assert(batched.writes > 1);
+    const size_t writes = batched.writes;
+    MYLOGGER_INFO("Test - last\n");
+    assert(!batched.closed);
+    mylogger_destroy();
+    assert(batched.closed);
+    assert(batched.writes > writes);
+    assert(batched.len > 0 && strstr(batched.data, "Test - last\n") != NULL);
+
+    // expired batch is written without another log call
+    batched = (test_sink_t){0};
+    assert(mylogger_init_config(&(mylogger_config_t){
+        .features = MYLOGGER_FEATURE_NO_FILE,
+        .flush = {.size = 256, .interval_ms = 10},
+        .sinks = sinks,
+        .sinks_count = 1
+    }) == MYLOGGER_INIT_SUCCESS);
+    MYLOGGER_INFO("Test - expired\n");
+    for(size_t i = 0; i < 1000 && __atomic_load_n(&batched.writes, __ATOMIC_ACQUIRE) == 0; i++)
+        nanosleep(&(struct timespec){.tv_sec = 0, .tv_nsec = 1000000}, NULL);
+    assert(__atomic_load_n(&batched.writes, __ATOMIC_ACQUIRE) == 1);
+    mylogger_destroy();
+    assert(batched.writes == 1 && strstr(batched.data, "Test - expired\n") != NULL);
+
+    // explicit DEBUG flush level writes every message
+    batched = (test_sink_t){0};
+    assert(mylogger_init_config(&(mylogger_config_t){
+        .features = MYLOGGER_FEATURE_NO_FILE,
+        .flush = {.size = 256, .level = MYLOGGER_LEVEL_DEBUG, .level_set = true},
+        .sinks = sinks,
+        .sinks_count = 1
+    }) == MYLOGGER_INIT_SUCCESS);
+    MYLOGGER_DEBUG("Test - debug flushed\n");
+    assert(batched.writes == 1);
+    mylogger_destroy();
+
+    // every message written immediately, also from the writer thread
+    assert(mylogger_init_config(&(mylogger_config_t){
+        .features = MYLOGGER_FEATURE_NO_FILE | MYLOGGER_FEATURE_ASYNC,
+        .flush = {.size = 1},
+        .sinks = &sinks[1],
+        .sinks_count = 1
+    }) == MYLOGGER_INIT_SUCCESS);
+    MYLOGGER_DEBUG("Test - one\n");
+    MYLOGGER_DEBUG("Test - two\n");
+    mylogger_destroy();
+    assert(unbatched.writes == 2);
+
+    // interrupted and short writes of the log file are continued
+    FILE* f = fopen("test_sinks_log_file.txt", "w+");
+    assert(f != NULL);
+    assert(mylogger_init_config(&(mylogger_config_t){.log_file = f, .flush = {.size = 1}}) == MYLOGGER_INIT_SUCCESS);
+    MOCK_FAIL_AT(g_writev_mock_counter, 1);
+    g_writev_mock_max = 7;
+    MYLOGGER_INFO("Test - short writes\n");
+    g_writev_mock_max = SIZE_MAX;
+    mylogger_destroy();
+    f = fopen("test_sinks_log_file.txt", "r");
+    assert(f != NULL);
+    char line[512];
+    assert(fgets(line, sizeof(line), f) != NULL && strstr(line, "Test - short writes\n") != NULL);
+    assert(fgets(line, sizeof(line), f) == NULL);
+    fclose(f);
+
+    // failed write loses the message, next one is written
+    f = fopen("test_sinks_log_file.txt", "w+");
+    assert(f != NULL);
+    assert(mylogger_init_config(&(mylogger_config_t){.log_file = f, .flush = {.size = 1}}) == MYLOGGER_INIT_SUCCESS);
+    MOCK_FAIL_AT(g_writev_mock_counter, 1);
+    g_writev_mock_errno = EIO;
+    MYLOGGER_INFO("Test - lost write\n");
+    g_writev_mock_errno = EINTR;
+    MYLOGGER_INFO("Test - next write\n");
+    mylogger_destroy();
+    f = fopen("test_sinks_log_file.txt", "r");
+    assert(f != NULL);
+    assert(fgets(line, sizeof(line), f) != NULL && strstr(line, "Test - next write\n") != NULL);
+    assert(fgets(line, sizeof(line), f) == NULL);
+    fclose(f);
+    remove("test_sinks_log_file.txt");
+
+    // every failure of the initialization is cleaned up, log file created by MyLogger is closed
+    test_mylogger_init_failures(&(mylogger_config_t){
+        .flush = {.interval_ms = 10},
+        .sinks = sinks,
+        .sinks_count = 1
+    });
+}
+
+static void* test_mylogger_mmap_worker(void* arg)
+{
+    const size_t id = (size_t)arg;
+    for(size_t i = 0; i < TEST_ASYNC_MESSAGES_PER_THREAD; i++)
+        MYLOGGER_INFO("Test - mmap %zu %zu\n", id, i);
+    return NULL;
+}
+
+/**
+ * Testing MyLogger memory mapped file. Regions are one page so messages often span two mappings.
+ * File has to contain previous content, every message and nothing else.
+ * */
+static void test_mylogger_mmap_log_to_file(void)
+{
+    const mylogger_feature_t modes[] = {MYLOGGER_FEATURE_MMAP,
+                                        MYLOGGER_FEATURE_MMAP | MYLOGGER_FEATURE_ASYNC,
+                                        MYLOGGER_FEATURE_MMAP | MYLOGGER_FEATURE_ASYNC | MYLOGGER_FEATURE_DEFERRED};
+    for(size_t m = 0; m < sizeof(modes) / sizeof(modes[0]); m++)
+    {
+        FILE* f = fopen("test_mmap_log_file.txt", "w+");
+        assert(f != NULL);
+        fprintf(f, "Test - existing content\n");
+        assert(mylogger_init_config(&(mylogger_config_t){
+            .log_file = f,
+            .features = modes[m],
+            .mmap_region_size = 1
+        }) == MYLOGGER_INIT_SUCCESS);
+
+        pthread_t threads[TEST_ASYNC_THREADS];
+        for(size_t i = 0; i < TEST_ASYNC_THREADS; i++)
+            assert(pthread_create(&threads[i], NULL, test_mylogger_mmap_worker, (void*)i) == 0);
+        for(size_t i = 0; i < TEST_ASYNC_THREADS; i++)
+            pthread_join(threads[i], NULL);
+        mylogger_destroy();
+
+        f = fopen("test_mmap_log_file.txt", "r");
+        assert(f != NULL);
+        size_t lines = 0;
+        size_t bytes = 0;
+        char line[512];
+        while(fgets(line, sizeof(line), f) != NULL)
+        {
+            const size_t len = strlen(line);
+            assert(len > 0 && line[len - 1] == '\n');
+            assert(lines == 0 ? strcmp(line, "Test - existing content\n") == 0 : strstr(line, "Test - mmap ") != NULL);
+            bytes += len;
+            lines++;
+        }
+        // no zeros left from preallocation
+        assert(ftell(f) == (long)bytes);
+        fclose(f);
+        remove("test_mmap_log_file.txt");
+        assert(lines == 1 + TEST_ASYNC_THREADS * TEST_ASYNC_MESSAGES_PER_THREAD);
+    }
+
+    // file cannot grow past the limit, it keeps whole messages written before the failure
+    {
+        struct rlimit limit;
+        assert(getrlimit(RLIMIT_FSIZE, &limit) == 0);
+        struct rlimit small = {.rlim_cur = 4 * (rlim_t)sysconf(_SC_PAGESIZE), .rlim_max = limit.rlim_max};
+        void (*previous)(int) = signal(SIGXFSZ, SIG_IGN);
+        FILE* f = fopen("test_mmap_log_file.txt", "w+");
+        assert(f != NULL);
+        assert(mylogger_init_config(&(mylogger_config_t){
+            .log_file = f,
+            .features = MYLOGGER_FEATURE_MMAP,
+            .mmap_region_size = 1
+        }) == MYLOGGER_INIT_SUCCESS);
+        assert(setrlimit(RLIMIT_FSIZE, &small) == 0);
+
+        pthread_t threads[TEST_ASYNC_THREADS];
+        for(size_t i = 0; i < TEST_ASYNC_THREADS; i++)
+            assert(pthread_create(&threads[i], NULL, test_mylogger_mmap_worker, (void*)i) == 0);
+        for(size_t i = 0; i < TEST_ASYNC_THREADS; i++)
+            pthread_join(threads[i], NULL);
+        mylogger_destroy();
+        assert(setrlimit(RLIMIT_FSIZE, &limit) == 0);
+        signal(SIGXFSZ, previous);
+
+        f = fopen("test_mmap_log_file.txt", "r");
+        assert(f != NULL);
+        size_t lines = 0;
+        size_t bytes = 0;
+        char line[512];
+        while(fgets(line, sizeof(line), f) != NULL)
+        {
+            const size_t len = strlen(line);
+            assert(len > 0 && line[len - 1] == '\n' && strstr(line, "Test - mmap ") != NULL);
+            bytes += len;
+            lines++;
+        }
+        assert(ftell(f) == (long)bytes);
+        assert(bytes <= small.rlim_cur && lines > 0 && lines < TEST_ASYNC_THREADS * TEST_ASYNC_MESSAGES_PER_THREAD);
+        fclose(f);
+        remove("test_mmap_log_file.txt");
+    }
+
+    // next region cannot be mapped, file keeps messages of the first region
+    {
+        FILE* f = fopen("test_mmap_log_file.txt", "w+");
+        assert(f != NULL);
+        assert(mylogger_init_config(&(mylogger_config_t){
+            .log_file = f,
+            .features = MYLOGGER_FEATURE_MMAP,
+            .mmap_region_size = 1
+        }) == MYLOGGER_INIT_SUCCESS);
+        MyLogger_mmap_S* map = &atomic_load(&g_mylogger_instance)->mmap;
+        MOCK_FAIL_AT(g_mmap_mock_counter, 1);
+        for(size_t i = 0; i < 2 * map->region_size / 32; i++)
+            MYLOGGER_INFO("Test - mmap %zu\n", i);
+        MOCK_RESET(g_mmap_mock_counter);
+        // threads that waited for a region give up too
+        assert(__mylogger_mmap_region(map, 2) == NULL);
+        const size_t region_size = map->region_size;
+        mylogger_destroy();
+
+        f = fopen("test_mmap_log_file.txt", "r");
+        assert(f != NULL);
+        size_t lines = 0;
+        char line[512];
+        while(fgets(line, sizeof(line), f) != NULL)
+        {
+            assert(strstr(line, "Test - mmap ") != NULL && line[strlen(line) - 1] == '\n');
+            lines++;
+        }
+        assert(lines > 0 && ftell(f) <= (long)region_size);
+        fclose(f);
+        remove("test_mmap_log_file.txt");
+    }
+
+    // mapping needs a regular file opened for reading and writing
+    FILE* f = fopen("test_mmap_log_file.txt", "w");
+    assert(f != NULL);
+    assert(mylogger_init(f, MYLOGGER_FEATURE_MMAP) == MYLOGGER_INIT_FILE_CREATION_ERROR);
+    fclose(f);
+    remove("test_mmap_log_file.txt");
+    f = fopen("/dev/null", "r+");
+    assert(f != NULL);
+    assert(mylogger_init(f, MYLOGGER_FEATURE_MMAP) == MYLOGGER_INIT_FILE_CREATION_ERROR);
+    fclose(f);
+
+    // every failure of the initialization is cleaned up, mapped file is created by MyLogger
+    test_mylogger_init_failures(&(mylogger_config_t){.features = MYLOGGER_FEATURE_MMAP});
+}
+
+#define TEST_ROTATION_MAX_SIZE  1000
+#define TEST_ROTATION_KEEP      2
+
+/**
+ * Counts lines of the log file, checks that it is not bigger than TEST_ROTATION_MAX_SIZE.
+ * */
+static size_t test_mylogger_rotated_lines(const char* name, bool compressed)
+{
+    char line[512];
+    size_t lines = 0;
+    size_t bytes = 0;
+    if(!compressed)
+    {
+        FILE* f = fopen(name, "r");
+        assert(f != NULL);
+        while(fgets(line, sizeof(line), f) != NULL)
+        {
+            bytes += strlen(line);
+            lines++;
+        }
+        fclose(f);
+    }
+#ifdef MYLOGGER_WITH_ZLIB
+    else
+    {
+        gzFile f = gzopen(name, "rb");
+        assert(f != NULL);
+        while(gzgets(f, line, sizeof(line)) != NULL)
+        {
+            bytes += strlen(line);
+            lines++;
+        }
+        gzclose(f);
+    }
+#endif
+    assert(bytes <= TEST_ROTATION_MAX_SIZE);
+    return lines;
+}
+
+/**
+ * Testing rotation of the created log file by size and by time, retention and compression.
+ * */
+static void test_mylogger_rotation(void)
+{
+#ifdef MYLOGGER_WITH_ZLIB
+    const mylogger_compression_t compression = MYLOGGER_COMPRESSION_GZIP;
+#else
+    const mylogger_compression_t compression = MYLOGGER_COMPRESSION_NONE;
+#endif
+    char name[MYLOGGER_FILE_NAME_MAX_SIZE + 32];
+
+    // only the file created by MyLogger can be rotated
+    FILE* f = fopen("test_rotation_log_file.txt", "w");
+    assert(f != NULL);
+    assert(mylogger_init_config(&(mylogger_config_t){
+        .log_file = f,
+        .rotation = {.max_size = TEST_ROTATION_MAX_SIZE}
+    }) == MYLOGGER_INIT_OTHER_ERROR);
+    fclose(f);
+    remove("test_rotation_log_file.txt");
+
+    assert(mylogger_init_config(&(mylogger_config_t){
+        .rotation = {.max_size = TEST_ROTATION_MAX_SIZE, .keep = TEST_ROTATION_KEEP, .compression = compression}
+    }) == MYLOGGER_INIT_SUCCESS);
+    MyLogger_instance_S* instance = atomic_load(&g_mylogger_instance);
+    const MyLogger_rotation_S rotation = instance->rotation;
+    for(size_t i = 0; i < 200; i++)
+    {
+        // rotation thread opens next file ahead of time, file grows over the limit until it is ready
+        pthread_mutex_lock(&instance->rotation.mutex);
+        while(instance->rotation.next_fd < 0)
+        {
+            pthread_mutex_unlock(&instance->rotation.mutex);
+            nanosleep(&(struct timespec){.tv_sec = 0, .tv_nsec = 1000000L}, NULL);
+            pthread_mutex_lock(&instance->rotation.mutex);
+        }
+        pthread_mutex_unlock(&instance->rotation.mutex);
+        MYLOGGER_INFO("Test - rotation %zu\n", i);
+    }
+    const uint32_t last = instance->rotation.active_seq;
+    mylogger_destroy();
+    assert(last > TEST_ROTATION_KEEP);
+
+    // active file, TEST_ROTATION_KEEP rotated and compressed files, nothing else
+    __mylogger_rotation_file_name(&rotation, last, name, sizeof(name));
+    size_t lines = test_mylogger_rotated_lines(name, false);
+    remove(name);
+    for(uint32_t seq = last - TEST_ROTATION_KEEP; seq < last; seq++)
+    {
+        __mylogger_rotation_file_name(&rotation, seq, name, sizeof(name));
+        if(compression != MYLOGGER_COMPRESSION_NONE)
+        {
+            assert(access(name, F_OK) != 0);
+            strcat(name, ".gz");
+        }
+        lines += test_mylogger_rotated_lines(name, compression != MYLOGGER_COMPRESSION_NONE);
+        remove(name);
+    }
+    assert(lines > 0 && lines < 200);
+    for(uint32_t seq = 0; seq < last - TEST_ROTATION_KEEP; seq++)
+    {
+        __mylogger_rotation_file_name(&rotation, seq, name, sizeof(name));
+        assert(access(name, F_OK) != 0);
+        strcat(name, ".gz");
+        assert(access(name, F_OK) != 0);
+    }
+    // file opened ahead of time is removed
+    __mylogger_rotation_file_name(&rotation, last + 1, name, sizeof(name));
+    assert(access(name, F_OK) != 0);
+
+    // rotation by time
+    assert(mylogger_init_config(&(mylogger_config_t){
+        .rotation = {.interval_s = 1}
+    }) == MYLOGGER_INIT_SUCCESS);
+    instance = atomic_load(&g_mylogger_instance);
+    MYLOGGER_INFO("Test - before interval\n");
+    nanosleep(&(struct timespec){.tv_sec = 1, .tv_nsec = 200000000L}, NULL);
+    MYLOGGER_INFO("Test - after interval\n");
+    assert(instance->rotation.active_seq == 1);
+    const MyLogger_rotation_S interval_rotation = instance->rotation;
+    mylogger_destroy();
+    for(uint32_t seq = 0; seq <= 1; seq++)
+    {
+        __mylogger_rotation_file_name(&interval_rotation, seq, name, sizeof(name));
+        assert(test_mylogger_rotated_lines(name, false) == 1);
+        remove(name);
+    }
+
+    // next file cannot be opened, rotation thread tries again later and stops meanwhile
+    MOCK_FAIL_AT(g_open_mock_counter, 1);
+    assert(mylogger_init_config(&(mylogger_config_t){
+        .rotation = {.max_size = TEST_ROTATION_MAX_SIZE}
+    }) == MYLOGGER_INIT_SUCCESS);
+    instance = atomic_load(&g_mylogger_instance);
+    while(__atomic_load_n(&g_open_mock_counter, __ATOMIC_ACQUIRE) == 0)
+        sched_yield();
+    nanosleep(&(struct timespec){.tv_sec = 0, .tv_nsec = 10000000L}, NULL);
+    MYLOGGER_INFO("Test - without next file\n");
+    strcpy(name, instance->file_name);
+    mylogger_destroy();
+    assert(test_mylogger_rotated_lines(name, false) == 1);
+    remove(name);
+
+    // file opened ahead of time is removed with the logger
+    assert(mylogger_init_config(&(mylogger_config_t){
+        .rotation = {.max_size = TEST_ROTATION_MAX_SIZE}
+    }) == MYLOGGER_INIT_SUCCESS);
+    instance = atomic_load(&g_mylogger_instance);
+    int next_fd = -1;
+    while(next_fd < 0)
+    {
+        pthread_mutex_lock(&instance->rotation.mutex);
+        next_fd = instance->rotation.next_fd;
+        pthread_mutex_unlock(&instance->rotation.mutex);
+        sched_yield();
+    }
+    const MyLogger_rotation_S ahead_rotation = instance->rotation;
+    strcpy(name, instance->file_name);
+    mylogger_destroy();
+    remove(name);
+    __mylogger_rotation_file_name(&ahead_rotation, ahead_rotation.next_seq, name, sizeof(name));
+    assert(access(name, F_OK) != 0);
+
+    // unknown compression, size of the log file unknown
+    assert(mylogger_init_config(&(mylogger_config_t){
+        .rotation = {.max_size = TEST_ROTATION_MAX_SIZE, .compression = (mylogger_compression_t)-1}
+    }) == MYLOGGER_INIT_OTHER_ERROR);
+    MOCK_FAIL_AT(g_fstat_mock_counter, 1);
+    assert(mylogger_init_config(&(mylogger_config_t){
+        .rotation = {.max_size = TEST_ROTATION_MAX_SIZE}
+    }) == MYLOGGER_INIT_OTHER_ERROR);
+
+#ifdef MYLOGGER_WITH_ZLIB
+    // file is kept when it cannot be compressed
+    f = fopen("test_rotation_log_file.txt", "w");
+    assert(f != NULL);
+    fclose(f);
+    assert(!__mylogger_compress_file("test_rotation_missing_file.txt", MYLOGGER_COMPRESSION_GZIP));
+    MOCK_FAIL_AT(g_malloc_mock_counter, 1);
+    assert(!__mylogger_compress_file("test_rotation_log_file.txt", MYLOGGER_COMPRESSION_GZIP));
+    assert(symlink("/nonexistent/directory", "test_rotation_log_file.txt.gz") == 0);
+    assert(!__mylogger_compress_file("test_rotation_log_file.txt", MYLOGGER_COMPRESSION_GZIP));
+    assert(access("test_rotation_log_file.txt", F_OK) == 0);
+    remove("test_rotation_log_file.txt.gz");
+    remove("test_rotation_log_file.txt");
+#endif
+
+    // every failure of the initialization is cleaned up
+    test_mylogger_init_failures(&(mylogger_config_t){
+        .rotation = {.max_size = TEST_ROTATION_MAX_SIZE}
+    });
+}
+
+/**
+ * Logs the same messages in the current mode. Every call site is used twice.
+ * */
+static void test_mylogger_log_binary_messages(void)
+{
+    const char* volatile null_str = NULL;
+    for(int i = 0; i < 2; i++)
+    {
+        MYLOGGER_DEBUG("Test - no arguments\n");
+        MYLOGGER_INFO("Test - %d %u %ld %zu %lld %x %c %%\n", -i, 7u, -70000L, (size_t)i, 1LL << 40, 255u, 'a');
+        MYLOGGER_WARNING("Test - %f %.3e %10.2f %Lf\n", 3.14159, 1e-10, 2.5, 2.5L);
+        MYLOGGER_ERROR("Test - %s|%10s|%.2s|%*d|%s\n", "str", "ab", "abcdef", 6, 42, null_str);
+        MYLOGGER_CRITICAL("Test - %ls\n", L"not captured");
+    }
+}
+
+// Decodes session of the given records. Returns result of mylogger_decode.
+static int test_mylogger_decode_records(const void* records, size_t len)
+{
+    const MyLogger_binary_header_S header = {.len = sizeof(MyLogger_binary_file_S), .kind = MYLOGGER_BINARY_FILE};
+    MyLogger_binary_file_S session = {.version = MYLOGGER_BINARY_VERSION};
+    memcpy(session.magic, MYLOGGER_BINARY_MAGIC, sizeof(session.magic));
+
+    FILE* in = tmpfile();
+    FILE* out = tmpfile();
+    assert(in != NULL && out != NULL);
+    fwrite(&header, 1, sizeof(header), in);
+    fwrite(&session, 1, sizeof(session), in);
+    if(len > 0)
+        fwrite(records, 1, len, in);
+    rewind(in);
+    const int ret = mylogger_decode(in, out);
+    fclose(in);
+    fclose(out);
+    return ret;
+}
+
+// Writes SITE record of file "f", function "g" and the format, then MESSAGE record with the arguments.
+// Returns length of the records, strings of the site start at TEST_SITE_STRINGS.
+#define TEST_SITE_STRINGS (sizeof(MyLogger_binary_header_S) + sizeof(MyLogger_binary_site_S))
+static size_t test_mylogger_site_message(char* records, const char* format, const void* args, size_t args_len)
+{
+    const MyLogger_binary_site_S site = {.file_len = 1, .func_len = 1, .format_len = (uint32_t)strlen(format)};
+    MyLogger_binary_header_S header = {.len = (uint32_t)(sizeof(site) + site.format_len + 5), .kind = MYLOGGER_BINARY_SITE};
+    size_t len = 0;
+    memcpy(&records[len], &header, sizeof(header));
+    len += sizeof(header);
+    memcpy(&records[len], &site, sizeof(site));
+    len += sizeof(site);
+    memcpy(&records[len], "f\0g", 4);
+    memcpy(&records[len + 4], format, site.format_len + 1);
+    len += site.format_len + 5;
+
+    const MyLogger_binary_message_S message = {0};
+    header = (MyLogger_binary_header_S){.len = (uint32_t)(sizeof(message) + args_len), .kind = MYLOGGER_BINARY_MESSAGE};
+    memcpy(&records[len], &header, sizeof(header));
+    len += sizeof(header);
+    memcpy(&records[len], &message, sizeof(message));
+    len += sizeof(message);
+    if(args_len > 0)
+        memcpy(&records[len], args, args_len);
+    return len + args_len;
+}
+
+/**
+ * Testing binary log file. Decoded file has to be the same as text log of the same calls.
+ * */
+static void test_mylogger_binary_log(void)
+{
+    // binary records can go only to the log file
+    assert(mylogger_init(NULL, MYLOGGER_FEATURE_BINARY | MYLOGGER_FEATURE_STDOUT | MYLOGGER_FEATURE_NO_FILE) == MYLOGGER_INIT_OTHER_ERROR);
+
+    const mylogger_feature_t modes[] = {0, MYLOGGER_FEATURE_ASYNC, MYLOGGER_FEATURE_MMAP};
+    for(size_t m = 0; m < sizeof(modes) / sizeof(modes[0]); m++)
+    {
+        FILE* f = fopen("test_text_log_file.txt", "w+");
+        assert(f != NULL);
+        assert(mylogger_init(f, 0) == MYLOGGER_INIT_SUCCESS);
+        test_mylogger_log_binary_messages();
+        mylogger_destroy();
+
+        // two sessions in one file
+        f = fopen("test_binary_log_file.bin", "w+");
+        assert(f != NULL);
+        assert(mylogger_init(f, MYLOGGER_FEATURE_BINARY | modes[m]) == MYLOGGER_INIT_SUCCESS);
+        test_mylogger_log_binary_messages();
+        mylogger_destroy();
+        f = fopen("test_binary_log_file.bin", "a+");
+        assert(f != NULL);
+        assert(mylogger_init(f, MYLOGGER_FEATURE_BINARY | modes[m]) == MYLOGGER_INIT_SUCCESS);
+        test_mylogger_log_binary_messages();
+        mylogger_destroy();
+
+        static char text[8192];
+        static char decoded[16384];
+        f = fopen("test_text_log_file.txt", "r");
+        assert(f != NULL);
+        const size_t text_len = fread(text, 1, sizeof(text), f);
+        fclose(f);
+
+        FILE* in = fopen("test_binary_log_file.bin", "r");
+        FILE* out = fopen("test_decoded_log_file.txt", "w+");
+        assert(in != NULL && out != NULL);
+        assert(mylogger_decode(in, out) == 0);
+        fseek(in, 0, SEEK_END);
+        rewind(out);
+        const size_t decoded_len = fread(decoded, 1, sizeof(decoded), out);
+        fclose(in);
+        fclose(out);
+
+        assert(text_len > 0 && decoded_len == 2 * text_len);
+        assert(memcmp(decoded, text, text_len) == 0 && memcmp(&decoded[text_len], text, text_len) == 0);
+        remove("test_text_log_file.txt");
+        remove("test_binary_log_file.bin");
+        remove("test_decoded_log_file.txt");
+    }
+
+    // call site is written once, message carries only arguments
+    FILE* f = fopen("test_binary_log_file.bin", "w+");
+    assert(f != NULL);
+    assert(mylogger_init(f, MYLOGGER_FEATURE_BINARY | MYLOGGER_FEATURE_TIMESTAMPS | MYLOGGER_FEATURE_THREAD_ID) == MYLOGGER_INIT_SUCCESS);
+    for(int i = 0; i < 5000; i++)
+        MYLOGGER_INFO("Test - binary message %d\n", i);
+    mylogger_destroy();
+    FILE* in = fopen("test_binary_log_file.bin", "r");
+    FILE* out = fopen("test_decoded_log_file.txt", "w+");
+    assert(in != NULL && out != NULL);
+    assert(mylogger_decode(in, out) == 0);
+    const long binary_len = ftell(in);
+    const long text_len = ftell(out);
+    fclose(in);
+    fclose(out);
+    remove("test_decoded_log_file.txt");
+    assert(binary_len > MYLOGGER_THREAD_BUFFER_SIZE && 2 * binary_len < text_len);
+
+    // decoder cannot read the whole file
+    in = fopen("test_binary_log_file.bin", "r");
+    assert(in != NULL);
+    MOCK_FAIL_AT(g_realloc_mock_counter, 1);
+    assert(mylogger_decode(in, stdout) == -1);
+    fclose(in);
+
+    // string argument longer than the record is written as text
+    f = fopen("test_binary_log_file.bin", "w+");
+    assert(f != NULL);
+    assert(mylogger_init(f, MYLOGGER_FEATURE_BINARY) == MYLOGGER_INIT_SUCCESS);
+    char* payload = malloc(MYLOGGER_THREAD_BUFFER_SIZE);
+    assert(payload != NULL);
+    memset(payload, 'x', MYLOGGER_THREAD_BUFFER_SIZE - 1);
+    payload[MYLOGGER_THREAD_BUFFER_SIZE - 1] = '\0';
+    MYLOGGER_INFO("Test - %s\n", payload);
+    free(payload);
+    mylogger_destroy();
+    in = fopen("test_binary_log_file.bin", "r");
+    out = fopen("test_decoded_log_file.txt", "w+");
+    assert(in != NULL && out != NULL);
+    assert(mylogger_decode(in, out) == 0);
+    assert(ftell(out) > MYLOGGER_THREAD_BUFFER_SIZE);
+    fclose(in);
+    fclose(out);
+    remove("test_decoded_log_file.txt");
+
+    // text record is moved into the fallback buffer when the buffer cannot grow for its header
+    MyLogger_thread_S thread = {0};
+    const char* message = "Test - text record\n";
+    MOCK_FAIL_AT(g_realloc_mock_counter, 1);
+    assert(__mylogger_binary_text(&thread, &message, strlen(message), MYLOGGER_LEVEL_INFO) ==
+           sizeof(MyLogger_binary_header_S) + strlen("Test - text record\n"));
+    assert(message == thread.fallback && memcmp(&thread.fallback[sizeof(MyLogger_binary_header_S)], "Test - text record\n", 19) == 0);
+    // message filling the fallback buffer loses its end
+    assert(__mylogger_binary_text(&thread, &message, sizeof(thread.fallback), MYLOGGER_LEVEL_INFO) == sizeof(thread.fallback));
+
+    // colliding call sites take next entries, full table has no ID for new sites
+    static MyLogger_instance_S sites_instance;
+    sites_instance.binary_sites = calloc(MYLOGGER_BINARY_SITES, sizeof(*sites_instance.binary_sites));
+    assert(sites_instance.binary_sites != NULL);
+    assert(__mylogger_binary_site(&sites_instance, 1, true) == 1);
+    assert(__mylogger_binary_site(&sites_instance, 1 + MYLOGGER_BINARY_SITES, false) == UINT32_MAX);
+    assert(__mylogger_binary_site(&sites_instance, 1 + MYLOGGER_BINARY_SITES, true) == 2);
+    assert(__mylogger_binary_site(&sites_instance, 1 + MYLOGGER_BINARY_SITES, false) == 2);
+    for(uint64_t key = 2; key < MYLOGGER_BINARY_SITES; key++)
+        assert(__mylogger_binary_site(&sites_instance, key, true) != UINT32_MAX);
+    assert(__mylogger_binary_site(&sites_instance, 2 * MYLOGGER_BINARY_SITES, true) == UINT32_MAX);
+    free(sites_instance.binary_sites);
+
+    // malformed records
+    struct
+    {
+        MyLogger_binary_header_S header;
+        MyLogger_binary_site_S site;
+        char strings[3];
+    } site_record = {
+        .header = {.len = sizeof(MyLogger_binary_site_S) + 3, .kind = MYLOGGER_BINARY_SITE},
+        .site = {.site = MYLOGGER_BINARY_SITES}
+    };
+    assert(test_mylogger_decode_records(&site_record, sizeof(site_record)) == -1);
+    site_record.header.len = sizeof(MyLogger_binary_site_S) - 1;
+    assert(test_mylogger_decode_records(&site_record, sizeof(site_record.header) + site_record.header.len) == -1);
+    struct
+    {
+        MyLogger_binary_header_S header;
+        MyLogger_binary_message_S message;
+    } message_record = {
+        .header = {.len = sizeof(MyLogger_binary_message_S), .kind = MYLOGGER_BINARY_MESSAGE}
+    };
+    assert(test_mylogger_decode_records(&message_record, sizeof(message_record)) == -1);
+    message_record.header.len = sizeof(MyLogger_binary_message_S) - 1;
+    assert(test_mylogger_decode_records(&message_record, sizeof(message_record.header) + message_record.header.len) == -1);
+    const MyLogger_binary_header_S text_record = {.kind = MYLOGGER_BINARY_TEXT, .level = MYLOGGER_LEVEL_FATAL + 1};
+    assert(test_mylogger_decode_records(&text_record, sizeof(text_record)) == -1);
+    assert(test_mylogger_decode_records(NULL, 0) == 0);
+    // arguments of the message end before the format does
+    char records[256];
+    const int number = 7;
+    size_t records_len = test_mylogger_site_message(records, "%s%s%s%s", NULL, 0);
+    assert(test_mylogger_decode_records(records, records_len) == -1);
+    records_len = test_mylogger_site_message(records, "%d", &number, sizeof(number) - 1);
+    assert(test_mylogger_decode_records(records, records_len) == -1);
+    records_len = test_mylogger_site_message(records, "%*d", &number, sizeof(number) - 1);
+    assert(test_mylogger_decode_records(records, records_len) == -1);
+    const struct
+    {
+        uint32_t len;
+        char text[4];
+    } string_arg = {.len = 4, .text = "abc"};
+    records_len = test_mylogger_site_message(records, "%s", &string_arg, sizeof(string_arg));
+    assert(test_mylogger_decode_records(records, records_len) == -1);
+    // string argument without '\0'
+    const struct
+    {
+        uint32_t len;
+        char text[3];
+    } unterminated_arg = {.len = 2, .text = {'a', 'b', 'c'}};
+    records_len = test_mylogger_site_message(records, "%s", &unterminated_arg, sizeof(unterminated_arg));
+    assert(test_mylogger_decode_records(records, records_len) == -1);
+    const struct
+    {
+        uint32_t len;
+        char text[3];
+    } whole_arg = {.len = 2, .text = "ab"};
+    records_len = test_mylogger_site_message(records, "%s", &whole_arg, sizeof(whole_arg));
+    assert(test_mylogger_decode_records(records, records_len) == 0);
+    // strings of the site without '\0'
+    const size_t terminators[] = {TEST_SITE_STRINGS + 1, TEST_SITE_STRINGS + 3, TEST_SITE_STRINGS + 6};
+    for(size_t i = 0; i < sizeof(terminators) / sizeof(terminators[0]); i++)
+    {
+        records_len = test_mylogger_site_message(records, "%%", NULL, 0);
+        assert(test_mylogger_decode_records(records, records_len) == 0);
+        records[terminators[i]] = 'x';
+        assert(test_mylogger_decode_records(records, records_len) == -1);
+    }
+    // file not starting with a session
+    FILE* corrupted = tmpfile();
+    assert(corrupted != NULL);
+    fwrite(&site_record, 1, sizeof(site_record), corrupted);
+    rewind(corrupted);
+    assert(mylogger_decode(corrupted, stdout) == -1);
+    fclose(corrupted);
+
+    // not a binary log
+    in = fopen("test_binary_log_file.bin", "w+");
+    assert(in != NULL);
+    fprintf(in, "[INFO] text log\n");
+    rewind(in);
+    assert(mylogger_decode(in, stdout) == -1);
+    fclose(in);
+    remove("test_binary_log_file.bin");
+
+    // every failure of the initialization is cleaned up
+    test_mylogger_init_failures(&(mylogger_config_t){.features = MYLOGGER_FEATURE_BINARY});
+}
+
+static void test_mylogger_log_site(int i)
+{
+    MYLOGGER_INFO("Test - site %d %d\n", i, test_mylogger_count_evaluation());
+}
+
+static const mylogger_site_info_t* test_mylogger_find_site(const mylogger_site_info_t* sites, size_t count, const char* func)
+{
+    for(size_t i = 0; i < count; i++)
+        if(strcmp(sites[i].func, func) == 0)
+            return &sites[i];
+    return NULL;
+}
+
+static void test_mylogger_call_sites(void)
+{
+    FILE* f = fopen("test_site_log_file.txt", "w+");
+    assert(f != NULL);
+    assert(mylogger_init(f, 0) == MYLOGGER_INIT_SUCCESS);
+
+    const size_t evaluated = g_evaluated_args;
+    for(int i = 0; i < 3; i++)
+        test_mylogger_log_site(i);
+
+    static mylogger_site_info_t sites[256];
+    size_t count = mylogger_get_sites(sites, sizeof(sites) / sizeof(sites[0]));
+    assert(count > 0 && count <= sizeof(sites) / sizeof(sites[0]));
+    assert(mylogger_get_sites(NULL, 0) == count);
+    const mylogger_site_info_t* site = test_mylogger_find_site(sites, count, "test_mylogger_log_site");
+    assert(site != NULL && site->enabled && site->hits == 3 && site->level == MYLOGGER_LEVEL_INFO);
+    assert(strcmp(site->file, __FILE__) == 0);
+
+    // disabled site does not evaluate arguments
+    const uint32_t line = site->line;
+    assert(mylogger_set_site_enabled(__FILE__, line, false) == 1);
+    test_mylogger_log_site(3);
+    assert(g_evaluated_args == evaluated + 3);
+    assert(mylogger_set_site_enabled("no_such_file.c", 0, true) == 0);
+    assert(mylogger_set_site_enabled(__FILE__, line, true) == 1);
+    test_mylogger_log_site(4);
+    assert(g_evaluated_args == evaluated + 4);
+
+    count = mylogger_get_sites(sites, sizeof(sites) / sizeof(sites[0]));
+    site = test_mylogger_find_site(sites, count, "test_mylogger_log_site");
+    assert(site != NULL && site->enabled && site->hits == 4);
+    mylogger_destroy();
+
+    // cached prefix gives the same output as formatting it on every call
+    f = fopen("test_site_log_file.txt", "r");
+    assert(f != NULL);
+    char text[512];
+    char expected[512];
+    size_t lines = 0;
+    while(fgets(text, sizeof(text), f) != NULL)
+    {
+        const size_t i = lines == 3 ? 4 : lines;
+        snprintf(expected, sizeof(expected), "[INFO] %s:%" PRIu32 " test_mylogger_log_site: Test - site %zu %zu\n",
+                 __FILE__, line, i, evaluated + (i == 4 ? 3 : i));
+        assert(strcmp(text, expected) == 0);
+        lines++;
+    }
+    fclose(f);
+    remove("test_site_log_file.txt");
+    assert(lines == 4);
+
+    // previous entry point of the macros formats the prefix on every call
+    __mylogger_print(__FILE__, __func__, 1, MYLOGGER_LEVEL_INFO, "Test - %s\n", "not initialized");
+    f = fopen("test_site_log_file.txt", "w+");
+    assert(f != NULL);
+    assert(mylogger_init(f, 0) == MYLOGGER_INIT_SUCCESS);
+    __mylogger_print(__FILE__, __func__, 1, MYLOGGER_LEVEL_INFO, "Test - %s\n", "print");
+    mylogger_destroy();
+    f = fopen("test_site_log_file.txt", "r");
+    assert(f != NULL);
+    snprintf(expected, sizeof(expected), "[INFO] %s:1 %s: Test - print\n", __FILE__, __func__);
+    assert(fgets(text, sizeof(text), f) != NULL && strcmp(text, expected) == 0);
+    fclose(f);
+    remove("test_site_log_file.txt");
+}
+
+typedef struct test_slow_sink_t
+{
+    atomic_bool released;       // writes wait until the test releases the sink
+    size_t errors;
+    size_t reports;
+    size_t messages;
+} test_slow_sink_t;
+
+static void test_slow_sink_write(void* user_data, const char* data, size_t len)
+{
+    test_slow_sink_t* sink = user_data;
+    while(!atomic_load(&sink->released))
+        sched_yield();
+    // unbatched sink gets one message per write
+    char* message = strndup(data, len);
+    assert(message != NULL);
+    if(strstr(message, "overload error") != NULL)
+        sink->errors++;
+    else if(strstr(message, "messages dropped (DEBUG: ") != NULL)
+        sink->reports++;
+    sink->messages++;
+    free(message);
+}
+
+// Releases the slow sink after the ring of the logging thread fills up.
+static void* test_slow_sink_release(void* arg)
+{
+    test_slow_sink_t* sink = arg;
+    nanosleep(&(struct timespec){.tv_sec = 0, .tv_nsec = 100000000}, NULL);
+    atomic_store(&sink->released, true);
+    return NULL;
+}
+
+static void test_mylogger_overload(void)
+{
+    const mylogger_overload_mode_t modes[] = {MYLOGGER_OVERLOAD_DROP_NEWEST,
+                                              MYLOGGER_OVERLOAD_DROP_LOW_LEVELS,
+                                              MYLOGGER_OVERLOAD_SAMPLE};
+    for(size_t m = 0; m < sizeof(modes) / sizeof(modes[0]); m++)
+    {
+        static test_slow_sink_t sink;
+        sink = (test_slow_sink_t){0};
+        assert(mylogger_init_config(&(mylogger_config_t){
+            .features = MYLOGGER_FEATURE_ASYNC | MYLOGGER_FEATURE_NO_FILE,
+            .flush = {.size = 1},
+            .overload = {.mode = modes[m]},
+            .sinks = &(mylogger_sink_t){.write = test_slow_sink_write, .user_data = &sink},
+            .sinks_count = 1
+        }) == MYLOGGER_INIT_SUCCESS);
+
+        // writer is stuck in the sink, messages above the ring size cannot wait
+        const size_t count = 2 * MYLOGGER_RING_SIZE / 64;
+        for(size_t i = 0; i < count; i++)
+            MYLOGGER_DEBUG("Test - overload message %zu\n", i);
+        const uint64_t dropped = mylogger_get_dropped(MYLOGGER_LEVEL_DEBUG);
+        assert(dropped > 0 && dropped < count);
+        if(modes[m] == MYLOGGER_OVERLOAD_DROP_NEWEST)
+            atomic_store(&sink.released, true);
+
+        // errors wait for space
+        for(size_t i = 0; i < 10; i++)
+            MYLOGGER_ERROR("Test - overload error %zu\n", i);
+        assert(mylogger_get_dropped(MYLOGGER_LEVEL_ERROR) == 0);
+        atomic_store(&sink.released, true);
+        mylogger_destroy();
+
+        assert(sink.errors == 10);
+        assert(sink.reports > 0);
+        assert(sink.messages == count - dropped + 10 + sink.reports);
+    }
+    assert(mylogger_get_dropped(MYLOGGER_LEVEL_DEBUG) == 0);
+
+    // explicit DEBUG keep level waits for every message
+    static test_slow_sink_t sink;
+    sink = (test_slow_sink_t){0};
+    assert(mylogger_init_config(&(mylogger_config_t){
+        .features = MYLOGGER_FEATURE_ASYNC | MYLOGGER_FEATURE_NO_FILE,
+        .flush = {.size = 1},
+        .overload = {.mode = MYLOGGER_OVERLOAD_DROP_NEWEST, .keep_level = MYLOGGER_LEVEL_DEBUG, .keep_level_set = true},
+        .sinks = &(mylogger_sink_t){.write = test_slow_sink_write, .user_data = &sink},
+        .sinks_count = 1
+    }) == MYLOGGER_INIT_SUCCESS);
+    pthread_t releaser;
+    assert(pthread_create(&releaser, NULL, test_slow_sink_release, &sink) == 0);
+    const size_t count = 2 * MYLOGGER_RING_SIZE / 64;
+    for(size_t i = 0; i < count; i++)
+        MYLOGGER_DEBUG("Test - overload kept message %zu\n", i);
+    assert(mylogger_get_dropped(MYLOGGER_LEVEL_DEBUG) == 0);
+    pthread_join(releaser, NULL);
+    mylogger_destroy();
+    assert(sink.messages == count && sink.reports == 0);
+
+    // binary mapped log gets the report as text record, reports are limited by the interval
+    FILE* f = fopen("test_overload_log_file.bin", "w+");
+    assert(f != NULL);
+    assert(mylogger_init(f, MYLOGGER_FEATURE_ASYNC | MYLOGGER_FEATURE_BINARY | MYLOGGER_FEATURE_MMAP) == MYLOGGER_INIT_SUCCESS);
+    MyLogger_instance_S* instance = atomic_load(&g_mylogger_instance);
+    pthread_mutex_lock(&instance->mutex);
+    atomic_fetch_add(&instance->dropped[MYLOGGER_LEVEL_DEBUG], 3);
+    __mylogger_dropped_report(instance, false);
+    atomic_fetch_add(&instance->dropped[MYLOGGER_LEVEL_INFO], 2);
+    __mylogger_dropped_report(instance, false);
+    pthread_mutex_unlock(&instance->mutex);
+    mylogger_destroy();
+    FILE* in = fopen("test_overload_log_file.bin", "r");
+    FILE* out = tmpfile();
+    assert(in != NULL && out != NULL);
+    assert(mylogger_decode(in, out) == 0);
+    rewind(out);
+    char text[512];
+    size_t reports = 0;
+    while(fgets(text, sizeof(text), out) != NULL)
+        reports += strstr(text, "3 messages dropped (DEBUG: 3)") != NULL || strstr(text, "2 messages dropped (INFO: 2)") != NULL;
+    fclose(in);
+    fclose(out);
+    remove("test_overload_log_file.bin");
+    assert(reports == 2);
+}
+
+static void test_mylogger_rate_limits(void)
+{
+    FILE* f = fopen("test_limit_log_file.txt", "w+");
+    assert(f != NULL);
+    assert(mylogger_init(f, MYLOGGER_FEATURE_COLLAPSE) == MYLOGGER_INIT_SUCCESS);
+
+    // arguments of suppressed calls are not evaluated
+    const size_t evaluated = g_evaluated_args;
+    for(int i = 0; i < 10; i++)
+        MYLOGGER_INFO_EVERY_N(3, "Test - every third %d %d\n", i, test_mylogger_count_evaluation());
+    assert(g_evaluated_args == evaluated + 4);
+
+    for(int i = 0; i < 100; i++)
+        MYLOGGER_WARNING_RATELIMIT(5, "Test - rate limited %d %d\n", i, test_mylogger_count_evaluation());
+    const size_t limited = g_evaluated_args - evaluated - 4;
+    assert(limited >= 5 && limited < 10);
+
+    for(int i = 0; i < 8; i++)
+        MYLOGGER_ERROR("Test - repeated %s\n", i < 5 ? "first" : "second");
+    mylogger_destroy();
+
+    f = fopen("test_limit_log_file.txt", "r");
+    assert(f != NULL);
+    size_t every = 0, rate = 0, first = 0, second = 0, repeated = 0;
+    char line[512];
+    while(fgets(line, sizeof(line), f) != NULL)
+    {
+        every += strstr(line, "every third") != NULL;
+        rate += strstr(line, "rate limited") != NULL;
+        first += strstr(line, "repeated first") != NULL;
+        second += strstr(line, "repeated second") != NULL;
+        if(strstr(line, "last message repeated 4 times") != NULL)
+            repeated += first == 1 && second == 0;
+        if(strstr(line, "last message repeated 2 times") != NULL)
+            repeated += second == 1;
+    }
+    fclose(f);
+    remove("test_limit_log_file.txt");
+    assert(every == 4 && rate == limited && first == 1 && second == 1 && repeated == 2);
+
+    static mylogger_site_info_t sites[256];
+    const size_t count = mylogger_get_sites(sites, sizeof(sites) / sizeof(sites[0]));
+    size_t suppressed = 0;
+    for(size_t i = 0; i < count && i < sizeof(sites) / sizeof(sites[0]); i++)
+        if(strcmp(sites[i].func, __func__) == 0)
+            suppressed += sites[i].suppressed;
+    assert(suppressed == 6 + (100 - limited) + 4 + 2);
+
+    // repeats are written while the site is quiet, by the flusher or by the writer thread
+    const mylogger_feature_t modes[] = {MYLOGGER_FEATURE_COLLAPSE, MYLOGGER_FEATURE_COLLAPSE | MYLOGGER_FEATURE_ASYNC};
+    for(size_t m = 0; m < sizeof(modes) / sizeof(modes[0]); m++)
+    {
+        static test_sink_t sink;
+        sink = (test_sink_t){0};
+        assert(mylogger_init_config(&(mylogger_config_t){
+            .features = MYLOGGER_FEATURE_NO_FILE | modes[m],
+            .flush = {.size = 1, .interval_ms = 50},
+            .sinks = &(mylogger_sink_t){.write = test_sink_write, .user_data = &sink},
+            .sinks_count = 1
+        }) == MYLOGGER_INIT_SUCCESS);
+        // after the fifth call the repeats are written, the sixth is still collapsed
+        for(int i = 0; i < 6; i++)
+        {
+            MYLOGGER_ERROR("Test - repeated quiet\n");
+            for(size_t j = 0; i == 4 && j < 1000 && __atomic_load_n(&sink.writes, __ATOMIC_ACQUIRE) < 2; j++)
+                nanosleep(&(struct timespec){.tv_sec = 0, .tv_nsec = 1000000}, NULL);
+            assert(i != 4 || __atomic_load_n(&sink.writes, __ATOMIC_ACQUIRE) == 2);
+        }
+        mylogger_destroy();
+        assert(sink.writes == 3);
+        assert(strstr(sink.data, "last message repeated 4 times\n") != NULL);
+        assert(strstr(sink.data, "last message repeated 1 times\n") != NULL);
+    }
+
+    // zero rate logs nothing, messages with arguments that cannot be captured are never collapsed
+    static test_sink_t sink;
+    sink = (test_sink_t){0};
+    assert(mylogger_init_config(&(mylogger_config_t){
+        .features = MYLOGGER_FEATURE_NO_FILE | MYLOGGER_FEATURE_COLLAPSE,
+        .flush = {.size = 1},
+        .sinks = &(mylogger_sink_t){.write = test_sink_write, .user_data = &sink},
+        .sinks_count = 1
+    }) == MYLOGGER_INIT_SUCCESS);
+    for(int i = 0; i < 3; i++)
+        MYLOGGER_INFO_RATELIMIT(0, "Test - unlimited %d\n", i);
+    char long_arg[MYLOGGER_COLLAPSE_CAPTURE_SIZE + 1];
+    memset(long_arg, 'x', sizeof(long_arg) - 1);
+    long_arg[sizeof(long_arg) - 1] = '\0';
+    for(int i = 0; i < 3; i++)
+        MYLOGGER_INFO("Test - not compared %s\n", long_arg);
+    mylogger_destroy();
+    assert(sink.writes == 3 && strstr(sink.data, "unlimited") == NULL);
+    assert(strstr(sink.data, "last message repeated") == NULL);
+}
+
+/**
+ * Counts lines of the log file containing the text.
+ * */
+static size_t test_mylogger_count_lines(const char* file_name, const char* text)
+{
+    FILE* f = fopen(file_name, "r");
+    assert(f != NULL);
+    size_t count = 0;
+    char line[1024];
+    while(fgets(line, sizeof(line), f) != NULL)
+        count += strstr(line, text) != NULL;
+    fclose(f);
+    return count;
+}
+
+static size_t test_mylogger_crash_recurse(volatile char* previous, size_t depth)
+{
+    volatile char frame[1024];
+    frame[0] = previous != NULL ? previous[0] : 0;
+    if(depth == SIZE_MAX)
+        return 0;
+    return test_mylogger_crash_recurse(frame, depth + 1) + (size_t)frame[0];
+}
+
+static void* test_mylogger_crash_overflow_worker(void* arg)
+{
+    (void)arg;
+    MYLOGGER_INFO("Test - before overflow\n");
+    const size_t result = test_mylogger_crash_recurse(NULL, 0);
+    return (void*)result;
+}
+
+// Alternate stack is not given to threads that cannot get one or already have one.
+static void* test_mylogger_crash_stack_worker(void* arg)
+{
+    (void)arg;
+    MyLogger_thread_S thread = {0};
+    MOCK_FAIL_AT(g_malloc_mock_counter, 1);
+    __mylogger_crash_stack(&thread);
+    assert(thread.crash_stack == NULL);
+    MOCK_FAIL_AT(g_sigaltstack_mock_counter, 2);
+    __mylogger_crash_stack(&thread);
+    assert(thread.crash_stack == NULL);
+
+    static char memory[MYLOGGER_CRASH_STACK_SIZE];
+    const stack_t stack = {.ss_sp = memory, .ss_size = sizeof(memory)};
+    assert(sigaltstack(&stack, NULL) == 0);
+    __mylogger_crash_stack(&thread);
+    assert(thread.crash_stack == NULL);
+    const stack_t disabled = {.ss_flags = SS_DISABLE};
+    assert(sigaltstack(&disabled, NULL) == 0);
+    return NULL;
+}
+
+static void* test_mylogger_crash_logging_worker(void* arg)
+{
+    (void)arg;
+    MYLOGGER_INFO("Test - crash handler worker\n");
+    return NULL;
+}
+
+static void test_mylogger_crash_trace(void)
+{
+    // raw addresses with offsets inside modules
+    FILE* f = fopen("test_crash_log_file.txt", "w+");
+    assert(f != NULL);
+    assert(mylogger_init_config(&(mylogger_config_t){.log_file = f, .trace = MYLOGGER_TRACE_ADDRESSES}) == MYLOGGER_INIT_SUCCESS);
+    MYLOGGER_FATAL("Test - fatal with addresses\n");
+    mylogger_destroy();
+    assert(test_mylogger_count_lines("test_crash_log_file.txt", "TRACE:") == 1);
+    assert(test_mylogger_count_lines("test_crash_log_file.txt", "test.out(+0x") > 0);
+    remove("test_crash_log_file.txt");
+
+    // symbolized trace is left out when the stack or its symbols cannot be read
+    f = fopen("test_crash_log_file.txt", "w+");
+    assert(f != NULL);
+    assert(mylogger_init_config(&(mylogger_config_t){.log_file = f}) == MYLOGGER_INIT_SUCCESS);
+    MOCK_FAIL_AT(g_backtrace_mock_counter, 1);
+    MYLOGGER_FATAL("Test - fatal without stack\n");
+    MOCK_FAIL_AT(g_backtrace_symbols_mock_counter, 1);
+    MYLOGGER_FATAL("Test - fatal without symbols\n");
+    mylogger_destroy();
+    assert(test_mylogger_count_lines("test_crash_log_file.txt", "Test - fatal without") == 2);
+    assert(test_mylogger_count_lines("test_crash_log_file.txt", "TRACE:") == 0);
+    remove("test_crash_log_file.txt");
+
+    // trace without modules and trace that does not fit
+    void* frames[1] = {&frames};
+    char trace[64];
+    MOCK_FAIL_AT(g_open_mock_counter, 1);
+    __mylogger_trace_modules_load();
+    assert(g_mylogger_trace_modules_count == 0);
+    __mylogger_trace_modules_load();
+    assert(g_mylogger_trace_modules_count > 0);
+    assert(__mylogger_trace_addresses(trace, 8, frames, 1) == 0);
+    assert(__mylogger_trace_addresses(trace, 16, frames, 1) == strlen("TRACE:\n"));
+    assert(__mylogger_trace_addresses(trace, sizeof(trace), frames, 1) > strlen("TRACE:\n"));
+
+    // buffered messages and the trace survive the crash
+    const mylogger_feature_t modes[] = {0, MYLOGGER_FEATURE_ASYNC, MYLOGGER_FEATURE_MMAP};
+    const int signals[] = {SIGSEGV, SIGABRT, SIGBUS};
+    for(size_t m = 0; m < sizeof(modes) / sizeof(modes[0]); m++)
+    {
+        const pid_t pid = fork();
+        assert(pid >= 0);
+        if(pid == 0)
+        {
+            setrlimit(RLIMIT_CORE, &(struct rlimit){0, 0});
+            f = fopen("test_crash_log_file.txt", "w+");
+            if(f == NULL || mylogger_init(f, MYLOGGER_FEATURE_CRASH_HANDLER | modes[m]) != MYLOGGER_INIT_SUCCESS)
+                _exit(1);
+            for(int i = 0; i < 100; i++)
+                MYLOGGER_INFO("Test - before crash %d\n", i);
+            raise(signals[m]);
+            _exit(0);
+        }
+        int status;
+        assert(waitpid(pid, &status, 0) == pid);
+        assert(WIFSIGNALED(status) && WTERMSIG(status) == signals[m]);
+        assert(test_mylogger_count_lines("test_crash_log_file.txt", "Test - before crash") == 100);
+        assert(test_mylogger_count_lines("test_crash_log_file.txt", "MyLogger: caught SIG") == 1);
+        assert(test_mylogger_count_lines("test_crash_log_file.txt", "test.out(+0x") > 0);
+        remove("test_crash_log_file.txt");
+    }
+
+    // custom sinks have no descriptor the handler could write to
+    pid_t pid = fork();
+    assert(pid >= 0);
+    if(pid == 0)
+    {
+        setrlimit(RLIMIT_CORE, &(struct rlimit){0, 0});
+        static test_sink_t sink;
+        f = fopen("test_crash_log_file.txt", "w+");
+        if(f == NULL || mylogger_init_config(&(mylogger_config_t){
+                            .log_file = f,
+                            .features = MYLOGGER_FEATURE_CRASH_HANDLER,
+                            .sinks = &(mylogger_sink_t){.write = test_sink_write, .user_data = &sink},
+                            .sinks_count = 1}) != MYLOGGER_INIT_SUCCESS)
+            _exit(1);
+        MYLOGGER_INFO("Test - before crash with custom sink\n");
+        raise(SIGSEGV);
+        _exit(0);
+    }
+    int status;
+    assert(waitpid(pid, &status, 0) == pid);
+    assert(WIFSIGNALED(status) && WTERMSIG(status) == SIGSEGV);
+    assert(test_mylogger_count_lines("test_crash_log_file.txt", "Test - before crash with custom sink") == 1);
+    assert(test_mylogger_count_lines("test_crash_log_file.txt", "MyLogger: caught SIGSEGV") == 1);
+    remove("test_crash_log_file.txt");
+
+    // stack overflow of a thread that logs is reported from its own alternate stack
+    pid = fork();
+    assert(pid >= 0);
+    if(pid == 0)
+    {
+        setrlimit(RLIMIT_CORE, &(struct rlimit){0, 0});
+        f = fopen("test_crash_log_file.txt", "w+");
+        if(f == NULL || mylogger_init(f, MYLOGGER_FEATURE_CRASH_HANDLER) != MYLOGGER_INIT_SUCCESS)
+            _exit(1);
+        pthread_t thread;
+        if(pthread_create(&thread, NULL, test_mylogger_crash_overflow_worker, NULL) == 0)
+            pthread_join(thread, NULL);
+        _exit(0);
+    }
+    assert(waitpid(pid, &status, 0) == pid);
+    assert(WIFSIGNALED(status) && WTERMSIG(status) == SIGSEGV);
+    assert(test_mylogger_count_lines("test_crash_log_file.txt", "Test - before overflow") == 1);
+    assert(test_mylogger_count_lines("test_crash_log_file.txt", "MyLogger: caught SIGSEGV") == 1);
+    remove("test_crash_log_file.txt");
+
+    // instance closed while the handler walks the instances stays allocated
+    pid = fork();
+    assert(pid >= 0);
+    if(pid == 0)
+    {
+        atomic_store(&g_mylogger_crash_entered, true);
+        mylogger_t* logger = mylogger_create(&(mylogger_config_t){.features = MYLOGGER_FEATURE_NO_FILE | MYLOGGER_FEATURE_STDERR | MYLOGGER_FEATURE_CRASH_HANDLER}, NULL);
+        if(logger == NULL)
+            _exit(1);
+        mylogger_close(logger);
+        _exit(logger->features.feat_crash_handler == 1 ? 0 : 2);
+    }
+    assert(waitpid(pid, &status, 0) == pid);
+    assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+
+    // previous handlers are restored
+    struct sigaction action;
+    assert(mylogger_init(NULL, MYLOGGER_FEATURE_CRASH_HANDLER | MYLOGGER_FEATURE_NO_FILE | MYLOGGER_FEATURE_STDERR) == MYLOGGER_INIT_SUCCESS);
+    sigaction(SIGSEGV, NULL, &action);
+    assert(action.sa_handler == __mylogger_crash_handler);
+    // logging threads get their own alternate stack and free it when they exit
+    pthread_t thread;
+    assert(pthread_create(&thread, NULL, test_mylogger_crash_logging_worker, NULL) == 0);
+    pthread_join(thread, NULL);
+    assert(pthread_create(&thread, NULL, test_mylogger_crash_stack_worker, NULL) == 0);
+    pthread_join(thread, NULL);
+    mylogger_destroy();
+    sigaction(SIGSEGV, NULL, &action);
+    assert(action.sa_handler == SIG_DFL);
+
+    // handler returns when the raised signal is ignored, it skips instances without crash handler
+    mylogger_t* logger = mylogger_create(&(mylogger_config_t){.features = MYLOGGER_FEATURE_NO_FILE | MYLOGGER_FEATURE_STDERR}, NULL);
+    assert(logger != NULL);
+    signal(SIGUSR1, SIG_IGN);
+    __mylogger_crash_handler(SIGUSR1);
+    signal(SIGUSR1, SIG_DFL);
+    mylogger_close(logger);
+    atomic_store(&g_mylogger_crash_entered, false);
+}
+
+static void test_mylogger_instances(void)
+{
+    FILE* f_app = fopen("test_app_log_file.txt", "w+");
+    FILE* f_audit = fopen("test_audit_log_file.txt", "w+");
+    FILE* f_default = fopen("test_default_log_file.txt", "w+");
+    assert(f_app != NULL && f_audit != NULL && f_default != NULL);
+
+    mylogger_init_error_code_t err;
+    mylogger_t* app = mylogger_create(&(mylogger_config_t){.log_file = f_app,
+                                                           .features = MYLOGGER_FEATURE_ASYNC | MYLOGGER_FEATURE_CRASH_HANDLER,
+                                                           .level = MYLOGGER_LEVEL_WARNING}, &err);
+    assert(app != NULL && err == MYLOGGER_INIT_SUCCESS);
+    mylogger_t* audit = mylogger_create(&(mylogger_config_t){.log_file = f_audit,
+                                                             .features = MYLOGGER_FEATURE_COLLAPSE | MYLOGGER_FEATURE_CRASH_HANDLER}, NULL);
+    assert(audit != NULL);
+    // handles do not occupy the default instance
+    assert(mylogger_init(f_default, 0) == MYLOGGER_INIT_SUCCESS);
+    mylogger_set_level(MYLOGGER_LEVEL_ERROR);
+    assert(mylogger_logger_get_level(app) == MYLOGGER_LEVEL_WARNING);
+    assert(mylogger_logger_get_level(audit) == MYLOGGER_LEVEL_DEBUG);
+
+    // arguments below the level of the handle are not evaluated
+    const size_t evaluated = g_evaluated_args;
+    for(int i = 0; i < 10; i++)
+    {
+        MYLOGGER_INFO_TO(app, "Test - app info %d %d\n", i, test_mylogger_count_evaluation());
+        MYLOGGER_ERROR_TO(app, "Test - app error %d\n", i);
+        MYLOGGER_DEBUG_TO(audit, "Test - audit debug %d\n", i);
+        MYLOGGER_WARNING_TO(audit, "Test - audit repeated\n");
+        MYLOGGER_WARNING("Test - default warning %d\n", i);
+        MYLOGGER_ERROR("Test - default error %d\n", i);
+    }
+    assert(g_evaluated_args == evaluated);
+    mylogger_logger_set_level(audit, MYLOGGER_LEVEL_INFO);
+    MYLOGGER_DEBUG_TO(audit, "Test - audit debug filtered\n");
+    assert(mylogger_logger_get_dropped(app, MYLOGGER_LEVEL_ERROR) == 0);
+    assert(mylogger_logger_get_dropped(app, (mylogger_level_t)MYLOGGER_LEVELS_COUNT) == 0);
+    mylogger_close(NULL);
+
+    // NULL handle, e.g. from failed mylogger_create, is ignored
+    mylogger_t* none = NULL;
+    MYLOGGER_ERROR_TO(none, "Test - none error\n");
+    mylogger_logger_set_level(none, MYLOGGER_LEVEL_ERROR);
+    assert(mylogger_logger_get_level(none) == MYLOGGER_LEVEL_DEBUG);
+    assert(mylogger_logger_get_dropped(none, MYLOGGER_LEVEL_ERROR) == 0);
+    assert(!mylogger_logger_get_stats(none, &(mylogger_stats_t){0}));
+    assert(!mylogger_logger_dump_recorder(none));
+    assert(!mylogger_logger_batch_begin(none));
+
+    // default instance is closed with mylogger_destroy only
+    fprintf(stderr, "\033[0;32mExpected error: \033[0m");
+    mylogger_close(__mylogger_enter());
+    __mylogger_leave();
+
+    // crash handlers stay installed until the last instance using them is gone
+    struct sigaction action;
+    mylogger_close(app);
+    sigaction(SIGSEGV, NULL, &action);
+    assert(action.sa_handler == __mylogger_crash_handler);
+    mylogger_close(audit);
+    sigaction(SIGSEGV, NULL, &action);
+    assert(action.sa_handler == SIG_DFL);
+    mylogger_destroy();
+
+    assert(test_mylogger_count_lines("test_app_log_file.txt", "Test - app error") == 10);
+    assert(test_mylogger_count_lines("test_app_log_file.txt", "Test - app info") == 0);
+    assert(test_mylogger_count_lines("test_audit_log_file.txt", "Test - audit debug") == 10);
+    assert(test_mylogger_count_lines("test_audit_log_file.txt", "Test - audit repeated") == 1);
+    assert(test_mylogger_count_lines("test_audit_log_file.txt", "last message repeated 9 times") == 1);
+    assert(test_mylogger_count_lines("test_default_log_file.txt", "Test - default error") == 10);
+    assert(test_mylogger_count_lines("test_default_log_file.txt", "Test - default warning") == 0);
+    assert(test_mylogger_count_lines("test_default_log_file.txt", "Test - app") == 0);
+    remove("test_app_log_file.txt");
+    remove("test_audit_log_file.txt");
+    remove("test_default_log_file.txt");
+}
+
+static void test_mylogger_structured(void)
+{
+    // escaping in place, plain text is found eight characters at a time
+    {
+        char buffer[64] = "0123456789abcdef\"quoted\" back\\slash\n\x01";
+        const size_t len = strlen(buffer);
+        assert(__mylogger_escape_scan(buffer, len) == 16);
+        assert(__mylogger_escape(buffer, len, sizeof(buffer)) == len + 9);
+        assert(strcmp(buffer, "0123456789abcdef\\\"quoted\\\" back\\\\slash\\n\\u0001") == 0);
+
+        // what does not fit is reported like snprintf does
+        char small[8] = "ab\"cd";
+        assert(__mylogger_escape(small, 5, sizeof(small)) == 6);
+        assert(__mylogger_escape(strcpy(small, "\"\"\"\""), 4, sizeof(small)) == 8 && small[7] == '\0');
+
+        // valid UTF-8 is copied, other bytes above 0x7F are escaped
+        char utf8[128] = "caf\xc3\xa9 \xf0\x9f\x98\x80 0123456789 \xff \xc0\xaf \xed\xa0\x80 \xe2\x82\xac\xe2\x82";
+        const size_t utf8_len = strlen(utf8);
+        assert(__mylogger_escape_scan(utf8, utf8_len) == 22);
+        assert(__mylogger_escape(utf8, utf8_len, sizeof(utf8)) == utf8_len + 8 * 5);
+        assert(strcmp(utf8, "caf\xc3\xa9 \xf0\x9f\x98\x80 0123456789 \\u00ff \\u00c0\\u00af \\u00ed\\u00a0\\u0080 "
+                            "\xe2\x82\xac\\u00e2\\u0082") == 0);
+        assert(__mylogger_escape(strcpy(small, "\"\"\"\xc3\xa9"), 5, sizeof(small)) == 8);
+        assert(strcmp(small, "\\\"\\\"\\\" ") == 0);
+        // continuation byte missing inside of the character
+        assert(__mylogger_utf8_len("\xe2\x82\x28", 3) == 0 && __mylogger_utf8_len("\xf0\x9f\x98\x28", 4) == 0);
+
+        // logfmt quotes only invalid UTF-8
+        char logfmt[32];
+        assert(__mylogger_add_string(logfmt, sizeof(logfmt), "caf\xc3\xa9", 5, MYLOGGER_ENCODER_LOGFMT) == 5);
+        assert(strncmp(logfmt, "caf\xc3\xa9", 5) == 0);
+        assert(__mylogger_add_string(logfmt, sizeof(logfmt), "caf\xc3", 4, MYLOGGER_ENCODER_LOGFMT) == 11);
+        assert(strncmp(logfmt, "\"caf\\u00c3\"", 11) == 0);
+
+        // non-finite numbers are null in JSON, unknown field types have empty value
+        const mylogger_field_t fields[] = {MYLOGGER_KV_DOUBLE("nan", NAN), {.key = "unknown", .type = (mylogger_field_type_t)-1}};
+        assert(__mylogger_add_field(logfmt, sizeof(logfmt), &fields[0], MYLOGGER_ENCODER_JSON) == strlen(",\"nan\":null"));
+        assert(strncmp(logfmt, ",\"nan\":null", strlen(",\"nan\":null")) == 0);
+        assert(__mylogger_add_field(logfmt, sizeof(logfmt), &fields[1], MYLOGGER_ENCODER_JSON) == strlen(",\"unknown\":null"));
+        assert(__mylogger_add_field(logfmt, sizeof(logfmt), &fields[1], MYLOGGER_ENCODER_LOGFMT) == strlen(" unknown="));
+    }
+
+    // message that does not fit ends the text with the mark and stays valid, escapes are not split
+    {
+        static MyLogger_instance_S instance;
+        const mylogger_field_t fields[] = {MYLOGGER_KV_INT("after", 1)};
+        const MyLogger_call_S call = {.level = MYLOGGER_LEVEL_INFO, .fields = fields, .fields_count = 1};
+        char buffer[40] = "{\"msg\":\"";
+        const size_t message_idx = strlen(buffer);
+        memset(&buffer[message_idx], '"', 20);
+        bool truncated = false;
+        instance.encoder = MYLOGGER_ENCODER_JSON;
+        assert(__mylogger_format_suffix(&instance, buffer, sizeof(buffer), message_idx, message_idx + 20, &truncated, &call) == 38);
+        assert(truncated);
+        assert(strcmp(buffer, "{\"msg\":\"\\\"\\\"\\\"\\\"\\\"\\\"... [TRUNCATED]\"}\n") == 0);
+
+        // text fits, the field does not
+        strcpy(buffer, "msg=\"");
+        memset(&buffer[5], 'x', 30);
+        truncated = false;
+        instance.encoder = MYLOGGER_ENCODER_LOGFMT;
+        assert(__mylogger_format_suffix(&instance, buffer, sizeof(buffer), 5, 35, &truncated, &call) == 39);
+        assert(truncated);
+        assert(strcmp(buffer, "msg=\"xxxxxxxxxxxxxxxxx... [TRUNCATED]\"\n") == 0);
+
+        // UTF-8 characters are not split
+        strcpy(buffer, "msg=\"");
+        for(size_t i = 0; i < 6; i++)
+            memcpy(&buffer[5 + 5 * i], "\xc3\xa9\xe2\x82\xac", 5);
+        assert(__mylogger_encode_truncated(buffer, sizeof(buffer), 5, 35, false) == 39);
+        assert(strcmp(buffer, "msg=\"\xc3\xa9\xe2\x82\xac\xc3\xa9\xe2\x82\xac\xc3\xa9\xe2\x82\xac\xc3\xa9... [TRUNCATED]\"\n") == 0);
+        // prefix leaves no space for the text
+        assert(__mylogger_encode_truncated(buffer, sizeof(buffer), 30, 35, false) == sizeof(buffer) - 1);
+    }
+
+    fprintf(stderr, "\033[0;32mExpected error: \033[0m");
+    MYLOGGER_INFO_KV((MYLOGGER_KV_INT("status", 200)), "Test - %s\n", "not initialized");
+
+    const mylogger_encoder_t encoders[] = {MYLOGGER_ENCODER_TEXT, MYLOGGER_ENCODER_JSON, MYLOGGER_ENCODER_LOGFMT};
+    const char* expected[] = {
+        "test_mylogger_structured: request tab\there done user=\"a \\\"b\\\"\\n\" status=-200 bytes=18446744073709551615 ratio=0.5 ok=true none=\n",
+        ",\"func\":\"test_mylogger_structured\",\"msg\":\"request tab\\there done\",\"user\":\"a \\\"b\\\"\\n\",\"status\":-200,"
+        "\"bytes\":18446744073709551615,\"ratio\":0.5,\"ok\":true,\"none\":null}\n",
+        " func=test_mylogger_structured msg=\"request tab\\there done\" user=\"a \\\"b\\\"\\n\" status=-200 "
+        "bytes=18446744073709551615 ratio=0.5 ok=true none=\n"
+    };
+    for(size_t e = 0; e < sizeof(encoders) / sizeof(encoders[0]); e++)
+    {
+        FILE* f = fopen("test_structured_log_file.txt", "w+");
+        assert(f != NULL);
+        assert(mylogger_init_config(&(mylogger_config_t){
+            .log_file = f,
+            .features = MYLOGGER_FEATURE_TIMESTAMPS | MYLOGGER_FEATURE_THREAD_ID | MYLOGGER_FEATURE_DEFERRED,
+            .level = MYLOGGER_LEVEL_INFO,
+            .encoder = encoders[e]
+        }) == MYLOGGER_INIT_SUCCESS);
+
+        MYLOGGER_INFO_KV((MYLOGGER_KV_STR("user", "a \"b\"\n"),
+                          MYLOGGER_KV_INT("status", -200),
+                          MYLOGGER_KV_UINT("bytes", UINT64_MAX),
+                          MYLOGGER_KV_DOUBLE("ratio", 0.5),
+                          MYLOGGER_KV_BOOL("ok", true),
+                          MYLOGGER_KV_STR("none", NULL)),
+                         "request %s done\n", "tab\there");
+        // fields are not evaluated below the level
+        const size_t evaluated = g_evaluated_args;
+        MYLOGGER_DEBUG_KV((MYLOGGER_KV_INT("count", test_mylogger_count_evaluation())), "Test - filtered\n");
+        assert(g_evaluated_args == evaluated);
+        // deferred message gets the same layout
+        MYLOGGER_WARNING("Test - deferred %d \"%s\"\n", 42, "quoted");
+        MYLOGGER_FATAL("Test - fatal\n");
+        mylogger_destroy();
+
+        assert(test_mylogger_count_lines("test_structured_log_file.txt", expected[e]) == 1);
+        if(encoders[e] == MYLOGGER_ENCODER_TEXT)
+            assert(test_mylogger_count_lines("test_structured_log_file.txt", "Test - deferred 42 \"quoted\"\n") == 1);
+        else
+        {
+            const bool json = encoders[e] == MYLOGGER_ENCODER_JSON;
+            // one line per message, FATAL trace included
+            assert(test_mylogger_count_lines("test_structured_log_file.txt", "") == 3);
+            assert(test_mylogger_count_lines("test_structured_log_file.txt", json ? "{\"level\":\"INFO\",\"time\":\"" : "level=INFO time=") == 1);
+            assert(test_mylogger_count_lines("test_structured_log_file.txt", json ? "\"thread\":\"" : " thread=") == 3);
+            assert(test_mylogger_count_lines("test_structured_log_file.txt",
+                                             json ? "\"msg\":\"Test - deferred 42 \\\"quoted\\\"\"}\n" : "msg=\"Test - deferred 42 \\\"quoted\\\"\"\n") == 1);
+            assert(test_mylogger_count_lines("test_structured_log_file.txt", json ? "\"msg\":\"Test - fatal\",\"trace\":\"" : "msg=\"Test - fatal\" trace=\"") == 1);
+        }
+        remove("test_structured_log_file.txt");
+    }
+
+    // text layout adds the trace after the fields
+    FILE* f = fopen("test_structured_log_file.txt", "w+");
+    assert(f != NULL);
+    assert(mylogger_init(f, 0) == MYLOGGER_INIT_SUCCESS);
+    MYLOGGER_FATAL_KV((MYLOGGER_KV_INT("status", 500)), "Test - fatal with fields\n");
+    mylogger_destroy();
+    assert(test_mylogger_count_lines("test_structured_log_file.txt", "Test - fatal with fields status=500\n") == 1);
+    assert(test_mylogger_count_lines("test_structured_log_file.txt", "TRACE:") == 1);
+    remove("test_structured_log_file.txt");
+}
+
+static void* test_mylogger_stats_worker(void* arg)
+{
+    mylogger_t* logger = arg;
+    for(int i = 0; i < 1000; i++)
+        MYLOGGER_INFO_TO(logger, "Test - stats worker %d\n", i);
+    return NULL;
+}
+
+// Thread without counters still logs.
+static void* test_mylogger_stats_no_counters_worker(void* arg)
+{
+    mylogger_t* logger = arg;
+    MOCK_FAIL_AT(g_aligned_alloc_mock_counter, 1);
+    MYLOGGER_INFO_TO(logger, "Test - stats without counters\n");
+    return NULL;
+}
+
+static void test_mylogger_stats(void)
+{
+    mylogger_stats_t stats;
+    FILE* f = fopen("test_stats_log_file.txt", "w+");
+    assert(f != NULL);
+
+    // counters are opt-in
+    assert(mylogger_init(f, 0) == MYLOGGER_INIT_SUCCESS);
+    assert(!mylogger_get_stats(&stats));
+    mylogger_destroy();
+    assert(!mylogger_get_stats(&stats));
+
+    // every message is written with its own system call
+    f = fopen("test_stats_log_file.txt", "w+");
+    assert(f != NULL);
+    assert(mylogger_init_config(&(mylogger_config_t){.log_file = f,
+                                                     .features = MYLOGGER_FEATURE_STATS,
+                                                     .flush.size = 1}) == MYLOGGER_INIT_SUCCESS);
+    for(int i = 0; i < 10; i++)
+    {
+        MYLOGGER_INFO("Test - stats info %d\n", i);
+        MYLOGGER_ERROR("Test - stats error %d\n", i);
+    }
+    MYLOGGER_WARNING("Test - stats truncated %*s\n", 2 * MYLOGGER_MESSAGE_MAX_SIZE, "x");
+    assert(mylogger_get_stats(&stats));
+    assert(stats.messages[MYLOGGER_LEVEL_INFO] == 10);
+    assert(stats.messages[MYLOGGER_LEVEL_ERROR] == 10);
+    assert(stats.messages[MYLOGGER_LEVEL_WARNING] == 1);
+    assert(stats.messages[MYLOGGER_LEVEL_DEBUG] == 0);
+    assert(stats.truncated == 1);
+    assert(stats.bytes > MYLOGGER_MESSAGE_MAX_SIZE);
+    assert(stats.lock_wait.count == 21);
+    assert(stats.sink_write.count == 21);
+    assert(stats.sink_write.max_ns > 0);
+    assert(mylogger_histogram_percentile(&stats.sink_write, 100.0) == stats.sink_write.max_ns);
+    assert(mylogger_histogram_percentile(&stats.sink_write, 50.0) <= stats.sink_write.max_ns);
+    mylogger_destroy();
+
+    assert(test_mylogger_count_lines("test_stats_log_file.txt", "Test - stats info") == 10);
+
+    // counters of exited threads are kept, writer thread logs the totals
+    f = fopen("test_stats_log_file.txt", "w+");
+    assert(f != NULL);
+    mylogger_t* logger = mylogger_create(&(mylogger_config_t){.log_file = f,
+                                                              .features = MYLOGGER_FEATURE_ASYNC | MYLOGGER_FEATURE_STATS,
+                                                              .stats_interval_ms = 1}, NULL);
+    assert(logger != NULL);
+    pthread_t threads[4];
+    for(size_t i = 0; i < 4; i++)
+        assert(pthread_create(&threads[i], NULL, test_mylogger_stats_worker, logger) == 0);
+    for(size_t i = 0; i < 4; i++)
+        pthread_join(threads[i], NULL);
+    nanosleep(&(struct timespec){.tv_sec = 0, .tv_nsec = 50000000L}, NULL);
+    assert(mylogger_logger_get_stats(logger, &stats));
+    assert(stats.messages[MYLOGGER_LEVEL_INFO] == 4000);
+    assert(stats.bytes > 0 && stats.sink_write.count > 0);
+    mylogger_close(logger);
+
+    assert(test_mylogger_count_lines("test_stats_log_file.txt", "Test - stats worker") == 4000);
+    assert(test_mylogger_count_lines("test_stats_log_file.txt", "logger stats messages=") >= 1);
+
+    // logging thread reports the totals without writer thread, binary mapped log gets them as text record
+    const mylogger_feature_t modes[] = {MYLOGGER_FEATURE_STATS, MYLOGGER_FEATURE_STATS | MYLOGGER_FEATURE_BINARY | MYLOGGER_FEATURE_MMAP};
+    for(size_t m = 0; m < sizeof(modes) / sizeof(modes[0]); m++)
+    {
+        f = fopen("test_stats_log_file.txt", "w+");
+        assert(f != NULL);
+        // coarse clock ticks every few ms, the first message must not be late already
+        logger = mylogger_create(&(mylogger_config_t){.log_file = f, .features = modes[m], .stats_interval_ms = 100}, NULL);
+        assert(logger != NULL);
+        MYLOGGER_INFO_TO(logger, "Test - stats before report\n");
+        nanosleep(&(struct timespec){.tv_sec = 0, .tv_nsec = 150000000L}, NULL);
+        MYLOGGER_INFO_TO(logger, "Test - stats after report\n");
+        mylogger_close(logger);
+        if(modes[m] & MYLOGGER_FEATURE_BINARY)
+        {
+            FILE* in = fopen("test_stats_log_file.txt", "r");
+            FILE* out = fopen("test_stats_decoded_log_file.txt", "w+");
+            assert(in != NULL && out != NULL);
+            assert(mylogger_decode(in, out) == 0);
+            fclose(in);
+            fclose(out);
+            rename("test_stats_decoded_log_file.txt", "test_stats_log_file.txt");
+        }
+        assert(test_mylogger_count_lines("test_stats_log_file.txt", "logger stats messages=") == 1);
+    }
+
+    // deferred messages are counted by the writer thread, threads without counters are not counted
+    f = fopen("test_stats_log_file.txt", "w+");
+    assert(f != NULL);
+    logger = mylogger_create(&(mylogger_config_t){.log_file = f,
+                                                  .features = MYLOGGER_FEATURE_ASYNC | MYLOGGER_FEATURE_DEFERRED | MYLOGGER_FEATURE_STATS}, NULL);
+    assert(logger != NULL);
+    MYLOGGER_WARNING_TO(logger, "Test - stats deferred truncated %*s\n", 2 * MYLOGGER_MESSAGE_MAX_SIZE, "x");
+    for(int i = 0; i < 1000 && (!mylogger_logger_get_stats(logger, &stats) || stats.truncated == 0); i++)
+        nanosleep(&(struct timespec){.tv_sec = 0, .tv_nsec = 1000000L}, NULL);
+    assert(stats.truncated == 1 && stats.bytes > 0);
+    pthread_t thread;
+    assert(pthread_create(&thread, NULL, test_mylogger_stats_no_counters_worker, logger) == 0);
+    pthread_join(thread, NULL);
+    assert(mylogger_logger_get_stats(logger, &stats));
+    assert(stats.messages[MYLOGGER_LEVEL_INFO] == 0 && stats.messages[MYLOGGER_LEVEL_WARNING] == 1);
+    mylogger_close(logger);
+    assert(test_mylogger_count_lines("test_stats_log_file.txt", "Test - stats without counters") == 1);
+    remove("test_stats_log_file.txt");
+
+    // handle without counters
+    logger = mylogger_create(&(mylogger_config_t){.features = MYLOGGER_FEATURE_NO_FILE | MYLOGGER_FEATURE_STDERR}, NULL);
+    assert(logger != NULL);
+    assert(!mylogger_logger_get_stats(logger, &stats));
+    mylogger_close(logger);
+
+    // every failure of the initialization is cleaned up
+    test_mylogger_init_failures(&(mylogger_config_t){.features = MYLOGGER_FEATURE_STATS, .flush = {.interval_ms = 10}});
+}
+
+static void test_mylogger_io_uring(void)
+{
+    static char long_text[60000];
+    memset(long_text, 'x', sizeof(long_text) - 1);
+    const size_t flush_sizes[] = {0, 1};
+    for(size_t i = 0; i < sizeof(flush_sizes) / sizeof(flush_sizes[0]); i++)
+    {
+        // content of appended file stays in front, batches in flight land in message order
+        FILE* f = fopen("test_uring_log_file.txt", "w+");
+        assert(f != NULL);
+        fputs("Test - file header\n", f);
+        fclose(f);
+        f = fopen("test_uring_log_file.txt", "a+");
+        assert(f != NULL);
+
+        mylogger_t* logger = mylogger_create(&(mylogger_config_t){.log_file = f,
+                                                                  .features = MYLOGGER_FEATURE_ASYNC | MYLOGGER_FEATURE_IO_URING,
+                                                                  .flush.size = flush_sizes[i],
+                                                                  .sync_interval_ms = 1}, NULL);
+        assert(logger != NULL);
+        // io_uring can be disabled in the kernel, then the same output is written with writev
+        struct io_uring_params params = {0};
+        const int ring_fd = (int)syscall(SYS_io_uring_setup, 1, &params);
+        assert((logger->sinks[0].uring != NULL) == (ring_fd >= 0));
+        if(ring_fd >= 0)
+            close(ring_fd);
+
+        for(int j = 0; j < 20000; j++)
+        {
+            MYLOGGER_INFO_TO(logger, "Test - uring %d\n", j);
+            if(j % 1000 == 0)
+                MYLOGGER_INFO_TO(logger, "Test - uring long %s\n", long_text);
+        }
+        mylogger_close(logger);
+
+        f = fopen("test_uring_log_file.txt", "r");
+        assert(f != NULL);
+        char* line = malloc(MYLOGGER_ASYNC_MESSAGE_MAX_SIZE);
+        assert(line != NULL);
+        assert(fgets(line, MYLOGGER_ASYNC_MESSAGE_MAX_SIZE, f) != NULL && strcmp(line, "Test - file header\n") == 0);
+        int expected = 0;
+        size_t long_lines = 0;
+        while(fgets(line, MYLOGGER_ASYNC_MESSAGE_MAX_SIZE, f) != NULL)
+        {
+            const char* text = strstr(line, "Test - uring ");
+            assert(text != NULL);
+            if(strstr(text, "long") != NULL)
+            {
+                assert(strlen(line) > sizeof(long_text));
+                long_lines++;
+                continue;
+            }
+            assert(atoi(&text[strlen("Test - uring ")]) == expected);
+            expected++;
+        }
+        assert(expected == 20000 && long_lines == 20);
+        free(line);
+        fclose(f);
+        remove("test_uring_log_file.txt");
+    }
+
+    // failed request is written directly
+    const int fd = open("test_uring_log_file.txt", O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    assert(fd >= 0);
+    MyLogger_uring_S* uring = __mylogger_uring_open(fd, 64);
+    if(uring != NULL)
+    {
+        static const char text[] = "Test - uring failed request\n";
+        MyLogger_uring_slot_S* slot = __mylogger_uring_slot(uring);
+        memcpy(slot->buffer, text, sizeof(text) - 1);
+        slot->len = sizeof(text) - 1;
+        slot->done = 0;
+        slot->offset = atomic_fetch_add(uring->offset, slot->len);
+        slot->busy = true;
+        struct io_uring_sqe sqe = {
+            .opcode = IORING_OP_WRITE,
+            .fd = -1,
+            .off = slot->offset,
+            .addr = (uint64_t)(uintptr_t)slot->buffer,
+            .len = (uint32_t)slot->len,
+            .user_data = (uint64_t)(slot - uring->slots)
+        };
+        assert(__mylogger_uring_push(uring, &sqe));
+        __mylogger_uring_wait(uring);
+        assert(!slot->busy && slot->done == slot->len);
+
+        // short write is resubmitted
+        slot = __mylogger_uring_slot(uring);
+        memcpy(slot->buffer, text, sizeof(text) - 1);
+        slot->done = 0;
+        slot->offset = atomic_fetch_add(uring->offset, slot->len);
+        slot->busy = true;
+        sqe.fd = uring->fd;
+        sqe.off = slot->offset;
+        sqe.addr = (uint64_t)(uintptr_t)slot->buffer;
+        sqe.len = (uint32_t)slot->len - 5;
+        sqe.user_data = (uint64_t)(slot - uring->slots);
+        assert(__mylogger_uring_push(uring, &sqe));
+        __mylogger_uring_wait(uring);
+        assert(!slot->busy && slot->done == slot->len);
+
+        // interrupted submission is repeated, full queue waits for completions, failed submission is written directly
+        uring->owner = pthread_self();
+        uring->owned = true;
+        static const char large[] = "Test - uring message larger than the slot buffer of sixty four bytes\n";
+        const struct iovec iov = {.iov_base = (void*)large, .iov_len = sizeof(large) - 1};
+        MOCK_FAIL_AT(g_uring_enter_mock_counter, 1);
+        __mylogger_uring_writev(uring, &iov, 1);
+        g_uring_enter_mock_errno = EBUSY;
+        MOCK_FAIL_AT(g_uring_enter_mock_counter, 1);
+        __mylogger_uring_writev(uring, &iov, 1);
+        g_uring_enter_mock_errno = EBADF;
+        MOCK_FAIL_AT(g_uring_enter_mock_counter, 1);
+        MOCK_FAIL_AT(g_pwrite_mock_counter, 1);
+        __mylogger_uring_writev(uring, &iov, 1);
+        MOCK_FAIL_AT(g_uring_enter_mock_counter, 1);
+        __mylogger_uring_sync(uring);
+        g_uring_enter_mock_errno = EINTR;
+        assert(!uring->sync_pending);
+        // sync already in flight is not repeated
+        uring->sync_pending = true;
+        __mylogger_uring_sync(uring);
+        uring->sync_pending = false;
+        __mylogger_uring_wait(uring);
+
+        // failed write loses the batch
+        slot = __mylogger_uring_slot(uring);
+        slot->len = 1;
+        slot->done = 0;
+        slot->busy = true;
+        const int uring_fd = uring->fd;
+        uring->fd = -1;
+        __mylogger_uring_pwrite(uring, slot);
+        uring->fd = uring_fd;
+        assert(!slot->busy && slot->done == 0);
+        uring->owned = false;
+
+        __mylogger_uring_close(uring);
+        assert(test_mylogger_count_lines("test_uring_log_file.txt", text) == 2);
+        assert(test_mylogger_count_lines("test_uring_log_file.txt", "sixty four bytes") == 3);
+    }
+    close(fd);
+    remove("test_uring_log_file.txt");
+
+    // writer thread syncs the file also without io_uring, counts batches handed over to io_uring
+    const mylogger_feature_t modes[] = {MYLOGGER_FEATURE_ASYNC, MYLOGGER_FEATURE_ASYNC | MYLOGGER_FEATURE_IO_URING | MYLOGGER_FEATURE_STATS};
+    for(size_t m = 0; m < sizeof(modes) / sizeof(modes[0]); m++)
+    {
+        FILE* f = fopen("test_uring_log_file.txt", "w+");
+        assert(f != NULL);
+        mylogger_t* logger = mylogger_create(&(mylogger_config_t){.log_file = f, .features = modes[m], .sync_interval_ms = 1}, NULL);
+        assert(logger != NULL);
+        for(int j = 0; j < 100; j++)
+        {
+            MYLOGGER_INFO_TO(logger, "Test - uring sync %d\n", j);
+            nanosleep(&(struct timespec){.tv_sec = 0, .tv_nsec = 100000L}, NULL);
+        }
+        mylogger_stats_t stats;
+        assert(!(modes[m] & MYLOGGER_FEATURE_STATS) || (mylogger_logger_get_stats(logger, &stats) && stats.sink_write.count > 0));
+        mylogger_close(logger);
+        assert(test_mylogger_count_lines("test_uring_log_file.txt", "Test - uring sync") == 100);
+        remove("test_uring_log_file.txt");
+    }
+
+    // crash report goes into reserved space, also when the writer thread is stuck
+    for(size_t stuck = 0; stuck < 2; stuck++)
+    {
+        const pid_t pid = fork();
+        assert(pid >= 0);
+        if(pid == 0)
+        {
+            setrlimit(RLIMIT_CORE, &(struct rlimit){0, 0});
+            FILE* f = fopen("test_uring_log_file.txt", "w+");
+            if(f == NULL || mylogger_init(f, MYLOGGER_FEATURE_CRASH_HANDLER | MYLOGGER_FEATURE_ASYNC | MYLOGGER_FEATURE_IO_URING) != MYLOGGER_INIT_SUCCESS)
+                _exit(1);
+            for(int j = 0; j < 100; j++)
+                MYLOGGER_INFO("Test - uring before crash %d\n", j);
+            if(stuck)
+            {
+                nanosleep(&(struct timespec){.tv_sec = 0, .tv_nsec = 100000000L}, NULL);
+                pthread_mutex_lock(&atomic_load(&g_mylogger_instance)->mutex);
+            }
+            raise(SIGSEGV);
+            _exit(0);
+        }
+        int status;
+        assert(waitpid(pid, &status, 0) == pid);
+        assert(WIFSIGNALED(status) && WTERMSIG(status) == SIGSEGV);
+        assert(test_mylogger_count_lines("test_uring_log_file.txt", "Test - uring before crash") == 100);
+        assert(test_mylogger_count_lines("test_uring_log_file.txt", "MyLogger: caught SIGSEGV") == 1);
+        remove("test_uring_log_file.txt");
+    }
+
+    // rings that cannot be set up fall back to writev
+    test_mylogger_init_failures(&(mylogger_config_t){.features = MYLOGGER_FEATURE_ASYNC | MYLOGGER_FEATURE_IO_URING});
+}
+
+static void* test_mylogger_recorder_worker(void* arg)
+{
+    MYLOGGER_DEBUG_TO((mylogger_t*)arg, "Test - recorder worker %s\n", "context");
+    return NULL;
+}
+
+// Thread without recorder loses its messages.
+static void* test_mylogger_recorder_lost_worker(void* arg)
+{
+    // first allocation of the thread is its crash stack
+    MOCK_FAIL_AT(g_malloc_mock_counter, 2);
+    MYLOGGER_DEBUG_TO((mylogger_t*)arg, "Test - recorder lost\n");
+    return NULL;
+}
+
+// Thread without buffer for the dump writes nothing.
+static void* test_mylogger_recorder_dump_worker(void* arg)
+{
+    MOCK_FAIL_AT(g_realloc_mock_counter, 1);
+    assert(mylogger_logger_dump_recorder((mylogger_t*)arg));
+    return NULL;
+}
+
+static void test_mylogger_recorder(void)
+{
+    const mylogger_feature_t features[] = {0, MYLOGGER_FEATURE_ASYNC | MYLOGGER_FEATURE_DEFERRED};
+    for(size_t i = 0; i < sizeof(features) / sizeof(features[0]); i++)
+    {
+        FILE* f = fopen("test_recorder_log_file.txt", "w+");
+        assert(f != NULL);
+        mylogger_t* logger = mylogger_create(&(mylogger_config_t){.log_file = f,
+                                                                  .features = features[i],
+                                                                  .level = MYLOGGER_LEVEL_INFO,
+                                                                  .recorder.size = 4096}, NULL);
+        assert(logger != NULL);
+        assert(mylogger_logger_get_level(logger) == MYLOGGER_LEVEL_INFO);
+
+        // only the newest messages fit in the recorder, arguments are evaluated
+        int evaluated = 0;
+        for(int j = 0; j < 1000; j++)
+            MYLOGGER_DEBUG_TO(logger, "Test - recorder debug %d %s\n", evaluated++, "context");
+        assert(evaluated == 1000);
+        MYLOGGER_DEBUG_TO(logger, "Test - recorder positional %1$d\n", 1000);
+        MYLOGGER_INFO_TO(logger, "Test - recorder info\n");
+        MYLOGGER_ERROR_TO(logger, "Test - recorder error\n");
+        // recorder is empty after dump
+        MYLOGGER_ERROR_TO(logger, "Test - recorder second error\n");
+
+        // raised threshold records INFO too, other threads are dumped on demand
+        mylogger_logger_set_level(logger, MYLOGGER_LEVEL_WARNING);
+        assert(mylogger_logger_get_level(logger) == MYLOGGER_LEVEL_WARNING);
+        MYLOGGER_INFO_TO(logger, "Test - recorder raised info\n");
+        pthread_t thread;
+        assert(pthread_create(&thread, NULL, test_mylogger_recorder_worker, logger) == 0);
+        pthread_join(thread, NULL);
+        assert(mylogger_logger_dump_recorder(logger));
+        mylogger_close(logger);
+
+        f = fopen("test_recorder_log_file.txt", "r");
+        assert(f != NULL);
+        char* content = calloc(1, 1 << 20);
+        assert(content != NULL);
+        assert(fread(content, 1, (1 << 20) - 1, f) > 0);
+        fclose(f);
+
+        const char* info = strstr(content, "[INFO]");
+        const char* last = strstr(content, "Test - recorder debug 999 context\n");
+        const char* positional = strstr(content, "Test - recorder positional 1000\n");
+        const char* error = strstr(content, "Test - recorder error");
+        const char* second = strstr(content, "Test - recorder second error");
+        assert(info != NULL && strstr(info, "Test - recorder info") != NULL);
+        assert(last != NULL && positional != NULL && error != NULL && second != NULL);
+        assert(info < last && last < positional && positional < error && error < second);
+        assert(strstr(content, "Test - recorder debug 0 context") == NULL);
+        assert(strstr(error, "[DEBUG]") > second);
+        // consecutive newest messages
+        int previous = -1;
+        for(const char* line = strstr(content, "Test - recorder debug "); line != NULL; line = strstr(line + 1, "Test - recorder debug "))
+        {
+            const int number = atoi(&line[strlen("Test - recorder debug ")]);
+            assert(previous == -1 || number == previous + 1);
+            previous = number;
+        }
+        assert(previous == 999);
+        assert(strstr(second, "[INFO]") != NULL && strstr(second, "Test - recorder raised info") != NULL);
+        assert(strstr(second, "Test - recorder worker context") != NULL);
+        free(content);
+    }
+
+    // writer thread dumps recorders before the crash report
+    const pid_t pid = fork();
+    assert(pid >= 0);
+    if(pid == 0)
+    {
+        setrlimit(RLIMIT_CORE, &(struct rlimit){0, 0});
+        FILE* f = fopen("test_recorder_log_file.txt", "w+");
+        if(f == NULL || mylogger_init_config(&(mylogger_config_t){.log_file = f,
+                                                                  .features = MYLOGGER_FEATURE_ASYNC | MYLOGGER_FEATURE_CRASH_HANDLER,
+                                                                  .level = MYLOGGER_LEVEL_INFO,
+                                                                  .recorder.size = 4096}) != MYLOGGER_INIT_SUCCESS)
+            _exit(1);
+        MYLOGGER_DEBUG("Test - recorder before crash\n");
+        raise(SIGSEGV);
+        _exit(0);
+    }
+    int status;
+    assert(waitpid(pid, &status, 0) == pid);
+    assert(WIFSIGNALED(status) && WTERMSIG(status) == SIGSEGV);
+    assert(test_mylogger_count_lines("test_recorder_log_file.txt", "Test - recorder before crash") == 1);
+    assert(test_mylogger_count_lines("test_recorder_log_file.txt", "MyLogger: caught SIGSEGV") == 1);
+
+    // default instance, disabled recorder keeps levels as they are
+    FILE* f = fopen("test_recorder_log_file.txt", "w+");
+    assert(f != NULL);
+    assert(mylogger_init_config(&(mylogger_config_t){.log_file = f,
+                                                     .level = MYLOGGER_LEVEL_WARNING,
+                                                     .recorder = {.size = 1, .dump_level = MYLOGGER_LEVEL_WARNING}}) == MYLOGGER_INIT_SUCCESS);
+    assert(mylogger_get_level() == MYLOGGER_LEVEL_WARNING);
+    MYLOGGER_DEBUG("Test - recorder default debug\n");
+    MYLOGGER_WARNING("Test - recorder default warning\n");
+    assert(mylogger_dump_recorder());
+    mylogger_destroy();
+    assert(!mylogger_dump_recorder());
+    assert(test_mylogger_count_lines("test_recorder_log_file.txt", "Test - recorder default debug") == 1);
+
+    f = fopen("test_recorder_log_file.txt", "w+");
+    assert(f != NULL);
+    assert(mylogger_init_config(&(mylogger_config_t){.log_file = f, .level = MYLOGGER_LEVEL_WARNING}) == MYLOGGER_INIT_SUCCESS);
+    MYLOGGER_DEBUG("Test - recorder default debug\n");
+    MYLOGGER_ERROR("Test - recorder default error\n");
+    assert(!mylogger_dump_recorder());
+    mylogger_destroy();
+    assert(test_mylogger_count_lines("test_recorder_log_file.txt", "Test - recorder default debug") == 0);
+
+    // explicit DEBUG dump level dumps before every written message
+    f = fopen("test_recorder_log_file.txt", "w+");
+    assert(f != NULL);
+    assert(mylogger_init_config(&(mylogger_config_t){.log_file = f,
+                                                     .level = MYLOGGER_LEVEL_INFO,
+                                                     .recorder = {.size = 4096,
+                                                                  .dump_level = MYLOGGER_LEVEL_DEBUG,
+                                                                  .dump_level_set = true}}) == MYLOGGER_INIT_SUCCESS);
+    MYLOGGER_DEBUG("Test - recorder dumped debug\n");
+    MYLOGGER_INFO("Test - recorder dumping info\n");
+    mylogger_destroy();
+    assert(test_mylogger_count_lines("test_recorder_log_file.txt", "Test - recorder dumped debug") == 1);
+
+    // recorders of exited threads are reused, mapped log file gets the dump too
+    f = fopen("test_recorder_log_file.txt", "w+");
+    assert(f != NULL);
+    mylogger_t* logger = mylogger_create(&(mylogger_config_t){.log_file = f,
+                                                              .features = MYLOGGER_FEATURE_MMAP,
+                                                              .level = MYLOGGER_LEVEL_INFO,
+                                                              .recorder.size = 5000}, NULL);
+    assert(logger != NULL && logger->recorder_size == 2 * MYLOGGER_RECORDER_MIN_SIZE);
+    pthread_t thread;
+    assert(pthread_create(&thread, NULL, test_mylogger_recorder_lost_worker, logger) == 0);
+    pthread_join(thread, NULL);
+    assert(logger->recorders == NULL);
+    for(size_t i = 0; i < 2; i++)
+    {
+        assert(pthread_create(&thread, NULL, test_mylogger_recorder_worker, logger) == 0);
+        pthread_join(thread, NULL);
+    }
+    assert(logger->recorders != NULL && logger->recorders->next == NULL);
+    assert(pthread_create(&thread, NULL, test_mylogger_recorder_dump_worker, logger) == 0);
+    pthread_join(thread, NULL);
+
+    // writer thread of a crashed process skips recorders locked by the crashed thread
+    pthread_mutex_lock(&logger->recorder_mutex);
+    __mylogger_recorders_dump(logger, true);
+    pthread_mutex_unlock(&logger->recorder_mutex);
+    pthread_mutex_lock(&logger->recorders->mutex);
+    __mylogger_recorders_dump(logger, true);
+    pthread_mutex_unlock(&logger->recorders->mutex);
+
+    assert(mylogger_logger_dump_recorder(logger));
+    mylogger_close(logger);
+    assert(test_mylogger_count_lines("test_recorder_log_file.txt", "Test - recorder lost") == 0);
+    assert(test_mylogger_count_lines("test_recorder_log_file.txt", "Test - recorder worker context") == 1);
+    remove("test_recorder_log_file.txt");
+
+    logger = mylogger_create(&(mylogger_config_t){.features = MYLOGGER_FEATURE_NO_FILE | MYLOGGER_FEATURE_STDERR}, NULL);
+    assert(logger != NULL);
+    assert(!mylogger_logger_dump_recorder(logger));
+    mylogger_close(logger);
+
+    // every failure of the initialization is cleaned up
+    test_mylogger_init_failures(&(mylogger_config_t){.features = MYLOGGER_FEATURE_STATS,
+                                                     .flush = {.interval_ms = 10},
+                                                     .recorder = {.size = 4096}});
+}
+
+/**
+ * Formats format with vsnprintf, parsed format program and captured arguments, results have to be equal.
+ * */
+static void test_mylogger_fast_format_compare(size_t size, const char* format, ...)
+{
+    char expected[512];
+    char actual[512];
+    char captured[512];
+    char rendered[512];
+    assert(size <= sizeof(expected));
+
+    va_list args;
+    va_start(args, format);
+    va_list copy;
+    va_copy(copy, args);
+    const int expected_len = vsnprintf(expected, size, format, copy);
+    va_end(copy);
+
+    MyLogger_format_program_S* program = __mylogger_format_parse(format);
+    assert(program != NULL);
+    if(program->supported && expected_len >= 0)
+    {
+        memset(actual, 'X', sizeof(actual));
+        va_copy(copy, args);
+        const size_t actual_len = __mylogger_format_run(actual, size, program, copy);
+        va_end(copy);
+        if(actual_len != (size_t)expected_len || (size > 0 && strcmp(actual, expected) != 0))
+        {
+            fprintf(stderr, "format \"%s\" size %zu: expected \"%s\" (%d), got \"%s\" (%zu)\n",
+                    format, size, expected, expected_len, actual, actual_len);
+            assert(false);
+        }
+
+        // deferred rendering uses the same formatter
+        va_copy(copy, args);
+        const size_t captured_len = __mylogger_capture_args(captured, sizeof(captured), format, copy);
+        va_end(copy);
+        if(captured_len != MYLOGGER_CAPTURE_FAILED && size > 0)
+        {
+            __mylogger_render_args(rendered, size, format, captured, &captured[captured_len]);
+            assert(strcmp(rendered, expected) == 0);
+        }
+    }
+    free(program);
+    va_end(args);
+}
+
+static const char* const g_test_format_race = "Test - format race %d\n";
+static mylogger_site_t g_test_format_race_site;
+
+// Another thread parses the format of the site in the middle of the parsing.
+static void test_mylogger_format_race_hook(void)
+{
+    atomic_store(&g_test_format_race_site.parsed, __mylogger_format_parse(g_test_format_race));
+}
+
+/**
+ * Testing formatter of call sites against vsnprintf with random formats and values.
+ * */
+static void test_mylogger_fast_format(void)
+{
+    static const char* const flags[] = {"", "", "", "-", "0", "+", " ", "-0", "+0", " -", "#", "'", "0+ "};
+    static const char* const lengths[] = {"", "", "", "l", "ll", "z", "j", "t", "h", "hh", "L", "q"};
+    static const char* const strings[] = {NULL, "", "a", "text", "longer text with spaces"};
+    const char conversions[] = "diuxXcspfFfFeEgGaoo%";
+
+    uint64_t state = 0x9E3779B97F4A7C15ULL;
+#define TEST_RANDOM() (state ^= state << 13, state ^= state >> 7, state ^= state << 17, state)
+
+    for(size_t i = 0; i < 200000; i++)
+    {
+        // RANDOM FORMAT WITH ONE CONVERSION
+        char format[64];
+        char width[8] = "";
+        char precision[8] = "";
+        const uint64_t choice = TEST_RANDOM();
+        if(choice % 4 == 1)
+            snprintf(width, sizeof(width), "%u", (unsigned int)(choice >> 8) % 30);
+        else if(choice % 4 == 2)
+            snprintf(width, sizeof(width), "*");
+        if((choice >> 16) % 4 == 1)
+            snprintf(precision, sizeof(precision), ".%u", (unsigned int)(choice >> 24) % 14);
+        else if((choice >> 16) % 4 == 2)
+            snprintf(precision, sizeof(precision), ".*");
+        snprintf(format, sizeof(format), "%s%%%s%s%s%s%c%s",
+                 (choice >> 32) % 2 == 0 ? "" : "a=",
+                 flags[(choice >> 34) % (sizeof(flags) / sizeof(flags[0]))],
+                 strcmp(width, "0") == 0 ? "" : width,
+                 precision,
+                 lengths[(choice >> 40) % (sizeof(lengths) / sizeof(lengths[0]))],
+                 conversions[(choice >> 44) % (sizeof(conversions) - 1)],
+                 (choice >> 50) % 2 == 0 ? "" : " end");
+        const size_t size = (choice >> 51) % 4 == 0 ? 1 + (choice >> 53) % 24 : 512;
+
+        MyLogger_conversion_S conv;
+        assert(__mylogger_next_conversion(format, &conv) != NULL);
+        const int star1 = (int)(TEST_RANDOM() % 50) - 20;
+        const int star2 = (int)(TEST_RANDOM() % 50) - 20;
+
+        // RANDOM VALUE OF THE ARGUMENT TYPE
+        const uint64_t bits = TEST_RANDOM();
+        const uint64_t small = TEST_RANDOM() % 3 == 0 ? bits % 1000 : bits;
+        double number;
+        switch(bits % 6)
+        {
+            case 0:  memcpy(&number, &bits, sizeof(number)); break;
+            case 1:  number = (double)(int64_t)small / 8.0; break;    // halves and eighths for rounding ties
+            case 2:  number = (double)(bits % 2000000) / 1000.0 - 1000.0; break;
+            case 3:
+            {
+                // exponents around the 2^63 limit and small fractions
+                const uint64_t exponent = 1023 + 63 - bits % 130;
+                const uint64_t value = (bits & 0x800FFFFFFFFFFFFFULL) | exponent << 52;
+                memcpy(&number, &value, sizeof(number));
+                break;
+            }
+            case 4:  number = (double)(int64_t)bits; break;
+            default: number = (double)(bits % 100) * 1e-310; break; // subnormals
+        }
+        if(bits % 97 == 0)
+            number = bits % 2 == 0 ? -0.0 : INFINITY;
+
+#define TEST_COMPARE(value) \
+        do { \
+            if(conv.stars == 0) \
+                test_mylogger_fast_format_compare(size, format, value); \
+            else if(conv.stars == 1) \
+                test_mylogger_fast_format_compare(size, format, star1, value); \
+            else \
+                test_mylogger_fast_format_compare(size, format, star1, star2, value); \
+        } while(0)
+
+        switch(conv.type)
+        {
+            case MYLOGGER_ARG_NONE:         test_mylogger_fast_format_compare(size, format); break;
+            case MYLOGGER_ARG_INT:          TEST_COMPARE((int)small); break;
+            case MYLOGGER_ARG_UINT:         TEST_COMPARE((unsigned int)small); break;
+            case MYLOGGER_ARG_LONG:         TEST_COMPARE((long)small); break;
+            case MYLOGGER_ARG_ULONG:        TEST_COMPARE((unsigned long)small); break;
+            case MYLOGGER_ARG_LLONG:        TEST_COMPARE((long long)small); break;
+            case MYLOGGER_ARG_ULLONG:       TEST_COMPARE((unsigned long long)small); break;
+            case MYLOGGER_ARG_INTMAX:       TEST_COMPARE((intmax_t)small); break;
+            case MYLOGGER_ARG_UINTMAX:      TEST_COMPARE((uintmax_t)small); break;
+            case MYLOGGER_ARG_SIZE:         TEST_COMPARE((size_t)small); break;
+            case MYLOGGER_ARG_PTRDIFF:      TEST_COMPARE((ptrdiff_t)small); break;
+            case MYLOGGER_ARG_DOUBLE:       TEST_COMPARE(number); break;
+            case MYLOGGER_ARG_LDOUBLE:      TEST_COMPARE((long double)number); break;
+            case MYLOGGER_ARG_PTR:          TEST_COMPARE(small % 5 == 0 ? NULL : (void*)(uintptr_t)small); break;
+            case MYLOGGER_ARG_STR:          TEST_COMPARE(strings[small % (sizeof(strings) / sizeof(strings[0]))]); break;
+            case MYLOGGER_ARG_UNSUPPORTED:
+            default:
+                break;
+        }
+#undef TEST_COMPARE
+    }
+#undef TEST_RANDOM
+
+    // several conversions, extreme values and truncation inside a conversion
+    for(size_t size = 1; size < 80; size++)
+    {
+        test_mylogger_fast_format_compare(size, "%d|%u|%x|%X|%ld|%zu|%lld|%%|%s|%c|%p|%f|%.3f|%-8s|%08.2f",
+                                          INT_MIN, UINT_MAX, 0xDEADBEEFU, 48879U, LONG_MIN, SIZE_MAX, LLONG_MAX,
+                                          "str", 'c', (void*)&size, -1234.5678, 0.0005, "ab", -3.14159);
+        test_mylogger_fast_format_compare(size, "%.9f %.0f %.0f %.0f %f %f", 0.1, 0.5, 1.5, 2.5, 9223372036854774784.0, 1e-320);
+    }
+
+    // call site caches the parsed format, other formats of the same site use vsnprintf
+    FILE* f = fopen("test_fast_format_log_file.txt", "w+");
+    assert(f != NULL);
+    mylogger_t* logger = mylogger_create(&(mylogger_config_t){.log_file = f}, NULL);
+    assert(logger != NULL);
+    for(int i = 0; i < 3; i++)
+        MYLOGGER_INFO_TO(logger, "Test - fast format %d %5.2f %-4s| %p %m\n", -i, 2.345 * i, "s", NULL);
+    for(int i = 0; i < 3; i++)
+        MYLOGGER_INFO_TO(logger, "Test - fast format %d %5.2f %-4s|\n", -i, 2.345 * i, "s");
+    mylogger_close(logger);
+    assert(test_mylogger_count_lines("test_fast_format_log_file.txt", "Test - fast format -2  4.69 s   | (nil) ") == 1);
+    assert(test_mylogger_count_lines("test_fast_format_log_file.txt", "Test - fast format -2  4.69 s   |\n") == 1);
+    assert(test_mylogger_count_lines("test_fast_format_log_file.txt", "Test - fast format 0  0.00 s   |") == 2);
+    remove("test_fast_format_log_file.txt");
+
+    // zero precision prints no digits of zero
+    test_mylogger_fast_format_compare(512, "%.0d|%5.0x|%-3.0i|", 0, 0u, 0);
+
+    // format that cannot be parsed is formatted by vsnprintf, the next call parses it
+    mylogger_site_t unparsed = {0};
+    MOCK_FAIL_AT(g_malloc_mock_counter, 1);
+    assert(__mylogger_format_program(&unparsed, g_test_format_race) == NULL);
+    assert(__mylogger_format_program(&unparsed, g_test_format_race) != NULL);
+    free((void*)atomic_load(&unparsed.parsed));
+
+    // only one of the threads parsing the same site at the same time keeps its program
+    g_malloc_mock_hook = test_mylogger_format_race_hook;
+    const MyLogger_format_program_S* program = __mylogger_format_program(&g_test_format_race_site, g_test_format_race);
+    assert(program != NULL && program == atomic_load(&g_test_format_race_site.parsed));
+    free((void*)program);
+
+    // sites keep nothing allocated without an instance, the next instance renders the prefixes again
+    assert(atomic_load(&g_mylogger_instances) == NULL && g_mylogger_sites != NULL);
+    for(const mylogger_site_t* site = g_mylogger_sites; site != NULL; site = site->next)
+        assert(site->prefix == NULL && site->prefix_len == 0 && atomic_load(&site->parsed) == NULL);
+    logger = mylogger_create(&(mylogger_config_t){.features = MYLOGGER_FEATURE_NO_FILE | MYLOGGER_FEATURE_STDERR}, NULL);
+    assert(logger != NULL);
+    for(const mylogger_site_t* site = g_mylogger_sites; site != NULL; site = site->next)
+        assert(site->prefix != NULL && site->prefix_len == strlen(site->prefix));
+    mylogger_close(logger);
+}
+
+#define TEST_FORK_CHILDREN  8
+#define TEST_FORK_LINES     300
+#define TEST_FORK_BEFORE    10
+#define TEST_FORK_PAYLOAD   "0123456789abcdefghijklmnopqrstuvwxyz0123456789abcdefghijklmnopqrstuvwxyz0123456789" \
+                            "abcdefghijklmnopqrstuvwxyz0123456789abcdefghijklmnopqrstuvwxyz0123456789abcdefghij"
+
+static atomic_bool g_test_fork_stop;
+
+static void* test_mylogger_fork_worker(void* arg)
+{
+    int count = 0;
+    while(!atomic_load(&g_test_fork_stop))
+        MYLOGGER_INFO_TO((mylogger_t*)arg, "Test - fork thread %d " TEST_FORK_PAYLOAD "\n", count++);
+    return (void*)(intptr_t)count;
+}
+
+static void test_mylogger_fork_writers(void)
+{
+    static const struct
+    {
+        mylogger_feature_t features;
+        size_t recorder;
+        bool independent;       // every child opens the file again and creates its own logger
+    } modes[] = {
+        {MYLOGGER_FEATURE_THREAD_ID, 0, false},
+        {MYLOGGER_FEATURE_ASYNC, 0, false},
+        {MYLOGGER_FEATURE_ASYNC | MYLOGGER_FEATURE_DEFERRED, 0, false},
+        {MYLOGGER_FEATURE_ASYNC | MYLOGGER_FEATURE_IO_URING, 0, false},
+        {MYLOGGER_FEATURE_MMAP, 0, false},
+        {MYLOGGER_FEATURE_MMAP | MYLOGGER_FEATURE_ASYNC, 0, false},
+        {MYLOGGER_FEATURE_STATS, 4096, false},
+        {MYLOGGER_FEATURE_SHARED, 0, false},
+        {MYLOGGER_FEATURE_SHARED | MYLOGGER_FEATURE_ASYNC | MYLOGGER_FEATURE_IO_URING, 0, false},
+        {MYLOGGER_FEATURE_SHARED, 0, true},
+        {MYLOGGER_FEATURE_SHARED | MYLOGGER_FEATURE_ASYNC, 0, true}
+    };
+
+    // shared file cannot be mapped, rotated or binary
+    FILE* f = fopen("test_fork_log_file.txt", "w+");
+    assert(f != NULL);
+    fprintf(stderr, "\033[0;32mExpected error: \033[0m");
+    assert(mylogger_create(&(mylogger_config_t){.log_file = f, .features = MYLOGGER_FEATURE_SHARED | MYLOGGER_FEATURE_MMAP}, NULL) == NULL);
+    fprintf(stderr, "\033[0;32mExpected error: \033[0m");
+    assert(mylogger_create(&(mylogger_config_t){.log_file = f, .features = MYLOGGER_FEATURE_SHARED | MYLOGGER_FEATURE_BINARY}, NULL) == NULL);
+    fprintf(stderr, "\033[0;32mExpected error: \033[0m");
+    assert(mylogger_create(&(mylogger_config_t){.log_file = f, .features = MYLOGGER_FEATURE_SHARED, .rotation.max_size = 1024}, NULL) == NULL);
+    fclose(f);
+
+    for(size_t i = 0; i < sizeof(modes) / sizeof(modes[0]); i++)
+    {
+        f = fopen("test_fork_log_file.txt", "w+");
+        assert(f != NULL);
+        mylogger_t* logger = mylogger_create(&(mylogger_config_t){.log_file = f,
+                                                                  .features = modes[i].features,
+                                                                  .recorder.size = modes[i].recorder,
+                                                                  .mmap_region_size = 4096}, NULL);
+        assert(logger != NULL);
+        const bool uring = logger->sinks_count > 0 && logger->sinks[0].uring != NULL;
+
+        // batched and queued messages are written once, by the parent
+        for(int j = 0; j < TEST_FORK_BEFORE; j++)
+            MYLOGGER_INFO_TO(logger, "Test - fork before %d " TEST_FORK_PAYLOAD "\n", j);
+        atomic_store(&g_test_fork_stop, false);
+        pthread_t thread;
+        assert(pthread_create(&thread, NULL, test_mylogger_fork_worker, logger) == 0);
+
+        pid_t children[TEST_FORK_CHILDREN];
+        for(int child = 0; child < TEST_FORK_CHILDREN; child++)
+        {
+            children[child] = fork();
+            assert(children[child] >= 0);
+            if(children[child] == 0)
+            {
+                // lock inherited in a wrong state would hang the child
+                alarm(30);
+                mylogger_t* own = logger;
+                if(modes[i].independent)
+                {
+                    FILE* file = fopen("test_fork_log_file.txt", "r+");
+                    own = file != NULL ? mylogger_create(&(mylogger_config_t){.log_file = file,
+                                                                                .features = modes[i].features}, NULL) : NULL;
+                    if(own == NULL)
+                        _exit(1);
+                }
+                for(int j = 0; j < TEST_FORK_LINES; j++)
+                    MYLOGGER_INFO_TO(own, "Test - fork child %d line %d " TEST_FORK_PAYLOAD "\n", child, j);
+                mylogger_close(own);
+                _exit(0);
+            }
+        }
+        for(int child = 0; child < TEST_FORK_CHILDREN; child++)
+        {
+            int status;
+            assert(waitpid(children[child], &status, 0) == children[child]);
+            assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+        }
+        // parent keeps its ring, children reserved space from the same offset
+        assert((logger->sinks_count > 0 && logger->sinks[0].uring != NULL) == uring);
+
+        atomic_store(&g_test_fork_stop, true);
+        void* result;
+        pthread_join(thread, &result);
+        const int thread_count = (int)(intptr_t)result;
+        mylogger_close(logger);
+
+        // every line is whole and written exactly once
+        static unsigned char seen[TEST_FORK_CHILDREN][TEST_FORK_LINES];
+        memset(seen, 0, sizeof(seen));
+        unsigned char before[TEST_FORK_BEFORE] = {0};
+        unsigned char* thread_seen = calloc((size_t)thread_count + 1, 1);
+        assert(thread_seen != NULL);
+        f = fopen("test_fork_log_file.txt", "r");
+        assert(f != NULL);
+        char line[1024];
+        while(fgets(line, sizeof(line), f) != NULL)
+        {
+            const char* text = strstr(line, "Test - fork ");
+            assert(text != NULL);
+            const char* payload = strstr(text, TEST_FORK_PAYLOAD "\n");
+            assert(payload != NULL && strcmp(payload, TEST_FORK_PAYLOAD "\n") == 0);
+            int child;
+            int number;
+            if(sscanf(text, "Test - fork child %d line %d ", &child, &number) == 2)
+            {
+                assert(child >= 0 && child < TEST_FORK_CHILDREN && number >= 0 && number < TEST_FORK_LINES);
+                seen[child][number]++;
+            }
+            else if(sscanf(text, "Test - fork before %d ", &number) == 1)
+            {
+                assert(number >= 0 && number < TEST_FORK_BEFORE);
+                before[number]++;
+            }
+            else
+            {
+                assert(sscanf(text, "Test - fork thread %d ", &number) == 1);
+                assert(number >= 0 && number < thread_count);
+                thread_seen[number]++;
+            }
+        }
+        fclose(f);
+        for(int child = 0; child < TEST_FORK_CHILDREN; child++)
+        {
+            for(int j = 0; j < TEST_FORK_LINES; j++)
+                assert(seen[child][j] == 1);
+        }
+        for(int j = 0; j < TEST_FORK_BEFORE; j++)
+            assert(before[j] == 1);
+        for(int j = 0; j < thread_count; j++)
+            assert(thread_seen[j] == 1);
+        free(thread_seen);
+    }
+    remove("test_fork_log_file.txt");
+
+    // child drops files rotated by the parent and messages recorded by other threads, rotation and flusher
+    // threads stay in the parent
+    mylogger_t* logger = mylogger_create(&(mylogger_config_t){.level = MYLOGGER_LEVEL_INFO,
+                                                              .rotation = {.max_size = 1 << 20},
+                                                              .flush = {.interval_ms = 10},
+                                                              .recorder = {.size = 4096}}, NULL);
+    assert(logger != NULL);
+    char name[MYLOGGER_FILE_NAME_MAX_SIZE + 16];
+    __mylogger_rotation_file_name(&logger->rotation, 0, name, sizeof(name));
+    MYLOGGER_DEBUG_TO(logger, "Test - fork recorded\n");
+    pthread_t thread;
+    assert(pthread_create(&thread, NULL, test_mylogger_recorder_worker, logger) == 0);
+    pthread_join(thread, NULL);
+    assert(logger->recorders != NULL && logger->recorders->next != NULL);
+    pthread_mutex_lock(&logger->rotation.mutex);
+    while(logger->rotation.next_fd < 0)
+    {
+        pthread_mutex_unlock(&logger->rotation.mutex);
+        nanosleep(&(struct timespec){.tv_nsec = 1000000L}, NULL);
+        pthread_mutex_lock(&logger->rotation.mutex);
+    }
+    // files rotated just before the fork, the rotation thread is not woken up
+    logger->rotation.rotated[0] = (MyLogger_rotated_file_S){.fd = -1, .file = fopen("/dev/null", "w")};
+    logger->rotation.rotated[1] = (MyLogger_rotated_file_S){.fd = open("/dev/null", O_WRONLY)};
+    logger->rotation.rotated_count = 2;
+    pthread_mutex_unlock(&logger->rotation.mutex);
+    assert(logger->rotation.rotated[0].file != NULL && logger->rotation.rotated[1].fd >= 0);
+
+    pid_t pid = fork();
+    assert(pid >= 0);
+    if(pid == 0)
+    {
+        const MyLogger_recorder_S* own = pthread_getspecific(logger->recorder_key);
+        bool reset = logger->rotation.forked && logger->rotation.rotated_count == 0 && logger->rotation.next_fd < 0 &&
+                     logger->flusher.forked && own != NULL && own->head == 0 && !atomic_load(&own->exited);
+        for(const MyLogger_recorder_S* recorder = logger->recorders; recorder != NULL; recorder = recorder->next)
+            reset = reset && recorder->head == 0 && (recorder == own || atomic_load(&recorder->exited));
+        MYLOGGER_ERROR_TO(logger, "Test - fork child error\n");
+        mylogger_close(logger);
+        _exit(reset ? 0 : 1);
+    }
+    int status;
+    assert(waitpid(pid, &status, 0) == pid);
+    assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    pthread_mutex_lock(&logger->rotation.mutex);
+    fclose(logger->rotation.rotated[0].file);
+    close(logger->rotation.rotated[1].fd);
+    logger->rotation.rotated_count = 0;
+    pthread_mutex_unlock(&logger->rotation.mutex);
+    mylogger_close(logger);
+    assert(test_mylogger_count_lines(name, "Test - fork child error") == 1);
+    assert(test_mylogger_count_lines(name, "Test - fork recorded") == 0);
+    assert(test_mylogger_count_lines(name, "Test - recorder worker") == 0);
+    remove(name);
+
+    // child that died holding the mapping mutex does not block the others
+    f = fopen("test_fork_log_file.txt", "w+");
+    assert(f != NULL);
+    logger = mylogger_create(&(mylogger_config_t){.log_file = f, .features = MYLOGGER_FEATURE_MMAP}, NULL);
+    assert(logger != NULL);
+    pid = fork();
+    assert(pid >= 0);
+    if(pid == 0)
+    {
+        __mylogger_mmap_lock(&logger->mmap);
+        _exit(0);
+    }
+    assert(waitpid(pid, &status, 0) == pid);
+    __mylogger_mmap_lock(&logger->mmap);
+    pthread_mutex_unlock(&logger->mmap.shared->map_mutex);
+    MYLOGGER_INFO_TO(logger, "Test - fork mapping\n");
+
+    // file that cannot be truncated keeps its mapped length
+    MOCK_FAIL_AT(g_ftruncate_mock_counter, 1);
+    fprintf(stderr, "\033[0;32mExpected error: \033[0m");
+    mylogger_close(logger);
+    assert(test_mylogger_count_lines("test_fork_log_file.txt", "Test - fork mapping") == 1);
+    remove("test_fork_log_file.txt");
+
+    // shared file that cannot be switched to append mode
+    f = fopen("test_fork_log_file.txt", "w+");
+    assert(f != NULL);
+    const int fd = dup(fileno(f));
+    close(fileno(f));
+    fprintf(stderr, "\033[0;32mExpected error: \033[0m");
+    assert(mylogger_create(&(mylogger_config_t){.log_file = f, .features = MYLOGGER_FEATURE_SHARED}, NULL) == NULL);
+    dup2(fd, fileno(f));
+    close(fd);
+    fclose(f);
+    remove("test_fork_log_file.txt");
+}
+
+typedef struct test_batch_sink_t
+{
+    size_t writes;
+    size_t bytes;
+} test_batch_sink_t;
+
+static void test_batch_sink_write(void* user_data, const char* data, size_t len)
+{
+    test_batch_sink_t* sink = user_data;
+    (void)data;
+    sink->writes++;
+    sink->bytes += len;
+}
+
+static void* test_mylogger_batch_worker(void* arg)
+{
+    (void)arg;
+    MYLOGGER_INFO("Test - batch other thread\n");
+    return NULL;
+}
+
+static void* test_mylogger_batch_exit_worker(void* arg)
+{
+    (void)arg;
+    assert(mylogger_batch_begin());
+    MYLOGGER_INFO("Test - batch thread exit\n");
+    return NULL;
+}
+
+// Batch that cannot grow is written at once with the message, FATAL message writes the batch too.
+static void* test_mylogger_batch_grow_worker(void* arg)
+{
+    mylogger_t* logger = arg;
+    MYLOGGER_INFO_TO(logger, "Test - batch grow first\n");
+    assert(mylogger_logger_batch_begin(logger));
+    MOCK_FAIL_AT(g_realloc_mock_counter, 1);
+    MYLOGGER_INFO_TO(logger, "Test - batch grow failed\n");
+    MYLOGGER_INFO_TO(logger, "Test - batch appended\n");
+    MYLOGGER_FATAL_TO(logger, "Test - batch fatal\n");
+    assert(mylogger_batch_commit() == 3);
+    // empty batch is left open
+    assert(mylogger_logger_batch_begin(logger));
+    return NULL;
+}
+
+/**
+ * Testing batches. Messages of the batch keep their level, timestamp and TID and are written at once.
+ * */
+static void test_mylogger_batch(void)
+{
+    static test_batch_sink_t counter;
+    const mylogger_sink_t sink = {.write = test_batch_sink_write, .user_data = &counter};
+
+    assert(!mylogger_batch_begin());
+    assert(mylogger_batch_commit() == 0);
+
+    // outside of the batch every message is written immediately
+    FILE* f = fopen("test_batch_log_file.txt", "w+");
+    assert(f != NULL);
+    assert(mylogger_init_config(&(mylogger_config_t){.log_file = f,
+                                                     .features = MYLOGGER_FEATURE_TIMESTAMPS | MYLOGGER_FEATURE_THREAD_ID,
+                                                     .flush.size = 1,
+                                                     .sinks = &sink,
+                                                     .sinks_count = 1}) == MYLOGGER_INIT_SUCCESS);
+    mylogger_set_thread_name("batcher");
+    assert(mylogger_batch_begin());
+    assert(!mylogger_batch_begin());
+    for(int i = 0; i < 1000; i++)
+    {
+        MYLOGGER_INFO("Test - batch %d\n", i);
+        if(i % 100 == 99)
+            MYLOGGER_ERROR("Test - batch error %d\n", i);
+    }
+    assert(counter.writes == 0);
+    // other threads are not delayed
+    pthread_t thread;
+    assert(pthread_create(&thread, NULL, test_mylogger_batch_worker, NULL) == 0);
+    pthread_join(thread, NULL);
+    assert(counter.writes == 1);
+    assert(mylogger_batch_commit() == 1010);
+    assert(counter.writes == 2);
+    assert(mylogger_batch_commit() == 0);
+
+    // big batch is written in parts
+    assert(mylogger_batch_begin());
+    for(int i = 0; i < 20000; i++)
+        MYLOGGER_INFO("Test - batch big %d %0100d\n", i, i);
+    assert(counter.writes > 2);
+    assert(mylogger_batch_commit() == 20000);
+    assert(counter.writes > 4 && counter.writes < 10);
+    mylogger_set_thread_name(NULL);
+    mylogger_destroy();
+
+    f = fopen("test_batch_log_file.txt", "r");
+    assert(f != NULL);
+    char line[1024];
+    assert(fgets(line, sizeof(line), f) != NULL && strstr(line, "Test - batch other thread\n") != NULL);
+    for(int i = 0; i < 1000; i++)
+    {
+        char expected[64];
+        snprintf(expected, sizeof(expected), "Test - batch %d\n", i);
+        assert(fgets(line, sizeof(line), f) != NULL && strstr(line, expected) != NULL);
+        assert(strstr(line, "[INFO]") != NULL && strstr(line, " batcher]") != NULL);
+        if(i % 100 == 99)
+        {
+            snprintf(expected, sizeof(expected), "Test - batch error %d\n", i);
+            assert(fgets(line, sizeof(line), f) != NULL && strstr(line, expected) != NULL);
+            assert(strstr(line, "[ERROR]") != NULL && strstr(line, " batcher]") != NULL);
+        }
+    }
+    fclose(f);
+    assert(test_mylogger_count_lines("test_batch_log_file.txt", "Test - batch big") == 20000);
+
+    // writer thread batches messages of ASYNC instances already
+    f = fopen("test_batch_log_file.txt", "w+");
+    assert(f != NULL);
+    mylogger_t* logger = mylogger_create(&(mylogger_config_t){.log_file = f, .features = MYLOGGER_FEATURE_ASYNC}, NULL);
+    assert(logger != NULL);
+    assert(!mylogger_logger_batch_begin(logger));
+    MYLOGGER_INFO_TO(logger, "Test - batch async\n");
+    assert(mylogger_batch_commit() == 0);
+    mylogger_close(logger);
+    assert(test_mylogger_count_lines("test_batch_log_file.txt", "Test - batch async") == 1);
+
+    // dumped flight recorder stays in front of the error
+    f = fopen("test_batch_log_file.txt", "w+");
+    assert(f != NULL);
+    logger = mylogger_create(&(mylogger_config_t){.log_file = f, .level = MYLOGGER_LEVEL_INFO, .recorder.size = 4096}, NULL);
+    assert(logger != NULL);
+    assert(mylogger_logger_batch_begin(logger));
+    MYLOGGER_DEBUG_TO(logger, "Test - batch recorded\n");
+    MYLOGGER_ERROR_TO(logger, "Test - batch recorded error\n");
+    assert(mylogger_batch_commit() == 2);
+    mylogger_close(logger);
+    f = fopen("test_batch_log_file.txt", "r");
+    assert(f != NULL);
+    assert(fgets(line, sizeof(line), f) != NULL && strstr(line, "[DEBUG]") != NULL && strstr(line, "Test - batch recorded\n") != NULL);
+    assert(fgets(line, sizeof(line), f) != NULL && strstr(line, "Test - batch recorded error\n") != NULL);
+    fclose(f);
+
+    // uncommitted batch is written by close and destroy of its instance and when its thread exits
+    f = fopen("test_batch_log_file.txt", "w+");
+    assert(f != NULL);
+    logger = mylogger_create(&(mylogger_config_t){.log_file = f}, NULL);
+    assert(logger != NULL);
+    assert(mylogger_logger_batch_begin(logger));
+    MYLOGGER_INFO_TO(logger, "Test - batch closed\n");
+    mylogger_close(logger);
+    assert(mylogger_batch_commit() == 0);
+    assert(test_mylogger_count_lines("test_batch_log_file.txt", "Test - batch closed") == 1);
+
+    f = fopen("test_batch_log_file.txt", "w+");
+    assert(f != NULL);
+    assert(mylogger_init(f, 0) == MYLOGGER_INIT_SUCCESS);
+    assert(pthread_create(&thread, NULL, test_mylogger_batch_exit_worker, NULL) == 0);
+    pthread_join(thread, NULL);
+    assert(mylogger_batch_begin());
+    MYLOGGER_INFO("Test - batch destroyed\n");
+    mylogger_destroy();
+    assert(mylogger_batch_commit() == 0);
+    assert(test_mylogger_count_lines("test_batch_log_file.txt", "Test - batch thread exit") == 1);
+    assert(test_mylogger_count_lines("test_batch_log_file.txt", "Test - batch destroyed") == 1);
+
+    // batch of a mapped file with custom sink and counters, instance of the exiting thread is not the newest one
+    f = fopen("test_batch_log_file.txt", "w+");
+    assert(f != NULL);
+    counter = (test_batch_sink_t){0};
+    logger = mylogger_create(&(mylogger_config_t){.log_file = f,
+                                                  .features = MYLOGGER_FEATURE_MMAP | MYLOGGER_FEATURE_STATS,
+                                                  .sinks = &sink,
+                                                  .sinks_count = 1}, NULL);
+    assert(logger != NULL);
+    mylogger_t* other = mylogger_create(&(mylogger_config_t){.features = MYLOGGER_FEATURE_NO_FILE | MYLOGGER_FEATURE_STDERR}, NULL);
+    assert(other != NULL);
+    assert(pthread_create(&thread, NULL, test_mylogger_batch_grow_worker, logger) == 0);
+    pthread_join(thread, NULL);
+    mylogger_close(other);
+    mylogger_stats_t stats;
+    assert(mylogger_logger_get_stats(logger, &stats));
+    assert(stats.messages[MYLOGGER_LEVEL_INFO] == 3 && stats.messages[MYLOGGER_LEVEL_FATAL] == 1 && stats.bytes > 0);
+    mylogger_close(logger);
+    assert(counter.bytes > 0);
+    assert(test_mylogger_count_lines("test_batch_log_file.txt", "Test - batch grow") == 2);
+    assert(test_mylogger_count_lines("test_batch_log_file.txt", "Test - batch appended") == 1);
+    assert(test_mylogger_count_lines("test_batch_log_file.txt", "Test - batch fatal") == 1);
+    remove("test_batch_log_file.txt");
+}
+
 // "make clean" after running tests to remove created files.
 int main(void)
 {
@@ -157,6 +3629,30 @@ int main(void)
     test_mylogger_full_log_to_file();
     test_mylogger_log_to_stdout();
     test_mylogger_log_to_stderr();
+    test_mylogger_async_log_to_file();
+    test_mylogger_deferred_render();
+    test_mylogger_deferred_log_to_file();
+    test_mylogger_level_threshold();
+    test_mylogger_destroy_waits_for_readers();
+    test_mylogger_timestamps();
+    test_mylogger_thread_tag();
+    test_mylogger_long_messages();
+    test_mylogger_custom_sinks();
+    test_mylogger_mmap_log_to_file();
+    test_mylogger_rotation();
+    test_mylogger_binary_log();
+    test_mylogger_call_sites();
+    test_mylogger_overload();
+    test_mylogger_rate_limits();
+    test_mylogger_crash_trace();
+    test_mylogger_instances();
+    test_mylogger_structured();
+    test_mylogger_stats();
+    test_mylogger_io_uring();
+    test_mylogger_recorder();
+    test_mylogger_fast_format();
+    test_mylogger_fork_writers();
+    test_mylogger_batch();
     printf("\033[0;32mTests finished successfully!\033[0m\n");
     return 0;
 }
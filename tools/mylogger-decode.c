@@ -0,0 +1,44 @@
+/*
+ * Converts log file written with MYLOGGER_FEATURE_BINARY to the text layout.
+ * Has to run on a machine with the same ABI as the program that wrote the file.
+ *
+ * Usage: ./mylogger-decode [binary_log_file] [text_output_file]
+ * Reads stdin and writes stdout when files are not given.
+ * */
+#include <stdio.h>
+#include <string.h>
+
+#include <mylogger/mylogger.h>
+
+int main(int argc, char* argv[])
+{
+    if(argc > 3 || (argc > 1 && (strcmp(argv[1], "-h") == 0 || strcmp(argv[1], "--help") == 0)))
+    {
+        fprintf(stderr, "Usage: %s [binary_log_file] [text_output_file]\n", argv[0]);
+        return 2;
+    }
+
+    FILE* in = argc > 1 ? fopen(argv[1], "rb") : stdin;
+    if(in == NULL)
+    {
+        perror(argv[1]);
+        return 1;
+    }
+    FILE* out = argc > 2 ? fopen(argv[2], "w") : stdout;
+    if(out == NULL)
+    {
+        perror(argv[2]);
+        fclose(in);
+        return 1;
+    }
+
+    const int ret = mylogger_decode(in, out);
+    if(ret != 0)
+        fprintf(stderr, "%s: input is not a valid MyLogger binary log\n", argv[0]);
+
+    if(in != stdin)
+        fclose(in);
+    if(out != stdout)
+        fclose(out);
+    return ret == 0 ? 0 : 1;
+}